@@ -78,7 +78,7 @@ struct conf_token confTokens[CT_ID__MAX] =
     [CT_ID_IPADDR] = {
         .ct_name = "IPADDR",
         .ct_name_len = 6,
-        .ct_val_regex = IPADDR_REGEX,
+        .ct_val_regex = NET_ADDR_REGEX,
         .ct_id = CT_ID_IPADDR,
     },
     [CT_ID_CTL_SVC_FILENAME] = {
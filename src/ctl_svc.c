@@ -472,7 +472,8 @@ ctl_svc_node_token_hndlr_IPADDR(struct ctl_svc_node *csn,
 {
     (void)ct;
 
-    if (val_buf_sz >= IPV4_STRLEN) // IPV4_STRLEN includes NULL terminator
+    // TCP_ADDR_STRLEN includes NULL terminator
+    if (val_buf_sz >= sizeof(csn->csn_peer.csnp_ipv4))
         return -ENAMETOOLONG;
 
     else if (csn->csn_type == CTL_SVC_NODE_TYPE_RAFT)
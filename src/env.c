@@ -48,6 +48,39 @@ static struct niova_env_var niovaEnvVars[] = {
         .nev_present   = false,
         .nev_cb        = epoll_mgr_env_var_cb,
     },
+    [NIOVA_ENV_VAR_epoll_mgr_backend] = {
+        .nev_name      = "NIOVA_EPOLL_MGR_BACKEND",
+        .nev_subsystem = NIOVA_ENV_SUBSYSTEM_AIO,
+        .nev_var_num   = NIOVA_ENV_VAR_epoll_mgr_backend,
+        .nev_type      = NIOVA_ENV_VAR_TYPE_LONG,
+        .nev_default   = EPOLL_MGR_BACKEND_EPOLL,
+        .nev_min       = EPOLL_MGR_BACKEND_MIN,
+        .nev_max       = EPOLL_MGR_BACKEND_MAX,
+        .nev_present   = false,
+        .nev_cb        = epoll_mgr_backend_env_var_cb,
+    },
+    [NIOVA_ENV_VAR_epoll_mgr_busy_poll_usec] = {
+        .nev_name      = "NIOVA_EPOLL_MGR_BUSY_POLL_USEC",
+        .nev_subsystem = NIOVA_ENV_SUBSYSTEM_AIO,
+        .nev_var_num   = NIOVA_ENV_VAR_epoll_mgr_busy_poll_usec,
+        .nev_type      = NIOVA_ENV_VAR_TYPE_LONG,
+        .nev_default   = 0,
+        .nev_min       = 0,
+        .nev_max       = EPOLL_MGR_BUSY_POLL_MAX_USEC,
+        .nev_present   = false,
+        .nev_cb        = epoll_mgr_busy_poll_env_var_cb,
+    },
+    [NIOVA_ENV_VAR_epoll_mgr_profiling] = {
+        .nev_name      = "NIOVA_EPOLL_MGR_PROFILING",
+        .nev_subsystem = NIOVA_ENV_SUBSYSTEM_AIO,
+        .nev_var_num   = NIOVA_ENV_VAR_epoll_mgr_profiling,
+        .nev_type      = NIOVA_ENV_VAR_TYPE_LONG,
+        .nev_default   = 0,
+        .nev_min       = 0,
+        .nev_max       = 1,
+        .nev_present   = false,
+        .nev_cb        = epoll_mgr_profiling_env_var_cb,
+    },
     [NIOVA_ENV_VAR_inotify_base_path] = {
         .nev_name      = "NIOVA_INOTIFY_BASE_PATH",
         .nev_subsystem = NIOVA_ENV_SUBSYSTEM_CTL_INTERFACE,
@@ -133,6 +166,17 @@ static struct niova_env_var niovaEnvVars[] = {
         .nev_cb        = tcp_mgr_set_thread_cnt_env_cb,
         .nev_present   = false,
     },
+    [NIOVA_ENV_VAR_tcp_mgr_cork_usec] = {
+        .nev_name      = "NIOVA_TCP_MGR_CORK_USEC",
+        .nev_subsystem = NIOVA_ENV_SUBSYSTEM_NET,
+        .nev_var_num   = NIOVA_ENV_VAR_tcp_mgr_cork_usec,
+        .nev_type      = NIOVA_ENV_VAR_TYPE_LONG,
+        .nev_default   = 0,
+        .nev_min       = 0,
+        .nev_max       = TCP_MGR_CORK_MAX_USEC,
+        .nev_cb        = tcp_mgr_cork_usec_env_cb,
+        .nev_present   = false,
+    },
 };
 
 static void
@@ -4,11 +4,16 @@
  * Written by Paul Nowoczynski <pauln@niova.io> 2019
  */
 
+#define _GNU_SOURCE
+#include <sched.h>
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
+#include <sys/sysinfo.h>
+#include <sys/timerfd.h>
 #include <unistd.h>
 
 #include "alloc.h"
+#include "binary_hist.h"
 #include "common.h"
 #include "ctor.h"
 #include "env.h"
@@ -16,29 +21,1448 @@
 #include "log.h"
 #include "queue.h"
 #include "registry.h"
+#include "uring.h"
 
 REGISTRY_ENTRY_FILE_GENERATE;
 
+LREG_ROOT_ENTRY_GENERATE(epoll_mgr_nodes, LREG_USER_TYPE_EPOLL_MGR);
+
 typedef int epoll_mgr_thread_ctx_int_t;
 
-static long long epollMgrNumEvents = EPOLL_MGR_DEF_EVENTS;
-static pthread_mutex_t epollMgrInstallLock = PTHREAD_MUTEX_INITIALIZER;
+static long long epollMgrNumEvents = EPOLL_MGR_DEF_EVENTS;
+static enum epoll_mgr_backend epollMgrDefBackend = EPOLL_MGR_BACKEND_EPOLL;
+static unsigned int epollMgrBusyPollUsec;
+static bool epollMgrProfiling;
+static unsigned int epollMgrIdCnt;
+static pthread_mutex_t epollMgrInstallLock = PTHREAD_MUTEX_INITIALIZER;
+
+enum epoll_mgr_lreg_stats
+{
+    EPOLL_MGR_LREG_ID,               // unsigned int
+    EPOLL_MGR_LREG_BACKEND,          // string
+    EPOLL_MGR_LREG_NUM_HANDLES,      // signed int
+    EPOLL_MGR_LREG_WAIT_CNT,         // unsigned int
+    EPOLL_MGR_LREG_CTX_CB_PENDING,   // signed int
+    EPOLL_MGR_LREG_BUSY_POLL_MAX,    // unsigned int
+    EPOLL_MGR_LREG_BUSY_POLL_BUDGET, // unsigned int
+    EPOLL_MGR_LREG_BUSY_POLL_SPIN,   // unsigned int
+    EPOLL_MGR_LREG_BUSY_POLL_HITS,   // unsigned int
+    EPOLL_MGR_LREG_BUSY_POLL_MISSES, // unsigned int
+    EPOLL_MGR_LREG_BLOCKING_WAKEUPS, // unsigned int
+    EPOLL_MGR_LREG_WAKEUPS,          // unsigned int
+    EPOLL_MGR_LREG_WAKE_SUPPRESSED,  // unsigned int
+    EPOLL_MGR_LREG_EVENTS_SIZE,      // signed int
+    EPOLL_MGR_LREG_EVENTS_FULL,      // unsigned int
+    EPOLL_MGR_LREG_PROFILING,        // bool
+    EPOLL_MGR_LREG_LOOP_HIST,        // histogram object
+    EPOLL_MGR_LREG_HANDLES,          // varray
+    EPOLL_MGR_LREG___MAX,
+};
+
+enum epoll_handle_lreg_stats
+{
+    EPOLL_HANDLE_LREG_FD,          // signed int
+    EPOLL_HANDLE_LREG_EVENTS,      // unsigned int
+    EPOLL_HANDLE_LREG_CB_CNT,      // unsigned int
+    EPOLL_HANDLE_LREG_CB_USEC,     // unsigned int
+    EPOLL_HANDLE_LREG_CB_MAX_USEC, // unsigned int
+    EPOLL_HANDLE_LREG_CB_HIST,     // string
+    EPOLL_HANDLE_LREG___MAX,
+};
+
+/**
+ * Per-handle callback statistics.  Entries are owned by the epm and only
+ * released when it is closed, so the epm thread may safely update an entry
+ * whose handle was removed by its own callback.  In-use entries are kept at
+ * the front of epm_prof_stats.
+ */
+struct epoll_handle_stats
+{
+    const struct epoll_handle *ehs_eph;
+    int                        ehs_fd;
+    size_t                     ehs_idx;
+    unsigned long long         ehs_cb_cnt;
+    unsigned long long         ehs_cb_usec;
+    unsigned long long         ehs_cb_max_usec;
+    struct binary_hist         ehs_cb_hist;
+};
+
+// The epm's registry node along with its inlined histogram child
+struct epoll_mgr_lreg
+{
+    struct lreg_node eml_lrn;
+    struct lreg_node eml_loop_hist_lrn;
+};
+
+static int
+epoll_handle_lreg_cb(enum lreg_node_cb_ops op, struct lreg_node *lrn,
+                     struct lreg_value *lv)
+{
+    if (!lrn || !lrn->lrn_cb_arg)
+        return -EINVAL;
+
+    struct epoll_mgr *epm = lrn->lrn_cb_arg;
+
+    if (lv)
+        lv->get.lrv_num_keys_out = EPOLL_HANDLE_LREG___MAX;
+
+    NIOVA_ASSERT(lrn->lrn_vnode_child);
+    const size_t idx = lrn->lrn_lvd.lvd_index;
+
+    int rc = 0;
+
+    niova_mutex_lock(&epm->epm_prof_mutex);
+
+    if (idx >= epm->epm_prof_nused)
+    {
+        niova_mutex_unlock(&epm->epm_prof_mutex);
+        return -ERANGE;
+    }
+
+    const struct epoll_handle_stats *ehs = epm->epm_prof_stats[idx];
+
+    switch (op)
+    {
+    case LREG_NODE_CB_OP_GET_NAME:
+        if (!lv)
+        {
+            rc = -EINVAL;
+            break;
+        }
+        strncpy(lv->lrv_key_string, "handles", LREG_VALUE_STRING_MAX);
+        strncpy(LREG_VALUE_TO_OUT_STR(lv), "none", LREG_VALUE_STRING_MAX);
+        break;
+
+    case LREG_NODE_CB_OP_READ_VAL:
+        if (!lv)
+        {
+            rc = -EINVAL;
+            break;
+        }
+        switch (lv->lrv_value_idx_in)
+        {
+        case EPOLL_HANDLE_LREG_FD:
+            lreg_value_fill_signed(lv, "fd", ehs->ehs_fd);
+            break;
+        case EPOLL_HANDLE_LREG_EVENTS:
+            lreg_value_fill_unsigned(lv, "events",
+                                     ehs->ehs_eph ?
+                                     (uint32_t)ehs->ehs_eph->eph_events : 0);
+            break;
+        case EPOLL_HANDLE_LREG_CB_CNT:
+            lreg_value_fill_unsigned(lv, "cb-cnt", ehs->ehs_cb_cnt);
+            break;
+        case EPOLL_HANDLE_LREG_CB_USEC:
+            lreg_value_fill_unsigned(lv, "cb-usec", ehs->ehs_cb_usec);
+            break;
+        case EPOLL_HANDLE_LREG_CB_MAX_USEC:
+            lreg_value_fill_unsigned(lv, "cb-max-usec", ehs->ehs_cb_max_usec);
+            break;
+        case EPOLL_HANDLE_LREG_CB_HIST:
+        {
+            char hist_str[LREG_VALUE_STRING_MAX];
+            binary_hist_to_string(&ehs->ehs_cb_hist, hist_str,
+                                  sizeof(hist_str));
+            lreg_value_fill_string(lv, "cb-usec-hist", hist_str);
+            break;
+        }
+        default:
+            rc = -EOPNOTSUPP;
+            break;
+        }
+        break;
+
+    default:
+        rc = -EOPNOTSUPP;
+        break;
+    }
+
+    niova_mutex_unlock(&epm->epm_prof_mutex);
+
+    return rc;
+}
+
+static int
+epoll_mgr_lreg_loop_hist_cb(enum lreg_node_cb_ops op, struct lreg_node *lrn,
+                            struct lreg_value *lv)
+{
+    const struct binary_hist *bh = lrn->lrn_cb_arg;
+    if (!bh)
+        return -EINVAL;
+
+    switch (op)
+    {
+    case LREG_NODE_CB_OP_WRITE_VAL:           // fall through
+    case LREG_NODE_CB_OP_INSTALL_QUEUED_NODE: // fall through
+    case LREG_NODE_CB_OP_INSTALL_NODE:        // fall through
+    case LREG_NODE_CB_OP_DESTROY_NODE:
+        break;
+
+    case LREG_NODE_CB_OP_GET_NAME:
+        if (!lv)
+            return -EINVAL;
+        lv->get.lrv_num_keys_out = binary_hist_size(bh);
+        strncpy(lv->lrv_key_string, "loop-usec", LREG_VALUE_STRING_MAX);
+        break;
+
+    case LREG_NODE_CB_OP_READ_VAL:
+    {
+        if (lv->lrv_value_idx_in >= (unsigned int)binary_hist_size(bh))
+            return -ERANGE;
+
+        char key[LREG_VALUE_STRING_MAX];
+        snprintf(key, LREG_VALUE_STRING_MAX, "%lld",
+                 binary_hist_lower_bucket_range(bh, lv->lrv_value_idx_in));
+
+        lreg_value_fill_unsigned(lv, key,
+                                 binary_hist_get_cnt(bh,
+                                                     lv->lrv_value_idx_in));
+        break;
+    }
+
+    default:
+        return -ENOENT;
+    }
+
+    return 0;
+}
+
+static int
+epoll_mgr_lreg_cb(enum lreg_node_cb_ops op, struct lreg_node *lrn,
+                  struct lreg_value *lv)
+{
+    const struct epoll_mgr *epm = lrn->lrn_cb_arg;
+    if (!epm)
+        return -EINVAL;
+
+    int rc = 0;
+
+    switch (op)
+    {
+    case LREG_NODE_CB_OP_WRITE_VAL:           // fall through
+    case LREG_NODE_CB_OP_INSTALL_QUEUED_NODE: // fall through
+    case LREG_NODE_CB_OP_INSTALL_NODE:        // fall through
+    case LREG_NODE_CB_OP_DESTROY_NODE:
+        break;
+
+    case LREG_NODE_CB_OP_GET_NAME:
+        if (!lv)
+            return -EINVAL;
+        lv->get.lrv_num_keys_out = EPOLL_MGR_LREG___MAX;
+        strncpy(lv->lrv_key_string, "epoll-mgrs", LREG_VALUE_STRING_MAX);
+        break;
+
+    case LREG_NODE_CB_OP_READ_VAL:
+        switch (lv->lrv_value_idx_in)
+        {
+        case EPOLL_MGR_LREG_ID:
+            lreg_value_fill_unsigned(lv, "id", epm->epm_id);
+            break;
+        case EPOLL_MGR_LREG_BACKEND:
+            lreg_value_fill_string(lv, "backend",
+                                   epm->epm_backend ==
+                                   EPOLL_MGR_BACKEND_IO_URING ?
+                                   "io_uring" : "epoll");
+            break;
+        case EPOLL_MGR_LREG_NUM_HANDLES:
+            lreg_value_fill_signed(lv, "num-handles",
+                                   niova_atomic_read(&epm->epm_num_handles));
+            break;
+        case EPOLL_MGR_LREG_WAIT_CNT:
+            lreg_value_fill_unsigned(lv, "epoll-wait-cnt",
+                                     epm->epm_epoll_wait_cnt);
+            break;
+        case EPOLL_MGR_LREG_CTX_CB_PENDING:
+            lreg_value_fill_signed(lv, "ctx-cb-pending",
+                                   niova_atomic_read(&epm->epm_ctx_cb_num));
+            break;
+        case EPOLL_MGR_LREG_BUSY_POLL_MAX:
+            lreg_value_fill_unsigned(lv, "busy-poll-max-usec",
+                                     epm->epm_busy_poll_max_usec);
+            break;
+        case EPOLL_MGR_LREG_BUSY_POLL_BUDGET:
+            lreg_value_fill_unsigned(lv, "busy-poll-budget-usec",
+                                     epm->epm_busy_poll_budget_usec);
+            break;
+        case EPOLL_MGR_LREG_BUSY_POLL_SPIN:
+            lreg_value_fill_unsigned(lv, "busy-poll-spin-usec",
+                                     epm->epm_busy_poll_spin_usec);
+            break;
+        case EPOLL_MGR_LREG_BUSY_POLL_HITS:
+            lreg_value_fill_unsigned(lv, "busy-poll-hits",
+                                     epm->epm_busy_poll_hits);
+            break;
+        case EPOLL_MGR_LREG_BUSY_POLL_MISSES:
+            lreg_value_fill_unsigned(lv, "busy-poll-misses",
+                                     epm->epm_busy_poll_misses);
+            break;
+        case EPOLL_MGR_LREG_BLOCKING_WAKEUPS:
+            lreg_value_fill_unsigned(lv, "blocking-wakeups",
+                                     epm->epm_blocking_wakeups);
+            break;
+        case EPOLL_MGR_LREG_WAKEUPS:
+            lreg_value_fill_unsigned(lv, "wakeups",
+                                     niova_atomic_read(&epm->epm_wakeups));
+            break;
+        case EPOLL_MGR_LREG_WAKE_SUPPRESSED:
+            lreg_value_fill_unsigned(
+                lv, "wakeups-suppressed",
+                niova_atomic_read(&epm->epm_wakeups_suppressed));
+            break;
+        case EPOLL_MGR_LREG_EVENTS_SIZE:
+            lreg_value_fill_signed(lv, "events-size", epm->epm_events_size);
+            break;
+        case EPOLL_MGR_LREG_EVENTS_FULL:
+            lreg_value_fill_unsigned(lv, "events-full-batches",
+                                     epm->epm_events_full_cnt);
+            break;
+        case EPOLL_MGR_LREG_PROFILING:
+            lreg_value_fill_bool(lv, "profiling",
+                                 epm->epm_profiling ? true : false);
+            break;
+        case EPOLL_MGR_LREG_LOOP_HIST:
+            lreg_value_fill_histogram(lv, "loop-usec", 0);
+            break;
+        case EPOLL_MGR_LREG_HANDLES:
+            lreg_value_fill_varray(lv, "handles",
+                                   LREG_USER_TYPE_EPOLL_MGR_HANDLE,
+                                   epm->epm_prof_nused, epoll_handle_lreg_cb);
+            break;
+        default:
+            break;
+        }
+        break;
+
+    default:
+        rc = -ENOENT;
+        break;
+    }
+
+    return rc;
+}
+
+static void
+epoll_mgr_lreg_install(struct epoll_mgr *epm)
+{
+    // Nothing may be installed from a destructor
+    if (destroy_ctx())
+        return;
+
+    struct epoll_mgr_lreg *eml =
+        niova_calloc_can_fail(1UL, sizeof(struct epoll_mgr_lreg));
+    if (!eml)
+    {
+        LOG_MSG(LL_WARN, "epm=%p is not visible in the registry", epm);
+        return;
+    }
+
+    struct lreg_node *lrn = &eml->eml_lrn;
+
+    lreg_node_init(lrn, LREG_USER_TYPE_EPOLL_MGR, epoll_mgr_lreg_cb, epm,
+                   LREG_INIT_OPT_INLINED_CHILDREN);
+
+    // The histogram child is attached before its parent is installed
+    lreg_node_init(&eml->eml_loop_hist_lrn,
+                   lreg_user_type_histogram_convert(0),
+                   epoll_mgr_lreg_loop_hist_cb, epm->epm_loop_hist,
+                   LREG_INIT_OPT_INLINED_MEMBER);
+
+    int rc = lreg_node_install(&eml->eml_loop_hist_lrn, lrn);
+    NIOVA_ASSERT(rc == 0);
+
+    rc = lreg_node_install(lrn, LREG_ROOT_ENTRY_PTR(epoll_mgr_nodes));
+    NIOVA_ASSERT(rc == 0);
+
+    rc = lreg_node_wait_for_completion(lrn, true);
+    NIOVA_ASSERT(rc == 0);
+
+    epm->epm_lrn = lrn;
+}
+
+static void
+epoll_mgr_lreg_remove(struct epoll_mgr *epm)
+{
+    struct lreg_node *lrn = epm->epm_lrn;
+    if (!lrn)
+        return;
+
+    int rc = lreg_node_remove(lrn, LREG_ROOT_ENTRY_PTR(epoll_mgr_nodes));
+    NIOVA_ASSERT(rc == 0);
+
+    // Ensure removal before the epm is released
+    rc = lreg_node_wait_for_completion(lrn, false);
+    NIOVA_ASSERT(rc == 0);
+
+    epm->epm_lrn = NULL;
+    niova_free(OFFSET_CAST(epoll_mgr_lreg, eml_lrn, lrn));
+}
+
+/**
+ * epoll_mgr_prof_attach - assigns a stats entry to 'eph'.  Failure to
+ *   allocate an entry only leaves the handle unprofiled.
+ */
+static void
+epoll_mgr_prof_attach(struct epoll_mgr *epm, struct epoll_handle *eph)
+{
+    struct epoll_handle_stats *ehs = NULL;
+
+    niova_mutex_lock(&epm->epm_prof_mutex);
+
+    if (epm->epm_prof_nused == epm->epm_prof_nalloc)
+    {
+        size_t nalloc = epm->epm_prof_nalloc ? epm->epm_prof_nalloc * 2 : 16;
+
+        if (!niova_reallocarray(epm->epm_prof_stats,
+                                struct epoll_handle_stats *, nalloc))
+        {
+            for (size_t i = epm->epm_prof_nalloc; i < nalloc; i++)
+                epm->epm_prof_stats[i] = NULL;
+
+            epm->epm_prof_nalloc = nalloc;
+        }
+    }
+
+    if (epm->epm_prof_nused < epm->epm_prof_nalloc)
+    {
+        ehs = epm->epm_prof_stats[epm->epm_prof_nused];
+        if (!ehs)
+        {
+            ehs = niova_malloc_can_fail(sizeof(struct epoll_handle_stats));
+            epm->epm_prof_stats[epm->epm_prof_nused] = ehs;
+        }
+    }
+
+    if (ehs)
+    {
+        ehs->ehs_eph = eph;
+        ehs->ehs_fd = eph->eph_fd;
+        ehs->ehs_idx = epm->epm_prof_nused++;
+        ehs->ehs_cb_cnt = 0;
+        ehs->ehs_cb_usec = 0;
+        ehs->ehs_cb_max_usec = 0;
+        binary_hist_init(&ehs->ehs_cb_hist, EPOLL_MGR_PROF_HIST_START_BIT,
+                         EPOLL_MGR_PROF_HIST_BUCKETS);
+    }
+
+    niova_mutex_unlock(&epm->epm_prof_mutex);
+
+    eph->eph_stats = ehs;
+}
+
+static void
+epoll_mgr_prof_detach(struct epoll_mgr *epm, struct epoll_handle *eph)
+{
+    struct epoll_handle_stats *ehs = eph->eph_stats;
+    if (!ehs)
+        return;
+
+    eph->eph_stats = NULL;
+
+    niova_mutex_lock(&epm->epm_prof_mutex);
+
+    NIOVA_ASSERT(ehs->ehs_idx < epm->epm_prof_nused &&
+                 epm->epm_prof_stats[ehs->ehs_idx] == ehs);
+
+    // Swap with the last in-use entry
+    struct epoll_handle_stats *last =
+        epm->epm_prof_stats[--epm->epm_prof_nused];
+
+    epm->epm_prof_stats[ehs->ehs_idx] = last;
+    last->ehs_idx = ehs->ehs_idx;
+
+    epm->epm_prof_stats[epm->epm_prof_nused] = ehs;
+    ehs->ehs_idx = epm->epm_prof_nused;
+    ehs->ehs_eph = NULL;
+
+    niova_mutex_unlock(&epm->epm_prof_mutex);
+}
+
+static int
+epoll_mgr_prof_setup(struct epoll_mgr *epm)
+{
+    epm->epm_prof_stats = NULL;
+    epm->epm_prof_nused = 0;
+    epm->epm_prof_nalloc = 0;
+    epm->epm_profiling = epollMgrProfiling ? 1 : 0;
+
+    epm->epm_loop_hist = niova_malloc_can_fail(sizeof(struct binary_hist));
+    if (!epm->epm_loop_hist)
+        return -ENOMEM;
+
+    binary_hist_init(epm->epm_loop_hist, EPOLL_MGR_PROF_HIST_START_BIT,
+                     EPOLL_MGR_PROF_HIST_BUCKETS);
+
+    pthread_mutex_init(&epm->epm_prof_mutex, NULL);
+
+    return 0;
+}
+
+static void
+epoll_mgr_prof_free(struct epoll_mgr *epm)
+{
+    for (size_t i = 0; i < epm->epm_prof_nalloc; i++)
+        niova_free(epm->epm_prof_stats[i]);
+
+    niova_free(epm->epm_prof_stats);
+    niova_free(epm->epm_loop_hist);
+
+    epm->epm_prof_stats = NULL;
+    epm->epm_loop_hist = NULL;
+    epm->epm_prof_nused = 0;
+    epm->epm_prof_nalloc = 0;
+
+    pthread_mutex_destroy(&epm->epm_prof_mutex);
+}
+
+static unsigned long long
+epoll_mgr_now_nsec(void)
+{
+    struct timespec now;
+    niova_unstable_clock(&now);
+
+    return timespec_2_nsec(&now);
+}
+
+/**
+ * epoll_mgr_prof_record - the entry is ignored if its handle was removed,
+ *   and possibly freed, by the callback.
+ */
+static void
+epoll_mgr_prof_record(struct epoll_handle_stats *ehs,
+                      const struct epoll_handle *eph,
+                      unsigned long long start_nsec)
+{
+    if (ehs->ehs_eph != eph)
+        return;
+
+    const unsigned long long usec =
+        (epoll_mgr_now_nsec() - start_nsec) / 1000;
+
+    ehs->ehs_cb_cnt++;
+    ehs->ehs_cb_usec += usec;
+    ehs->ehs_cb_max_usec = MAX(ehs->ehs_cb_max_usec, usec);
+    binary_hist_incorporate_val(&ehs->ehs_cb_hist, usec);
+}
+
+/**
+ * epoll_mgr_profiling_set - applies to handles which are added afterwards.
+ */
+int
+epoll_mgr_profiling_set(struct epoll_mgr *epm, bool enable)
+{
+    if (!epm)
+        return -EINVAL;
+
+    epm->epm_profiling = enable ? 1 : 0;
+
+    return 0;
+}
+
+static unsigned long long
+epoll_mgr_now_usec(void)
+{
+    struct timespec now;
+    niova_unstable_clock(&now);
+
+    return timespec_2_usec(&now);
+}
+
+// The wake and timer handles are not counted in epm_num_handles
+#define EPOLL_MGR_NUM_INTERNAL_HANDLES 2
+// Consecutive oversized waits required before the events array is halved
+#define EPOLL_MGR_EVENTS_SHRINK_WAITS 64
+
+#define EPOLL_MGR_URING_INIT_SLOTS 64
+// Only the poll bits are passed to the kernel, oneshot is implied
+#define EPOLL_MGR_URING_POLL_MASK 0xffffU
+
+/**
+ * Each handle attached to an io_uring based epm occupies a slot.  The
+ * user_data of the poll request carries the slot index along with the slot's
+ * generation so that stale completions, which arrive after a handle has been
+ * modified or removed, are discarded without touching the handle.  Slot 0 is
+ * never used so that user_data 0 may tag poll-remove requests.
+ */
+struct epoll_mgr_uring_slot
+{
+    struct epoll_handle *eus_eph;
+    uint32_t             eus_gen;
+    uint32_t             eus_next_free;
+};
+
+struct epoll_mgr_uring
+{
+    struct niova_uring           emu_ring;
+    struct epoll_mgr_uring_slot *emu_slots;
+    uint32_t                     emu_nslots;
+    uint32_t                     emu_free_slot;
+};
+
+static uint64_t
+epoll_mgr_uring_user_data(const struct epoll_mgr_uring *emu,
+                          const struct epoll_handle *eph)
+{
+    uint32_t idx = eph->eph_uring_slot;
+
+    return ((uint64_t)emu->emu_slots[idx].eus_gen << 32) | idx;
+}
+
+static struct epoll_handle *
+epoll_mgr_uring_lookup(const struct epoll_mgr_uring *emu, uint64_t user_data)
+{
+    uint32_t idx = (uint32_t)user_data;
+    uint32_t gen = (uint32_t)(user_data >> 32);
+
+    if (!idx || idx >= emu->emu_nslots || emu->emu_slots[idx].eus_gen != gen)
+        return NULL;
+
+    return emu->emu_slots[idx].eus_eph;
+}
+
+static int
+epoll_mgr_uring_slot_alloc(struct epoll_mgr_uring *emu,
+                           struct epoll_handle *eph)
+{
+    if (!emu->emu_free_slot)
+    {
+        uint32_t nslots =
+            emu->emu_nslots ? emu->emu_nslots * 2 : EPOLL_MGR_URING_INIT_SLOTS;
+
+        int rc = niova_reallocarray(emu->emu_slots,
+                                    struct epoll_mgr_uring_slot, nslots);
+        if (rc)
+            return rc;
+
+        // Link the new slots into the free list, skipping slot 0
+        for (uint32_t i = MAX(1, emu->emu_nslots); i < nslots; i++)
+        {
+            emu->emu_slots[i].eus_eph = NULL;
+            emu->emu_slots[i].eus_gen = 0;
+            emu->emu_slots[i].eus_next_free = (i + 1 < nslots) ? i + 1 : 0;
+        }
+
+        emu->emu_free_slot = MAX(1, emu->emu_nslots);
+        emu->emu_nslots = nslots;
+    }
+
+    uint32_t idx = emu->emu_free_slot;
+    struct epoll_mgr_uring_slot *eus = &emu->emu_slots[idx];
+
+    emu->emu_free_slot = eus->eus_next_free;
+    eus->eus_eph = eph;
+    eus->eus_next_free = 0;
+
+    eph->eph_uring_slot = idx;
+
+    return 0;
+}
+
+static void
+epoll_mgr_uring_slot_free(struct epoll_mgr_uring *emu,
+                          struct epoll_handle *eph)
+{
+    uint32_t idx = eph->eph_uring_slot;
+    NIOVA_ASSERT(idx && idx < emu->emu_nslots);
+
+    struct epoll_mgr_uring_slot *eus = &emu->emu_slots[idx];
+
+    eus->eus_eph = NULL;
+    eus->eus_gen++;
+    eus->eus_next_free = emu->emu_free_slot;
+    emu->emu_free_slot = idx;
+
+    eph->eph_uring_slot = 0;
+}
+
+static int
+epoll_mgr_uring_arm(struct epoll_mgr_uring *emu, struct epoll_handle *eph)
+{
+    struct io_uring_sqe *sqe = niova_uring_get_sqe(&emu->emu_ring);
+    if (!sqe)
+        return -EAGAIN;
+
+    niova_uring_prep_poll_add(sqe, eph->eph_fd,
+                              eph->eph_events & EPOLL_MGR_URING_POLL_MASK,
+                              epoll_mgr_uring_user_data(emu, eph));
+    niova_uring_sqe_commit(&emu->emu_ring);
+
+    eph->eph_uring_armed = 1;
+
+    return 0;
+}
+
+/**
+ * epoll_mgr_uring_disarm - cancels the outstanding poll request, if any, and
+ *   advances the slot generation so that any completion which is already in
+ *   flight will be ignored.
+ */
+static int
+epoll_mgr_uring_disarm(struct epoll_mgr_uring *emu, struct epoll_handle *eph)
+{
+    if (eph->eph_uring_armed)
+    {
+        struct io_uring_sqe *sqe = niova_uring_get_sqe(&emu->emu_ring);
+        if (!sqe)
+            return -EAGAIN;
+
+        niova_uring_prep_poll_remove(sqe,
+                                     epoll_mgr_uring_user_data(emu, eph), 0);
+        niova_uring_sqe_commit(&emu->emu_ring);
+
+        eph->eph_uring_armed = 0;
+    }
+
+    emu->emu_slots[eph->eph_uring_slot].eus_gen++;
+
+    return 0;
+}
+
+/**
+ * epoll_mgr_uring_ctl - io_uring counterpart to epoll_ctl().  Requests issued
+ *   from the epm thread are left in the SQ so they may be submitted along
+ *   with the next wait.
+ */
+static int
+epoll_mgr_uring_ctl(struct epoll_mgr *epm, int op, struct epoll_handle *eph)
+{
+    struct epoll_mgr_uring *emu = epm->epm_uring;
+    int rc = 0;
+
+    niova_mutex_lock(&epm->epm_mutex);
+
+    switch (op)
+    {
+    case EPOLL_CTL_ADD:
+        rc = epoll_mgr_uring_slot_alloc(emu, eph);
+        if (!rc)
+        {
+            rc = epoll_mgr_uring_arm(emu, eph);
+            if (rc)
+                epoll_mgr_uring_slot_free(emu, eph);
+        }
+        break;
+    case EPOLL_CTL_MOD:
+        rc = epoll_mgr_uring_disarm(emu, eph);
+        if (!rc)
+            rc = epoll_mgr_uring_arm(emu, eph);
+        break;
+    case EPOLL_CTL_DEL:
+        rc = epoll_mgr_uring_disarm(emu, eph);
+        epoll_mgr_uring_slot_free(emu, eph);
+        break;
+    default:
+        rc = -EINVAL;
+        break;
+    }
+
+    if (epm->epm_thread_id != pthread_self())
+    {
+        int submit_rc = niova_uring_submit(&emu->emu_ring);
+        if (submit_rc < 0)
+            SIMPLE_LOG_MSG(LL_WARN, "niova_uring_submit(): %s",
+                           strerror(-submit_rc));
+    }
+
+    niova_mutex_unlock(&epm->epm_mutex);
+
+    return rc;
+}
+
+/**
+ * epoll_mgr_uring_wait - submits pending SQEs and waits for poll completions
+ *   in a single system call.  'user_data' receives the tag of each returned
+ *   event so that the handle may be re-armed once its callback has run.
+ */
+static int
+epoll_mgr_uring_wait(struct epoll_mgr *epm, struct epoll_event *evs,
+                     uint64_t *user_data, int maxevents, int timeout)
+{
+    struct epoll_mgr_uring *emu = epm->epm_uring;
+    struct niova_uring *nur = &emu->emu_ring;
+
+    niova_mutex_lock(&epm->epm_mutex);
+    unsigned int pending = niova_uring_sq_pending(nur);
+    niova_mutex_unlock(&epm->epm_mutex);
+
+    bool wait = (timeout && !niova_uring_cq_ready(nur)) ? true : false;
+
+    if (pending || wait)
+    {
+        int rc = niova_uring_enter(nur, pending, wait ? 1 : 0, timeout);
+        if (rc < 0)
+            return rc;
+    }
+
+    unsigned int ready = niova_uring_cq_ready(nur);
+    unsigned int i;
+    int nevents = 0;
+
+    niova_mutex_lock(&epm->epm_mutex);
+
+    for (i = 0; i < ready && nevents < maxevents; i++)
+    {
+        const struct io_uring_cqe *cqe = niova_uring_cqe_get(nur, i);
+
+        struct epoll_handle *eph =
+            epoll_mgr_uring_lookup(emu, cqe->user_data);
+        if (!eph)
+            continue;
+
+        eph->eph_uring_armed = 0;
+
+        if (cqe->res < 0)
+        {
+            if (cqe->res != -ECANCELED)
+                SIMPLE_LOG_MSG(LL_NOTIFY, "poll eph=%p fd=%d: %s",
+                               eph, eph->eph_fd, strerror(-cqe->res));
+            continue;
+        }
+
+        evs[nevents].events = cqe->res;
+        evs[nevents].data.ptr = eph;
+        user_data[nevents] = cqe->user_data;
+        nevents++;
+    }
+
+    niova_uring_cq_advance(nur, i);
+
+    niova_mutex_unlock(&epm->epm_mutex);
+
+    return nevents;
+}
+
+/**
+ * epoll_mgr_uring_rearm - single-shot polls are re-issued after the handle's
+ *   callback has run, which preserves epoll's level-triggered semantics.  The
+ *   slot lookup ensures 'eph' has not been modified or removed, and possibly
+ *   freed, by the callback.
+ */
+static void
+epoll_mgr_uring_rearm(struct epoll_mgr *epm, struct epoll_handle *eph,
+                      uint64_t user_data)
+{
+    struct epoll_mgr_uring *emu = epm->epm_uring;
+
+    niova_mutex_lock(&epm->epm_mutex);
+
+    if (epoll_mgr_uring_lookup(emu, user_data) == eph &&
+        eph->eph_installed && !eph->eph_destroying && !eph->eph_uring_armed &&
+        !(eph->eph_events & EPOLLONESHOT))
+    {
+        int rc = epoll_mgr_uring_arm(emu, eph);
+        if (rc)
+            SIMPLE_LOG_MSG(LL_WARN, "epoll_mgr_uring_arm(eph=%p): %s",
+                           eph, strerror(-rc));
+    }
+
+    niova_mutex_unlock(&epm->epm_mutex);
+}
+
+static int
+epoll_mgr_uring_setup(struct epoll_mgr *epm)
+{
+    struct epoll_mgr_uring *emu =
+        niova_calloc_can_fail(1UL, sizeof(struct epoll_mgr_uring));
+    if (!emu)
+        return -ENOMEM;
+
+    int rc = niova_uring_setup(&emu->emu_ring, NIOVA_URING_DEF_ENTRIES);
+    if (rc)
+    {
+        niova_free(emu);
+        return rc;
+    }
+
+    epm->epm_uring = emu;
+    epm->epm_epfd = emu->emu_ring.nur_fd;
+
+    return 0;
+}
+
+static void
+epoll_mgr_uring_close(struct epoll_mgr *epm)
+{
+    struct epoll_mgr_uring *emu = epm->epm_uring;
+    if (!emu)
+        return;
+
+    epm->epm_uring = NULL;
+
+    niova_uring_close(&emu->emu_ring);
+    niova_free(emu->emu_slots);
+    niova_free(emu);
+}
+
+static int
+epoll_mgr_ctl(struct epoll_mgr *epm, int op, struct epoll_handle *eph)
+{
+    if (epm->epm_backend == EPOLL_MGR_BACKEND_IO_URING)
+        return epoll_mgr_uring_ctl(epm, op, eph);
+
+    struct epoll_event ev = {.events = eph->eph_events, .data.ptr = eph};
+
+    return epoll_ctl(epm->epm_epfd, op, eph->eph_fd, &ev) ? -errno : 0;
+}
+
+static void
+epoll_mgr_wake_cb(const struct epoll_handle *eph, uint32_t evs)
+{
+    (void)evs;
+
+    uint64_t eventcnt;
+    int rc = read(eph->eph_fd, &eventcnt, sizeof(eventcnt));
+    SIMPLE_LOG_MSG(LL_TRACE, "read(): rc=%d evcnt=%lu", rc, eventcnt);
+}
+
+#define EPOLL_MGR_TIMER_WHEEL_MASK (EPOLL_MGR_TIMER_WHEEL_SLOTS - 1)
+#define EPOLL_MGR_TIMER_WHEEL_RANGE                                 \
+    (1ULL << (EPOLL_MGR_TIMER_WHEEL_BITS * EPOLL_MGR_TIMER_WHEEL_LEVELS))
+// Level marker for timers which have expired but whose cb has not yet run
+#define EPOLL_MGR_TIMER_LEVEL_EXPIRED EPOLL_MGR_TIMER_WHEEL_LEVELS
+
+LIST_HEAD(epoll_mgr_timer_list, epoll_mgr_timer);
+
+/**
+ * emtw_tick is the next tick to be processed, ticks are counted from
+ * emtw_base_usec.  emtw_next_tick is the tick for which the timerfd is
+ * currently programmed or UINT64_MAX if the timerfd is idle.
+ */
+struct epoll_mgr_timer_wheel
+{
+    pthread_mutex_t             emtw_mutex;
+    struct epoll_handle         emtw_eph;
+    unsigned long long          emtw_base_usec;
+    uint64_t                    emtw_tick;
+    uint64_t                    emtw_next_tick;
+    size_t                      emtw_num_armed;
+    size_t                      emtw_level_cnt[EPOLL_MGR_TIMER_WHEEL_LEVELS];
+    struct epoll_mgr_timer_list emtw_expired;
+    struct epoll_mgr_timer_list
+    emtw_slots[EPOLL_MGR_TIMER_WHEEL_LEVELS][EPOLL_MGR_TIMER_WHEEL_SLOTS];
+};
+
+static size_t
+epoll_mgr_timer_wheel_count(const struct epoll_mgr_timer_wheel *emtw)
+{
+    size_t cnt = 0;
+    for (int i = 0; i < EPOLL_MGR_TIMER_WHEEL_LEVELS; i++)
+        cnt += emtw->emtw_level_cnt[i];
+
+    return cnt;
+}
+
+static void
+epoll_mgr_timer_wheel_insert(struct epoll_mgr_timer_wheel *emtw,
+                             struct epoll_mgr_timer *emt)
+{
+    uint64_t expire = MAX(emt->emt_expire_tick, emtw->emtw_tick);
+    uint64_t delta = expire - emtw->emtw_tick;
+
+    // Timers beyond the range of the wheel are revisited when they come due
+    if (delta >= EPOLL_MGR_TIMER_WHEEL_RANGE)
+        expire = emtw->emtw_tick + EPOLL_MGR_TIMER_WHEEL_RANGE - 1;
+
+    int level = 0;
+    while (level < EPOLL_MGR_TIMER_WHEEL_LEVELS - 1 &&
+           delta >= (1ULL << (EPOLL_MGR_TIMER_WHEEL_BITS * (level + 1))))
+        level++;
+
+    size_t idx = (expire >> (EPOLL_MGR_TIMER_WHEEL_BITS * level)) &
+        EPOLL_MGR_TIMER_WHEEL_MASK;
+
+    LIST_INSERT_HEAD(&emtw->emtw_slots[level][idx], emt, emt_lentry);
+
+    emt->emt_level = level;
+    emtw->emtw_level_cnt[level]++;
+}
+
+static void
+epoll_mgr_timer_wheel_remove(struct epoll_mgr_timer_wheel *emtw,
+                             struct epoll_mgr_timer *emt)
+{
+    LIST_REMOVE(emt, emt_lentry);
+
+    if (emt->emt_level < EPOLL_MGR_TIMER_WHEEL_LEVELS)
+        emtw->emtw_level_cnt[emt->emt_level]--;
+}
+
+/**
+ * epoll_mgr_timer_wheel_cascade - redistributes the timers of a higher level
+ *   slot into the levels below.  Returns the slot index so the caller knows
+ *   whether the next level should be cascaded as well.
+ */
+static size_t
+epoll_mgr_timer_wheel_cascade(struct epoll_mgr_timer_wheel *emtw, int level)
+{
+    size_t idx = (emtw->emtw_tick >> (EPOLL_MGR_TIMER_WHEEL_BITS * level)) &
+        EPOLL_MGR_TIMER_WHEEL_MASK;
+
+    struct epoll_mgr_timer_list *slot = &emtw->emtw_slots[level][idx];
+    struct epoll_mgr_timer *emt;
+
+    while ((emt = LIST_FIRST(slot)))
+    {
+        epoll_mgr_timer_wheel_remove(emtw, emt);
+        epoll_mgr_timer_wheel_insert(emtw, emt);
+    }
+
+    return idx;
+}
+
+/**
+ * epoll_mgr_timer_wheel_advance - processes each tick up to and including
+ *   'now_tick'.  Due timers are moved onto the expired list, their callbacks
+ *   are issued once the wheel lock has been released.
+ */
+static void
+epoll_mgr_timer_wheel_advance(struct epoll_mgr_timer_wheel *emtw,
+                              uint64_t now_tick)
+{
+    for (; emtw->emtw_tick <= now_tick; emtw->emtw_tick++)
+    {
+        if (!epoll_mgr_timer_wheel_count(emtw)) // nothing to do, skip ahead
+        {
+            emtw->emtw_tick = now_tick + 1;
+            break;
+        }
+
+        // With an empty lowest level only the cascade points matter
+        if (!emtw->emtw_level_cnt[0] &&
+            (emtw->emtw_tick & EPOLL_MGR_TIMER_WHEEL_MASK))
+        {
+            uint64_t cascade_tick =
+                (emtw->emtw_tick + EPOLL_MGR_TIMER_WHEEL_MASK) &
+                ~(uint64_t)EPOLL_MGR_TIMER_WHEEL_MASK;
+
+            if (cascade_tick > now_tick)
+            {
+                emtw->emtw_tick = now_tick + 1;
+                break;
+            }
+
+            emtw->emtw_tick = cascade_tick;
+        }
+
+        for (int level = 1; level < EPOLL_MGR_TIMER_WHEEL_LEVELS; level++)
+        {
+            uint64_t lower_mask =
+                (1ULL << (EPOLL_MGR_TIMER_WHEEL_BITS * level)) - 1;
+
+            if ((emtw->emtw_tick & lower_mask) ||
+                epoll_mgr_timer_wheel_cascade(emtw, level))
+                break;
+        }
+
+        struct epoll_mgr_timer_list *slot =
+            &emtw->emtw_slots[0][emtw->emtw_tick & EPOLL_MGR_TIMER_WHEEL_MASK];
+
+        struct epoll_mgr_timer_list due = LIST_HEAD_INITIALIZER(due);
+        struct epoll_mgr_timer *emt;
+
+        // Detach the slot since clamped timers may be placed back into it
+        while ((emt = LIST_FIRST(slot)))
+        {
+            epoll_mgr_timer_wheel_remove(emtw, emt);
+            LIST_INSERT_HEAD(&due, emt, emt_lentry);
+        }
+
+        while ((emt = LIST_FIRST(&due)))
+        {
+            LIST_REMOVE(emt, emt_lentry);
+
+            if (emt->emt_expire_tick > emtw->emtw_tick)
+            {
+                epoll_mgr_timer_wheel_insert(emtw, emt);
+            }
+            else
+            {
+                emt->emt_level = EPOLL_MGR_TIMER_LEVEL_EXPIRED;
+                LIST_INSERT_HEAD(&emtw->emtw_expired, emt, emt_lentry);
+            }
+        }
+    }
+}
+
+/**
+ * epoll_mgr_timer_wheel_next_tick - finds the next tick which requires
+ *   attention, either the first occupied slot of the lowest level or the
+ *   earliest point at which an occupied upper level slot is cascaded.
+ */
+static uint64_t
+epoll_mgr_timer_wheel_next_tick(const struct epoll_mgr_timer_wheel *emtw)
+{
+    uint64_t next = UINT64_MAX;
+
+    for (int level = 0; level < EPOLL_MGR_TIMER_WHEEL_LEVELS; level++)
+    {
+        if (!emtw->emtw_level_cnt[level])
+            continue;
+
+        const int shift = EPOLL_MGR_TIMER_WHEEL_BITS * level;
+        const uint64_t span_mask = (1ULL << shift) - 1;
+        const uint64_t first = (emtw->emtw_tick + span_mask) & ~span_mask;
+
+        for (uint64_t i = 0; i < EPOLL_MGR_TIMER_WHEEL_SLOTS; i++)
+        {
+            uint64_t tick = first + (i << shift);
+            size_t idx = (tick >> shift) & EPOLL_MGR_TIMER_WHEEL_MASK;
+
+            if (!LIST_EMPTY(&emtw->emtw_slots[level][idx]))
+            {
+                next = MIN(next, tick);
+                break;
+            }
+        }
+    }
+
+    return next;
+}
+
+static void
+epoll_mgr_timer_wheel_program(struct epoll_mgr_timer_wheel *emtw,
+                              uint64_t next_tick)
+{
+    if (next_tick == emtw->emtw_next_tick)
+        return;
+
+    struct itimerspec its = {0};
+
+    // An all-zero setting disarms the timerfd
+    if (next_tick != UINT64_MAX)
+        usec_2_timespec(&its.it_value, emtw->emtw_base_usec +
+                        next_tick * EPOLL_MGR_TIMER_TICK_USEC);
+
+    if (timerfd_settime(emtw->emtw_eph.eph_fd, TFD_TIMER_ABSTIME, &its, NULL))
+    {
+        SIMPLE_LOG_MSG(LL_WARN, "timerfd_settime(): %s", strerror(errno));
+        return;
+    }
+
+    emtw->emtw_next_tick = next_tick;
+}
+
+static uint64_t
+epoll_mgr_timer_wheel_now_tick(const struct epoll_mgr_timer_wheel *emtw)
+{
+    return (epoll_mgr_now_usec() - emtw->emtw_base_usec) /
+        EPOLL_MGR_TIMER_TICK_USEC;
+}
 
+/**
+ * epoll_mgr_timer_wheel_cb - timerfd handler which advances the wheel and
+ *   runs the callbacks of expired timers.  Timers are taken from the expired
+ *   list one at a time so that callbacks may freely arm or cancel any timer,
+ *   including the one being run.
+ */
 static void
-epoll_mgr_wake_cb(const struct epoll_handle *eph, uint32_t evs)
+epoll_mgr_timer_wheel_cb(const struct epoll_handle *eph, uint32_t evs)
 {
     (void)evs;
 
-    uint64_t eventcnt;
-    int rc = read(eph->eph_fd, &eventcnt, sizeof(eventcnt));
-    SIMPLE_LOG_MSG(LL_TRACE, "read(): rc=%d evcnt=%lu", rc, eventcnt);
+    struct epoll_mgr *epm = eph->eph_arg;
+    struct epoll_mgr_timer_wheel *emtw = epm->epm_timers;
+
+    uint64_t expirations;
+    int rc = read(eph->eph_fd, &expirations, sizeof(expirations));
+    SIMPLE_LOG_MSG(LL_TRACE, "read(): rc=%d", rc);
+
+    niova_mutex_lock(&emtw->emtw_mutex);
+
+    epoll_mgr_timer_wheel_advance(emtw, epoll_mgr_timer_wheel_now_tick(emtw));
+
+    // Force reprogramming since the timerfd has fired
+    emtw->emtw_next_tick = 0;
+    epoll_mgr_timer_wheel_program(emtw, epoll_mgr_timer_wheel_next_tick(emtw));
+
+    struct epoll_mgr_timer *emt;
+    while ((emt = LIST_FIRST(&emtw->emtw_expired)))
+    {
+        LIST_REMOVE(emt, emt_lentry);
+        emt->emt_armed = 0;
+        emt->emt_epm = NULL;
+        emtw->emtw_num_armed--;
+
+        epoll_mgr_timer_cb_t cb = emt->emt_cb;
+        void *arg = emt->emt_arg;
+
+        niova_mutex_unlock(&emtw->emtw_mutex);
+
+        cb(emt, arg);
+
+        niova_mutex_lock(&emtw->emtw_mutex);
+    }
+
+    niova_mutex_unlock(&emtw->emtw_mutex);
+}
+
+void
+epoll_mgr_timer_init(struct epoll_mgr_timer *emt, epoll_mgr_timer_cb_t cb,
+                     void *arg)
+{
+    if (!emt)
+        return;
+
+    memset(emt, 0, sizeof(*emt));
+    emt->emt_cb = cb;
+    emt->emt_arg = arg;
+}
+
+/**
+ * epoll_mgr_timer_arm - schedules 'emt' to expire in 'usec' microseconds,
+ *   rounded up to the wheel's tick.  An armed timer is rescheduled.  The
+ *   timer may be armed from any thread but remains bound to 'epm' until it
+ *   expires or is canceled.
+ */
+int
+epoll_mgr_timer_arm(struct epoll_mgr *epm, struct epoll_mgr_timer *emt,
+                    unsigned long long usec)
+{
+    if (!epm || !emt || !emt->emt_cb || !epm->epm_timers)
+        return -EINVAL;
+
+    struct epoll_mgr_timer_wheel *emtw = epm->epm_timers;
+    int rc = 0;
+
+    niova_mutex_lock(&emtw->emtw_mutex);
+
+    // 'ready' is checked under the lock, see epoll_mgr_close()
+    if (!epm->epm_ready)
+    {
+        rc = -EINVAL;
+    }
+    else if (emt->emt_armed && emt->emt_epm != epm)
+    {
+        rc = -EBUSY;
+    }
+    else
+    {
+        if (emt->emt_armed)
+            epoll_mgr_timer_wheel_remove(emtw, emt);
+        else
+            emtw->emtw_num_armed++;
+
+        const unsigned long long now_usec =
+            epoll_mgr_now_usec() - emtw->emtw_base_usec;
+
+        // An idle wheel may lag far behind, bring it up to date
+        if (!epoll_mgr_timer_wheel_count(emtw))
+            emtw->emtw_tick = MAX(emtw->emtw_tick,
+                                  now_usec / EPOLL_MGR_TIMER_TICK_USEC);
+
+        emt->emt_expire_tick =
+            (now_usec + usec + EPOLL_MGR_TIMER_TICK_USEC - 1) /
+            EPOLL_MGR_TIMER_TICK_USEC;
+        emt->emt_epm = epm;
+        emt->emt_armed = 1;
+
+        epoll_mgr_timer_wheel_insert(emtw, emt);
+
+        uint64_t tick = MAX(emt->emt_expire_tick, emtw->emtw_tick);
+        if (tick < emtw->emtw_next_tick)
+            epoll_mgr_timer_wheel_program(emtw, tick);
+    }
+
+    niova_mutex_unlock(&emtw->emtw_mutex);
+
+    return rc;
+}
+
+/**
+ * epoll_mgr_timer_cancel - removes an armed timer.  Returns -ENOENT if the
+ *   timer is not armed, in which case its callback may be running.  The
+ *   timerfd is left as is, a spurious wakeup is cheaper than a system call.
+ */
+int
+epoll_mgr_timer_cancel(struct epoll_mgr *epm, struct epoll_mgr_timer *emt)
+{
+    if (!epm || !emt || !epm->epm_timers)
+        return -EINVAL;
+
+    struct epoll_mgr_timer_wheel *emtw = epm->epm_timers;
+    int rc = 0;
+
+    niova_mutex_lock(&emtw->emtw_mutex);
+
+    if (!emt->emt_armed)
+    {
+        rc = -ENOENT;
+    }
+    else if (emt->emt_epm != epm)
+    {
+        rc = -EINVAL;
+    }
+    else
+    {
+        epoll_mgr_timer_wheel_remove(emtw, emt);
+        emt->emt_armed = 0;
+        emt->emt_epm = NULL;
+        emtw->emtw_num_armed--;
+    }
+
+    niova_mutex_unlock(&emtw->emtw_mutex);
+
+    return rc;
+}
+
+static void
+epoll_mgr_timer_wheel_close(struct epoll_mgr *epm)
+{
+    struct epoll_mgr_timer_wheel *emtw = epm->epm_timers;
+    if (!emtw)
+        return;
+
+    epm->epm_timers = NULL;
+
+    if (emtw->emtw_eph.eph_fd >= 0 && close(emtw->emtw_eph.eph_fd))
+        LOG_MSG(LL_WARN, "epm=%p close(fd=%d): %s", epm,
+                emtw->emtw_eph.eph_fd, strerror(errno));
+
+    pthread_mutex_destroy(&emtw->emtw_mutex);
+    niova_free(emtw);
+}
+
+static int
+epoll_mgr_timer_wheel_setup(struct epoll_mgr *epm)
+{
+    struct epoll_mgr_timer_wheel *emtw =
+        niova_calloc_can_fail(1UL, sizeof(struct epoll_mgr_timer_wheel));
+    if (!emtw)
+        return -ENOMEM;
+
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0)
+    {
+        int rc = -errno;
+        SIMPLE_LOG_MSG(LL_WARN, "timerfd_create(): %s", strerror(-rc));
+        niova_free(emtw);
+        return rc;
+    }
+
+    pthread_mutex_init(&emtw->emtw_mutex, NULL);
+
+    for (int i = 0; i < EPOLL_MGR_TIMER_WHEEL_LEVELS; i++)
+        for (unsigned int j = 0; j < EPOLL_MGR_TIMER_WHEEL_SLOTS; j++)
+            LIST_INIT(&emtw->emtw_slots[i][j]);
+
+    LIST_INIT(&emtw->emtw_expired);
+
+    emtw->emtw_base_usec = epoll_mgr_now_usec();
+    emtw->emtw_next_tick = UINT64_MAX;
+
+    epm->epm_timers = emtw;
+
+    struct epoll_handle *eph = &emtw->emtw_eph;
+    int rc = epoll_handle_init(eph, fd, EPOLLIN, epoll_mgr_timer_wheel_cb,
+                               epm, NULL);
+    if (!rc)
+        rc = epoll_mgr_ctl(epm, EPOLL_CTL_ADD, eph); // internal, like wake
+
+    if (rc)
+    {
+        SIMPLE_LOG_MSG(LL_WARN, "epoll_mgr_ctl(): %s", strerror(-rc));
+        epoll_mgr_timer_wheel_close(epm);
+        return rc;
+    }
+
+    eph->eph_installed = true;
+
+    return 0;
+}
+
+/**
+ * epoll_mgr_events_resize - the arrays only hold the results of a single
+ *   wait so their contents are not carried over.  Both are allocated before
+ *   either is replaced, leaving epm_events_size accurate on failure.
+ */
+static int
+epoll_mgr_events_resize(struct epoll_mgr *epm, int size)
+{
+    struct epoll_event *events =
+        niova_calloc_can_fail((size_t)size, sizeof(struct epoll_event));
+    if (!events)
+        return -ENOMEM;
+
+    uint64_t *user_data = NULL;
+    if (epm->epm_backend == EPOLL_MGR_BACKEND_IO_URING)
+    {
+        user_data = niova_calloc_can_fail((size_t)size, sizeof(uint64_t));
+        if (!user_data)
+        {
+            niova_free(events);
+            return -ENOMEM;
+        }
+    }
+
+    SIMPLE_LOG_MSG(LL_DEBUG, "epm=%p events %d -> %d", epm,
+                   epm->epm_events_size, size);
+
+    niova_free(epm->epm_events);
+    niova_free(epm->epm_events_user_data);
+
+    epm->epm_events = events;
+    epm->epm_events_user_data = user_data;
+    epm->epm_events_size = size;
+    epm->epm_events_shrink_cnt = 0;
+
+    return 0;
+}
+
+/**
+ * epoll_mgr_events_autosize - called by the epm thread after each wait.  A
+ *   full batch suggests that events were left behind in the kernel so the
+ *   array is doubled, provided the handles outnumber it.  Sustained excess
+ *   capacity, relative to the handle count, halves the array.
+ */
+static void
+epoll_mgr_events_autosize(struct epoll_mgr *epm, int nevents)
+{
+    const int size = epm->epm_events_size;
+    const int nhandles = niova_atomic_read(&epm->epm_num_handles) +
+        EPOLL_MGR_NUM_INTERNAL_HANDLES;
+
+    if (nevents == size)
+    {
+        epm->epm_events_full_cnt++;
+        epm->epm_events_shrink_cnt = 0;
+
+        if (size < EPOLL_MGR_AUTO_MAX_EVENTS && size < nhandles)
+            epoll_mgr_events_resize(epm,
+                                    MIN(size * 2, EPOLL_MGR_AUTO_MAX_EVENTS));
+    }
+    else if (size > EPOLL_MGR_MIN_EVENTS && nhandles * 4 <= size)
+    {
+        if (++epm->epm_events_shrink_cnt >= EPOLL_MGR_EVENTS_SHRINK_WAITS)
+            epoll_mgr_events_resize(epm, MAX(size / 2, EPOLL_MGR_MIN_EVENTS));
+    }
+    else
+    {
+        epm->epm_events_shrink_cnt = 0;
+    }
+}
+
+static void
+epoll_mgr_events_free(struct epoll_mgr *epm)
+{
+    niova_free(epm->epm_events);
+    niova_free(epm->epm_events_user_data);
+
+    epm->epm_events = NULL;
+    epm->epm_events_user_data = NULL;
+    epm->epm_events_size = 0;
 }
 
 int
 epoll_mgr_setup(struct epoll_mgr *epm)
+{
+    return epoll_mgr_setup_backend(epm, epollMgrDefBackend);
+}
+
+int
+epoll_mgr_setup_backend(struct epoll_mgr *epm, enum epoll_mgr_backend backend)
 {
     SIMPLE_FUNC_ENTRY(LL_TRACE);
-    if (!epm)
+    if (!epm || backend < EPOLL_MGR_BACKEND_MIN ||
+        backend > EPOLL_MGR_BACKEND_MAX)
         return -EINVAL;
 
     pthread_mutex_lock(&epollMgrInstallLock);
@@ -53,12 +1477,39 @@ epoll_mgr_setup(struct epoll_mgr *epm)
 
     epm->epm_thread_id = 0;
     epm->epm_num_handles = 0;
-
-    epm->epm_epfd = epoll_create1(0);
-    if (epm->epm_epfd < 0)
+    epm->epm_backend = backend;
+    epm->epm_uring = NULL;
+    epm->epm_timers = NULL;
+    epm->epm_lrn = NULL;
+    epm->epm_id = niova_atomic_inc(&epollMgrIdCnt);
+    epm->epm_busy_poll_spin_usec = 0;
+    epm->epm_busy_poll_hits = 0;
+    epm->epm_busy_poll_misses = 0;
+    epm->epm_blocking_wakeups = 0;
+    epoll_mgr_busy_poll_set(epm, epollMgrBusyPollUsec);
+
+    epm->epm_events = NULL;
+    epm->epm_events_user_data = NULL;
+    epm->epm_events_size = 0;
+    epm->epm_events_full_cnt = 0;
+
+    if (backend == EPOLL_MGR_BACKEND_IO_URING)
     {
-        pthread_mutex_unlock(&epollMgrInstallLock);
-        return -errno;
+        int rc = epoll_mgr_uring_setup(epm);
+        if (rc)
+        {
+            pthread_mutex_unlock(&epollMgrInstallLock);
+            return rc;
+        }
+    }
+    else
+    {
+        epm->epm_epfd = epoll_create1(0);
+        if (epm->epm_epfd < 0)
+        {
+            pthread_mutex_unlock(&epollMgrInstallLock);
+            return -errno;
+        }
     }
 
     int wakefd = eventfd(0, EFD_NONBLOCK);
@@ -80,70 +1531,123 @@ epoll_mgr_setup(struct epoll_mgr *epm)
     }
 
     // wake handle only used internally, don't track it like user handles
-    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = eph };
-    rc = epoll_ctl(epm->epm_epfd, EPOLL_CTL_ADD, eph->eph_fd, &ev);
+    rc = epoll_mgr_ctl(epm, EPOLL_CTL_ADD, eph);
     if (rc)
     {
-        SIMPLE_LOG_MSG(LL_DEBUG, "epoll_ctl(): errno=%d", errno);
+        SIMPLE_LOG_MSG(LL_DEBUG, "epoll_mgr_ctl(): %s", strerror(-rc));
         pthread_mutex_unlock(&epollMgrInstallLock);
-        return -errno;
+        return rc;
     }
     eph->eph_installed = true;
 
-    CIRCLEQ_INIT(&epm->epm_active_list);
-    CIRCLEQ_INIT(&epm->epm_destroy_list);
-    SLIST_INIT(&epm->epm_ctx_cb_list);
-
+    epm->epm_cmd_head = NULL;
     epm->epm_ctx_cb_num = 0;
+    epm->epm_wake_pending = 0;
+    epm->epm_wakeups = 0;
+    epm->epm_wakeups_suppressed = 0;
+
+    rc = epoll_mgr_timer_wheel_setup(epm);
+    if (rc)
+    {
+        pthread_mutex_unlock(&epollMgrInstallLock);
+        return rc;
+    }
+
+    rc = epoll_mgr_prof_setup(epm);
+    if (rc)
+    {
+        epoll_mgr_timer_wheel_close(epm);
+        pthread_mutex_unlock(&epollMgrInstallLock);
+        return rc;
+    }
+
+    rc = epoll_mgr_events_resize(epm, epollMgrNumEvents);
+    if (rc)
+    {
+        epoll_mgr_events_free(epm);
+        epoll_mgr_prof_free(epm);
+        epoll_mgr_timer_wheel_close(epm);
+        pthread_mutex_unlock(&epollMgrInstallLock);
+        return rc;
+    }
 
     epm->epm_ready = 1;
     niova_atomic_init(&epm->epm_epoll_wait_cnt, 0);
 
     pthread_mutex_unlock(&epollMgrInstallLock);
+
+    epoll_mgr_lreg_install(epm);
+
     return 0;
 }
 
+/**
+ * epoll_mgr_wake - rings the epm's doorbell.  Only the first caller after
+ *   the epm thread has cleared epm_wake_pending writes to the wake handle,
+ *   the others are covered by that write since the epm thread clears the
+ *   flag before it drains the command queue.
+ */
 static int
 epoll_mgr_wake(struct epoll_mgr *epm)
 {
     if (!epm || epm->epm_wake_handle.eph_fd <= 0)
         return -EINVAL;
 
+    if (niova_atomic_read(&epm->epm_wake_pending) ||
+        !niova_atomic_cas(&epm->epm_wake_pending, 0, 1))
+    {
+        niova_atomic_inc(&epm->epm_wakeups_suppressed);
+        return 0;
+    }
+
+    niova_atomic_inc(&epm->epm_wakeups);
+
     uint64_t i = 1;
     return write(epm->epm_wake_handle.eph_fd, &i, sizeof(i));
 }
 
+static uintptr_t
+epoll_handle_cookie(const struct epoll_mgr *epm, const struct epoll_handle *eph)
+{
+    return (uintptr_t)epm ^ (uintptr_t)eph;
+}
+
 /**
- * epoll_mgr_tally_handles - this function counts the number of handles which
- *   are attached to the epm's lists.  There is a small window where this
- *   number may vary from epm_num_handles which is why there is no assert here.
- *   epoll_mgr_tally_handles() should be used for the 'official' handle count.
- *   epm_num_handles is primarily used an a optimized way to determine the
- *   number of events in epoll_mgr_wait_and_process_events().
+ * epoll_handle_is_member - O(1) test for whether 'eph' is installed in 'epm'.
+ *   The cookie binds the handle's address to the epm, so a copy of an
+ *   installed handle is not mistaken for the original.
  */
-static ssize_t
-epoll_mgr_tally_handles(struct epoll_mgr *epm)
+static bool
+epoll_handle_is_member(const struct epoll_mgr *epm,
+                       const struct epoll_handle *eph)
 {
-    size_t cnt = 0;
-    struct epoll_handle *eph;
-
-    pthread_mutex_lock(&epm->epm_mutex);
+    return eph->eph_epm_cookie == epoll_handle_cookie(epm, eph) ?
+        true : false;
+}
 
-    CIRCLEQ_FOREACH(eph, &epm->epm_active_list, eph_lentry)
-    {
-        SIMPLE_LOG_MSG(LL_TRACE, "active eph %p", eph);
-        cnt++;
-    }
+/**
+ * epoll_mgr_cmd_push - places 'op' onto the epm's MPSC command queue.  The
+ *   queue is a lock-free stack which the epm thread detaches as a whole.
+ *   Each handle appears on the queue at most once, its pending operations
+ *   are accumulated in eph_cmd_ops.
+ */
+static void
+epoll_mgr_cmd_push(struct epoll_mgr *epm, struct epoll_handle *eph,
+                   uint32_t op)
+{
+    uint32_t pending_ops = __sync_fetch_and_or(&eph->eph_cmd_ops, op);
 
-    CIRCLEQ_FOREACH(eph, &epm->epm_destroy_list, eph_lentry)
+    if (!pending_ops)
     {
-        SIMPLE_LOG_MSG(LL_TRACE, "destroy eph %p", eph);
-        cnt++;
+        struct epoll_handle *head;
+        do
+        {
+            head = niova_atomic_read(&epm->epm_cmd_head);
+            eph->eph_cmd_next = head;
+        } while (!niova_atomic_cas(&epm->epm_cmd_head, head, eph));
     }
 
-    pthread_mutex_unlock(&epm->epm_mutex);
-
-    return cnt;
+    epoll_mgr_wake(epm);
 }
 
 int
@@ -156,33 +1660,67 @@ epoll_mgr_close(struct epoll_mgr *epm)
     pthread_mutex_lock(&epollMgrInstallLock);
     int rc = 0;
     if (!epm->epm_ready)
+    {
         rc = -EALREADY;
-    else if (epm->epm_ctx_cb_num || epoll_mgr_tally_handles(epm))
-        rc = -EBUSY;
-
-    // XXX what if eph_add is called between the tally_handles and ready=0?
-    if (!rc)
+    }
+    else
+    {
+        /* Clear 'ready' before checking the counters.  Adders bump the
+         * counters before checking 'ready' so one side is guaranteed to
+         * notice the other.
+         */
         epm->epm_ready = 0;
+        __sync_synchronize();
+
+        size_t num_timers = 0;
+        if (epm->epm_timers)
+        {
+            niova_mutex_lock(&epm->epm_timers->emtw_mutex);
+            num_timers = epm->epm_timers->emtw_num_armed;
+            niova_mutex_unlock(&epm->epm_timers->emtw_mutex);
+        }
+
+        if (niova_atomic_read(&epm->epm_ctx_cb_num) ||
+            niova_atomic_read(&epm->epm_num_handles) ||
+            niova_atomic_read(&epm->epm_cmd_head) || num_timers)
+        {
+            epm->epm_ready = 1;
+            rc = -EBUSY;
+        }
+    }
 
     pthread_mutex_unlock(&epollMgrInstallLock);
 
     if (rc)
     {
-        LOG_MSG(LL_WARN, "epm=%p cannot be destroyed num_handles=%zu (%s)",
-                epm, epoll_mgr_tally_handles(epm), strerror(-rc));
+        LOG_MSG(LL_WARN, "epm=%p cannot be destroyed num_handles=%d (%s)",
+                epm, niova_atomic_read(&epm->epm_num_handles),
+                strerror(-rc));
 
         return rc;
     }
 
+    epoll_mgr_lreg_remove(epm);
+    epoll_mgr_timer_wheel_close(epm);
+    epoll_mgr_events_free(epm);
+    epoll_mgr_prof_free(epm);
+
     int close_fd = epm->epm_epfd;
     epm->epm_epfd = -1;
 
-    rc = close(close_fd);
-    if (rc)
+    if (epm->epm_backend == EPOLL_MGR_BACKEND_IO_URING)
     {
-        rc = -errno;
-        LOG_MSG(LL_WARN, "epm=%p close(fd=%d): %s", epm, close_fd,
-                strerror(-rc));
+        epoll_mgr_uring_close(epm);
+    }
+    else
+    {
+        rc = close(close_fd);
+        if (rc)
+        {
+            rc = -errno;
+            LOG_MSG(LL_WARN, "epm=%p close(fd=%d): %s", epm, close_fd,
+                    strerror(-rc));
+        }
     }
 
     // closing fd removes from epoll set
@@ -213,14 +1751,18 @@ epoll_handle_init(struct epoll_handle *eph, int fd, int events,
     eph->eph_destroying = 0;
     eph->eph_async_destroy = 0;
     eph->eph_installed = 0;
+    eph->eph_uring_armed = 0;
+    eph->eph_uring_slot = 0;
     eph->eph_fd        = fd;
     eph->eph_events    = events;
     eph->eph_cb        = cb;
     eph->eph_arg       = arg;
     eph->eph_ref_cb    = ref_cb;
     eph->eph_ctx_cb    = NULL;
-
-    SLIST_ENTRY_INIT(&eph->eph_cb_lentry);
+    eph->eph_epm_cookie = 0;
+    eph->eph_cmd_ops   = 0;
+    eph->eph_cmd_next  = NULL;
+    eph->eph_stats     = NULL;
 
     return 0;
 }
@@ -236,38 +1778,42 @@ epoll_handle_add(struct epoll_mgr *epm, struct epoll_handle *eph)
     else if (eph->eph_fd < 0 || epm->epm_epfd < 0)
         return -EBADF;
 
-    else if (eph->eph_installed || eph->eph_installing)
+    else if (eph->eph_installed ||
+             !niova_atomic_cas(&eph->eph_installing, 0, 1))
         return -EALREADY;
 
-    if (eph->eph_ref_cb) // take user ref in advance of handle install
-        eph->eph_ref_cb(eph->eph_arg, EPH_REF_GET);
-
-    pthread_mutex_lock(&epm->epm_mutex);
-    NIOVA_ASSERT(epm->epm_num_handles >= 0);
+    // Count the handle before checking 'ready', see epoll_mgr_close()
+    niova_atomic_inc(&epm->epm_num_handles);
 
-    CIRCLEQ_INSERT_HEAD(&epm->epm_active_list, eph, eph_lentry);
-    eph->eph_installing = 1;
-    pthread_mutex_unlock(&epm->epm_mutex);
+    if (!epm->epm_ready)
+    {
+        niova_atomic_dec(&epm->epm_num_handles);
+        eph->eph_installing = 0;
+        return -EINVAL;
+    }
 
-    struct epoll_event ev = {.events = eph->eph_events, .data.ptr = eph};
+    if (eph->eph_ref_cb) // take user ref in advance of handle install
+        eph->eph_ref_cb(eph->eph_arg, EPH_REF_GET);
 
-    int rc = epoll_ctl(epm->epm_epfd, EPOLL_CTL_ADD, eph->eph_fd, &ev);
+    /* Mark the handle installed ahead of the ctl since the epm thread may
+     * observe an event for it before epoll_mgr_ctl() returns.
+     */
+    eph->eph_epm_cookie = epoll_handle_cookie(epm, eph);
+    eph->eph_installed = 1;
 
-    pthread_mutex_lock(&epm->epm_mutex);
-    eph->eph_installing = 0;
+    if (epm->epm_profiling)
+        epoll_mgr_prof_attach(epm, eph);
 
-    if (rc) // 'installing' bit prevents removal from the active list
-    {
-        CIRCLEQ_REMOVE(&epm->epm_active_list, eph, eph_lentry);
-        rc = -errno;
-    }
-    else
+    int rc = epoll_mgr_ctl(epm, EPOLL_CTL_ADD, eph);
+    if (rc)
     {
-        eph->eph_installed = 1;
-        epm->epm_num_handles++;
+        epoll_mgr_prof_detach(epm, eph);
+        eph->eph_installed = 0;
+        eph->eph_epm_cookie = 0;
+        niova_atomic_dec(&epm->epm_num_handles);
     }
 
-    pthread_mutex_unlock(&epm->epm_mutex);
+    eph->eph_installing = 0;
 
     if (rc && eph->eph_ref_cb) // release user ref if there was a problem
         eph->eph_ref_cb(eph->eph_arg, EPH_REF_PUT);
@@ -287,17 +1833,12 @@ epoll_handle_mod(struct epoll_mgr *epm, struct epoll_handle *eph)
     else if (!eph->eph_installed || eph->eph_installing || eph->eph_destroying)
         return -EINVAL;
 
-    struct epoll_event ev = {.events = eph->eph_events, .data.ptr = eph};
-
-    int rc = epoll_ctl(epm->epm_epfd, EPOLL_CTL_MOD, eph->eph_fd, &ev);
-
-    SIMPLE_LOG_MSG(LL_DEBUG, "epoll_handle_mod: fd=%d ev=%d rc=%d",
-                   eph->eph_fd, ev.events, rc);
+    int rc = epoll_mgr_ctl(epm, EPOLL_CTL_MOD, eph);
 
-    if (rc < 0)
-        return -errno;
+    SIMPLE_LOG_MSG(LL_DEBUG, "epoll_handle_mod: fd=%d ev=%d rc=%d",
+                   eph->eph_fd, eph->eph_events, rc);
 
-    return 0;
+    return rc;
 }
 
 static epoll_mgr_thread_ctx_int_t
@@ -323,26 +1864,23 @@ epoll_handle_del_complete(struct epoll_mgr *epm, struct epoll_handle *eph)
     if (eph->eph_async_destroy)
         SIMPLE_LOG_MSG(LL_NOTIFY, "epm=%p eph=%p", epm, eph);
 
-    struct epoll_event ev = {.events = 0, .data.fd = -1};
-
-    int rc = epoll_ctl(epm->epm_epfd, EPOLL_CTL_DEL, eph->eph_fd, &ev);
+    int rc = epoll_mgr_ctl(epm, EPOLL_CTL_DEL, eph);
     if (rc)
-    {
-        rc = -errno;
-        LOG_MSG(LL_WARN, "epoll_ctl(epm_fd=%d, eph_fd=%d, EPOLL_CTL_DEL): %s",
+        LOG_MSG(LL_WARN,
+                "epoll_mgr_ctl(epm_fd=%d, eph_fd=%d, EPOLL_CTL_DEL): %s",
                 epm->epm_epfd, eph->eph_fd, strerror(-rc));
-    }
 
-    pthread_mutex_lock(&epm->epm_mutex);
-    NIOVA_ASSERT(epm->epm_num_handles > 0);
-    epm->epm_num_handles--;
+    NIOVA_ASSERT(niova_atomic_read(&epm->epm_num_handles) > 0);
+
+    epoll_mgr_prof_detach(epm, eph);
 
+    eph->eph_epm_cookie = 0;
     eph->eph_installed = 0;
     eph->eph_fd = -1;
-    eph->eph_destroying = 0;
     eph->eph_async_destroy = 0;
+    eph->eph_destroying = 0;
 
-    pthread_mutex_unlock(&epm->epm_mutex);
+    niova_atomic_dec(&epm->epm_num_handles);
 
     if (eph->eph_ref_cb)
         eph->eph_ref_cb(eph->eph_arg, EPH_REF_PUT);
@@ -365,81 +1903,19 @@ epoll_handle_del(struct epoll_mgr *epm, struct epoll_handle *eph)
     else if (!eph->eph_installed)
         return -EAGAIN;
 
-    struct epoll_handle *tmp;
-    bool found = false;
-    bool complete_here = true;
-
-    pthread_mutex_lock(&epm->epm_mutex);
-    CIRCLEQ_FOREACH(tmp, &epm->epm_active_list, eph_lentry)
-    {
-        if (tmp == eph)
-        {
-            found = true;
-            break;
-        }
-    }
-
-    if (found)
-    {
-        // Signify that the 'eph' is being placed onto the destroyed
-        eph->eph_destroying = 1;
-        CIRCLEQ_REMOVE(&epm->epm_active_list, eph, eph_lentry);
-
-        if (!epoll_handle_releases_in_current_thread(epm, eph))
-        {
-            CIRCLEQ_INSERT_HEAD(&epm->epm_destroy_list, eph, eph_lentry);
-            // Mark that the 'eph' will be destroyed async
-            eph->eph_async_destroy = 1;
-            complete_here = false;
-        }
-    }
-
-    pthread_mutex_unlock(&epm->epm_mutex);
-
-    int rc = found ? 0 : -ENOENT;
-
-    if (!rc)
-    {
-        if (complete_here)
-            rc = epoll_handle_del_complete(epm, eph);
-
-        else
-            epoll_mgr_wake(epm);
-    }
-
-    return rc;
-}
-
-static void
-epoll_mgr_reap_destroy_list(struct epoll_mgr *epm)
-{
-    SIMPLE_FUNC_ENTRY(LL_TRACE);
-
-    struct epoll_handle *destroy = NULL;
-
-    if (CIRCLEQ_EMPTY(&epm->epm_destroy_list))
-        return;
-    do
-    {
-        pthread_mutex_lock(&epm->epm_mutex);
-
-        destroy = CIRCLEQ_EMPTY(&epm->epm_destroy_list) ? NULL :
-            CIRCLEQ_FIRST(&epm->epm_destroy_list);
+    // Only a single caller may move the handle into the 'destroying' state
+    else if (!epoll_handle_is_member(epm, eph) ||
+             !niova_atomic_cas(&eph->eph_destroying, 0, 1))
+        return -ENOENT;
 
-        if (destroy)
-            CIRCLEQ_REMOVE(&epm->epm_destroy_list, destroy, eph_lentry);
+    if (epoll_handle_releases_in_current_thread(epm, eph))
+        return epoll_handle_del_complete(epm, eph);
 
-        pthread_mutex_unlock(&epm->epm_mutex);
+    // Mark that the 'eph' will be destroyed async
+    eph->eph_async_destroy = 1;
+    epoll_mgr_cmd_push(epm, eph, EPH_CMD_DESTROY);
 
-        if (destroy)
-        {
-            int rc = epoll_handle_del_complete(epm, destroy);
-            if (rc)
-                LOG_MSG(LL_WARN,
-                        "epoll_handle_del_complete(eph=%p): %s",
-                        destroy, strerror(-rc));
-        }
-    } while (destroy);
+    return 0;
 }
 
 int
@@ -460,46 +1936,36 @@ epoll_mgr_ctx_cb_add(struct epoll_mgr *epm, struct epoll_handle *eph,
         return 0;
     }
 
-    // PUT in reap_ctx_list
+    // PUT in epoll_mgr_ctx_cb_run()
     eph->eph_ref_cb(eph->eph_arg, EPH_REF_GET);
 
-    niova_mutex_lock(&epm->epm_mutex);
-    epm->epm_ctx_cb_num++;
+    // Count the callback before checking 'ready', see epoll_mgr_close()
+    niova_atomic_inc(&epm->epm_ctx_cb_num);
 
     int rc = 0;
     if (!epm->epm_ready)
     {
         LOG_MSG(LL_DEBUG, "epm closing");
-
         rc = -EBUSY;
-        goto out;
     }
-
-    if (eph->eph_ctx_cb)
+    else if (!niova_atomic_cas(&eph->eph_ctx_cb, NULL, cb))
     {
         LOG_MSG(LL_DEBUG, "eph busy, cb %p", eph->eph_ctx_cb);
-
         rc = -EAGAIN;
-        goto out;
     }
 
-    eph->eph_ctx_cb = cb;
-
-    NIOVA_ASSERT(SLIST_ENTRY_DETACHED(&eph->eph_cb_lentry));
-    SIMPLE_LOG_MSG(LL_TRACE, "inserting eph %p eph_ctx_cb %p eph_ref_cb %p",
-                   eph, eph->eph_ctx_cb, eph->eph_ref_cb);
-    SLIST_INSERT_HEAD(&epm->epm_ctx_cb_list, eph, eph_cb_lentry);
-
-    epoll_mgr_wake(epm);
-
-out:
-    if (rc)
-        epm->epm_ctx_cb_num--;
-
-    niova_mutex_unlock(&epm->epm_mutex);
-
     if (rc)
+    {
+        niova_atomic_dec(&epm->epm_ctx_cb_num);
         eph->eph_ref_cb(eph->eph_arg, EPH_REF_PUT);
+    }
+    else
+    {
+        SIMPLE_LOG_MSG(LL_TRACE, "queuing eph %p eph_ctx_cb %p eph_ref_cb %p",
+                       eph, eph->eph_ctx_cb, eph->eph_ref_cb);
+
+        epoll_mgr_cmd_push(epm, eph, EPH_CMD_CTX_CB);
+    }
 
     SIMPLE_FUNC_EXIT(LL_TRACE);
     return 0;
@@ -515,50 +1981,156 @@ epoll_mgr_ctx_cb_run(struct epoll_mgr *epm, struct epoll_handle *eph)
 
     cb(arg);
 
-    niova_mutex_lock(&epm->epm_mutex);
-
-    SLIST_ENTRY_INIT(&eph->eph_cb_lentry);
     eph->eph_ctx_cb = NULL;
-    epm->epm_ctx_cb_num--;
+    niova_atomic_dec(&epm->epm_ctx_cb_num);
 
-    niova_mutex_unlock(&epm->epm_mutex);
     eph->eph_ref_cb(eph->eph_arg, EPH_REF_PUT);
 }
 
+/**
+ * epoll_mgr_reap_cmd_queue - detaches the entire command queue with a single
+ *   atomic exchange and applies the commands in the order they were issued.
+ *   Context callbacks are run ahead of a pending destroy on the same handle.
+ */
 static void
-epoll_mgr_reap_ctx_list(struct epoll_mgr *epm)
+epoll_mgr_reap_cmd_queue(struct epoll_mgr *epm)
 {
     SIMPLE_FUNC_ENTRY(LL_TRACE);
-    if (!epm)
-        return;
 
     NIOVA_ASSERT(epm->epm_thread_id == pthread_self());
 
-    // prevent epm close while checking epm_mutex
-    niova_mutex_lock(&epollMgrInstallLock);
-    if (!epm->epm_ready)
-    {
-        niova_mutex_unlock(&epollMgrInstallLock);
+    /* Clear the doorbell ahead of detaching the queue so that a command
+     * pushed after the detach is followed by a fresh wakeup.
+     */
+    if (niova_atomic_read(&epm->epm_wake_pending))
+        niova_atomic_and(&epm->epm_wake_pending, 0);
+
+    if (!niova_atomic_read(&epm->epm_cmd_head))
         return;
-    }
 
-    niova_mutex_lock(&epm->epm_mutex);
-    struct epoll_ctx_callback_list tmp_head =
-        SLIST_HEAD_INITIALIZER(epoll_ctx_callback_list);
-    SLIST_FIRST(&tmp_head) = SLIST_FIRST(&epm->epm_ctx_cb_list);
-    SLIST_INIT(&epm->epm_ctx_cb_list);
-    niova_mutex_unlock(&epm->epm_mutex);
-    niova_mutex_unlock(&epollMgrInstallLock);
+    struct epoll_handle *eph =
+        __sync_lock_test_and_set(&epm->epm_cmd_head, NULL);
+
+    struct epoll_handle *fifo = NULL;
+    while (eph)
+    {
+        struct epoll_handle *next = eph->eph_cmd_next;
+        eph->eph_cmd_next = fifo;
+        fifo = eph;
+        eph = next;
+    }
 
-    struct epoll_handle *eph, *tmp;
-    SLIST_FOREACH_SAFE(eph, &tmp_head, eph_cb_lentry, tmp)
+    while (fifo)
     {
-        epoll_mgr_ctx_cb_run(epm, eph);
+        eph = fifo;
+        fifo = eph->eph_cmd_next; // 'eph' may be requeued or freed below
+
+        uint32_t ops = __sync_lock_test_and_set(&eph->eph_cmd_ops, 0);
+
+        if (ops & EPH_CMD_CTX_CB)
+            epoll_mgr_ctx_cb_run(epm, eph);
+
+        if (ops & EPH_CMD_DESTROY)
+        {
+            int rc = epoll_handle_del_complete(epm, eph);
+            if (rc)
+                LOG_MSG(LL_WARN, "epoll_handle_del_complete(eph=%p): %s",
+                        eph, strerror(-rc));
+        }
     }
 
     SIMPLE_FUNC_EXIT(LL_TRACE);
 }
 
+static int
+epoll_mgr_backend_wait(struct epoll_mgr *epm, struct epoll_event *evs,
+                       uint64_t *user_data, int maxevents, int timeout)
+{
+    if (epm->epm_backend == EPOLL_MGR_BACKEND_IO_URING)
+        return epoll_mgr_uring_wait(epm, evs, user_data, maxevents, timeout);
+
+    int rc = epoll_wait(epm->epm_epfd, evs, maxevents, timeout);
+
+    return rc < 0 ? -errno : rc;
+}
+
+/**
+ * epoll_mgr_busy_poll - polls without blocking until events arrive or the
+ *   budget, which never exceeds the caller's timeout, is spent.  'timeout' is
+ *   reduced by the time spent spinning.
+ */
+static int
+epoll_mgr_busy_poll(struct epoll_mgr *epm, struct epoll_event *evs,
+                    uint64_t *user_data, int maxevents, int *timeout)
+{
+    unsigned long long budget = epm->epm_busy_poll_budget_usec;
+    if (*timeout >= 0)
+        budget = MIN(budget, (unsigned long long)*timeout * 1000);
+
+    const unsigned long long start = epoll_mgr_now_usec();
+    unsigned long long elapsed;
+    int rc;
+
+    do
+    {
+        rc = epoll_mgr_backend_wait(epm, evs, user_data, maxevents, 0);
+        elapsed = epoll_mgr_now_usec() - start;
+    } while (!rc && elapsed < budget);
+
+    epm->epm_busy_poll_spin_usec += elapsed;
+
+    if (rc > 0)
+        epm->epm_busy_poll_hits++;
+    else if (!rc)
+        epm->epm_busy_poll_misses++;
+
+    if (*timeout > 0)
+        *timeout = MAX(0, *timeout - (int)(elapsed / 1000));
+
+    return rc;
+}
+
+/**
+ * epoll_mgr_busy_poll_adapt - maintains a moving average, weighted 1/8, of
+ *   the time between batches of events.  Spinning for twice the average gap
+ *   catches most arrivals, if that exceeds the maximum spinning is unlikely
+ *   to pay off and the budget is cleared until events arrive more densely.
+ */
+static void
+epoll_mgr_busy_poll_adapt(struct epoll_mgr *epm)
+{
+    const unsigned long long now = epoll_mgr_now_usec();
+    const unsigned long long gap = now - epm->epm_last_event_usec;
+
+    epm->epm_last_event_usec = now;
+    epm->epm_busy_poll_gap_usec =
+        epm->epm_busy_poll_gap_usec - (epm->epm_busy_poll_gap_usec >> 3) +
+        (gap >> 3);
+
+    const unsigned long long budget = epm->epm_busy_poll_gap_usec * 2;
+
+    epm->epm_busy_poll_budget_usec =
+        budget <= epm->epm_busy_poll_max_usec ? budget : 0;
+}
+
+/**
+ * epoll_mgr_busy_poll_set - enables busy-polling with a budget of up to
+ *   'max_usec' or disables it if 'max_usec' is 0.
+ */
+int
+epoll_mgr_busy_poll_set(struct epoll_mgr *epm, unsigned int max_usec)
+{
+    if (!epm || max_usec > EPOLL_MGR_BUSY_POLL_MAX_USEC)
+        return -EINVAL;
+
+    epm->epm_busy_poll_gap_usec = max_usec / 2;
+    epm->epm_busy_poll_budget_usec = max_usec;
+    epm->epm_last_event_usec = max_usec ? epoll_mgr_now_usec() : 0;
+    epm->epm_busy_poll_max_usec = max_usec;
+
+    return 0;
+}
+
 int
 epoll_mgr_wait_and_process_events(struct epoll_mgr *epm, int timeout)
 {
@@ -572,16 +2144,35 @@ epoll_mgr_wait_and_process_events(struct epoll_mgr *epm, int timeout)
     else
         NIOVA_ASSERT(epm->epm_thread_id == pthread_self());
 
-    int maxevents = MAX(1, MIN(epollMgrNumEvents, epm->epm_num_handles));
+    const int maxevents = epm->epm_events_size;
+    struct epoll_event *evs = epm->epm_events;
+    uint64_t *user_data = epm->epm_events_user_data;
+
+    const bool uring =
+        epm->epm_backend == EPOLL_MGR_BACKEND_IO_URING ? true : false;
 
-    struct epoll_event evs[maxevents];
+    const bool busy_poll = epm->epm_busy_poll_max_usec ? true : false;
+    int nevents = 0;
 
-    const int nevents =
-        epoll_wait(epm->epm_epfd, evs, maxevents, timeout);
+    if (busy_poll && epm->epm_busy_poll_budget_usec && timeout)
+        nevents = epoll_mgr_busy_poll(epm, evs, user_data, maxevents,
+                                      &timeout);
+
+    if (!nevents)
+    {
+        nevents = epoll_mgr_backend_wait(epm, evs, user_data, maxevents,
+                                         timeout);
+        if (nevents > 0 && timeout)
+            epm->epm_blocking_wakeups++;
+    }
+
+    if (busy_poll && nevents > 0)
+        epoll_mgr_busy_poll_adapt(epm);
 
     niova_atomic_inc(&epm->epm_epoll_wait_cnt);
 
-    const int rc = -errno;
+    const unsigned long long loop_start_nsec =
+        epm->epm_profiling && nevents > 0 ? epoll_mgr_now_nsec() : 0;
 
     for (int i = 0; i < nevents; i++)
     {
@@ -603,18 +2194,248 @@ epoll_mgr_wait_and_process_events(struct epoll_mgr *epm, int timeout)
         if (eph->eph_ref_cb)
             eph_ref_cb = eph->eph_ref_cb;
 
+        // Fetched ahead of the callback, which may free the handle
+        struct epoll_handle_stats *ehs = eph->eph_stats;
+        const unsigned long long start_nsec = ehs ? epoll_mgr_now_nsec() : 0;
+
         if (eph->eph_cb)
             eph->eph_cb(eph, evs[i].events);
 
+        if (ehs)
+            epoll_mgr_prof_record(ehs, eph, start_nsec);
+
+        if (uring)
+            epoll_mgr_uring_rearm(epm, eph, user_data[i]);
+
         if (eph_ref_cb)
             eph_ref_cb(eph->eph_arg, EPH_REF_PUT);
     }
 
     // Reap again before returning control to the caller
-    epoll_mgr_reap_ctx_list(epm);
-    epoll_mgr_reap_destroy_list(epm);
+    epoll_mgr_reap_cmd_queue(epm);
+
+    if (loop_start_nsec)
+        binary_hist_incorporate_val(epm->epm_loop_hist,
+                                    (epoll_mgr_now_nsec() - loop_start_nsec) /
+                                    1000);
+
+    // 'evs' is no longer referenced and may be resized
+    epoll_mgr_events_autosize(epm, nevents);
+
+    return nevents;
+}
+
+/**
+ * epoll_handle_migrate - moves an installed handle from 'src' to 'dst'.  For
+ *   handles managed with a ref_cb, this must be called from the context of
+ *   src's thread, epoll_mgr_ctx_cb_add() may be used to arrange this.
+ */
+int
+epoll_handle_migrate(struct epoll_mgr *src, struct epoll_mgr *dst,
+                     struct epoll_handle *eph)
+{
+    if (!src || !dst || !eph || !src->epm_ready || !dst->epm_ready)
+        return -EINVAL;
+
+    else if (src == dst)
+        return 0;
+
+    else if (!epoll_handle_releases_in_current_thread(src, eph))
+        return -EAGAIN;
+
+    else if (eph->eph_ctx_cb)
+        return -EBUSY;
+
+    // Hold a user ref so the handle survives its removal from 'src'
+    if (eph->eph_ref_cb)
+        eph->eph_ref_cb(eph->eph_arg, EPH_REF_GET);
+
+    const int fd = eph->eph_fd;
+
+    int rc = epoll_handle_del(src, eph);
+    if (!rc)
+    {
+        eph->eph_fd = fd;
+        rc = epoll_handle_add(dst, eph);
+        if (rc)
+            LOG_MSG(LL_WARN, "epoll_handle_add(epm=%p, eph=%p): %s",
+                    dst, eph, strerror(-rc));
+    }
+
+    if (eph->eph_ref_cb)
+        eph->eph_ref_cb(eph->eph_arg, EPH_REF_PUT);
+
+    return rc;
+}
+
+static void *
+epoll_mgr_pool_thread(void *arg)
+{
+    struct thread_ctl *tc = arg;
+    struct epoll_mgr_pool *emp = thread_ctl_get_arg(tc);
+
+    const size_t idx = tc - emp->emp_threads;
+    NIOVA_ASSERT(idx < emp->emp_nreactors);
+
+    struct epoll_mgr *epm = &emp->emp_epms[idx];
+
+    if (emp->emp_pin_cpus)
+    {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(idx % get_nprocs(), &cpuset);
+
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpuset),
+                                        &cpuset);
+        if (rc)
+            LOG_MSG(LL_WARN, "pthread_setaffinity_np(): %s", strerror(rc));
+    }
+
+    THREAD_LOOP_WITH_CTL(tc)
+    {
+        int rc = epoll_mgr_wait_and_process_events(epm,
+                                                   EPOLL_MGR_POOL_WAIT_MSEC);
+        if (rc < 0 && rc != -EINTR)
+            LOG_MSG(LL_WARN, "epoll_mgr_wait_and_process_events(): %s",
+                    strerror(-rc));
+    }
+
+    return NULL;
+}
+
+static void
+epoll_mgr_pool_free(struct epoll_mgr_pool *emp)
+{
+    niova_free(emp->emp_epms);
+    niova_free(emp->emp_threads);
+
+    emp->emp_epms = NULL;
+    emp->emp_threads = NULL;
+    emp->emp_nreactors = 0;
+}
+
+int
+epoll_mgr_pool_destroy(struct epoll_mgr_pool *emp)
+{
+    if (!emp || !emp->emp_nreactors)
+        return -EINVAL;
+
+    for (size_t i = 0; i < emp->emp_nreactors; i++)
+        if (emp->emp_epms[i].epm_num_handles)
+            return -EBUSY;
+
+    int rc = 0;
+
+    for (size_t i = 0; i < emp->emp_nreactors; i++)
+    {
+        if (emp->emp_threads[i].tc_thread_id)
+            thread_halt_and_destroy(&emp->emp_threads[i]);
+
+        int close_rc = epoll_mgr_close(&emp->emp_epms[i]);
+        if (close_rc && close_rc != -EALREADY)
+            rc = close_rc;
+    }
 
-    return nevents < 0 ? rc : nevents;
+    epoll_mgr_pool_free(emp);
+
+    return rc;
+}
+
+int
+epoll_mgr_pool_setup(struct epoll_mgr_pool *emp, size_t nreactors,
+                     enum epoll_mgr_pool_policy policy, bool pin_cpus)
+{
+    if (!emp || !nreactors || nreactors > EPOLL_MGR_POOL_MAX_REACTORS ||
+        (policy != EPOLL_MGR_POOL_POLICY_HASH &&
+         policy != EPOLL_MGR_POOL_POLICY_LEAST_LOADED))
+        return -EINVAL;
+
+    emp->emp_epms = niova_calloc_can_fail(nreactors, sizeof(struct epoll_mgr));
+    emp->emp_threads =
+        niova_calloc_can_fail(nreactors, sizeof(struct thread_ctl));
+
+    if (!emp->emp_epms || !emp->emp_threads)
+    {
+        epoll_mgr_pool_free(emp);
+        return -ENOMEM;
+    }
+
+    emp->emp_nreactors = nreactors;
+    emp->emp_policy = policy;
+    emp->emp_pin_cpus = pin_cpus ? 1 : 0;
+
+    int rc = 0;
+
+    for (size_t i = 0; i < nreactors && !rc; i++)
+        rc = epoll_mgr_setup(&emp->emp_epms[i]);
+
+    for (size_t i = 0; i < nreactors && !rc; i++)
+    {
+        char thr_name[MAX_THREAD_NAME] = {0};
+        snprintf(thr_name, MAX_THREAD_NAME, "epm_pool.%zu", i);
+
+        rc = thread_create(epoll_mgr_pool_thread, &emp->emp_threads[i],
+                           thr_name, emp, NULL);
+        if (!rc)
+            thread_ctl_run(&emp->emp_threads[i]);
+    }
+
+    if (rc)
+    {
+        LOG_MSG(LL_WARN, "pool setup failed: %s", strerror(rc < 0 ? -rc : rc));
+        epoll_mgr_pool_destroy(emp);
+        return rc < 0 ? rc : -rc;
+    }
+
+    for (size_t i = 0; i < nreactors; i++)
+        thread_creator_wait_until_ctl_loop_reached(&emp->emp_threads[i]);
+
+    return 0;
+}
+
+/**
+ * epoll_mgr_pool_select - returns the reactor which should host a new handle.
+ *   'key' is only consulted by the hash policy.  The least-loaded policy
+ *   reads the per-reactor handle counts without locking so its choice is
+ *   approximate.
+ */
+struct epoll_mgr *
+epoll_mgr_pool_select(struct epoll_mgr_pool *emp, uint64_t key)
+{
+    if (!emp || !emp->emp_nreactors)
+        return NULL;
+
+    // Mix the key so that aligned pointers and sequential fds spread evenly
+    if (emp->emp_policy == EPOLL_MGR_POOL_POLICY_HASH)
+        return &emp->emp_epms[((key * 0x9E3779B97F4A7C15ULL) >> 32) %
+                              emp->emp_nreactors];
+
+    size_t idx = 0;
+    for (size_t i = 1; i < emp->emp_nreactors; i++)
+        if (emp->emp_epms[i].epm_num_handles <
+            emp->emp_epms[idx].epm_num_handles)
+            idx = i;
+
+    return &emp->emp_epms[idx];
+}
+
+int
+epoll_mgr_pool_handle_add(struct epoll_mgr_pool *emp,
+                          struct epoll_handle *eph,
+                          struct epoll_mgr **ret_epm)
+{
+    if (!emp || !eph)
+        return -EINVAL;
+
+    struct epoll_mgr *epm = epoll_mgr_pool_select(emp, (uint64_t)eph->eph_fd);
+    if (!epm)
+        return -EINVAL;
+
+    int rc = epoll_handle_add(epm, eph);
+    if (!rc && ret_epm)
+        *ret_epm = epm;
+
+    return rc;
 }
 
 void
@@ -623,3 +2444,32 @@ epoll_mgr_env_var_cb(const struct niova_env_var *nev)
     if (nev && nev->nev_present)
         epollMgrNumEvents = nev->nev_long_value;
 }
+
+void
+epoll_mgr_backend_env_var_cb(const struct niova_env_var *nev)
+{
+    if (nev && nev->nev_present)
+        epollMgrDefBackend = nev->nev_long_value;
+}
+
+void
+epoll_mgr_busy_poll_env_var_cb(const struct niova_env_var *nev)
+{
+    if (nev && nev->nev_present)
+        epollMgrBusyPollUsec = nev->nev_long_value;
+}
+
+void
+epoll_mgr_profiling_env_var_cb(const struct niova_env_var *nev)
+{
+    if (nev && nev->nev_present)
+        epollMgrProfiling = nev->nev_long_value ? true : false;
+}
+
+static init_ctx_t NIOVA_CONSTRUCTOR(EPOLL_MGR_CTOR_PRIORITY)
+epoll_mgr_ctor(void)
+{
+    LREG_ROOT_ENTRY_INSTALL(epoll_mgr_nodes);
+
+    return;
+}
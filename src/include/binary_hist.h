@@ -162,4 +162,30 @@ binary_hist_print(const struct binary_hist *bh, size_t num_hist,
     }
 }
 
+/**
+ * binary_hist_to_string - formats the non-empty buckets as
+ *   "<lower-bound>:<count>" pairs separated by spaces.
+ */
+static inline void
+binary_hist_to_string(const struct binary_hist *bh, char *buf, size_t len)
+{
+    size_t off = 0;
+    buf[0] = '\0';
+
+    for (int i = 0; i < binary_hist_size(bh) && off < len; i++)
+    {
+        if (!binary_hist_get_cnt(bh, i))
+            continue;
+
+        int rc = snprintf(&buf[off], len - off, "%s%lld:%lld",
+                          off ? " " : "",
+                          binary_hist_lower_bucket_range(bh, i),
+                          binary_hist_get_cnt(bh, i));
+        if (rc < 0)
+            break;
+
+        off += rc;
+    }
+}
+
 #endif
@@ -62,7 +62,7 @@ struct ctl_svc_node_raft_peer
 struct ctl_svc_node_peer
 {
     char           csnp_hostname[HOST_NAME_MAX];
-    char           csnp_ipv4[IPV4_STRLEN];
+    char           csnp_ipv4[TCP_ADDR_STRLEN]; // or "unix:<path>"
     char          *csnp_store;
     uint16_t       csnp_port;
     uint16_t       csnp_client_port;
@@ -26,6 +26,8 @@ enum constructor_priorities {
     LOG_SUBSYS_CTOR_PRIORITY,
     SYSTEM_INFO_CTOR_PRIORITY,
     BUFFER_SET_CTOR_PRIORITY,
+    EPOLL_MGR_CTOR_PRIORITY,
+    TCP_MGR_CTOR_PRIORITY,
     LCTLI_SUBSYS_CTOR_PRIORITY,
     UTIL_THREAD_SUBSYS_CTOR_PRIORITY,
     CONFIG_TOKEN_CTOR_PRIORITY,
@@ -35,6 +35,9 @@ enum niova_env_var_num
     NIOVA_ENV_VAR_alloc_log_level,
     NIOVA_ENV_VAR_ctl_interface_init_path,
     NIOVA_ENV_VAR_epoll_mgr_nevents,
+    NIOVA_ENV_VAR_epoll_mgr_backend,
+    NIOVA_ENV_VAR_epoll_mgr_busy_poll_usec,
+    NIOVA_ENV_VAR_epoll_mgr_profiling,
     NIOVA_ENV_VAR_inotify_base_path,
     NIOVA_ENV_VAR_inotify_path,
     NIOVA_ENV_VAR_local_ctl_svc_dir,
@@ -45,6 +48,7 @@ enum niova_env_var_num
     NIOVA_ENV_VAR_watchdog_stall_cnt,
     NIOVA_ENV_VAR_tcp_disable,
     NIOVA_ENV_VAR_niova_thread_cnt,
+    NIOVA_ENV_VAR_tcp_mgr_cork_usec,
     NIOVA_ENV_VAR__MAX,
     NIOVA_ENV_VAR__MIN = NIOVA_ENV_VAR_alloc_log_level,
 } PACKED;
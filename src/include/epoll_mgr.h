@@ -11,16 +11,51 @@
 #include <pthread.h>
 
 #include "atomic.h"
+#include "queue.h"
 #include "thread.h"
 
 /**
  * There should be 1 event per fd (I think, based on my reading of the kernel's
- * eventpoll.c).  At this time, this library only supports these 3 static
- * values.
+ * eventpoll.c).  Each epm starts with EPOLL_MGR_DEF_EVENTS, or the value
+ * from the environment, and then resizes its events array as needed.  The
+ * array grows while the wait returns full batches and there are more
+ * handles than events, and shrinks when the handle count has dropped well
+ * below its size.
  */
 #define EPOLL_MGR_MIN_EVENTS 32
 #define EPOLL_MGR_DEF_EVENTS 128
 #define EPOLL_MGR_MAX_EVENTS 1024
+#define EPOLL_MGR_AUTO_MAX_EVENTS 16384
+
+/**
+ * Busy-polling is off by default.  When enabled, the epm thread polls without
+ * blocking for up to its current budget before falling back to a blocking
+ * wait.  The budget follows the recent event inter-arrival time and is
+ * dropped to zero while events arrive too sparsely to be caught by spinning.
+ */
+#define EPOLL_MGR_BUSY_POLL_MAX_USEC 10000
+
+/**
+ * Profiling is off by default.  When enabled, each handle added to the epm
+ * records the number and duration of its callbacks and the epm records the
+ * time spent processing each batch of events.  The results are found under
+ * the epm's registry entry.
+ */
+#define EPOLL_MGR_PROF_HIST_START_BIT 0
+#define EPOLL_MGR_PROF_HIST_BUCKETS   20
+
+/**
+ * Event engines which may drive an epoll_mgr.  The io_uring backend uses
+ * single-shot IORING_OP_POLL_ADD requests which are re-armed in batches,
+ * along with the subsequent wait, by the epm thread.
+ */
+enum epoll_mgr_backend
+{
+    EPOLL_MGR_BACKEND_EPOLL = 0,
+    EPOLL_MGR_BACKEND_IO_URING = 1,
+    EPOLL_MGR_BACKEND_MIN = EPOLL_MGR_BACKEND_EPOLL,
+    EPOLL_MGR_BACKEND_MAX = EPOLL_MGR_BACKEND_IO_URING,
+};
 
 enum epoll_handle_ref_op
 {
@@ -33,27 +68,73 @@ typedef void (*epoll_mgr_cb_t)(const struct epoll_handle *, uint32_t);
 typedef void (*epoll_mgr_ref_cb_t)(void *, enum epoll_handle_ref_op);
 typedef void (*epoll_mgr_ctx_op_cb_t)(void *);
 
+// Operations which may be queued to the epm thread
+enum epoll_handle_cmd_op
+{
+    EPH_CMD_CTX_CB  = 1 << 0,
+    EPH_CMD_DESTROY = 1 << 1,
+};
+
+struct epoll_handle_stats;
+
+/**
+ * The state flags are kept in separate bytes, rather than bitfields, since
+ * they are updated from different threads without a common lock.
+ */
 struct epoll_handle
 {
     int                   eph_fd;
     int                   eph_events;
-    unsigned int          eph_installed     : 1;
-    unsigned int          eph_installing    : 1;
-    unsigned int          eph_destroying    : 1;
-    unsigned int          eph_async_destroy : 1;
+    uint8_t               eph_installed;
+    uint8_t               eph_installing;
+    uint8_t               eph_destroying;
+    uint8_t               eph_async_destroy;
+    uint8_t               eph_uring_armed;
+    uint32_t              eph_uring_slot;
+    uint32_t              eph_cmd_ops;
+    uintptr_t             eph_epm_cookie;
     void                 *eph_arg;
     epoll_mgr_cb_t        eph_cb;
     epoll_mgr_ref_cb_t    eph_ref_cb;
     epoll_mgr_ctx_op_cb_t eph_ctx_cb;
-    CIRCLEQ_ENTRY(epoll_handle) eph_lentry;
-    SLIST_ENTRY(epoll_handle) eph_cb_lentry;
+    struct epoll_handle  *eph_cmd_next;
+    struct epoll_handle_stats *eph_stats;
 };
 
-CIRCLEQ_HEAD(epoll_handle_list, epoll_handle);
-SLIST_HEAD(epoll_ctx_callback_list, epoll_handle);
-
 typedef void epoll_mgr_cb_ctx_t;
 
+/**
+ * Timers are kept in a hierarchical timing wheel, one per epm, which is
+ * driven by a single timerfd.  Arming and canceling are O(1) and do not
+ * require a system call unless the new timer expires ahead of all others.
+ * Expiration callbacks are issued from the epm thread.  Timers which are
+ * further out than the wheel's range are parked in the top level and
+ * re-inserted as they draw near.
+ */
+#define EPOLL_MGR_TIMER_TICK_USEC    1000ULL
+#define EPOLL_MGR_TIMER_WHEEL_BITS   6
+#define EPOLL_MGR_TIMER_WHEEL_SLOTS  (1U << EPOLL_MGR_TIMER_WHEEL_BITS)
+#define EPOLL_MGR_TIMER_WHEEL_LEVELS 4
+
+struct epoll_mgr_timer;
+typedef void (*epoll_mgr_timer_cb_t)(struct epoll_mgr_timer *, void *);
+
+struct epoll_mgr_timer
+{
+    LIST_ENTRY(epoll_mgr_timer) emt_lentry;
+    uint64_t                    emt_expire_tick;
+    struct epoll_mgr           *emt_epm;
+    epoll_mgr_timer_cb_t        emt_cb;
+    void                       *emt_arg;
+    uint8_t                     emt_armed;
+    uint8_t                     emt_level;
+};
+
+struct epoll_mgr_uring;
+struct epoll_mgr_timer_wheel;
+struct lreg_node;
+struct binary_hist;
+
 struct epoll_mgr
 {
     pthread_t                      epm_thread_id;
@@ -62,11 +143,63 @@ struct epoll_mgr
     int                            epm_epfd;
     struct epoll_handle            epm_wake_handle;
     unsigned int                   epm_ready : 1;
+    enum epoll_mgr_backend         epm_backend;
+    struct epoll_mgr_uring        *epm_uring;
     niova_atomic64_t               epm_epoll_wait_cnt;
-    struct epoll_handle_list       epm_active_list;
-    struct epoll_handle_list       epm_destroy_list;
-    struct epoll_ctx_callback_list epm_ctx_cb_list;
+    struct epoll_handle           *epm_cmd_head;
     int                            epm_ctx_cb_num;
+    // doorbell, set by the producer which writes to the wake handle
+    int                            epm_wake_pending;
+    unsigned long long             epm_wakeups;
+    unsigned long long             epm_wakeups_suppressed;
+    struct epoll_mgr_timer_wheel  *epm_timers;
+    struct lreg_node              *epm_lrn;
+    unsigned int                   epm_id;
+    // events array, only accessed by the epm thread once it is running
+    struct epoll_event            *epm_events;
+    uint64_t                      *epm_events_user_data;
+    int                            epm_events_size;
+    unsigned int                   epm_events_shrink_cnt;
+    unsigned long long             epm_events_full_cnt;
+    // profiling, the stats array is protected by epm_prof_mutex
+    uint8_t                        epm_profiling;
+    pthread_mutex_t                epm_prof_mutex;
+    struct epoll_handle_stats    **epm_prof_stats;
+    size_t                         epm_prof_nused;
+    size_t                         epm_prof_nalloc;
+    struct binary_hist            *epm_loop_hist;
+    // busy-poll state and stats, only modified by the epm thread
+    unsigned int                   epm_busy_poll_max_usec;
+    unsigned int                   epm_busy_poll_budget_usec;
+    unsigned long long             epm_busy_poll_gap_usec;
+    unsigned long long             epm_last_event_usec;
+    unsigned long long             epm_busy_poll_spin_usec;
+    unsigned long long             epm_busy_poll_hits;
+    unsigned long long             epm_busy_poll_misses;
+    unsigned long long             epm_blocking_wakeups;
+};
+
+/**
+ * A pool of epoll_mgrs, each driven by its own thread which may be pinned to
+ * a CPU.  New handles are placed onto a reactor by hash of their fd or onto
+ * the reactor with the fewest handles.
+ */
+#define EPOLL_MGR_POOL_MAX_REACTORS 64
+#define EPOLL_MGR_POOL_WAIT_MSEC 1000
+
+enum epoll_mgr_pool_policy
+{
+    EPOLL_MGR_POOL_POLICY_HASH,
+    EPOLL_MGR_POOL_POLICY_LEAST_LOADED,
+};
+
+struct epoll_mgr_pool
+{
+    struct epoll_mgr          *emp_epms;
+    struct thread_ctl         *emp_threads;
+    size_t                     emp_nreactors;
+    enum epoll_mgr_pool_policy emp_policy;
+    unsigned int               emp_pin_cpus : 1;
 };
 
 struct niova_env_var;
@@ -74,12 +207,31 @@ struct niova_env_var;
 void
 epoll_mgr_env_var_cb(const struct niova_env_var *nev);
 
+void
+epoll_mgr_backend_env_var_cb(const struct niova_env_var *nev);
+
+void
+epoll_mgr_busy_poll_env_var_cb(const struct niova_env_var *nev);
+
+void
+epoll_mgr_profiling_env_var_cb(const struct niova_env_var *nev);
+
 int
 epoll_mgr_setup(struct epoll_mgr *epm);
 
+int
+epoll_mgr_setup_backend(struct epoll_mgr *epm,
+                        enum epoll_mgr_backend backend);
+
 int
 epoll_mgr_close(struct epoll_mgr *epm);
 
+int
+epoll_mgr_busy_poll_set(struct epoll_mgr *epm, unsigned int max_usec);
+
+int
+epoll_mgr_profiling_set(struct epoll_mgr *epm, bool enable);
+
 int
 epoll_handle_init(struct epoll_handle *eph, int fd, int events,
                   epoll_mgr_cb_t cb, void *arg,
@@ -104,6 +256,42 @@ int
 epoll_mgr_ctx_cb_add(struct epoll_mgr *epm, struct epoll_handle *eph,
                      epoll_mgr_ctx_op_cb_t cb);
 
+int
+epoll_handle_migrate(struct epoll_mgr *src, struct epoll_mgr *dst,
+                     struct epoll_handle *eph);
+
+int
+epoll_mgr_pool_setup(struct epoll_mgr_pool *emp, size_t nreactors,
+                     enum epoll_mgr_pool_policy policy, bool pin_cpus);
+
+int
+epoll_mgr_pool_destroy(struct epoll_mgr_pool *emp);
+
+struct epoll_mgr *
+epoll_mgr_pool_select(struct epoll_mgr_pool *emp, uint64_t key);
+
+int
+epoll_mgr_pool_handle_add(struct epoll_mgr_pool *emp,
+                          struct epoll_handle *eph,
+                          struct epoll_mgr **ret_epm);
+
+void
+epoll_mgr_timer_init(struct epoll_mgr_timer *emt, epoll_mgr_timer_cb_t cb,
+                     void *arg);
+
+int
+epoll_mgr_timer_arm(struct epoll_mgr *epm, struct epoll_mgr_timer *emt,
+                    unsigned long long usec);
+
+int
+epoll_mgr_timer_cancel(struct epoll_mgr *epm, struct epoll_mgr_timer *emt);
+
+static inline bool
+epoll_mgr_timer_is_armed(const struct epoll_mgr_timer *emt)
+{
+    return (emt && emt->emt_armed) ? true : false;
+}
+
 static inline bool
 epoll_mgr_is_ready(const struct epoll_mgr *epm)
 {
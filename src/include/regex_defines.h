@@ -23,6 +23,10 @@
 #define IPADDR_REGEX \
     "^\\(\\([0-9]\\|[1-9][0-9]\\|1[0-9]\\{2\\}\\|2[0-4][0-9]\\|25[0-5]\\)\\.\\)\\{3\\}\\([0-9]\\|[1-9][0-9]\\|1[0-9]\\{2\\}\\|2[0-4][0-9]\\|25[0-5]\\)$"
 
+// An IPv4 address or the path of a Unix-domain socket, "unix:<path>"
+#define UNIX_ADDR_REGEX "^unix:/[^[:space:]]\\+$"
+#define NET_ADDR_REGEX IPADDR_REGEX"\\|"UNIX_ADDR_REGEX
+
 #define HOSTNAME_REGEX \
     "^\\(\\([a-zA-Z0-9]\\|[a-zA-Z0-9][a-zA-Z0-9\\-]*[a-zA-Z0-9]\\)\\.\\)*\\([A-Za-z0-9]\\|[A-Za-z0-9][A-Za-z0-9\\-]*[A-Za-z0-9]\\)$"
 
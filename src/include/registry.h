@@ -123,6 +123,10 @@ enum lreg_user_types
     LREG_USER_TYPE_NIOVA_CHUNK_SNAP,
     LREG_USER_TYPE_NIOVA_CHUNK_DEFRAG,
     LREG_USER_TYPE_BUFFER_SET,
+    LREG_USER_TYPE_EPOLL_MGR,
+    LREG_USER_TYPE_EPOLL_MGR_HANDLE,
+    LREG_USER_TYPE_TCP_MGR,
+    LREG_USER_TYPE_TCP_MGR_CONN,
     LREG_USER_TYPE_ANY,
     LREG_USER_TYPE_HISTOGRAM = LREG_USER_TYPE_HISTOGRAM0,
     LREG_USER_TYPE_HISTOGRAM__MIN = LREG_USER_TYPE_HISTOGRAM0,
@@ -0,0 +1,150 @@
+/* Copyright (C) NIOVA Systems, Inc - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef _SHM_MGR_H_
+#define _SHM_MGR_H_ 1
+
+#include <pthread.h>
+#include <sys/uio.h>
+
+#include "common.h"
+#include "epoll_mgr.h"
+#include "tcp.h"
+
+/**
+ * shm_mgr moves messages between processes on the same host without socket
+ * copies.  Each connection shares a memory region, created by the connecting
+ * side, which holds a single-producer / single-consumer ring and a bulk arena
+ * for each direction.  Small messages are copied into the ring while larger
+ * ones are copied into the arena, the ring entry carrying their offset.  As
+ * with tcp_mgr's tmi_recv_cb, the receiver's callback is handed the entire
+ * message, here in place within the region, and the space is released once
+ * the callback returns.  Each side waits on an eventfd doorbell, installed in
+ * its epoll_mgr, which the peer rings only once the waiter has gone idle.  The
+ * region and doorbells are passed over a Unix-domain socket ("unix:<path>")
+ * which remains open so that either side notices the other's exit.
+ */
+#define SHM_MGR_RING_MIN_SIZE   (64UL * 1024)
+#define SHM_MGR_RING_DEF_SIZE   (1UL << 20)
+#define SHM_MGR_RING_MAX_SIZE   (64UL << 20)
+#define SHM_MGR_ARENA_DEF_SIZE  (16UL << 20)
+#define SHM_MGR_ARENA_MAX_SIZE  (1UL << 30)
+
+#define SHM_MGR_HANDSHAKE_MAX_SIZE 256
+
+// Bounds the client's connect and the server's wait for the handshake
+#define SHM_MGR_HANDSHAKE_TIMEOUT_MSEC 1000
+
+// Messages processed per doorbell before yielding to other handles
+#define SHM_MGR_RECV_BUDGET 64
+
+struct shm_mgr_connection;
+struct shm_mgr_ring_ctl;
+
+typedef int (*shm_mgr_recv_cb_t)(struct shm_mgr_connection *, char *, size_t,
+                                 void *);
+
+/**
+ * shm_mgr_accept_cb_t - issued for each incoming connection with the
+ *   handshake passed to shm_mgr_connect().  The callback returns, through
+ *   its second argument, a disconnected shm_mgr_connection to attach.
+ */
+typedef int (*shm_mgr_accept_cb_t)(void *, struct shm_mgr_connection **,
+                                   const void *, size_t);
+
+enum shm_mgr_connection_status
+{
+    SMCS_DISCONNECTED = 0,
+    SMCS_CONNECTED,
+};
+
+// One direction of the connection, as seen from this side
+struct shm_mgr_ring
+{
+    struct shm_mgr_ring_ctl *smr_ctl;
+    char                    *smr_data;
+    size_t                   smr_size;
+    char                    *smr_arena;
+    size_t                   smr_arena_size;
+    int                      smr_doorbell_fd;
+};
+
+struct shm_mgr_instance;
+struct shm_mgr_pending;
+
+LIST_HEAD(shm_mgr_pending_list, shm_mgr_pending);
+
+struct shm_mgr_connection
+{
+    struct shm_mgr_instance        *smc_smi;
+    enum shm_mgr_connection_status  smc_status;
+    uint8_t                         smc_close_requested;
+    struct tcp_socket_handle        smc_tsh;
+    struct epoll_handle             smc_sock_eph;
+    struct epoll_handle             smc_doorbell_eph;
+    void                           *smc_region;
+    size_t                          smc_region_size;
+    struct shm_mgr_ring             smc_tx;
+    struct shm_mgr_ring             smc_rx;
+    // the tx ring and the region's mapping are protected by smc_send_mutex
+    pthread_mutex_t                 smc_send_mutex;
+    unsigned long long              smc_send_msgs;
+    unsigned long long              smc_send_bulk;
+    unsigned long long              smc_send_full;
+    unsigned long long              smc_doorbells;
+    unsigned long long              smc_recv_msgs;
+};
+
+struct shm_mgr_instance
+{
+    struct epoll_mgr         *smi_epm;
+    struct tcp_socket_handle  smi_listen_socket;
+    struct epoll_handle       smi_listen_eph;
+    shm_mgr_recv_cb_t         smi_recv_cb;
+    shm_mgr_accept_cb_t       smi_accept_cb;
+    void                     *smi_data;
+    size_t                    smi_ring_size;
+    size_t                    smi_arena_size;
+    // accepted sockets whose handshake has yet to arrive
+    struct shm_mgr_pending_list smi_pending;
+};
+
+int
+shm_mgr_setup(struct shm_mgr_instance *smi, struct epoll_mgr *epm,
+              void *data, shm_mgr_recv_cb_t recv_cb,
+              shm_mgr_accept_cb_t accept_cb);
+
+int
+shm_mgr_sizes_set(struct shm_mgr_instance *smi, size_t ring_size,
+                  size_t arena_size);
+
+int
+shm_mgr_listen(struct shm_mgr_instance *smi, const char *addr);
+
+int
+shm_mgr_close(struct shm_mgr_instance *smi);
+
+void
+shm_mgr_connection_setup(struct shm_mgr_connection *smc,
+                         struct shm_mgr_instance *smi);
+
+int
+shm_mgr_connect(struct shm_mgr_connection *smc, const char *addr,
+                const void *handshake, size_t handshake_size);
+
+int
+shm_mgr_send_msg(struct shm_mgr_connection *smc, const struct iovec *iov,
+                 size_t niovs);
+
+void
+shm_mgr_connection_close(struct shm_mgr_connection *smc);
+
+static inline bool
+shm_mgr_connection_is_connected(const struct shm_mgr_connection *smc)
+{
+    return (smc && smc->smc_status == SMCS_CONNECTED) ? true : false;
+}
+
+#endif
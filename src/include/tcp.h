@@ -9,6 +9,7 @@
 
 #include <sys/types.h>          /* See NOTES */
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
@@ -22,11 +23,27 @@
 
 #define NIOVA_TCP_LISTEN_DEPTH 16
 
+/**
+ * tcp_socket_send() waits up to this long for a full socket to drain, so
+ * that a peer which has stopped reading cannot stall the caller forever.
+ * The wait restarts whenever the peer makes progress.
+ */
+#define NIOVA_TCP_SEND_TIMEOUT_MSEC 1000
+
+/**
+ * An address of the form "unix:<path>" selects a Unix-domain stream socket,
+ * for peers on the same host, in place of TCP.  The port is not used.
+ */
+#define TCP_UNIX_ADDR_PREFIX     "unix:"
+#define TCP_UNIX_ADDR_PREFIX_LEN (sizeof(TCP_UNIX_ADDR_PREFIX) - 1)
+#define TCP_ADDR_STRLEN                                                 \
+    (TCP_UNIX_ADDR_PREFIX_LEN + sizeof(((struct sockaddr_un *)0)->sun_path))
+
 struct tcp_socket_handle
 {
     int  tsh_socket;
     int  tsh_port;
-    char tsh_ipaddr[IPV4_STRLEN];
+    char tsh_ipaddr[TCP_ADDR_STRLEN];
 };
 
 static inline void
@@ -36,10 +53,23 @@ tcp_socket_handle_init(struct tcp_socket_handle *tsh)
     {
         tsh->tsh_socket = -1;
         tsh->tsh_port = -1;
-        memset(tsh->tsh_ipaddr, 0, IPV4_STRLEN);
+        memset(tsh->tsh_ipaddr, 0, TCP_ADDR_STRLEN);
     }
 }
 
+static inline bool
+tcp_addr_is_unix(const char *addr)
+{
+    return (addr && !strncmp(addr, TCP_UNIX_ADDR_PREFIX,
+                             TCP_UNIX_ADDR_PREFIX_LEN)) ? true : false;
+}
+
+static inline bool
+tcp_socket_handle_is_unix(const struct tcp_socket_handle *tsh)
+{
+    return tsh ? tcp_addr_is_unix(tsh->tsh_ipaddr) : false;
+}
+
 static inline int
 tcp_socket_handle_2_sockfd(const struct tcp_socket_handle *tsh)
 {
@@ -62,6 +92,12 @@ int
 tcp_setup_sockaddr_in(const char *ipaddr, int port,
                       struct sockaddr_in *addr_in);
 
+int
+tcp_setup_sockaddr_un(const char *addr, struct sockaddr_un *addr_un);
+
+int
+tcp_socket_reuseport_enable(const struct tcp_socket_handle *tsh);
+
 int
 tcp_socket_bind(struct tcp_socket_handle *tsh);
 
@@ -87,6 +123,18 @@ ssize_t
 tcp_socket_send(const struct tcp_socket_handle *tsh, const struct iovec *iov,
                 const size_t iovlen);
 
+ssize_t
+tcp_socket_send_nb(const struct tcp_socket_handle *tsh,
+                   const struct iovec *iov, const size_t iovlen,
+                   bool zerocopy);
+
+int
+tcp_socket_zerocopy_enable(const struct tcp_socket_handle *tsh);
+
+int
+tcp_socket_zerocopy_reap(const struct tcp_socket_handle *tsh, uint32_t *lo,
+                         uint32_t *hi, bool *copied);
+
 int
 tcp_socket_handle_accept(int fd, struct tcp_socket_handle *tsh);
 
@@ -7,7 +7,10 @@
 #ifndef __NIOVA_TCP_MGR_H_
 #define __NIOVA_TCP_MGR_H_ 1
 
+#include "binary_hist.h"
+#include "buffer.h"
 #include "epoll_mgr.h"
+#include "io.h"
 #include "tcp.h"
 #include "env.h"
 
@@ -23,10 +26,16 @@ struct tcp_mgr_connection;
 env_cb_ctx_t
 tcp_mgr_set_thread_cnt_env_cb(const struct niova_env_var *ev);
 
+env_cb_ctx_t
+tcp_mgr_cork_usec_env_cb(const struct niova_env_var *ev);
+
 typedef tcp_mgr_ctx_int_t
 (*tcp_mgr_recv_cb_t)(struct tcp_mgr_connection *, char *, size_t, void *);
 typedef tcp_mgr_ctx_ssize_t
 (*tcp_mgr_bulk_size_cb_t)(struct tcp_mgr_connection *, char *, void *);
+typedef tcp_mgr_ctx_ssize_t
+(*tcp_mgr_bulk_iov_cb_t)(struct tcp_mgr_connection *, char *, size_t,
+                         struct iovec *, size_t, void *);
 typedef tcp_mgr_ctx_int_t
 (*tcp_mgr_handshake_cb_t)(void *, struct tcp_mgr_connection **, size_t *,
                           int fd, void *, size_t);
@@ -35,20 +44,265 @@ typedef tcp_mgr_ctx_ssize_t
                             void *, size_t);
 typedef tcp_mgr_ctx_t
 (*tcp_mgr_connection_epoll_ctx_cb_t)(struct tcp_mgr_connection *);
+typedef void
+(*tcp_mgr_send_done_cb_t)(struct tcp_mgr_connection *, void *, int);
 
 struct tcp_mgr_connection;
 STAILQ_HEAD(tcp_mgr_conn_list, tcp_mgr_connection);
 
+struct tcp_mgr_pipeline_msg;
+STAILQ_HEAD(tcp_mgr_pipeline_msg_list, tcp_mgr_pipeline_msg);
+
+// Serializes the handoff state of the instance's connections
 struct tcp_mgr_connq
 {
-    pthread_mutex_t          tmcq_mutex;
-    pthread_cond_t           tmcq_cond;
-    struct tcp_mgr_conn_list tmcq_queue;
+    pthread_mutex_t tmcq_mutex;
 };
 
+/**
+ * Each worker has its own run queue of connections which are ready to be
+ * read and of pipelined requests.  Work is placed onto an idle worker's
+ * queue when there is one, otherwise onto the next queue in turn, and only
+ * that worker is woken.  Workers whose queue is empty steal from the others
+ * before sleeping.  Requests queued by a worker are placed onto its own
+ * queue and an idle worker, if any, is woken to steal them.
+ */
 #define TCP_MGR_NTHREADS 32
 #define TCP_MGR_NTHREADS_MIN 2
-#define TCP_MGR_NTHREADS_MAX 32
+#define TCP_MGR_NTHREADS_MAX 1024
+
+struct tcp_mgr_instance;
+
+struct tcp_mgr_worker
+{
+    struct thread_ctl                tmw_thr_ctl;
+    struct tcp_mgr_instance         *tmw_tmi;
+    size_t                           tmw_idx;
+    pthread_mutex_t                  tmw_mutex;
+    pthread_cond_t                   tmw_cond;
+    struct tcp_mgr_conn_list         tmw_conns;
+    struct tcp_mgr_pipeline_msg_list tmw_msgs;
+    uint8_t                          tmw_idle;
+    uint8_t                          tmw_wake;
+    unsigned long long               tmw_steals;
+};
+
+/**
+ * The unsent portion of a message is copied onto the connection's send queue
+ * and flushed by the epm thread once the socket becomes writable.  Senders
+ * receive -EAGAIN while the queue holds more than tmi_sendq_max_bytes.
+ */
+#define TCP_MGR_SENDQ_MAX_BYTES (4UL * 1024 * 1024)
+#define TCP_MGR_SENDQ_FLUSH_IOVS IO_MAX_IOVS
+
+/**
+ * Corking is off by default.  When enabled, messages are held on the send
+ * queue for up to tmi_cork_usec, rounded up to the epm timer tick, so that
+ * they may be written with a single sendmsg().  The queue is flushed early
+ * once it holds TCP_MGR_CORK_MAX_BYTES.
+ */
+#define TCP_MGR_CORK_MAX_USEC 10000
+#define TCP_MGR_CORK_MAX_BYTES (64UL * 1024)
+
+/**
+ * Zero-copy is off by default.  When tmi_zerocopy_threshold is set, messages
+ * of at least that size passed to tcp_mgr_send_msg_zc() are sent with
+ * MSG_ZEROCOPY.  The caller's memory is referenced, not copied, until the
+ * kernel reports the send complete on the socket's error queue, at which
+ * point the done callback is issued from the epm thread.
+ */
+#define TCP_MGR_ZEROCOPY_MIN_BYTES (10UL * 1024)
+
+/**
+ * A queued send references either a copy of the unsent data, held in
+ * tmsb_data, or the caller's iovs for zero-copy sends.
+ */
+struct tcp_mgr_send_buf
+{
+    STAILQ_ENTRY(tcp_mgr_send_buf) tmsb_lentry;
+    size_t                         tmsb_len;
+    size_t                         tmsb_off;
+    struct iovec                  *tmsb_iovs;
+    size_t                         tmsb_niovs;
+    struct iovec                   tmsb_iov;
+    uint8_t                        tmsb_zerocopy;
+    uint8_t                        tmsb_zc_has_id;
+    uint32_t                       tmsb_zc_last_id;
+    uint8_t                        tmsb_fc_charged;
+    unsigned long long             tmsb_start_usec;
+    tcp_mgr_send_done_cb_t         tmsb_done_cb;
+    void                          *tmsb_done_arg;
+    char                           tmsb_data[];
+};
+STAILQ_HEAD(tcp_mgr_send_queue, tcp_mgr_send_buf);
+
+/**
+ * Pipelining is off by default.  In handoff mode a connection is normally
+ * left disarmed until its message has been processed.  With a pipeline depth
+ * greater than 1, the connection is re-armed once a message has been read
+ * and up to 'depth' of its messages may be processed by the workers at once.
+ * Replies sent from within tmi_recv_cb are written in the order in which the
+ * requests arrived, replies to a request which is not the oldest outstanding
+ * one are held until the requests ahead of it have been processed.
+ */
+#define TCP_MGR_PIPELINE_MAX_DEPTH 256
+
+/**
+ * Flow control is off by default.  Since it places a tcp_mgr_fc_hdr ahead of
+ * each message it must be enabled, with the same number of credits, on both
+ * ends.  Each message consumes one of the peer's credits, which is returned
+ * once the peer's tmi_recv_cb has processed the message.  Credits owed are
+ * returned in the header of the next outgoing message or, once a quarter of
+ * the credits are owed, in a header of their own.  Messages sent while no
+ * credits remain are held on the send queue, whose tmi_sendq_max_bytes limit
+ * then pushes back on the sender with -EAGAIN.  Zero-copy is not used on
+ * connections with flow control.
+ */
+#define TCP_MGR_FC_MAX_CREDITS 65536
+
+#define TCP_MGR_FC_FLAG_GRANT_ONLY 0x1
+
+struct tcp_mgr_fc_hdr
+{
+    uint32_t tmfh_grant;
+    uint32_t tmfh_flags;
+};
+
+/**
+ * Compression is off by default.  tcp_mgr_compress_threshold_set() enables
+ * lz4 compression of bulks of at least that many bytes, the bulk being the
+ * portion of a message which follows its tmc_header_size header.  It is
+ * negotiated by the caller's handshake: tmi_handshake_fill places the value
+ * returned by tcp_mgr_connection_compress_offer() into the handshake and the
+ * peer's tmi_handshake_cb passes it to tcp_mgr_connection_compress_accept().
+ * Once offered, every message in both directions carries a
+ * tcp_mgr_compress_hdr after its flow control header, if any, and each side
+ * compresses its own sends according to its own threshold.  A bulk which
+ * would not shrink by at least 1/TCP_MGR_COMPRESS_MIN_SAVING is sent as is,
+ * after which the connection stops trying for a number of bulks which
+ * doubles, up to TCP_MGR_COMPRESS_MAX_BACKOFF, while the data remains
+ * incompressible.  Compressed bulks are not offered to tmi_bulk_iov_cb and
+ * zero-copy is not used on connections carrying the header.
+ */
+#define TCP_MGR_COMPRESS_MIN_THRESHOLD 256
+#define TCP_MGR_COMPRESS_MIN_SAVING    8
+#define TCP_MGR_COMPRESS_MAX_BACKOFF   64
+
+#define TCP_MGR_COMPRESS_LZ4 0x1
+
+struct tcp_mgr_compress_hdr
+{
+    uint32_t tmch_size; // bytes of bulk on the wire
+    uint32_t tmch_flags;
+};
+
+/**
+ * Each connection counts its traffic from the time it is established, the
+ * counts being folded into its instance's totals once it closes.  The
+ * latency histograms, of the time from a message's header having been read
+ * until tmi_recv_cb is issued, or the message is queued to a worker, and of
+ * the time from a send call until the message has been written to the
+ * socket, read the clock for each message and are only kept while enabled
+ * by tcp_mgr_latency_stats_set().  tcp_mgr_lreg_install() publishes the
+ * instance, along with its established connections, under the registry's
+ * "tcp-mgrs" entry.
+ */
+#define TCP_MGR_STATS_USEC_HIST_START_BIT 0
+#define TCP_MGR_STATS_USEC_HIST_BUCKETS   20
+#define TCP_MGR_STATS_BULK_HIST_START_BIT 9
+#define TCP_MGR_STATS_BULK_HIST_BUCKETS   20
+#define TCP_MGR_STATS_NAME_MAX            32
+
+struct tcp_mgr_connection_stats
+{
+    unsigned long long tmcs_bytes_in;
+    unsigned long long tmcs_msgs_in;
+    unsigned long long tmcs_bytes_out;
+    // -EAGAIN returned to senders by a full send queue
+    unsigned long long tmcs_sendq_full;
+    // writes which found the socket full
+    unsigned long long tmcs_sock_eagain;
+    size_t             tmcs_sendq_max_bytes;
+    // bulk bytes sent before and after compression, and the time it took
+    unsigned long long tmcs_compress_in;
+    unsigned long long tmcs_compress_out;
+    unsigned long long tmcs_compress_usec;
+    // bulks sent as is, having not shrunk or while backed off
+    unsigned long long tmcs_compress_skipped;
+    unsigned long long tmcs_decompress_usec;
+    /* Allocated while the connection is established, which leaves
+     * tcp_mgr_connection assignable since binary_hist has const members.
+     */
+    struct binary_hist *tmcs_bulk_hist;
+    struct binary_hist *tmcs_recv_usec_hist;
+    struct binary_hist *tmcs_send_usec_hist;
+};
+
+struct tcp_mgr_pipeline_msg
+{
+    STAILQ_ENTRY(tcp_mgr_pipeline_msg) tmpm_lentry;
+    STAILQ_ENTRY(tcp_mgr_pipeline_msg) tmpm_conn_lentry;
+    struct tcp_mgr_connection         *tmpm_tmc;
+    char                              *tmpm_buf;
+    size_t                             tmpm_size;
+    char                              *tmpm_bulk_buf;
+    struct buffer_item                *tmpm_bulk_bi;
+    struct tcp_mgr_send_queue          tmpm_replies;
+    uint8_t                            tmpm_done;
+    uint8_t                            tmpm_orphaned;
+    char                               tmpm_data[];
+};
+
+/**
+ * Bulk receive buffers may be drawn from size-classed buffer_set pools, set
+ * up with tcp_mgr_bulk_pools_setup(), rather than being malloc'd for each
+ * message.  Class 'n' holds buffers of TCP_MGR_BULK_POOL_MIN_SIZE << (2 * n)
+ * bytes, and a message uses the smallest class which fits it and has a free
+ * buffer.  Pooled buffers are not counted against tmi_bulk_credits, the
+ * number of buffers in each pool serves as its credit count.  Messages which
+ * exceed the largest class are malloc'd as before.
+ */
+#define TCP_MGR_BULK_POOL_MIN_SIZE (64UL * 1024)
+#define TCP_MGR_BULK_POOL_NCLASSES 4
+
+/**
+ * An optional tmi_bulk_iov_cb is issued, after tmi_bulk_size_cb, with the
+ * header and the bulk size.  It may fill up to TCP_MGR_BULK_MAX_IOVS iovs,
+ * which must describe exactly the bulk size, and return the number used.
+ * The bulk is then received directly into them and tmi_recv_cb is issued
+ * with only the header.  Returning 0 receives the bulk into a tcp_mgr
+ * buffer as usual.
+ */
+#define TCP_MGR_BULK_MAX_IOVS 16
+
+/**
+ * Buffered receive is off by default.  When tmi_recv_buf_size is set, each
+ * connection reads whatever is available, up to the size of its receive
+ * buffer, with a single recv and then dispatches every complete message
+ * found in the buffer.  The bulk is received separately only for messages
+ * which do not fit into the buffer or whose bulk is scattered into the
+ * user's iovs.
+ */
+#define TCP_MGR_RECV_BUF_MIN_SIZE (4UL * 1024)
+#define TCP_MGR_RECV_BUF_MAX_SIZE (1UL * 1024 * 1024)
+
+/**
+ * With tcp_mgr_listen_shards_set(), the instance listens on several sockets
+ * bound to the same address with SO_REUSEPORT, and the kernel spreads
+ * incoming connections across them.  tmi_listen_socket is the first shard,
+ * the others are held in tmi_listen_shards.  When an epoll_mgr_pool is used
+ * each shard is serviced by its own reactor and the connections it accepts
+ * remain with that reactor.
+ */
+#define TCP_MGR_LISTEN_MAX_SHARDS EPOLL_MGR_POOL_MAX_REACTORS
+
+struct tcp_mgr_listen_shard
+{
+    struct tcp_socket_handle  tmls_socket;
+    struct epoll_handle       tmls_eph;
+    struct epoll_mgr         *tmls_epm;
+    struct tcp_mgr_instance  *tmls_tmi;
+};
 
 struct tcp_mgr_instance
 {
@@ -57,21 +311,47 @@ struct tcp_mgr_instance
     uint8_t                  tmi_conn_recv_handoff:1;
 
     struct epoll_mgr        *tmi_epoll_mgr;
+    struct epoll_mgr_pool   *tmi_epoll_pool;
     struct epoll_handle      tmi_listen_eph;
+    struct tcp_mgr_listen_shard *tmi_listen_shards;
+    size_t                   tmi_nlisten_shards;
     epoll_mgr_ref_cb_t       tmi_connection_ref_cb;
     pthread_mutex_t          tmi_epoll_ctx_mutex;
 
     tcp_mgr_recv_cb_t        tmi_recv_cb;
     tcp_mgr_bulk_size_cb_t   tmi_bulk_size_cb;
+    tcp_mgr_bulk_iov_cb_t    tmi_bulk_iov_cb;
     tcp_mgr_handshake_cb_t   tmi_handshake_cb;
     tcp_mgr_handshake_fill_t tmi_handshake_fill;
     size_t                   tmi_handshake_size;
 
     niova_atomic32_t         tmi_bulk_credits;
+    uint8_t                  tmi_bulk_pools_enabled;
+    struct buffer_set        tmi_bulk_pools[TCP_MGR_BULK_POOL_NCLASSES];
     niova_atomic32_t         tmi_incoming_credits;
+    size_t                   tmi_sendq_max_bytes;
+    unsigned int             tmi_cork_usec;
+    size_t                   tmi_zerocopy_threshold;
+    unsigned int             tmi_pipeline_depth;
+    size_t                   tmi_recv_buf_size;
+    uint32_t                 tmi_fc_credits;
+    size_t                   tmi_compress_threshold;
     struct tcp_mgr_connq     tmi_connq;
-    struct thread_ctl        tmi_workers[TCP_MGR_NTHREADS];
+    struct tcp_mgr_worker   *tmi_workers;
     size_t                   tmi_nworkers;
+    niova_atomic32_t         tmi_worker_next;
+    niova_atomic32_t         tmi_workers_idle;
+    // established connections and the totals of those which have closed
+    uint8_t                  tmi_latency_stats;
+    pthread_mutex_t          tmi_stats_mutex;
+    struct tcp_mgr_connection **tmi_stats_conns;
+    size_t                   tmi_stats_nconns;
+    size_t                   tmi_stats_nalloc;
+    unsigned long long       tmi_stats_nclosed;
+    unsigned long long       tmi_stats_closed_msgs_out;
+    struct tcp_mgr_connection_stats tmi_stats_closed;
+    struct lreg_node        *tmi_lrn;
+    char                     tmi_name[TCP_MGR_STATS_NAME_MAX];
 };
 
 enum tcp_mgr_connection_status
@@ -90,14 +370,109 @@ struct tcp_mgr_connection
     uint8_t                           tmc_user_error:1;
     struct tcp_socket_handle          tmc_tsh;
     struct epoll_handle               tmc_eph;
+    struct epoll_mgr                 *tmc_epm;
     struct tcp_mgr_instance          *tmc_tmi;
     size_t                            tmc_header_size;
     char                             *tmc_bulk_buf;
+    struct buffer_item               *tmc_bulk_bi;
+    // retains a partial header or the header of a scattered bulk
+    char                             *tmc_hdr_buf;
+    size_t                            tmc_hdr_offset;
+    struct iovec                      tmc_bulk_iovs[TCP_MGR_BULK_MAX_IOVS];
+    size_t                            tmc_bulk_niovs;
     size_t                            tmc_bulk_offset;
     size_t                            tmc_bulk_remain;
+    // receive buffer, only accessed by the thread reading the connection
+    char                             *tmc_rbuf;
+    size_t                            tmc_rbuf_size;
+    size_t                            tmc_rbuf_head;
+    size_t                            tmc_rbuf_tail;
+    ssize_t                           tmc_rbuf_bulk_size;
     tcp_mgr_connection_epoll_ctx_cb_t tmc_epoll_ctx_cb;
     STAILQ_ENTRY(tcp_mgr_connection)  tmc_lentry;
     pthread_mutex_t                   tmc_send_mutex;
+    // send queue, protected by tmc_send_mutex
+    struct tcp_mgr_send_queue         tmc_sendq;
+    size_t                            tmc_sendq_bytes;
+    uint8_t                           tmc_sendq_pending;
+    struct epoll_mgr_timer            tmc_cork_timer;
+    // the coalescing ratio is tmc_send_msgs / tmc_send_syscalls, both are
+    // restarted along with tmc_stats when the connection is established
+    unsigned long long                tmc_send_msgs;
+    unsigned long long                tmc_send_syscalls;
+    // zero-copy sends awaiting completion, in the order they were sent
+    uint8_t                           tmc_zerocopy;
+    uint32_t                          tmc_zc_next_id;
+    struct tcp_mgr_send_queue         tmc_zc_inflight;
+    unsigned long long                tmc_zc_sends;
+    unsigned long long                tmc_zc_copied;
+    // flow control, protected by tmc_send_mutex
+    uint32_t                          tmc_fc_window;
+    uint32_t                          tmc_fc_credits;
+    uint32_t                          tmc_fc_owed;
+    unsigned long long                tmc_fc_stalls;
+    // compression, tmc_compress_caps is set during the handshake and applied
+    // once the connection is established, the backoff is protected by
+    // tmc_send_mutex
+    uint32_t                          tmc_compress_caps;
+    uint8_t                           tmc_compress;
+    unsigned int                      tmc_compress_backoff;
+    unsigned int                      tmc_compress_skip;
+    // a compressed bulk being received, decompressed once complete
+    char                             *tmc_zbuf;
+    size_t                            tmc_zbuf_size;
+    size_t                            tmc_zbuf_bulk_size;
+    // outstanding requests, in arrival order, protected by tmc_send_mutex
+    struct tcp_mgr_pipeline_msg_list  tmc_pipeline_msgs;
+    // protected by tmcq_mutex
+    unsigned int                      tmc_pipeline_inflight;
+    uint8_t                           tmc_pipeline_throttled;
+    // send stats are protected by tmc_send_mutex, the rest belong to the
+    // thread reading the connection
+    struct tcp_mgr_connection_stats   tmc_stats;
+    unsigned long long                tmc_hdr_usec;
+    ssize_t                           tmc_stats_idx;
+};
+
+/**
+ * A stripe sends to a single peer over several connections, each of which
+ * is owned and set up by the caller as usual.  The peer's handshake_cb must
+ * map each incoming connection onto its own tmc, otherwise they replace one
+ * another.  With TCP_MGR_STRIPE_ORDER_NONE a message is placed onto the
+ * connected tmc with the least queued data, so messages may arrive out of
+ * order.  With TCP_MGR_STRIPE_ORDER_KEY messages sharing a key use the same
+ * tmc and arrive in the order they were sent.  tcp_mgr_stripe_send_split()
+ * divides a large payload into one chunk per connection, the caller's
+ * headers describe the chunks and the receiver may gather them with a
+ * tcp_mgr_stripe_reasm, receiving the chunks in place with tmi_bulk_iov_cb.
+ */
+#define TCP_MGR_STRIPE_MAX_CONNS 16
+#define TCP_MGR_STRIPE_MAX_IOVS  16
+
+enum tcp_mgr_stripe_order
+{
+    TCP_MGR_STRIPE_ORDER_NONE,
+    TCP_MGR_STRIPE_ORDER_KEY,
+};
+
+struct tcp_mgr_stripe
+{
+    struct tcp_mgr_connection *tms_conns[TCP_MGR_STRIPE_MAX_CONNS];
+    size_t                     tms_nconns;
+    enum tcp_mgr_stripe_order  tms_order;
+    niova_atomic32_t           tms_next;
+};
+
+// Fills 'hdr_iov' with the header for chunk 'idx' of 'nchunks'
+typedef int
+(*tcp_mgr_stripe_hdr_cb_t)(void *, size_t idx, size_t nchunks, size_t offset,
+                           size_t len, struct iovec *hdr_iov);
+
+struct tcp_mgr_stripe_reasm
+{
+    char             *tmsr_buf;
+    size_t            tmsr_size;
+    niova_atomic64_t  tmsr_received;
 };
 
 struct tcp_mgr_incoming_connection
@@ -137,10 +512,17 @@ tcp_mgr_sockets_setup(struct tcp_mgr_instance *tmi, const char *ipaddr,
 int
 tcp_mgr_sockets_bind(struct tcp_mgr_instance *tmi);
 
+int
+tcp_mgr_listen_shards_set(struct tcp_mgr_instance *tmi, size_t nshards);
+
 int
 tcp_mgr_epoll_setup(struct tcp_mgr_instance *tmi, struct epoll_mgr *epoll_mgr,
                     bool is_raft_client);
 
+int
+tcp_mgr_epoll_pool_setup(struct tcp_mgr_instance *tmi,
+                         struct epoll_mgr_pool *emp, bool tmi_listen);
+
 static inline void
 tcp_mgr_connection_header_size_set(struct tcp_mgr_connection *tmc,
                                    size_t size)
@@ -154,16 +536,107 @@ tcp_mgr_connection_header_size_get(struct tcp_mgr_connection *tmc)
     return tmc->tmc_header_size;
 }
 
+/**
+ * tcp_mgr_send_msg - returns 0 once the message has been sent or queued.
+ *   -EAGAIN is not fatal, nothing was sent and the caller may retry later.
+ *   It is returned while the connection is being established and, once
+ *   connected, while the send queue holds more than tmi_sendq_max_bytes.
+ *   tcp_mgr_send_msg_zc() and the stripe send calls return it likewise.
+ */
 int
 tcp_mgr_send_msg(struct tcp_mgr_connection *tmc, struct iovec *iov,
                  size_t niovs);
 
+int
+tcp_mgr_send_msg_zc(struct tcp_mgr_connection *tmc, struct iovec *iov,
+                    size_t niovs, tcp_mgr_send_done_cb_t done_cb,
+                    void *done_arg);
+
+int
+tcp_mgr_stripe_init(struct tcp_mgr_stripe *tms,
+                    enum tcp_mgr_stripe_order order);
+
+int
+tcp_mgr_stripe_conn_add(struct tcp_mgr_stripe *tms,
+                        struct tcp_mgr_connection *tmc);
+
+struct tcp_mgr_connection *
+tcp_mgr_stripe_select(struct tcp_mgr_stripe *tms, uint64_t key);
+
+int
+tcp_mgr_stripe_send_msg(struct tcp_mgr_stripe *tms, uint64_t key,
+                        struct iovec *iov, size_t niovs);
+
+int
+tcp_mgr_stripe_send_split(struct tcp_mgr_stripe *tms,
+                          const struct iovec *iov, size_t niovs,
+                          size_t min_chunk, tcp_mgr_stripe_hdr_cb_t hdr_cb,
+                          void *arg);
+
+int
+tcp_mgr_stripe_reasm_init(struct tcp_mgr_stripe_reasm *tmsr, char *buf,
+                          size_t size);
+
+int
+tcp_mgr_stripe_reasm_add(struct tcp_mgr_stripe_reasm *tmsr, size_t offset,
+                         const char *data, size_t len);
+
 void
 tcp_mgr_bulk_credits_set(struct tcp_mgr_instance *tmi, uint32_t cnt);
 
 void
 tcp_mgr_incoming_credits_set(struct tcp_mgr_instance *tmi, uint32_t cnt);
 
+void
+tcp_mgr_bulk_iov_cb_set(struct tcp_mgr_instance *tmi,
+                        tcp_mgr_bulk_iov_cb_t bulk_iov_cb);
+
+int
+tcp_mgr_bulk_pools_setup(struct tcp_mgr_instance *tmi, size_t nbufs);
+
+int
+tcp_mgr_bulk_pools_destroy(struct tcp_mgr_instance *tmi);
+
+struct buffer_item *
+tcp_mgr_connection_bulk_item_take(struct tcp_mgr_connection *tmc);
+
+void
+tcp_mgr_sendq_max_bytes_set(struct tcp_mgr_instance *tmi, size_t max_bytes);
+
+int
+tcp_mgr_cork_usec_set(struct tcp_mgr_instance *tmi, unsigned int usec);
+
+int
+tcp_mgr_zerocopy_threshold_set(struct tcp_mgr_instance *tmi, size_t bytes);
+
+int
+tcp_mgr_pipeline_depth_set(struct tcp_mgr_instance *tmi, unsigned int depth);
+
+int
+tcp_mgr_recv_buf_size_set(struct tcp_mgr_instance *tmi, size_t bytes);
+
+int
+tcp_mgr_flow_control_set(struct tcp_mgr_instance *tmi, uint32_t credits);
+
+int
+tcp_mgr_compress_threshold_set(struct tcp_mgr_instance *tmi, size_t bytes);
+
+uint32_t
+tcp_mgr_connection_compress_offer(struct tcp_mgr_connection *tmc);
+
+void
+tcp_mgr_connection_compress_accept(struct tcp_mgr_connection *tmc,
+                                   uint32_t caps);
+
+void
+tcp_mgr_latency_stats_set(struct tcp_mgr_instance *tmi, bool enable);
+
+int
+tcp_mgr_lreg_install(struct tcp_mgr_instance *tmi, const char *name);
+
+void
+tcp_mgr_lreg_remove(struct tcp_mgr_instance *tmi);
+
 void
 tcp_mgr_connection_close(struct tcp_mgr_connection *tmc);
 
@@ -27,6 +27,23 @@ struct udp_socket_handle
     char ush_ipaddr[IPV4_STRLEN];
 };
 
+/**
+ * Batch calls move up to UDP_SOCKET_BATCH_MAX datagrams with a single
+ * recvmmsg() or sendmmsg().  Each datagram is described by its own
+ * udp_socket_batch_msg, whose address is the source on receive and the
+ * destination on send, and whose usbm_len is set to the size of the datagram
+ * or, for a datagram truncated by its iovs, to -EBADMSG.
+ */
+#define UDP_SOCKET_BATCH_MAX 64
+
+struct udp_socket_batch_msg
+{
+    struct iovec       *usbm_iov;
+    size_t              usbm_iovlen;
+    struct sockaddr_in  usbm_addr;
+    ssize_t             usbm_len;
+};
+
 static inline void
 udp_socket_handle_init(struct udp_socket_handle *ush)
 {
@@ -77,6 +94,19 @@ ssize_t
 udp_socket_send(const struct udp_socket_handle *ush, const struct iovec *iov,
                 const size_t iovlen, const struct sockaddr_in *to);
 
+ssize_t
+udp_socket_recv_batch(const struct udp_socket_handle *ush,
+                      struct udp_socket_batch_msg *msgs, size_t nmsgs,
+                      bool block);
+
+ssize_t
+udp_socket_recv_batch_fd(int fd, struct udp_socket_batch_msg *msgs,
+                         size_t nmsgs, bool block);
+
+ssize_t
+udp_socket_send_batch(const struct udp_socket_handle *ush,
+                      struct udp_socket_batch_msg *msgs, size_t nmsgs);
+
 size_t
 udp_get_max_size();
 #endif
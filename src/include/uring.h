@@ -0,0 +1,126 @@
+/* Copyright (C) NIOVA Systems, Inc - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef _NIOVA_URING_H_
+#define _NIOVA_URING_H_ 1
+
+#include <linux/io_uring.h>
+
+#include "common.h"
+
+/**
+ * Minimal io_uring wrapper built directly on the kernel interface so that
+ * liburing is not required.  Submission queue producers must be serialized
+ * by the caller, completions must only be consumed by a single thread.
+ */
+#define NIOVA_URING_DEF_ENTRIES 1024
+
+struct niova_uring
+{
+    int                  nur_fd;
+    unsigned int         nur_features;
+    // submission queue
+    unsigned int        *nur_sq_khead;
+    unsigned int        *nur_sq_ktail;
+    unsigned int         nur_sq_mask;
+    unsigned int         nur_sq_entries;
+    unsigned int         nur_sq_tail;
+    struct io_uring_sqe *nur_sqes;
+    // completion queue
+    unsigned int        *nur_cq_khead;
+    unsigned int        *nur_cq_ktail;
+    unsigned int         nur_cq_mask;
+    struct io_uring_cqe *nur_cqes;
+    // mappings
+    void                *nur_sq_ring;
+    size_t               nur_sq_ring_sz;
+    void                *nur_cq_ring;
+    size_t               nur_cq_ring_sz;
+    size_t               nur_sqes_sz;
+};
+
+int
+niova_uring_setup(struct niova_uring *nur, unsigned int entries);
+
+void
+niova_uring_close(struct niova_uring *nur);
+
+struct io_uring_sqe *
+niova_uring_get_sqe(struct niova_uring *nur);
+
+void
+niova_uring_sqe_commit(struct niova_uring *nur);
+
+int
+niova_uring_enter(struct niova_uring *nur, unsigned int to_submit,
+                  unsigned int min_complete, int timeout_ms);
+
+static inline unsigned int
+niova_uring_sq_pending(const struct niova_uring *nur)
+{
+    return nur->nur_sq_tail -
+        __atomic_load_n(nur->nur_sq_khead, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * niova_uring_submit - pushes all pending SQEs to the kernel without waiting
+ *   for completions.
+ */
+static inline int
+niova_uring_submit(struct niova_uring *nur)
+{
+    unsigned int pending = niova_uring_sq_pending(nur);
+
+    return pending ? niova_uring_enter(nur, pending, 0, 0) : 0;
+}
+
+static inline unsigned int
+niova_uring_cq_ready(const struct niova_uring *nur)
+{
+    return __atomic_load_n(nur->nur_cq_ktail, __ATOMIC_ACQUIRE) -
+        *nur->nur_cq_khead;
+}
+
+/**
+ * niova_uring_cqe_get - returns the 'n'th unconsumed completion.  'n' must be
+ *   less than the value returned by niova_uring_cq_ready().
+ */
+static inline const struct io_uring_cqe *
+niova_uring_cqe_get(const struct niova_uring *nur, unsigned int n)
+{
+    return &nur->nur_cqes[(*nur->nur_cq_khead + n) & nur->nur_cq_mask];
+}
+
+static inline void
+niova_uring_cq_advance(struct niova_uring *nur, unsigned int n)
+{
+    if (n)
+        __atomic_store_n(nur->nur_cq_khead, *nur->nur_cq_khead + n,
+                         __ATOMIC_RELEASE);
+}
+
+static inline void
+niova_uring_prep_poll_add(struct io_uring_sqe *sqe, int fd, uint32_t events,
+                          uint64_t user_data)
+{
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->user_data = user_data;
+}
+
+static inline void
+niova_uring_prep_poll_remove(struct io_uring_sqe *sqe, uint64_t target,
+                             uint64_t user_data)
+{
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = user_data;
+}
+
+#endif
@@ -0,0 +1,1184 @@
+/* Copyright (C) NIOVA Systems, Inc - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "alloc.h"
+#include "io.h"
+#include "log.h"
+#include "shm_mgr.h"
+#include "util.h"
+
+REGISTRY_ENTRY_FILE_GENERATE;
+
+#define SHM_MGR_MAGIC   0x4e53484d
+#define SHM_MGR_VERSION 1
+
+// Ring entries, and therefore their headers, start on this boundary
+#define SHM_MGR_ENTRY_ALIGN 32
+
+#define SHM_MGR_ENTRY_PAD  (1U << 0)
+#define SHM_MGR_ENTRY_BULK (1U << 1)
+
+// Messages whose entry exceeds this fraction of the ring go to the arena
+#define SHM_MGR_INLINE_DIVISOR 4
+
+enum shm_mgr_dir
+{
+    SHM_MGR_DIR_C2S = 0,
+    SHM_MGR_DIR_S2C = 1,
+    SHM_MGR_DIR_MAX = 2,
+};
+
+// The region memfd followed by the doorbell eventfds, indexed by direction
+#define SHM_MGR_NFDS (1 + SHM_MGR_DIR_MAX)
+
+/**
+ * The producer and consumer positions are free-running byte counts which are
+ * masked into the ring or arena.  Each group sits in its own cache line so
+ * that the two processes do not contend on the same line.  'smrc_waiting' is
+ * set by an idle consumer and cleared by the producer which rings the
+ * doorbell.
+ */
+struct shm_mgr_ring_ctl
+{
+    uint64_t CACHE_ALIGN_MEMBER(smrc_tail);
+    uint64_t                    smrc_arena_tail;
+    uint64_t CACHE_ALIGN_MEMBER(smrc_head);
+    uint64_t                    smrc_arena_head;
+    uint32_t CACHE_ALIGN_MEMBER(smrc_waiting);
+};
+
+/**
+ * Layout of the shared region:
+ *   [hdr page][ring c2s][ring s2c][arena c2s][arena s2c]
+ */
+struct shm_mgr_region_hdr
+{
+    uint32_t                smrh_magic;
+    uint32_t                smrh_version;
+    uint64_t                smrh_ring_size;
+    uint64_t                smrh_arena_size;
+    struct shm_mgr_ring_ctl smrh_ctl[SHM_MGR_DIR_MAX];
+};
+
+#define SHM_MGR_REGION_HDR_SIZE 4096UL
+
+/**
+ * 'sme_len' is the entry's footprint in the ring, including this header.
+ * Bulk entries locate their data by the arena position at which it ends.
+ */
+struct shm_mgr_entry
+{
+    uint32_t sme_len;
+    uint32_t sme_flags;
+    uint64_t sme_msg_size;
+    uint64_t sme_arena_end;
+    char     sme_data[];
+};
+
+struct shm_mgr_hello
+{
+    uint32_t smh_magic;
+    uint32_t smh_version;
+    uint32_t smh_handshake_size;
+    uint32_t smh_pad;
+};
+
+/**
+ * An accepted socket whose handshake has yet to arrive.  The handshake is
+ * received by the socket's EPOLLIN callback and the timer drops sockets which
+ * have not delivered it within SHM_MGR_HANDSHAKE_TIMEOUT_MSEC.  The entry is
+ * freed, and its socket closed, once the epm drops its last reference.  Only
+ * the epm thread touches pending entries.
+ */
+struct shm_mgr_pending
+{
+    struct shm_mgr_instance    *smp_smi;
+    struct tcp_socket_handle    smp_tsh;
+    struct epoll_handle         smp_eph;
+    struct epoll_mgr_timer      smp_timer;
+    int                         smp_ref;
+    LIST_ENTRY(shm_mgr_pending) smp_lentry;
+};
+
+static bool
+shm_mgr_size_is_pow2(size_t size)
+{
+    return (size && !(size & (size - 1))) ? true : false;
+}
+
+static size_t
+shm_mgr_region_size(size_t ring_size, size_t arena_size)
+{
+    return SHM_MGR_REGION_HDR_SIZE + (SHM_MGR_DIR_MAX * ring_size) +
+        (SHM_MGR_DIR_MAX * arena_size);
+}
+
+static bool
+shm_mgr_sizes_are_valid(size_t ring_size, size_t arena_size)
+{
+    return (shm_mgr_size_is_pow2(ring_size) &&
+            ring_size >= SHM_MGR_RING_MIN_SIZE &&
+            ring_size <= SHM_MGR_RING_MAX_SIZE &&
+            shm_mgr_size_is_pow2(arena_size) &&
+            arena_size >= SHM_MGR_RING_MIN_SIZE &&
+            arena_size <= SHM_MGR_ARENA_MAX_SIZE) ? true : false;
+}
+
+/**
+ * shm_mgr_msg_size_max - bulk messages are limited to half of the arena so
+ *   that one always fits, even after skipping the arena's tail end.
+ */
+static size_t
+shm_mgr_msg_size_max(const struct shm_mgr_ring *smr)
+{
+    return smr->smr_arena_size / 2;
+}
+
+int
+shm_mgr_setup(struct shm_mgr_instance *smi, struct epoll_mgr *epm,
+              void *data, shm_mgr_recv_cb_t recv_cb,
+              shm_mgr_accept_cb_t accept_cb)
+{
+    COMPILE_TIME_ASSERT(sizeof(struct shm_mgr_entry) <= SHM_MGR_ENTRY_ALIGN);
+    COMPILE_TIME_ASSERT(sizeof(struct shm_mgr_region_hdr) <=
+                        SHM_MGR_REGION_HDR_SIZE);
+
+    if (!smi || !epm || !recv_cb)
+        return -EINVAL;
+
+    smi->smi_epm = epm;
+    smi->smi_recv_cb = recv_cb;
+    smi->smi_accept_cb = accept_cb;
+    smi->smi_data = data;
+    smi->smi_ring_size = SHM_MGR_RING_DEF_SIZE;
+    smi->smi_arena_size = SHM_MGR_ARENA_DEF_SIZE;
+
+    tcp_socket_handle_init(&smi->smi_listen_socket);
+    LIST_INIT(&smi->smi_pending);
+
+    return epoll_handle_init(&smi->smi_listen_eph, -1, 0, NULL, NULL, NULL);
+}
+
+/**
+ * shm_mgr_sizes_set - sets the ring and arena sizes of the regions created by
+ *   subsequent connects from this instance.  Both must be powers of 2.
+ */
+int
+shm_mgr_sizes_set(struct shm_mgr_instance *smi, size_t ring_size,
+                  size_t arena_size)
+{
+    if (!smi || !shm_mgr_sizes_are_valid(ring_size, arena_size))
+        return -EINVAL;
+
+    smi->smi_ring_size = ring_size;
+    smi->smi_arena_size = arena_size;
+
+    return 0;
+}
+
+void
+shm_mgr_connection_setup(struct shm_mgr_connection *smc,
+                         struct shm_mgr_instance *smi)
+{
+    if (!smc)
+        return;
+
+    memset(smc, 0, sizeof(*smc));
+
+    smc->smc_smi = smi;
+    smc->smc_status = SMCS_DISCONNECTED;
+    smc->smc_tx.smr_doorbell_fd = -1;
+    smc->smc_rx.smr_doorbell_fd = -1;
+
+    tcp_socket_handle_init(&smc->smc_tsh);
+    epoll_handle_init(&smc->smc_sock_eph, -1, 0, NULL, NULL, NULL);
+    epoll_handle_init(&smc->smc_doorbell_eph, -1, 0, NULL, NULL, NULL);
+
+    pthread_mutex_init(&smc->smc_send_mutex, NULL);
+}
+
+static void
+shm_mgr_ring_init(struct shm_mgr_ring *smr, char *region, enum shm_mgr_dir dir,
+                  int doorbell_fd)
+{
+    struct shm_mgr_region_hdr *hdr = (struct shm_mgr_region_hdr *)region;
+    char *data = region + SHM_MGR_REGION_HDR_SIZE;
+
+    smr->smr_ctl = &hdr->smrh_ctl[dir];
+    smr->smr_size = hdr->smrh_ring_size;
+    smr->smr_data = data + (dir * smr->smr_size);
+    smr->smr_arena_size = hdr->smrh_arena_size;
+    smr->smr_arena = data + (SHM_MGR_DIR_MAX * smr->smr_size) +
+        (dir * smr->smr_arena_size);
+    smr->smr_doorbell_fd = doorbell_fd;
+}
+
+static void
+shm_mgr_doorbell_write(int fd)
+{
+    uint64_t one = 1;
+
+    if (write(fd, &one, sizeof(one)) != sizeof(one) && errno != EAGAIN)
+        SIMPLE_LOG_MSG(LL_ERROR, "write(): %s", strerror(errno));
+}
+
+/**
+ * shm_mgr_connection_close_internal - tears down the connection.  Must be
+ *   called from the epm thread.  The send mutex keeps senders off the region
+ *   while it is unmapped.
+ */
+static void
+shm_mgr_connection_close_internal(struct shm_mgr_connection *smc)
+{
+    struct epoll_mgr *epm = smc->smc_smi->smi_epm;
+
+    niova_mutex_lock(&smc->smc_send_mutex);
+
+    if (smc->smc_status != SMCS_CONNECTED)
+    {
+        niova_mutex_unlock(&smc->smc_send_mutex);
+        return;
+    }
+
+    SIMPLE_LOG_MSG(LL_NOTIFY, "smc %p sent=%llu recv=%llu", smc,
+                   smc->smc_send_msgs, smc->smc_recv_msgs);
+
+    if (epoll_handle_is_installed(&smc->smc_doorbell_eph))
+        epoll_handle_del(epm, &smc->smc_doorbell_eph);
+
+    if (epoll_handle_is_installed(&smc->smc_sock_eph))
+        epoll_handle_del(epm, &smc->smc_sock_eph);
+
+    munmap(smc->smc_region, smc->smc_region_size);
+    smc->smc_region = NULL;
+    smc->smc_region_size = 0;
+
+    close(smc->smc_tx.smr_doorbell_fd);
+    close(smc->smc_rx.smr_doorbell_fd);
+    memset(&smc->smc_tx, 0, sizeof(smc->smc_tx));
+    memset(&smc->smc_rx, 0, sizeof(smc->smc_rx));
+    smc->smc_tx.smr_doorbell_fd = -1;
+    smc->smc_rx.smr_doorbell_fd = -1;
+
+    tcp_socket_close(&smc->smc_tsh);
+
+    smc->smc_close_requested = 0;
+    smc->smc_status = SMCS_DISCONNECTED;
+
+    niova_mutex_unlock(&smc->smc_send_mutex);
+}
+
+/**
+ * shm_mgr_connection_close - closes the connection and unmaps its region.
+ *   From outside of the epm thread the close is handed to the epm, through
+ *   the connection's own doorbell, and completes asynchronously.  The
+ *   connection must not be freed before shm_mgr_connection_is_connected()
+ *   returns false.
+ */
+void
+shm_mgr_connection_close(struct shm_mgr_connection *smc)
+{
+    if (!smc || !smc->smc_smi)
+        return;
+
+    if (smc->smc_smi->smi_epm->epm_thread_id == pthread_self())
+    {
+        shm_mgr_connection_close_internal(smc);
+        return;
+    }
+
+    niova_mutex_lock(&smc->smc_send_mutex);
+    if (smc->smc_status == SMCS_CONNECTED)
+    {
+        smc->smc_close_requested = 1;
+        shm_mgr_doorbell_write(smc->smc_rx.smr_doorbell_fd);
+    }
+    niova_mutex_unlock(&smc->smc_send_mutex);
+}
+
+/**
+ * shm_mgr_ring_produce - copies the message into the tx ring, or its arena,
+ *   and rings the peer's doorbell if it has gone idle.  Called with the send
+ *   mutex held.  The consumer's positions live in memory writable by the
+ *   peer and are checked before use.
+ */
+static int
+shm_mgr_ring_produce(struct shm_mgr_connection *smc, const struct iovec *iov,
+                     size_t niovs, size_t msg_size)
+{
+    struct shm_mgr_ring *smr = &smc->smc_tx;
+    struct shm_mgr_ring_ctl *ctl = smr->smr_ctl;
+
+    const size_t size = smr->smr_size;
+    const bool bulk = (sizeof(struct shm_mgr_entry) + msg_size >
+                       size / SHM_MGR_INLINE_DIVISOR) ? true : false;
+
+    if (bulk && msg_size > shm_mgr_msg_size_max(smr))
+        return -EMSGSIZE;
+
+    const size_t len =
+        bulk ? SHM_MGR_ENTRY_ALIGN :
+        ((sizeof(struct shm_mgr_entry) + msg_size + SHM_MGR_ENTRY_ALIGN - 1) &
+         ~(SHM_MGR_ENTRY_ALIGN - 1));
+
+    uint64_t tail = __atomic_load_n(&ctl->smrc_tail, __ATOMIC_RELAXED);
+    uint64_t head = __atomic_load_n(&ctl->smrc_head, __ATOMIC_ACQUIRE);
+    if (tail - head > size)
+        return -EPROTO;
+
+    size_t pos = tail & (size - 1);
+    const size_t pad = (pos + len > size) ? (size - pos) : 0;
+
+    if (tail + pad + len - head > size)
+        return -EAGAIN;
+
+    uint64_t arena_end = 0;
+    if (bulk)
+    {
+        const size_t asize = smr->smr_arena_size;
+        uint64_t atail = __atomic_load_n(&ctl->smrc_arena_tail,
+                                         __ATOMIC_RELAXED);
+        uint64_t ahead = __atomic_load_n(&ctl->smrc_arena_head,
+                                         __ATOMIC_ACQUIRE);
+        if (atail - ahead > asize)
+            return -EPROTO;
+
+        // Bulk data is kept contiguous, skip the arena's tail end if needed
+        size_t apos = atail & (asize - 1);
+        if (apos + msg_size > asize)
+            atail += asize - apos;
+
+        if (atail + msg_size - ahead > asize)
+            return -EAGAIN;
+
+        niova_io_copy_from_iovs(smr->smr_arena + (atail & (asize - 1)),
+                                msg_size, iov, niovs);
+
+        arena_end = atail + msg_size;
+        __atomic_store_n(&ctl->smrc_arena_tail, arena_end, __ATOMIC_RELAXED);
+    }
+
+    struct shm_mgr_entry *sme;
+
+    if (pad)
+    {
+        sme = (struct shm_mgr_entry *)(smr->smr_data + pos);
+        sme->sme_len = pad;
+        sme->sme_flags = SHM_MGR_ENTRY_PAD;
+        sme->sme_msg_size = 0;
+        sme->sme_arena_end = 0;
+
+        tail += pad;
+        pos = 0;
+    }
+
+    sme = (struct shm_mgr_entry *)(smr->smr_data + pos);
+    sme->sme_len = len;
+    sme->sme_flags = bulk ? SHM_MGR_ENTRY_BULK : 0;
+    sme->sme_msg_size = msg_size;
+    sme->sme_arena_end = arena_end;
+
+    if (!bulk)
+        niova_io_copy_from_iovs(sme->sme_data, msg_size, iov, niovs);
+
+    // Publishes the entry, along with any bulk data, to the consumer
+    __atomic_store_n(&ctl->smrc_tail, tail + len, __ATOMIC_RELEASE);
+
+    /* Pairs with the consumer's fence between setting 'waiting' and
+     * re-reading the tail, one side or the other sees the update.
+     */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&ctl->smrc_waiting, __ATOMIC_RELAXED) &&
+        __atomic_exchange_n(&ctl->smrc_waiting, 0, __ATOMIC_ACQ_REL))
+    {
+        shm_mgr_doorbell_write(smr->smr_doorbell_fd);
+        smc->smc_doorbells++;
+    }
+
+    if (bulk)
+        smc->smc_send_bulk++;
+
+    return 0;
+}
+
+/**
+ * shm_mgr_send_msg - copies the message into the connection's shared region.
+ *   Returns -EAGAIN, rather than blocking, while the region has no room for
+ *   it.  Messages may be sent from any thread.
+ */
+int
+shm_mgr_send_msg(struct shm_mgr_connection *smc, const struct iovec *iov,
+                 size_t niovs)
+{
+    if (!smc || !iov || !niovs)
+        return -EINVAL;
+
+    const size_t msg_size = niova_io_iovs_total_size_get(iov, niovs);
+    if (!msg_size)
+        return -EMSGSIZE;
+
+    niova_mutex_lock(&smc->smc_send_mutex);
+
+    int rc = smc->smc_status == SMCS_CONNECTED ?
+        shm_mgr_ring_produce(smc, iov, niovs, msg_size) : -ENOTCONN;
+
+    if (!rc)
+        smc->smc_send_msgs++;
+    else if (rc == -EAGAIN)
+        smc->smc_send_full++;
+
+    niova_mutex_unlock(&smc->smc_send_mutex);
+
+    if (rc && rc != -EAGAIN)
+        SIMPLE_LOG_MSG(LL_NOTIFY, "smc %p msg_size=%zu: %s", smc, msg_size,
+                       strerror(-rc));
+
+    return rc;
+}
+
+/**
+ * shm_mgr_entry_buf_get - locates the message of a non-pad entry.  Returns
+ *   NULL if the entry, which was written by the peer, lies outside the ring
+ *   or arena.
+ */
+static char *
+shm_mgr_entry_buf_get(const struct shm_mgr_ring *smr,
+                      struct shm_mgr_entry *sme, uint32_t len,
+                      uint32_t flags, uint64_t msg_size,
+                      uint64_t arena_end)
+{
+    if (!msg_size)
+        return NULL;
+
+    // Arranged so that a huge 'msg_size' cannot wrap the sum
+    if (!(flags & SHM_MGR_ENTRY_BULK))
+        return (len >= sizeof(struct shm_mgr_entry) &&
+                msg_size <= len - sizeof(struct shm_mgr_entry)) ?
+            sme->sme_data : NULL;
+
+    if (msg_size > shm_mgr_msg_size_max(smr))
+        return NULL;
+
+    size_t apos = (arena_end - msg_size) & (smr->smr_arena_size - 1);
+
+    return (apos + msg_size <= smr->smr_arena_size) ?
+        smr->smr_arena + apos : NULL;
+}
+
+/**
+ * shm_mgr_ring_consume - issues the recv callback for up to
+ *   SHM_MGR_RECV_BUDGET messages, in place, releasing each entry once its
+ *   callback returns.  If work remains the connection rings its own doorbell
+ *   so that other handles in the epm are not starved.
+ */
+static void
+shm_mgr_ring_consume(struct shm_mgr_connection *smc)
+{
+    struct shm_mgr_instance *smi = smc->smc_smi;
+    struct shm_mgr_ring *smr = &smc->smc_rx;
+    struct shm_mgr_ring_ctl *ctl = smr->smr_ctl;
+
+    const size_t size = smr->smr_size;
+    uint64_t head = __atomic_load_n(&ctl->smrc_head, __ATOMIC_RELAXED);
+    int budget = SHM_MGR_RECV_BUDGET;
+
+    for (;;)
+    {
+        uint64_t tail = __atomic_load_n(&ctl->smrc_tail, __ATOMIC_ACQUIRE);
+        if (tail == head)
+        {
+            // Ask for the doorbell then look once more before sleeping
+            __atomic_store_n(&ctl->smrc_waiting, 1, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+            if (__atomic_load_n(&ctl->smrc_tail, __ATOMIC_ACQUIRE) == head)
+                return;
+
+            __atomic_store_n(&ctl->smrc_waiting, 0, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        if (!budget--)
+        {
+            shm_mgr_doorbell_write(smr->smr_doorbell_fd);
+            return;
+        }
+
+        const size_t pos = head & (size - 1);
+        struct shm_mgr_entry *sme =
+            (struct shm_mgr_entry *)(smr->smr_data + pos);
+
+        // Read the entry once, the peer may still scribble on it
+        const uint32_t len = __atomic_load_n(&sme->sme_len, __ATOMIC_RELAXED);
+        const uint32_t flags = __atomic_load_n(&sme->sme_flags,
+                                               __ATOMIC_RELAXED);
+        const uint64_t msg_size = __atomic_load_n(&sme->sme_msg_size,
+                                                  __ATOMIC_RELAXED);
+        const uint64_t arena_end = __atomic_load_n(&sme->sme_arena_end,
+                                                   __ATOMIC_RELAXED);
+
+        char *buf = NULL;
+        bool valid = (tail - head <= size && len >= SHM_MGR_ENTRY_ALIGN &&
+                      !(len & (SHM_MGR_ENTRY_ALIGN - 1)) &&
+                      pos + len <= size && len <= tail - head) ? true : false;
+
+        if (valid && !(flags & SHM_MGR_ENTRY_PAD))
+        {
+            buf = shm_mgr_entry_buf_get(smr, sme, len, flags, msg_size,
+                                        arena_end);
+            valid = buf ? true : false;
+        }
+
+        if (!valid)
+        {
+            SIMPLE_LOG_MSG(LL_ERROR, "smc %p bad entry at %lu len=%u", smc,
+                           head, len);
+            shm_mgr_connection_close_internal(smc);
+            return;
+        }
+
+        if (buf)
+        {
+            int rc = smi->smi_recv_cb(smc, buf, msg_size, smi->smi_data);
+            smc->smc_recv_msgs++;
+
+            // The callback closed the connection, the region is gone
+            if (smc->smc_status != SMCS_CONNECTED)
+                return;
+
+            if (rc < 0)
+            {
+                SIMPLE_LOG_MSG(LL_NOTIFY, "smc %p recv_cb: %s", smc,
+                               strerror(-rc));
+                shm_mgr_connection_close_internal(smc);
+                return;
+            }
+
+            if (flags & SHM_MGR_ENTRY_BULK)
+                __atomic_store_n(&ctl->smrc_arena_head, arena_end,
+                                 __ATOMIC_RELEASE);
+        }
+
+        head += len;
+        __atomic_store_n(&ctl->smrc_head, head, __ATOMIC_RELEASE);
+    }
+}
+
+static epoll_mgr_cb_ctx_t
+shm_mgr_doorbell_cb(const struct epoll_handle *eph, uint32_t events)
+{
+    struct shm_mgr_connection *smc = eph->eph_arg;
+    uint64_t cnt;
+
+    (void)events;
+
+    // The count carries no information, the ring is the source of truth
+    if (read(eph->eph_fd, &cnt, sizeof(cnt)) < 0 && errno != EAGAIN)
+        SIMPLE_LOG_MSG(LL_ERROR, "read(): %s", strerror(errno));
+
+    if (smc->smc_status != SMCS_CONNECTED)
+        return;
+
+    if (smc->smc_close_requested)
+        shm_mgr_connection_close_internal(smc);
+    else
+        shm_mgr_ring_consume(smc);
+}
+
+/**
+ * shm_mgr_sock_cb - the socket carries nothing after the handshake, so
+ *   readiness means that the peer has gone away.
+ */
+static epoll_mgr_cb_ctx_t
+shm_mgr_sock_cb(const struct epoll_handle *eph, uint32_t events)
+{
+    struct shm_mgr_connection *smc = eph->eph_arg;
+    char c;
+
+    ssize_t rc = recv(eph->eph_fd, &c, sizeof(c), MSG_DONTWAIT);
+    if (rc < 0 && (errno == EAGAIN || errno == EINTR))
+        return;
+
+    SIMPLE_LOG_MSG(LL_NOTIFY, "smc %p peer closed (rc=%zd events=%x)", smc,
+                   rc, events);
+
+    shm_mgr_connection_close_internal(smc);
+}
+
+/**
+ * shm_mgr_connection_attach - takes ownership of the mapped region, the
+ *   doorbells and the connected socket, then installs the doorbell and socket
+ *   handles.  Everything is released on failure.
+ */
+static int
+shm_mgr_connection_attach(struct shm_mgr_connection *smc, char *region,
+                          size_t region_size, const int *doorbell_fds,
+                          bool client)
+{
+    const enum shm_mgr_dir tx = client ? SHM_MGR_DIR_C2S : SHM_MGR_DIR_S2C;
+    const enum shm_mgr_dir rx = client ? SHM_MGR_DIR_S2C : SHM_MGR_DIR_C2S;
+    struct epoll_mgr *epm = smc->smc_smi->smi_epm;
+
+    niova_mutex_lock(&smc->smc_send_mutex);
+
+    smc->smc_region = region;
+    smc->smc_region_size = region_size;
+    shm_mgr_ring_init(&smc->smc_tx, region, tx, doorbell_fds[tx]);
+    shm_mgr_ring_init(&smc->smc_rx, region, rx, doorbell_fds[rx]);
+    smc->smc_close_requested = 0;
+    smc->smc_status = SMCS_CONNECTED;
+
+    niova_mutex_unlock(&smc->smc_send_mutex);
+
+    int rc = epoll_handle_init(&smc->smc_doorbell_eph, doorbell_fds[rx],
+                               EPOLLIN, shm_mgr_doorbell_cb, smc, NULL);
+    if (!rc)
+        rc = epoll_handle_add(epm, &smc->smc_doorbell_eph);
+
+    if (!rc)
+        rc = epoll_handle_init(&smc->smc_sock_eph, smc->smc_tsh.tsh_socket,
+                               EPOLLIN | EPOLLRDHUP, shm_mgr_sock_cb, smc,
+                               NULL);
+    if (!rc)
+        rc = epoll_handle_add(epm, &smc->smc_sock_eph);
+
+    if (rc)
+    {
+        SIMPLE_LOG_MSG(LL_ERROR, "smc %p epoll_handle_add(): %s", smc,
+                       strerror(-rc));
+
+        shm_mgr_connection_close_internal(smc);
+    }
+
+    return rc;
+}
+
+static void
+shm_mgr_fds_close(int *fds, size_t nfds)
+{
+    for (size_t i = 0; i < nfds; i++)
+    {
+        if (fds[i] >= 0)
+            close(fds[i]);
+
+        fds[i] = -1;
+    }
+}
+
+/**
+ * shm_mgr_socket_connect - connects the client's socket, which
+ *   tcp_socket_connect() leaves nonblocking.  A Unix-domain connect fails
+ *   with -EAGAIN, rather than proceeding in the background, while the
+ *   listener's backlog is full and is retried.  A connect reported as
+ *   -EINPROGRESS is waited for.  Both waits are bounded by
+ *   SHM_MGR_HANDSHAKE_TIMEOUT_MSEC.
+ */
+static int
+shm_mgr_socket_connect(struct tcp_socket_handle *tsh)
+{
+    int rc;
+
+    for (int i = 0; (rc = tcp_socket_connect(tsh)) == -EAGAIN &&
+             i < SHM_MGR_HANDSHAKE_TIMEOUT_MSEC; i++)
+        usleep(1000);
+
+    if (rc != -EINPROGRESS)
+        return rc;
+
+    struct pollfd pfd = {.fd = tsh->tsh_socket, .events = POLLOUT};
+
+    rc = poll(&pfd, 1, SHM_MGR_HANDSHAKE_TIMEOUT_MSEC);
+    if (rc <= 0)
+        return rc ? -errno : -ETIMEDOUT;
+
+    int error = 0;
+    socklen_t len = sizeof(error);
+
+    if (getsockopt(tsh->tsh_socket, SOL_SOCKET, SO_ERROR, &error, &len))
+        return -errno;
+
+    return -error;
+}
+
+/**
+ * shm_mgr_connect - creates the shared region and its doorbells and passes
+ *   them, along with the handshake, to the shm_mgr listening at 'addr' which
+ *   must be of the form "unix:<path>".  The connection may be used once this
+ *   returns, the peer begins consuming after accepting it.
+ */
+int
+shm_mgr_connect(struct shm_mgr_connection *smc, const char *addr,
+                const void *handshake, size_t handshake_size)
+{
+    if (!smc || !smc->smc_smi || !addr ||
+        (handshake_size && !handshake) ||
+        handshake_size > SHM_MGR_HANDSHAKE_MAX_SIZE)
+        return -EINVAL;
+
+    else if (!tcp_addr_is_unix(addr))
+        return -EAFNOSUPPORT;
+
+    else if (smc->smc_status != SMCS_DISCONNECTED)
+        return -EALREADY;
+
+    const struct shm_mgr_instance *smi = smc->smc_smi;
+    const size_t region_size = shm_mgr_region_size(smi->smi_ring_size,
+                                                   smi->smi_arena_size);
+    int fds[SHM_MGR_NFDS] = {-1, -1, -1};
+    char *region = MAP_FAILED;
+
+    int rc = 0;
+
+    fds[0] = memfd_create("niova-shm-mgr", MFD_CLOEXEC);
+    if (fds[0] < 0 || ftruncate(fds[0], region_size))
+    {
+        rc = -errno;
+        SIMPLE_LOG_MSG(LL_ERROR, "memfd_create(): %s", strerror(-rc));
+        goto out;
+    }
+
+    region = mmap(NULL, region_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                  fds[0], 0);
+    if (region == MAP_FAILED)
+    {
+        rc = -errno;
+        SIMPLE_LOG_MSG(LL_ERROR, "mmap(): %s", strerror(-rc));
+        goto out;
+    }
+
+    // The region is zero-filled, both consumers start out idle
+    struct shm_mgr_region_hdr *hdr = (struct shm_mgr_region_hdr *)region;
+    hdr->smrh_magic = SHM_MGR_MAGIC;
+    hdr->smrh_version = SHM_MGR_VERSION;
+    hdr->smrh_ring_size = smi->smi_ring_size;
+    hdr->smrh_arena_size = smi->smi_arena_size;
+    for (int i = 0; i < SHM_MGR_DIR_MAX; i++)
+        hdr->smrh_ctl[i].smrc_waiting = 1;
+
+    for (int i = 1; i < SHM_MGR_NFDS; i++)
+    {
+        fds[i] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (fds[i] < 0)
+        {
+            rc = -errno;
+            SIMPLE_LOG_MSG(LL_ERROR, "eventfd(): %s", strerror(-rc));
+            goto out;
+        }
+    }
+
+    tcp_socket_handle_init(&smc->smc_tsh);
+    tcp_socket_handle_set_data(&smc->smc_tsh, addr, 0);
+
+    rc = tcp_socket_setup(&smc->smc_tsh);
+    if (!rc)
+        rc = shm_mgr_socket_connect(&smc->smc_tsh);
+
+    if (rc)
+        goto out;
+
+    struct shm_mgr_hello hello = {
+        .smh_magic = SHM_MGR_MAGIC,
+        .smh_version = SHM_MGR_VERSION,
+        .smh_handshake_size = handshake_size,
+    };
+
+    struct iovec iov[2] = {
+        {.iov_base = &hello, .iov_len = sizeof(hello)},
+        {.iov_base = (void *)handshake, .iov_len = handshake_size},
+    };
+
+    union {
+        char           buf[CMSG_SPACE(sizeof(fds))];
+        struct cmsghdr align;
+    } cmsg_u;
+
+    struct msghdr msg = {
+        .msg_iov = iov,
+        .msg_iovlen = handshake_size ? 2 : 1,
+        .msg_control = cmsg_u.buf,
+        .msg_controllen = sizeof(cmsg_u.buf),
+    };
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    ssize_t nb = sendmsg(smc->smc_tsh.tsh_socket, &msg, MSG_NOSIGNAL);
+    if (nb != (ssize_t)(sizeof(hello) + handshake_size))
+    {
+        rc = nb < 0 ? -errno : -EIO;
+        SIMPLE_LOG_MSG(LL_ERROR, "sendmsg(): %s", strerror(-rc));
+        goto out;
+    }
+
+    // The mapping keeps the region alive
+    close(fds[0]);
+    fds[0] = -1;
+
+    return shm_mgr_connection_attach(smc, region, region_size, &fds[1],
+                                     true);
+
+out:
+    if (region != MAP_FAILED)
+        munmap(region, region_size);
+
+    shm_mgr_fds_close(fds, SHM_MGR_NFDS);
+    tcp_socket_close(&smc->smc_tsh);
+
+    return rc;
+}
+
+/**
+ * shm_mgr_handshake_recv - receives the client's region, doorbells and
+ *   handshake without blocking.  Returns -EAGAIN if they have yet to arrive.
+ */
+static int
+shm_mgr_handshake_recv(int sock, int *fds, char *buf, size_t buf_size)
+{
+    union {
+        char           buf[CMSG_SPACE(SHM_MGR_NFDS * sizeof(int))];
+        struct cmsghdr align;
+    } cmsg_u;
+
+    struct iovec iov = {.iov_base = buf, .iov_len = buf_size};
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = cmsg_u.buf,
+        .msg_controllen = sizeof(cmsg_u.buf),
+    };
+
+    ssize_t nb = recvmsg(sock, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+    if (nb < 0)
+        return -errno;
+
+    size_t nfds = 0;
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+         cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+
+        size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < n; i++)
+        {
+            int fd;
+            memcpy(&fd, CMSG_DATA(cmsg) + (i * sizeof(int)), sizeof(int));
+
+            if (nfds < SHM_MGR_NFDS)
+                fds[nfds++] = fd;
+            else
+                close(fd);
+        }
+    }
+
+    if (nfds != SHM_MGR_NFDS || (msg.msg_flags & MSG_CTRUNC))
+        return -EPROTO;
+
+    return nb;
+}
+
+/**
+ * shm_mgr_accept - validates the handshake, of 'nb' bytes or a negative
+ *   error from shm_mgr_handshake_recv(), maps the client's region and
+ *   attaches it to the connection supplied by the accept callback.  The
+ *   received fds are consumed.
+ */
+static int
+shm_mgr_accept(struct shm_mgr_instance *smi, struct tcp_socket_handle *tsh,
+               int *fds, char *buf, ssize_t nb)
+{
+    struct shm_mgr_hello *hello;
+    char *region = MAP_FAILED;
+    size_t region_size = 0;
+    struct shm_mgr_connection *smc = NULL;
+
+    int rc = nb < 0 ? nb : 0;
+    if (rc)
+        goto out;
+
+    hello = (struct shm_mgr_hello *)buf;
+    if (nb < (ssize_t)sizeof(*hello) || hello->smh_magic != SHM_MGR_MAGIC ||
+        hello->smh_version != SHM_MGR_VERSION ||
+        hello->smh_handshake_size > SHM_MGR_HANDSHAKE_MAX_SIZE ||
+        nb != (ssize_t)(sizeof(*hello) + hello->smh_handshake_size))
+    {
+        rc = -EPROTO;
+        goto out;
+    }
+
+    struct stat stb;
+    if (fstat(fds[0], &stb))
+    {
+        rc = -errno;
+        goto out;
+    }
+
+    region_size = stb.st_size;
+    if (region_size < SHM_MGR_REGION_HDR_SIZE)
+    {
+        rc = -EPROTO;
+        goto out;
+    }
+
+    region = mmap(NULL, region_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                  fds[0], 0);
+    if (region == MAP_FAILED)
+    {
+        rc = -errno;
+        goto out;
+    }
+
+    const struct shm_mgr_region_hdr *hdr =
+        (const struct shm_mgr_region_hdr *)region;
+
+    if (hdr->smrh_magic != SHM_MGR_MAGIC ||
+        hdr->smrh_version != SHM_MGR_VERSION ||
+        !shm_mgr_sizes_are_valid(hdr->smrh_ring_size,
+                                 hdr->smrh_arena_size) ||
+        shm_mgr_region_size(hdr->smrh_ring_size,
+                            hdr->smrh_arena_size) != region_size)
+    {
+        rc = -EPROTO;
+        goto out;
+    }
+
+    rc = smi->smi_accept_cb ?
+        smi->smi_accept_cb(smi->smi_data, &smc, buf + sizeof(*hello),
+                           hello->smh_handshake_size) : -ENOTSUP;
+    if (rc)
+        goto out;
+
+    if (!smc || smc->smc_smi != smi || smc->smc_status != SMCS_DISCONNECTED)
+    {
+        rc = -EINVAL;
+        goto out;
+    }
+
+    close(fds[0]);
+    fds[0] = -1;
+
+    smc->smc_tsh = *tsh;
+    tcp_socket_handle_init(tsh);
+
+    return shm_mgr_connection_attach(smc, region, region_size, &fds[1],
+                                     false);
+
+out:
+    SIMPLE_LOG_MSG(LL_NOTIFY, "accept failed: %s", strerror(-rc));
+
+    if (region != MAP_FAILED)
+        munmap(region, region_size);
+
+    shm_mgr_fds_close(fds, SHM_MGR_NFDS);
+
+    return rc;
+}
+
+static void
+shm_mgr_pending_getput(void *arg, enum epoll_handle_ref_op op)
+{
+    struct shm_mgr_pending *smp = arg;
+
+    if (op == EPH_REF_GET)
+    {
+        smp->smp_ref++;
+        return;
+    }
+
+    NIOVA_ASSERT(smp->smp_ref > 0);
+    if (--smp->smp_ref)
+        return;
+
+    tcp_socket_close(&smp->smp_tsh);
+    niova_free(smp);
+}
+
+/**
+ * shm_mgr_pending_drop - removes the entry's handle and timer, which releases
+ *   it once the epm is done with it.
+ */
+static void
+shm_mgr_pending_drop(struct shm_mgr_pending *smp)
+{
+    struct epoll_mgr *epm = smp->smp_smi->smi_epm;
+
+    LIST_REMOVE(smp, smp_lentry);
+    epoll_mgr_timer_cancel(epm, &smp->smp_timer);
+
+    int rc = epoll_handle_del(epm, &smp->smp_eph);
+    if (rc)
+        SIMPLE_LOG_MSG(LL_ERROR, "epoll_handle_del(): %s", strerror(-rc));
+}
+
+static void
+shm_mgr_pending_timer_cb(struct epoll_mgr_timer *emt, void *arg)
+{
+    struct shm_mgr_pending *smp = arg;
+
+    (void)emt;
+
+    SIMPLE_LOG_MSG(LL_NOTIFY, "handshake timed out (fd=%d)",
+                   smp->smp_tsh.tsh_socket);
+
+    shm_mgr_pending_drop(smp);
+}
+
+static epoll_mgr_cb_ctx_t
+shm_mgr_pending_cb(const struct epoll_handle *eph, uint32_t events)
+{
+    struct shm_mgr_pending *smp = eph->eph_arg;
+    char buf[sizeof(struct shm_mgr_hello) + SHM_MGR_HANDSHAKE_MAX_SIZE];
+    int fds[SHM_MGR_NFDS] = {-1, -1, -1};
+
+    (void)events;
+
+    ssize_t nb = shm_mgr_handshake_recv(smp->smp_tsh.tsh_socket, fds, buf,
+                                        sizeof(buf));
+    if (nb == -EAGAIN || nb == -EINTR)
+        return;
+
+    /* The socket must leave the epm before it can be attached to a
+     * connection, which installs it anew.
+     */
+    struct shm_mgr_instance *smi = smp->smp_smi;
+    struct tcp_socket_handle tsh = smp->smp_tsh;
+
+    tcp_socket_handle_init(&smp->smp_tsh);
+    shm_mgr_pending_drop(smp);
+
+    shm_mgr_accept(smi, &tsh, fds, buf, nb);
+
+    tcp_socket_close(&tsh);
+}
+
+/**
+ * shm_mgr_listen_cb - accepts the socket and waits, from the epm, for its
+ *   handshake so that a slow or silent client does not stall the epm thread.
+ */
+static epoll_mgr_cb_ctx_t
+shm_mgr_listen_cb(const struct epoll_handle *eph, uint32_t events)
+{
+    struct shm_mgr_instance *smi = eph->eph_arg;
+
+    (void)events;
+
+    struct shm_mgr_pending *smp =
+        niova_calloc_can_fail(1UL, sizeof(struct shm_mgr_pending));
+    if (!smp)
+    {
+        SIMPLE_LOG_MSG(LL_ERROR, "niova_calloc_can_fail(): %s",
+                       strerror(ENOMEM));
+        return;
+    }
+
+    smp->smp_smi = smi;
+    tcp_socket_handle_init(&smp->smp_tsh);
+    epoll_mgr_timer_init(&smp->smp_timer, shm_mgr_pending_timer_cb, smp);
+
+    // Released below, once the handle holds its own reference
+    smp->smp_ref = 1;
+
+    int rc = tcp_socket_handle_accept(eph->eph_fd, &smp->smp_tsh);
+    if (!rc)
+        rc = epoll_handle_init(&smp->smp_eph, smp->smp_tsh.tsh_socket,
+                               EPOLLIN, shm_mgr_pending_cb, smp,
+                               shm_mgr_pending_getput);
+    if (!rc)
+        rc = epoll_handle_add(smi->smi_epm, &smp->smp_eph);
+
+    if (!rc)
+    {
+        LIST_INSERT_HEAD(&smi->smi_pending, smp, smp_lentry);
+
+        rc = epoll_mgr_timer_arm(smi->smi_epm, &smp->smp_timer,
+                                 SHM_MGR_HANDSHAKE_TIMEOUT_MSEC * 1000ULL);
+        if (rc)
+        {
+            SIMPLE_LOG_MSG(LL_ERROR, "epoll_mgr_timer_arm(): %s",
+                           strerror(-rc));
+            shm_mgr_pending_drop(smp);
+        }
+    }
+
+    shm_mgr_pending_getput(smp, EPH_REF_PUT);
+}
+
+/**
+ * shm_mgr_listen - accepts shm_mgr connections on the Unix-domain socket
+ *   'addr' ("unix:<path>").  Requires an accept callback.
+ */
+int
+shm_mgr_listen(struct shm_mgr_instance *smi, const char *addr)
+{
+    if (!smi || !smi->smi_accept_cb || !addr)
+        return -EINVAL;
+
+    else if (!tcp_addr_is_unix(addr))
+        return -EAFNOSUPPORT;
+
+    else if (smi->smi_listen_socket.tsh_socket >= 0)
+        return -EALREADY;
+
+    struct tcp_socket_handle *tsh = &smi->smi_listen_socket;
+
+    tcp_socket_handle_set_data(tsh, addr, 0);
+
+    int rc = tcp_socket_setup(tsh);
+    if (!rc)
+        rc = tcp_socket_bind(tsh);
+
+    if (rc)
+        return rc;
+
+    rc = epoll_handle_init(&smi->smi_listen_eph, tsh->tsh_socket, EPOLLIN,
+                           shm_mgr_listen_cb, smi, NULL);
+    if (!rc)
+        rc = epoll_handle_add(smi->smi_epm, &smi->smi_listen_eph);
+
+    if (rc)
+    {
+        SIMPLE_LOG_MSG(LL_ERROR, "epoll_handle_add(): %s", strerror(-rc));
+        tcp_socket_close(tsh);
+    }
+
+    return rc;
+}
+
+/**
+ * shm_mgr_close - stops listening and drops sockets whose handshake has yet
+ *   to arrive.  Must be called from the epm thread, or once the epm is no
+ *   longer being run, but before it is closed.  Connections are closed
+ *   individually with shm_mgr_connection_close().
+ */
+int
+shm_mgr_close(struct shm_mgr_instance *smi)
+{
+    if (!smi)
+        return -EINVAL;
+
+    if (epoll_handle_is_installed(&smi->smi_listen_eph))
+        epoll_handle_del(smi->smi_epm, &smi->smi_listen_eph);
+
+    struct shm_mgr_pending *smp;
+    while ((smp = LIST_FIRST(&smi->smi_pending)))
+        shm_mgr_pending_drop(smp);
+
+    return smi->smi_listen_socket.tsh_socket >= 0 ?
+        tcp_socket_close(&smi->smi_listen_socket) : 0;
+}
@@ -5,10 +5,29 @@
  */
 
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <linux/errqueue.h>
 #include "io.h"
 #include "tcp.h"
 #include "log.h"
 
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
 REGISTRY_ENTRY_FILE_GENERATE;
 
 static size_t maxTcpSize = NIOVA_MAX_TCP_SIZE;
@@ -54,6 +73,99 @@ tcp_setup_sockaddr_in(const char *ipaddr, int port,
     return !rc ? -EINVAL : 0;
 }
 
+/**
+ * tcp_setup_sockaddr_un - fills 'addr_un' from an address of the form
+ *   "unix:<path>".
+ */
+int
+tcp_setup_sockaddr_un(const char *addr, struct sockaddr_un *addr_un)
+{
+    if (!tcp_addr_is_unix(addr) || !addr_un)
+        return -EINVAL;
+
+    const char *path = addr + TCP_UNIX_ADDR_PREFIX_LEN;
+    const size_t len = strlen(path);
+
+    if (!len)
+        return -EINVAL;
+
+    else if (len >= sizeof(addr_un->sun_path))
+        return -ENAMETOOLONG;
+
+    memset(addr_un, 0, sizeof(*addr_un));
+    addr_un->sun_family = AF_UNIX;
+    memcpy(addr_un->sun_path, path, len);
+
+    return 0;
+}
+
+static int
+tcp_socket_sockaddr_get(const struct tcp_socket_handle *tsh,
+                        struct sockaddr_storage *addr, socklen_t *addr_len)
+{
+    if (tcp_socket_handle_is_unix(tsh))
+    {
+        *addr_len = sizeof(struct sockaddr_un);
+        return tcp_setup_sockaddr_un(tsh->tsh_ipaddr,
+                                     (struct sockaddr_un *)addr);
+    }
+
+    *addr_len = sizeof(struct sockaddr_in);
+    return tcp_setup_sockaddr_in(tsh->tsh_ipaddr, tsh->tsh_port,
+                                 (struct sockaddr_in *)addr);
+}
+
+/**
+ * tcp_socket_unix_stale_remove - removes the socket file left behind by a
+ *   listener which has exited.  A file which is not a socket, or which still
+ *   has a listener, is left in place and the bind will fail.
+ */
+static void
+tcp_socket_unix_stale_remove(const struct sockaddr_un *addr_un)
+{
+    struct stat stb;
+
+    if (lstat(addr_un->sun_path, &stb) || !S_ISSOCK(stb.st_mode))
+        return;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0)
+        return;
+
+    if (connect(fd, (const struct sockaddr *)addr_un, sizeof(*addr_un)) &&
+        errno == ECONNREFUSED)
+    {
+        SIMPLE_LOG_MSG(LL_NOTIFY, "removing stale socket %s",
+                       addr_un->sun_path);
+        unlink(addr_un->sun_path);
+    }
+
+    close(fd);
+}
+
+/**
+ * tcp_socket_unix_listener_unlink - removes the socket file of a listening
+ *   Unix-domain socket.  Accepted sockets share the listener's name and are
+ *   skipped.
+ */
+static void
+tcp_socket_unix_listener_unlink(int socket)
+{
+    int listening = 0;
+    socklen_t len = sizeof(listening);
+
+    if (getsockopt(socket, SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) ||
+        !listening)
+        return;
+
+    struct sockaddr_un addr_un = {0};
+    len = sizeof(addr_un);
+
+    if (!getsockname(socket, (struct sockaddr *)&addr_un, &len) &&
+        len > offsetof(struct sockaddr_un, sun_path) && addr_un.sun_path[0])
+        unlink(addr_un.sun_path);
+}
+
 void
 tcp_sockaddr_in_2_handle(struct sockaddr_in *addr_in,
                          struct tcp_socket_handle *tsh)
@@ -84,6 +196,9 @@ tcp_socket_close(struct tcp_socket_handle *tsh)
     int socket = tsh->tsh_socket;
     tsh->tsh_socket = -1;
 
+    if (socket >= 0 && tcp_socket_handle_is_unix(tsh))
+        tcp_socket_unix_listener_unlink(socket);
+
     return (socket >= 0) ? close(socket) : 0;
 }
 
@@ -97,7 +212,9 @@ tcp_socket_setup(struct tcp_socket_handle *tsh)
 
     int rc = 0;
 
-    tsh->tsh_socket = socket(AF_INET, SOCK_STREAM, 0);
+    const int domain = tcp_socket_handle_is_unix(tsh) ? AF_UNIX : AF_INET;
+
+    tsh->tsh_socket = socket(domain, SOCK_STREAM, 0);
     if (tsh->tsh_socket < 0)
     {
         rc = -errno;
@@ -116,6 +233,24 @@ tcp_socket_set_nonblocking(struct tcp_socket_handle *tsh)
     return fcntl(tsh->tsh_socket, F_SETFL, O_NONBLOCK);
 }
 
+/**
+ * tcp_socket_reuseport_enable - allows several sockets to bind the same
+ *   address, the kernel then spreads incoming connections across them.  Must
+ *   be called on each of them prior to tcp_socket_bind().
+ */
+int
+tcp_socket_reuseport_enable(const struct tcp_socket_handle *tsh)
+{
+    if (!tsh || tsh->tsh_socket < 0)
+        return -EINVAL;
+
+    int sock_opt = 1;
+    int rc = setsockopt(tsh->tsh_socket, SOL_SOCKET, SO_REUSEPORT, &sock_opt,
+                        sizeof(sock_opt));
+
+    return rc ? -errno : 0;
+}
+
 /**
  * tcp_socket_bind - called at some point after tcp_socket_setup() to complete
  *    the setup of the UDP socket.
@@ -127,24 +262,32 @@ tcp_socket_bind(struct tcp_socket_handle *tsh)
     if (!tsh || tsh->tsh_socket < 0)
         return -EINVAL;
 
+    const bool unix_socket = tcp_socket_handle_is_unix(tsh);
+
     if (tsh->tsh_port <= 0)
-        tsh->tsh_port = tcpDefaultPort;
+        tsh->tsh_port = unix_socket ? 0 : tcpDefaultPort;
 
-    int sock_opt = 1;
-    setsockopt(tsh->tsh_socket, SOL_SOCKET, SO_REUSEADDR, (char*)&sock_opt,
-               sizeof(sock_opt));
+    if (!unix_socket)
+    {
+        int sock_opt = 1;
+        setsockopt(tsh->tsh_socket, SOL_SOCKET, SO_REUSEADDR,
+                   (char*)&sock_opt, sizeof(sock_opt));
+    }
 
-    struct sockaddr_in addr_in = {0};
+    struct sockaddr_storage addr = {0};
+    socklen_t addr_len;
 
     SIMPLE_LOG_MSG(LL_NOTIFY, "tcp_socket_bind(): %s:%d", tsh->tsh_ipaddr,
                    tsh->tsh_port);
 
-    int rc = tcp_setup_sockaddr_in(tsh->tsh_ipaddr, tsh->tsh_port, &addr_in);
+    int rc = tcp_socket_sockaddr_get(tsh, &addr, &addr_len);
     if (rc)
         goto out;
 
-    rc = bind(tsh->tsh_socket, (struct sockaddr *)&addr_in,
-              sizeof(addr_in));
+    if (unix_socket)
+        tcp_socket_unix_stale_remove((struct sockaddr_un *)&addr);
+
+    rc = bind(tsh->tsh_socket, (struct sockaddr *)&addr, addr_len);
     if (rc)
     {
         rc = -errno;
@@ -169,15 +312,124 @@ out:
     return rc;
 }
 
+/**
+ * tcp_socket_send_nb - issues a single non-blocking sendmsg().  Returns the
+ *   number of bytes sent, which may be less than the size of the iovs, or
+ *   -EAGAIN if the socket buffer is full.  With 'zerocopy' the pages are
+ *   pinned rather than copied and must not be modified until the send's
+ *   completion has been read with tcp_socket_zerocopy_reap().
+ */
+ssize_t
+tcp_socket_send_nb(const struct tcp_socket_handle *tsh,
+                   const struct iovec *iov, const size_t iovlen,
+                   bool zerocopy)
+{
+    SIMPLE_FUNC_ENTRY(LL_TRACE);
+
+    if (!tsh || !iov || !iovlen)
+        return -EINVAL;
+
+    else if (iovlen > IO_MAX_IOVS)
+        return -E2BIG;
+
+    struct msghdr msg = {
+        .msg_name = 0,
+        .msg_namelen = 0,
+        .msg_iov = (struct iovec *)iov,
+        .msg_iovlen = iovlen,
+    };
+
+    ssize_t rc;
+    do
+    {
+        rc = sendmsg(tsh->tsh_socket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT |
+                     (zerocopy ? MSG_ZEROCOPY : 0));
+    } while (rc < 0 && errno == EINTR);
+
+    if (rc < 0)
+    {
+        rc = (errno == EWOULDBLOCK) ? -EAGAIN : -errno;
+        if (rc != -EAGAIN && rc != -ENOBUFS)
+            LOG_MSG(LL_NOTIFY, "sendmsg() %s:%u: %s",
+                    tsh->tsh_ipaddr, tsh->tsh_port, strerror(-rc));
+    }
+
+    SIMPLE_LOG_MSG(LL_DEBUG, "sendmsg() %s:%u rc=%zd",
+                   tsh->tsh_ipaddr, tsh->tsh_port, rc);
+
+    return rc;
+}
+
+int
+tcp_socket_zerocopy_enable(const struct tcp_socket_handle *tsh)
+{
+    if (!tsh || tsh->tsh_socket < 0)
+        return -EINVAL;
+
+    int sock_opt = 1;
+    int rc = setsockopt(tsh->tsh_socket, SOL_SOCKET, SO_ZEROCOPY, &sock_opt,
+                        sizeof(sock_opt));
+
+    return rc ? -errno : 0;
+}
+
+/**
+ * tcp_socket_zerocopy_reap - reads one notification from the socket's error
+ *   queue.  Zero-copy sends are numbered from 0 in the order they were issued
+ *   and each notification covers the range [lo, hi].  'copied' is set if the
+ *   kernel fell back to copying the data, as it does on loopback.  Returns
+ *   -EAGAIN once the queue is empty and -ENOMSG for other error types.
+ */
+int
+tcp_socket_zerocopy_reap(const struct tcp_socket_handle *tsh, uint32_t *lo,
+                         uint32_t *hi, bool *copied)
+{
+    if (!tsh || !lo || !hi || !copied)
+        return -EINVAL;
+
+    char control[128];
+    struct msghdr msg = {
+        .msg_control = control,
+        .msg_controllen = sizeof(control),
+    };
+
+    ssize_t rc;
+    do
+    {
+        rc = recvmsg(tsh->tsh_socket, &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+    } while (rc < 0 && errno == EINTR);
+
+    if (rc < 0)
+        return (errno == EWOULDBLOCK) ? -EAGAIN : -errno;
+
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    if (!cm ||
+        !((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+          (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+        return -ENOMSG;
+
+    const struct sock_extended_err *serr =
+        (const struct sock_extended_err *)CMSG_DATA(cm);
+
+    if (serr->ee_errno || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+        return -ENOMSG;
+
+    *lo = serr->ee_info;
+    *hi = serr->ee_data;
+    *copied = (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) ? true : false;
+
+    return 0;
+}
+
 int
 tcp_socket_handle_accept(int fd, struct tcp_socket_handle *tsh)
 {
-    struct sockaddr_in addr_in;
-    unsigned int addr_size = sizeof(struct sockaddr_in);
+    struct sockaddr_storage addr;
+    socklen_t addr_size = sizeof(addr);
 
     SIMPLE_LOG_MSG(LL_NOTIFY, "tcp_socket_handle_accept()");
 
-    int rc = accept(fd, (struct sockaddr *)&addr_in, &addr_size);
+    int rc = accept(fd, (struct sockaddr *)&addr, &addr_size);
     if (rc < 0)
     {
         rc = -errno;
@@ -187,7 +439,12 @@ tcp_socket_handle_accept(int fd, struct tcp_socket_handle *tsh)
     }
 
     tsh->tsh_socket = rc;
-    tcp_sockaddr_in_2_handle(&addr_in, tsh);
+
+    // Unix-domain clients are normally unnamed
+    if (addr.ss_family == AF_INET)
+        tcp_sockaddr_in_2_handle((struct sockaddr_in *)&addr, tsh);
+    else
+        tcp_socket_handle_set_data(tsh, TCP_UNIX_ADDR_PREFIX, 0);
 
     return 0;
 };
@@ -242,7 +499,7 @@ tcp_socket_recv(const struct tcp_socket_handle *tsh, struct iovec *iov,
         return rc;
     }
 
-    if (from)
+    if (from && !tcp_socket_handle_is_unix(tsh))
         tcp_setup_sockaddr_in(tsh->tsh_ipaddr, tsh->tsh_port, from);
 
     SIMPLE_LOG_MSG((rc == 0 ? LL_NOTIFY : LL_DEBUG),
@@ -323,9 +580,25 @@ tcp_socket_send(const struct tcp_socket_handle *tsh, const struct iovec *iov,
         sendmsg_rc = sendmsg(tsh->tsh_socket, &msg, MSG_NOSIGNAL);
         if (sendmsg_rc < 0)
         {
-            if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+            if (errno == EINTR)
                 continue; // retry the send.
 
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                // Wait for the socket to drain rather than spinning
+                struct pollfd pfd = {
+                    .fd = tsh->tsh_socket,
+                    .events = POLLOUT,
+                };
+
+                int poll_rc = poll(&pfd, 1, NIOVA_TCP_SEND_TIMEOUT_MSEC);
+                if (poll_rc > 0 || (poll_rc < 0 && errno == EINTR))
+                    continue;
+
+                else if (!poll_rc)
+                    errno = ETIMEDOUT;
+            }
+
             rc = -errno;
 
             LOG_MSG(LL_NOTIFY, "sendmsg() %s:%u: %s",
@@ -355,16 +628,19 @@ tcp_socket_connect(struct tcp_socket_handle *tsh)
     if (!tsh || tsh->tsh_socket < 0)
         return -EINVAL;
 
-    struct sockaddr_in addr_in = {0};
-    tcp_setup_sockaddr_in(tsh->tsh_ipaddr, tsh->tsh_port, &addr_in);
+    struct sockaddr_storage addr = {0};
+    socklen_t addr_len;
+
+    int rc = tcp_socket_sockaddr_get(tsh, &addr, &addr_len);
+    if (rc)
+        return rc;
 
     SIMPLE_LOG_MSG(LL_NOTIFY, "tcp_socket_connect() fd:%d host: %s:%d",
                    tsh->tsh_socket, tsh->tsh_ipaddr, tsh->tsh_port);
 
     tcp_socket_set_nonblocking(tsh);
 
-    int rc = connect(tsh->tsh_socket, (struct sockaddr *)&addr_in,
-                     sizeof(struct sockaddr_in));
+    rc = connect(tsh->tsh_socket, (struct sockaddr *)&addr, addr_len);
     if (rc < 0)
     {
         rc = -errno;
@@ -1,16 +1,22 @@
 #include <sys/ioctl.h>
+#include <lz4.h>
 
 #include "alloc.h"
+#include "ctor.h"
 #include "log.h"
 #include "epoll_mgr.h"
 #include "io.h"
+#include "registry.h"
 #include "tcp.h"
 #include "tcp_mgr.h"
 #include "util.h"
 
 REGISTRY_ENTRY_FILE_GENERATE;
 
+LREG_ROOT_ENTRY_GENERATE(tcp_mgr_nodes, LREG_USER_TYPE_TCP_MGR);
+
 static int tcpWorkerCnt = TCP_MGR_NTHREADS;
+static unsigned int tcpMgrCorkUsec;
 
 
 int
@@ -63,97 +69,2408 @@ tcp_mgr_incoming_credits_set(struct tcp_mgr_instance *tmi, uint32_t cnt)
     tcp_mgr_credits_set(&tmi->tmi_incoming_credits, cnt);
 }
 
-static void *
-tcp_mgr_bulk_malloc(struct tcp_mgr_instance *tmi, size_t sz)
+void
+tcp_mgr_sendq_max_bytes_set(struct tcp_mgr_instance *tmi, size_t max_bytes)
 {
-    return tcp_mgr_credits_malloc(&tmi->tmi_bulk_credits, sz);
+    tmi->tmi_sendq_max_bytes = max_bytes;
+}
+
+/**
+ * tcp_mgr_cork_usec_set - sets the window over which messages are coalesced,
+ *   zero disables corking.
+ */
+int
+tcp_mgr_cork_usec_set(struct tcp_mgr_instance *tmi, unsigned int usec)
+{
+    if (!tmi || usec > TCP_MGR_CORK_MAX_USEC)
+        return -EINVAL;
+
+    tmi->tmi_cork_usec = usec;
+
+    return 0;
+}
+
+/**
+ * tcp_mgr_zerocopy_threshold_set - sets the message size at which
+ *   tcp_mgr_send_msg_zc() uses MSG_ZEROCOPY, zero disables zero-copy.  The
+ *   setting applies to connections established after the call.
+ */
+int
+tcp_mgr_zerocopy_threshold_set(struct tcp_mgr_instance *tmi, size_t bytes)
+{
+    if (!tmi || (bytes && bytes < TCP_MGR_ZEROCOPY_MIN_BYTES))
+        return -EINVAL;
+
+    tmi->tmi_zerocopy_threshold = bytes;
+
+    return 0;
+}
+
+/**
+ * tcp_mgr_recv_buf_size_set - sets the size of each connection's receive
+ *   buffer, zero disables buffered receive.  The buffer is allocated on the
+ *   connection's first read and is only used if it can hold the connection's
+ *   header.
+ */
+int
+tcp_mgr_recv_buf_size_set(struct tcp_mgr_instance *tmi, size_t bytes)
+{
+    if (!tmi || (bytes && (bytes < TCP_MGR_RECV_BUF_MIN_SIZE ||
+                           bytes > TCP_MGR_RECV_BUF_MAX_SIZE)))
+        return -EINVAL;
+
+    tmi->tmi_recv_buf_size = bytes;
+
+    return 0;
+}
+
+/**
+ * tcp_mgr_flow_control_set - sets the number of messages each peer may have
+ *   outstanding on a connection, zero disables flow control.  The setting
+ *   applies to connections established after the call.
+ */
+int
+tcp_mgr_flow_control_set(struct tcp_mgr_instance *tmi, uint32_t credits)
+{
+    if (!tmi || credits > TCP_MGR_FC_MAX_CREDITS)
+        return -EINVAL;
+
+    tmi->tmi_fc_credits = credits;
+
+    return 0;
+}
+
+/**
+ * tcp_mgr_compress_threshold_set - sets the bulk size from which sends are
+ *   compressed, zero disables compression.  The setting applies to
+ *   connections established after the call.
+ */
+int
+tcp_mgr_compress_threshold_set(struct tcp_mgr_instance *tmi, size_t bytes)
+{
+    if (!tmi || (bytes && (bytes < TCP_MGR_COMPRESS_MIN_THRESHOLD ||
+                           bytes > TCP_MGR_MAX_BULK_SIZE)))
+        return -EINVAL;
+
+    tmi->tmi_compress_threshold = bytes;
+
+    return 0;
+}
+
+/**
+ * tcp_mgr_connection_compress_offer - called from tmi_handshake_fill.
+ *   Returns the capabilities to be passed, through the handshake, to the
+ *   peer's tcp_mgr_connection_compress_accept().
+ */
+uint32_t
+tcp_mgr_connection_compress_offer(struct tcp_mgr_connection *tmc)
+{
+    if (!tmc || !tmc->tmc_tmi)
+        return 0;
+
+    tmc->tmc_compress_caps =
+        tmc->tmc_tmi->tmi_compress_threshold ? TCP_MGR_COMPRESS_LZ4 : 0;
+
+    return tmc->tmc_compress_caps;
+}
+
+/**
+ * tcp_mgr_connection_compress_accept - called from tmi_handshake_cb with the
+ *   connection being returned and the capabilities found in the handshake.
+ *   Unknown capabilities are ignored.
+ */
+void
+tcp_mgr_connection_compress_accept(struct tcp_mgr_connection *tmc,
+                                   uint32_t caps)
+{
+    if (tmc)
+        tmc->tmc_compress_caps = caps & TCP_MGR_COMPRESS_LZ4;
+}
+
+enum tcp_mgr_lreg_stats
+{
+    TCP_MGR_LREG_NAME,          // string
+    TCP_MGR_LREG_LATENCY_STATS, // bool
+    TCP_MGR_LREG_NUM_CONNS,     // unsigned int
+    TCP_MGR_LREG_NUM_CLOSED,    // unsigned int
+    // BYTES_IN through SEND_HIST are totals over all connections
+    TCP_MGR_LREG_BYTES_IN,      // unsigned int
+    TCP_MGR_LREG_MSGS_IN,       // unsigned int
+    TCP_MGR_LREG_BYTES_OUT,     // unsigned int
+    TCP_MGR_LREG_MSGS_OUT,      // unsigned int
+    TCP_MGR_LREG_SENDQ_FULL,    // unsigned int
+    TCP_MGR_LREG_SOCK_EAGAIN,   // unsigned int
+    TCP_MGR_LREG_COMPRESS_IN,   // unsigned int
+    TCP_MGR_LREG_COMPRESS_OUT,  // unsigned int
+    TCP_MGR_LREG_COMPRESS_SKIP, // unsigned int
+    TCP_MGR_LREG_COMPRESS_USEC, // unsigned int
+    TCP_MGR_LREG_DECOMP_USEC,   // unsigned int
+    TCP_MGR_LREG_BULK_HIST,     // string
+    TCP_MGR_LREG_RECV_HIST,     // string
+    TCP_MGR_LREG_SEND_HIST,     // string
+    TCP_MGR_LREG_CONNS,         // varray
+    TCP_MGR_LREG___MAX,
+};
+
+enum tcp_mgr_conn_lreg_stats
+{
+    TCP_MGR_CONN_LREG_PEER,            // string
+    TCP_MGR_CONN_LREG_FD,              // signed int
+    TCP_MGR_CONN_LREG_BYTES_IN,        // unsigned int
+    TCP_MGR_CONN_LREG_MSGS_IN,         // unsigned int
+    TCP_MGR_CONN_LREG_BYTES_OUT,       // unsigned int
+    TCP_MGR_CONN_LREG_MSGS_OUT,        // unsigned int
+    TCP_MGR_CONN_LREG_SEND_SYSCALLS,   // unsigned int
+    TCP_MGR_CONN_LREG_SENDQ_BYTES,     // unsigned int
+    TCP_MGR_CONN_LREG_SENDQ_MAX_BYTES, // unsigned int
+    TCP_MGR_CONN_LREG_SENDQ_FULL,      // unsigned int
+    TCP_MGR_CONN_LREG_SOCK_EAGAIN,     // unsigned int
+    TCP_MGR_CONN_LREG_FC_STALLS,       // unsigned int
+    TCP_MGR_CONN_LREG_ZC_SENDS,        // unsigned int
+    TCP_MGR_CONN_LREG_COMPRESS,        // bool
+    TCP_MGR_CONN_LREG_COMPRESS_IN,     // unsigned int
+    TCP_MGR_CONN_LREG_COMPRESS_OUT,    // unsigned int
+    TCP_MGR_CONN_LREG_COMPRESS_SKIP,   // unsigned int
+    TCP_MGR_CONN_LREG_COMPRESS_USEC,   // unsigned int
+    TCP_MGR_CONN_LREG_DECOMP_USEC,     // unsigned int
+    TCP_MGR_CONN_LREG_BULK_HIST,       // string
+    TCP_MGR_CONN_LREG_RECV_HIST,       // string
+    TCP_MGR_CONN_LREG_SEND_HIST,       // string
+    TCP_MGR_CONN_LREG___MAX,
+};
+
+static unsigned long long
+tcp_mgr_now_usec(void)
+{
+    struct timespec now;
+    niova_unstable_clock(&now);
+
+    return timespec_2_usec(&now);
+}
+
+static unsigned long long
+tcp_mgr_stats_start_usec(const struct tcp_mgr_connection *tmc)
+{
+    return tmc->tmc_tmi->tmi_latency_stats ? tcp_mgr_now_usec() : 0;
 }
 
 static void
-tcp_mgr_bulk_free(struct tcp_mgr_instance *tmi, void *buf)
+tcp_mgr_stats_usec_record(struct binary_hist *bh, unsigned long long start)
 {
-    tcp_mgr_credits_free(&tmi->tmi_bulk_credits, buf);
+    if (start)
+        binary_hist_incorporate_val(bh, tcp_mgr_now_usec() - start);
 }
 
+/**
+ * tcp_mgr_connection_stats_init - zeroes the counters and histograms.  The
+ *   histograms are left out, and so are not kept, if they have not been
+ *   allocated.
+ */
 static void
-tcp_mgr_connection_put(struct tcp_mgr_connection *tmc)
+tcp_mgr_connection_stats_init(struct tcp_mgr_connection_stats *tmcs)
 {
-    if (tmc->tmc_tmi && tmc->tmc_tmi->tmi_connection_ref_cb)
-        tmc->tmc_tmi->tmi_connection_ref_cb(tmc, EPH_REF_PUT);
+    struct binary_hist *bulk_hist = tmcs->tmcs_bulk_hist;
+    struct binary_hist *recv_usec_hist = tmcs->tmcs_recv_usec_hist;
+    struct binary_hist *send_usec_hist = tmcs->tmcs_send_usec_hist;
+
+    memset(tmcs, 0, sizeof(*tmcs));
+
+    tmcs->tmcs_bulk_hist = bulk_hist;
+    tmcs->tmcs_recv_usec_hist = recv_usec_hist;
+    tmcs->tmcs_send_usec_hist = send_usec_hist;
+
+    if (bulk_hist)
+        binary_hist_init(bulk_hist, TCP_MGR_STATS_BULK_HIST_START_BIT,
+                         TCP_MGR_STATS_BULK_HIST_BUCKETS);
+    if (recv_usec_hist)
+        binary_hist_init(recv_usec_hist, TCP_MGR_STATS_USEC_HIST_START_BIT,
+                         TCP_MGR_STATS_USEC_HIST_BUCKETS);
+    if (send_usec_hist)
+        binary_hist_init(send_usec_hist, TCP_MGR_STATS_USEC_HIST_START_BIT,
+                         TCP_MGR_STATS_USEC_HIST_BUCKETS);
 }
 
 static void
-tcp_mgr_conn_recv_inline(struct tcp_mgr_connection *tmc);
+tcp_mgr_connection_stats_hists_free(struct tcp_mgr_connection_stats *tmcs)
+{
+    niova_free(tmcs->tmcs_bulk_hist);
+    niova_free(tmcs->tmcs_recv_usec_hist);
+    niova_free(tmcs->tmcs_send_usec_hist);
+
+    tmcs->tmcs_bulk_hist = NULL;
+    tmcs->tmcs_recv_usec_hist = NULL;
+    tmcs->tmcs_send_usec_hist = NULL;
+}
+
+static int
+tcp_mgr_connection_stats_hists_alloc(struct tcp_mgr_connection_stats *tmcs)
+{
+    if (!tmcs->tmcs_bulk_hist)
+        tmcs->tmcs_bulk_hist =
+            niova_malloc_can_fail(sizeof(struct binary_hist));
+    if (!tmcs->tmcs_recv_usec_hist)
+        tmcs->tmcs_recv_usec_hist =
+            niova_malloc_can_fail(sizeof(struct binary_hist));
+    if (!tmcs->tmcs_send_usec_hist)
+        tmcs->tmcs_send_usec_hist =
+            niova_malloc_can_fail(sizeof(struct binary_hist));
+
+    if (!tmcs->tmcs_bulk_hist || !tmcs->tmcs_recv_usec_hist ||
+        !tmcs->tmcs_send_usec_hist)
+    {
+        tcp_mgr_connection_stats_hists_free(tmcs);
+        return -ENOMEM;
+    }
+
+    return 0;
+}
 
 static void
-tcp_mgr_conn_reenable(struct tcp_mgr_connection *tmc)
+tcp_mgr_stats_hist_add(struct binary_hist *dst, const struct binary_hist *src)
 {
-    if (!tmc->tmc_handoff)
+    if (!dst || !src)
         return;
 
+    for (int i = 0; i < binary_hist_size(dst); i++)
+        dst->bh_values[i] += binary_hist_get_cnt(src, i);
+}
+
+static void
+tcp_mgr_connection_stats_add(struct tcp_mgr_connection_stats *dst,
+                             const struct tcp_mgr_connection_stats *src)
+{
+    dst->tmcs_bytes_in += src->tmcs_bytes_in;
+    dst->tmcs_msgs_in += src->tmcs_msgs_in;
+    dst->tmcs_bytes_out += src->tmcs_bytes_out;
+    dst->tmcs_sendq_full += src->tmcs_sendq_full;
+    dst->tmcs_sock_eagain += src->tmcs_sock_eagain;
+    dst->tmcs_sendq_max_bytes = MAX(dst->tmcs_sendq_max_bytes,
+                                    src->tmcs_sendq_max_bytes);
+    dst->tmcs_compress_in += src->tmcs_compress_in;
+    dst->tmcs_compress_out += src->tmcs_compress_out;
+    dst->tmcs_compress_usec += src->tmcs_compress_usec;
+    dst->tmcs_compress_skipped += src->tmcs_compress_skipped;
+    dst->tmcs_decompress_usec += src->tmcs_decompress_usec;
+
+    tcp_mgr_stats_hist_add(dst->tmcs_bulk_hist, src->tmcs_bulk_hist);
+    tcp_mgr_stats_hist_add(dst->tmcs_recv_usec_hist,
+                           src->tmcs_recv_usec_hist);
+    tcp_mgr_stats_hist_add(dst->tmcs_send_usec_hist,
+                           src->tmcs_send_usec_hist);
+}
+
+/**
+ * tcp_mgr_connection_stats_attach - restarts the connection's stats and adds
+ *   it to the instance's established connections.  A connection which cannot
+ *   be added is only missing from the registry.
+ */
+static void
+tcp_mgr_connection_stats_attach(struct tcp_mgr_connection *tmc)
+{
     struct tcp_mgr_instance *tmi = tmc->tmc_tmi;
-    struct tcp_mgr_connq *tmcq = &tmi->tmi_connq;
 
-    niova_mutex_lock(&tmcq->tmcq_mutex);
+    niova_mutex_lock(&tmc->tmc_send_mutex);
 
-    if (!tmc->tmc_handoff)
+    // Without its histograms the connection still keeps its counters
+    if (tcp_mgr_connection_stats_hists_alloc(&tmc->tmc_stats))
+        DBG_TCP_MGR_CXN(LL_WARN, tmc, "no memory for stats histograms");
+
+    tcp_mgr_connection_stats_init(&tmc->tmc_stats);
+    tmc->tmc_send_msgs = 0;
+    tmc->tmc_send_syscalls = 0;
+
+    niova_mutex_unlock(&tmc->tmc_send_mutex);
+
+    tmc->tmc_hdr_usec = 0;
+
+    niova_mutex_lock(&tmi->tmi_stats_mutex);
+
+    if (tmc->tmc_stats_idx < 0 &&
+        tmi->tmi_stats_nconns == tmi->tmi_stats_nalloc)
     {
-        niova_mutex_unlock(&tmcq->tmcq_mutex);
-        return;
+        size_t nalloc = tmi->tmi_stats_nalloc ? tmi->tmi_stats_nalloc * 2 : 16;
+
+        if (!niova_reallocarray(tmi->tmi_stats_conns,
+                                struct tcp_mgr_connection *, nalloc))
+            tmi->tmi_stats_nalloc = nalloc;
     }
 
-    tmc->tmc_handoff = 0; // mark the tmc as not residing on the queue
+    if (tmc->tmc_stats_idx < 0 &&
+        tmi->tmi_stats_nconns < tmi->tmi_stats_nalloc)
+    {
+        tmc->tmc_stats_idx = tmi->tmi_stats_nconns++;
+        tmi->tmi_stats_conns[tmc->tmc_stats_idx] = tmc;
+    }
 
-    int rc = epoll_handle_mod(tmi->tmi_epoll_mgr, &tmc->tmc_eph);
-    if (rc != 0)
-        LOG_MSG(LL_DEBUG, "epoll_handle_mod(): %s", strerror(-rc));
+    niova_mutex_unlock(&tmi->tmi_stats_mutex);
+}
 
-    niova_mutex_unlock(&tmcq->tmcq_mutex);
+/**
+ * tcp_mgr_connection_stats_detach - removes the connection from the
+ *   registry's view and folds its stats into the instance's totals.  Called
+ *   once the connection can no longer send.
+ */
+static void
+tcp_mgr_connection_stats_detach(struct tcp_mgr_connection *tmc)
+{
+    struct tcp_mgr_instance *tmi = tmc->tmc_tmi;
+
+    niova_mutex_lock(&tmi->tmi_stats_mutex);
+
+    const ssize_t idx = tmc->tmc_stats_idx;
+    if (idx >= 0)
+    {
+        NIOVA_ASSERT((size_t)idx < tmi->tmi_stats_nconns &&
+                     tmi->tmi_stats_conns[idx] == tmc);
+
+        // Swap with the last entry
+        struct tcp_mgr_connection *last =
+            tmi->tmi_stats_conns[--tmi->tmi_stats_nconns];
+
+        tmi->tmi_stats_conns[idx] = last;
+        last->tmc_stats_idx = idx;
+        tmc->tmc_stats_idx = -1;
+
+        tcp_mgr_connection_stats_add(&tmi->tmi_stats_closed, &tmc->tmc_stats);
+        tmi->tmi_stats_closed_msgs_out += tmc->tmc_send_msgs;
+        tmi->tmi_stats_nclosed++;
+    }
+
+    niova_mutex_unlock(&tmi->tmi_stats_mutex);
+
+    // Senders record their latency while holding the send mutex
+    niova_mutex_lock(&tmc->tmc_send_mutex);
+    tcp_mgr_connection_stats_hists_free(&tmc->tmc_stats);
+    niova_mutex_unlock(&tmc->tmc_send_mutex);
 }
 
-static void *
-tcp_mgr_worker(void *arg)
+/**
+ * tcp_mgr_stats_recv_hdr - counts a message whose header has just been read
+ *   and notes the time for the receive latency.  'wire_size' is the size of
+ *   the entire message as sent, which differs from its header and bulk sizes
+ *   if the bulk was compressed.
+ */
+static void
+tcp_mgr_stats_recv_hdr(struct tcp_mgr_connection *tmc, size_t wire_size,
+                       size_t bulk_size)
 {
-    struct thread_ctl *tc = (struct thread_ctl *)arg;
-    NIOVA_ASSERT(tc && tc->tc_arg);
+    struct tcp_mgr_connection_stats *tmcs = &tmc->tmc_stats;
 
-    struct tcp_mgr_instance *tmi = (struct tcp_mgr_instance *)tc->tc_arg;
-    struct tcp_mgr_connq *tmcq = &tmi->tmi_connq;
+    tmcs->tmcs_msgs_in++;
+    tmcs->tmcs_bytes_in += wire_size;
 
-    THREAD_LOOP_WITH_CTL(tc)
+    if (bulk_size)
+        binary_hist_incorporate_val(tmcs->tmcs_bulk_hist, bulk_size);
+
+    tmc->tmc_hdr_usec = tcp_mgr_stats_start_usec(tmc);
+}
+
+/**
+ * tcp_mgr_latency_stats_set - enables or disables the latency histograms of
+ *   the instance's connections.
+ */
+void
+tcp_mgr_latency_stats_set(struct tcp_mgr_instance *tmi, bool enable)
+{
+    if (tmi)
+        tmi->tmi_latency_stats = enable ? 1 : 0;
+}
+
+static int
+tcp_mgr_conn_lreg_cb(enum lreg_node_cb_ops op, struct lreg_node *lrn,
+                     struct lreg_value *lv)
+{
+    if (!lrn || !lrn->lrn_cb_arg)
+        return -EINVAL;
+
+    struct tcp_mgr_instance *tmi = lrn->lrn_cb_arg;
+
+    if (lv)
+        lv->get.lrv_num_keys_out = TCP_MGR_CONN_LREG___MAX;
+
+    NIOVA_ASSERT(lrn->lrn_vnode_child);
+    const size_t idx = lrn->lrn_lvd.lvd_index;
+
+    int rc = 0;
+
+    niova_mutex_lock(&tmi->tmi_stats_mutex);
+
+    if (idx >= tmi->tmi_stats_nconns)
     {
-        struct tcp_mgr_connection *tmc = NULL;
+        niova_mutex_unlock(&tmi->tmi_stats_mutex);
+        return -ERANGE;
+    }
 
-        NIOVA_WAIT_COND(
-            (!STAILQ_EMPTY(&tmcq->tmcq_queue) ||
-             thread_ctl_has_flag(tc, TC_FLAG_HALT)),
-             &tmcq->tmcq_mutex, &tmcq->tmcq_cond,
-            {
-                if (!STAILQ_EMPTY(&tmcq->tmcq_queue) &&
-                    !thread_ctl_has_flag(tc, TC_FLAG_HALT))
-                {
-                    tmc = STAILQ_FIRST(&tmcq->tmcq_queue);
-                    STAILQ_REMOVE_HEAD(&tmcq->tmcq_queue, tmc_lentry);
-                }
-            });
+    const struct tcp_mgr_connection *tmc = tmi->tmi_stats_conns[idx];
+    const struct tcp_mgr_connection_stats *tmcs = &tmc->tmc_stats;
+    char str[LREG_VALUE_STRING_MAX];
+
+    switch (op)
+    {
+    case LREG_NODE_CB_OP_GET_NAME:
+        if (!lv)
+        {
+            rc = -EINVAL;
+            break;
+        }
+        strncpy(lv->lrv_key_string, "connections", LREG_VALUE_STRING_MAX);
+        strncpy(LREG_VALUE_TO_OUT_STR(lv), "none", LREG_VALUE_STRING_MAX);
+        break;
+
+    case LREG_NODE_CB_OP_READ_VAL:
+        if (!lv)
+        {
+            rc = -EINVAL;
+            break;
+        }
+        switch (lv->lrv_value_idx_in)
+        {
+        case TCP_MGR_CONN_LREG_PEER:
+            snprintf(str, sizeof(str), "%s:%d", tmc->tmc_tsh.tsh_ipaddr,
+                     tmc->tmc_tsh.tsh_port);
+            lreg_value_fill_string(lv, "peer", str);
+            break;
+        case TCP_MGR_CONN_LREG_FD:
+            lreg_value_fill_signed(lv, "fd", tmc->tmc_tsh.tsh_socket);
+            break;
+        case TCP_MGR_CONN_LREG_BYTES_IN:
+            lreg_value_fill_unsigned(lv, "bytes-in", tmcs->tmcs_bytes_in);
+            break;
+        case TCP_MGR_CONN_LREG_MSGS_IN:
+            lreg_value_fill_unsigned(lv, "msgs-in", tmcs->tmcs_msgs_in);
+            break;
+        case TCP_MGR_CONN_LREG_BYTES_OUT:
+            lreg_value_fill_unsigned(lv, "bytes-out", tmcs->tmcs_bytes_out);
+            break;
+        case TCP_MGR_CONN_LREG_MSGS_OUT:
+            lreg_value_fill_unsigned(lv, "msgs-out", tmc->tmc_send_msgs);
+            break;
+        case TCP_MGR_CONN_LREG_SEND_SYSCALLS:
+            lreg_value_fill_unsigned(lv, "send-syscalls",
+                                     tmc->tmc_send_syscalls);
+            break;
+        case TCP_MGR_CONN_LREG_SENDQ_BYTES:
+            lreg_value_fill_unsigned(lv, "sendq-bytes",
+                                     tmc->tmc_sendq_bytes);
+            break;
+        case TCP_MGR_CONN_LREG_SENDQ_MAX_BYTES:
+            lreg_value_fill_unsigned(lv, "sendq-max-bytes",
+                                     tmcs->tmcs_sendq_max_bytes);
+            break;
+        case TCP_MGR_CONN_LREG_SENDQ_FULL:
+            lreg_value_fill_unsigned(lv, "sendq-full", tmcs->tmcs_sendq_full);
+            break;
+        case TCP_MGR_CONN_LREG_SOCK_EAGAIN:
+            lreg_value_fill_unsigned(lv, "sock-eagain",
+                                     tmcs->tmcs_sock_eagain);
+            break;
+        case TCP_MGR_CONN_LREG_FC_STALLS:
+            lreg_value_fill_unsigned(lv, "fc-stalls", tmc->tmc_fc_stalls);
+            break;
+        case TCP_MGR_CONN_LREG_ZC_SENDS:
+            lreg_value_fill_unsigned(lv, "zc-sends", tmc->tmc_zc_sends);
+            break;
+        case TCP_MGR_CONN_LREG_COMPRESS:
+            lreg_value_fill_bool(lv, "compress",
+                                 tmc->tmc_compress ? true : false);
+            break;
+        case TCP_MGR_CONN_LREG_COMPRESS_IN:
+            lreg_value_fill_unsigned(lv, "compress-in-bytes",
+                                     tmcs->tmcs_compress_in);
+            break;
+        case TCP_MGR_CONN_LREG_COMPRESS_OUT:
+            lreg_value_fill_unsigned(lv, "compress-out-bytes",
+                                     tmcs->tmcs_compress_out);
+            break;
+        case TCP_MGR_CONN_LREG_COMPRESS_SKIP:
+            lreg_value_fill_unsigned(lv, "compress-skipped",
+                                     tmcs->tmcs_compress_skipped);
+            break;
+        case TCP_MGR_CONN_LREG_COMPRESS_USEC:
+            lreg_value_fill_unsigned(lv, "compress-usec",
+                                     tmcs->tmcs_compress_usec);
+            break;
+        case TCP_MGR_CONN_LREG_DECOMP_USEC:
+            lreg_value_fill_unsigned(lv, "decompress-usec",
+                                     tmcs->tmcs_decompress_usec);
+            break;
+        case TCP_MGR_CONN_LREG_BULK_HIST:
+            binary_hist_to_string(tmcs->tmcs_bulk_hist, str, sizeof(str));
+            lreg_value_fill_string(lv, "bulk-bytes-hist", str);
+            break;
+        case TCP_MGR_CONN_LREG_RECV_HIST:
+            binary_hist_to_string(tmcs->tmcs_recv_usec_hist, str,
+                                  sizeof(str));
+            lreg_value_fill_string(lv, "recv-usec-hist", str);
+            break;
+        case TCP_MGR_CONN_LREG_SEND_HIST:
+            binary_hist_to_string(tmcs->tmcs_send_usec_hist, str,
+                                  sizeof(str));
+            lreg_value_fill_string(lv, "send-usec-hist", str);
+            break;
+        default:
+            rc = -EOPNOTSUPP;
+            break;
+        }
+        break;
+
+    default:
+        rc = -EOPNOTSUPP;
+        break;
+    }
+
+    niova_mutex_unlock(&tmi->tmi_stats_mutex);
+
+    return rc;
+}
+
+/**
+ * tcp_mgr_stats_totals_locked - sums the stats of the established
+ *   connections with those of the connections which have closed.
+ */
+static unsigned long long
+tcp_mgr_stats_totals_locked(const struct tcp_mgr_instance *tmi,
+                            struct tcp_mgr_connection_stats *tot)
+{
+    unsigned long long msgs_out = tmi->tmi_stats_closed_msgs_out;
+
+    // 'tot' supplies its own histograms
+    tcp_mgr_connection_stats_init(tot);
+    tcp_mgr_connection_stats_add(tot, &tmi->tmi_stats_closed);
+
+    for (size_t i = 0; i < tmi->tmi_stats_nconns; i++)
+    {
+        const struct tcp_mgr_connection *tmc = tmi->tmi_stats_conns[i];
 
-        SIMPLE_LOG_MSG(LL_DEBUG, "tmc=%p", tmc);
+        tcp_mgr_connection_stats_add(tot, &tmc->tmc_stats);
+        msgs_out += tmc->tmc_send_msgs;
+    }
+
+    return msgs_out;
+}
+
+static int
+tcp_mgr_lreg_cb(enum lreg_node_cb_ops op, struct lreg_node *lrn,
+                struct lreg_value *lv)
+{
+    struct tcp_mgr_instance *tmi = lrn->lrn_cb_arg;
+    if (!tmi)
+        return -EINVAL;
+
+    int rc = 0;
+
+    switch (op)
+    {
+    case LREG_NODE_CB_OP_WRITE_VAL:           // fall through
+    case LREG_NODE_CB_OP_INSTALL_QUEUED_NODE: // fall through
+    case LREG_NODE_CB_OP_INSTALL_NODE:        // fall through
+    case LREG_NODE_CB_OP_DESTROY_NODE:
+        break;
+
+    case LREG_NODE_CB_OP_GET_NAME:
+        if (!lv)
+            return -EINVAL;
+        lv->get.lrv_num_keys_out = TCP_MGR_LREG___MAX;
+        strncpy(lv->lrv_key_string, "tcp-mgrs", LREG_VALUE_STRING_MAX);
+        break;
+
+    case LREG_NODE_CB_OP_READ_VAL:
+    {
+        if (!lv)
+            return -EINVAL;
+
+        struct binary_hist hists[3];
+        struct tcp_mgr_connection_stats tot = {
+            .tmcs_bulk_hist = &hists[0],
+            .tmcs_recv_usec_hist = &hists[1],
+            .tmcs_send_usec_hist = &hists[2],
+        };
+        char str[LREG_VALUE_STRING_MAX];
+        unsigned long long msgs_out = 0;
+
+        // Only the aggregate keys walk the connections
+        const bool totals = (lv->lrv_value_idx_in >= TCP_MGR_LREG_BYTES_IN &&
+                             lv->lrv_value_idx_in <= TCP_MGR_LREG_SEND_HIST) ?
+            true : false;
+
+        niova_mutex_lock(&tmi->tmi_stats_mutex);
+        if (totals)
+            msgs_out = tcp_mgr_stats_totals_locked(tmi, &tot);
+        const size_t nconns = tmi->tmi_stats_nconns;
+        niova_mutex_unlock(&tmi->tmi_stats_mutex);
+
+        switch (lv->lrv_value_idx_in)
+        {
+        case TCP_MGR_LREG_NAME:
+            lreg_value_fill_string(lv, "name", tmi->tmi_name);
+            break;
+        case TCP_MGR_LREG_LATENCY_STATS:
+            lreg_value_fill_bool(lv, "latency-stats",
+                                 tmi->tmi_latency_stats ? true : false);
+            break;
+        case TCP_MGR_LREG_NUM_CONNS:
+            lreg_value_fill_unsigned(lv, "num-connections", nconns);
+            break;
+        case TCP_MGR_LREG_NUM_CLOSED:
+            lreg_value_fill_unsigned(lv, "num-closed",
+                                     tmi->tmi_stats_nclosed);
+            break;
+        case TCP_MGR_LREG_BYTES_IN:
+            lreg_value_fill_unsigned(lv, "bytes-in", tot.tmcs_bytes_in);
+            break;
+        case TCP_MGR_LREG_MSGS_IN:
+            lreg_value_fill_unsigned(lv, "msgs-in", tot.tmcs_msgs_in);
+            break;
+        case TCP_MGR_LREG_BYTES_OUT:
+            lreg_value_fill_unsigned(lv, "bytes-out", tot.tmcs_bytes_out);
+            break;
+        case TCP_MGR_LREG_MSGS_OUT:
+            lreg_value_fill_unsigned(lv, "msgs-out", msgs_out);
+            break;
+        case TCP_MGR_LREG_SENDQ_FULL:
+            lreg_value_fill_unsigned(lv, "sendq-full", tot.tmcs_sendq_full);
+            break;
+        case TCP_MGR_LREG_SOCK_EAGAIN:
+            lreg_value_fill_unsigned(lv, "sock-eagain", tot.tmcs_sock_eagain);
+            break;
+        case TCP_MGR_LREG_COMPRESS_IN:
+            lreg_value_fill_unsigned(lv, "compress-in-bytes",
+                                     tot.tmcs_compress_in);
+            break;
+        case TCP_MGR_LREG_COMPRESS_OUT:
+            lreg_value_fill_unsigned(lv, "compress-out-bytes",
+                                     tot.tmcs_compress_out);
+            break;
+        case TCP_MGR_LREG_COMPRESS_SKIP:
+            lreg_value_fill_unsigned(lv, "compress-skipped",
+                                     tot.tmcs_compress_skipped);
+            break;
+        case TCP_MGR_LREG_COMPRESS_USEC:
+            lreg_value_fill_unsigned(lv, "compress-usec",
+                                     tot.tmcs_compress_usec);
+            break;
+        case TCP_MGR_LREG_DECOMP_USEC:
+            lreg_value_fill_unsigned(lv, "decompress-usec",
+                                     tot.tmcs_decompress_usec);
+            break;
+        case TCP_MGR_LREG_BULK_HIST:
+            binary_hist_to_string(tot.tmcs_bulk_hist, str, sizeof(str));
+            lreg_value_fill_string(lv, "bulk-bytes-hist", str);
+            break;
+        case TCP_MGR_LREG_RECV_HIST:
+            binary_hist_to_string(tot.tmcs_recv_usec_hist, str, sizeof(str));
+            lreg_value_fill_string(lv, "recv-usec-hist", str);
+            break;
+        case TCP_MGR_LREG_SEND_HIST:
+            binary_hist_to_string(tot.tmcs_send_usec_hist, str, sizeof(str));
+            lreg_value_fill_string(lv, "send-usec-hist", str);
+            break;
+        case TCP_MGR_LREG_CONNS:
+            lreg_value_fill_varray(lv, "connections",
+                                   LREG_USER_TYPE_TCP_MGR_CONN, nconns,
+                                   tcp_mgr_conn_lreg_cb);
+            break;
+        default:
+            break;
+        }
+        break;
+    }
+
+    default:
+        rc = -ENOENT;
+        break;
+    }
+
+    return rc;
+}
+
+/**
+ * tcp_mgr_lreg_install - publishes the instance in the registry under 'name'.
+ *   tcp_mgr_lreg_remove() must be called before the instance is released.
+ */
+int
+tcp_mgr_lreg_install(struct tcp_mgr_instance *tmi, const char *name)
+{
+    if (!tmi || !name)
+        return -EINVAL;
+
+    else if (tmi->tmi_lrn)
+        return -EALREADY;
+
+    struct lreg_node *lrn = niova_calloc_can_fail(1UL, sizeof(*lrn));
+    if (!lrn)
+        return -ENOMEM;
+
+    strncpy(tmi->tmi_name, name, TCP_MGR_STATS_NAME_MAX - 1);
+
+    lreg_node_init(lrn, LREG_USER_TYPE_TCP_MGR, tcp_mgr_lreg_cb, tmi,
+                   LREG_INIT_OPT_NONE);
+
+    int rc = lreg_node_install(lrn, LREG_ROOT_ENTRY_PTR(tcp_mgr_nodes));
+    if (!rc)
+        rc = lreg_node_wait_for_completion(lrn, true);
+
+    if (rc)
+    {
+        niova_free(lrn);
+        return rc;
+    }
+
+    tmi->tmi_lrn = lrn;
+
+    return 0;
+}
+
+void
+tcp_mgr_lreg_remove(struct tcp_mgr_instance *tmi)
+{
+    struct lreg_node *lrn = tmi ? tmi->tmi_lrn : NULL;
+    if (!lrn)
+        return;
+
+    int rc = lreg_node_remove(lrn, LREG_ROOT_ENTRY_PTR(tcp_mgr_nodes));
+    if (!rc)
+        rc = lreg_node_wait_for_completion(lrn, false);
+
+    FATAL_IF(rc, "lreg_node_remove(): %s", strerror(-rc));
+
+    tmi->tmi_lrn = NULL;
+    niova_free(lrn);
+}
 
-        if (tmc == NULL)
+static void
+tcp_mgr_connection_compress_setup(struct tcp_mgr_connection *tmc)
+{
+    tmc->tmc_compress =
+        (tmc->tmc_compress_caps & TCP_MGR_COMPRESS_LZ4) ? 1 : 0;
+    tmc->tmc_compress_caps = 0;
+    tmc->tmc_compress_backoff = 0;
+    tmc->tmc_compress_skip = 0;
+}
+
+static size_t
+tcp_mgr_connection_compress_hdr_size(const struct tcp_mgr_connection *tmc)
+{
+    return tmc->tmc_compress ? sizeof(struct tcp_mgr_compress_hdr) : 0;
+}
+
+/**
+ * tcp_mgr_compress_try - returns false while compression is backed off.
+ */
+static bool
+tcp_mgr_compress_try(struct tcp_mgr_connection *tmc)
+{
+    bool attempt = true;
+
+    niova_mutex_lock(&tmc->tmc_send_mutex);
+
+    if (tmc->tmc_compress_skip)
+    {
+        tmc->tmc_compress_skip--;
+        tmc->tmc_stats.tmcs_compress_skipped++;
+        attempt = false;
+    }
+
+    niova_mutex_unlock(&tmc->tmc_send_mutex);
+
+    return attempt;
+}
+
+static void
+tcp_mgr_compress_account(struct tcp_mgr_connection *tmc, size_t bulk_size,
+                         size_t zsize, unsigned long long usec)
+{
+    struct tcp_mgr_connection_stats *tmcs = &tmc->tmc_stats;
+
+    niova_mutex_lock(&tmc->tmc_send_mutex);
+
+    tmcs->tmcs_compress_usec += usec;
+
+    if (zsize)
+    {
+        tmcs->tmcs_compress_in += bulk_size;
+        tmcs->tmcs_compress_out += zsize;
+        tmc->tmc_compress_backoff = 0;
+    }
+    else
+    {
+        tmcs->tmcs_compress_skipped++;
+        tmc->tmc_compress_backoff =
+            MIN(MAX(tmc->tmc_compress_backoff * 2, 1),
+                TCP_MGR_COMPRESS_MAX_BACKOFF);
+        tmc->tmc_compress_skip = tmc->tmc_compress_backoff;
+    }
+
+    niova_mutex_unlock(&tmc->tmc_send_mutex);
+}
+
+/**
+ * tcp_mgr_compress_frame - places the tcp_mgr_compress_hdr ahead of the
+ *   message and, if the bulk is large enough and shrinks, replaces the bulk
+ *   with its compressed form, held in '*zbuf' which the caller must free
+ *   once the message has been sent or queued.  'frame_iovs' must have room
+ *   for niovs + 2 iovs.  Returns the number of iovs used or a negative
+ *   errno.
+ */
+static ssize_t
+tcp_mgr_compress_frame(struct tcp_mgr_connection *tmc,
+                       struct tcp_mgr_compress_hdr *czh,
+                       const struct iovec *iov, size_t niovs,
+                       size_t total_size, struct iovec *frame_iovs,
+                       char **zbuf)
+{
+    const size_t header_size = tmc->tmc_header_size;
+    const size_t bulk_size = total_size > header_size ?
+        total_size - header_size : 0;
+    const size_t threshold = tmc->tmc_tmi->tmi_compress_threshold;
+
+    czh->tmch_size = bulk_size;
+    czh->tmch_flags = 0;
+
+    frame_iovs[0].iov_base = czh;
+    frame_iovs[0].iov_len = sizeof(*czh);
+
+    *zbuf = NULL;
+
+    if (threshold && bulk_size >= threshold && tcp_mgr_compress_try(tmc))
+    {
+        struct iovec bulk_iovs[niovs];
+        ssize_t nbulk = niova_io_iovs_map_consumed(iov, bulk_iovs, niovs,
+                                                   header_size, -1);
+        if (nbulk <= 0)
+            return nbulk ? nbulk : -EINVAL;
+
+        // Anything larger than this is not worth sending compressed
+        const size_t zmax = bulk_size - bulk_size / TCP_MGR_COMPRESS_MIN_SAVING;
+
+        // A bulk spread over several iovs is gathered behind the output
+        char *buf = niova_malloc_can_fail(zmax + (nbulk > 1 ? bulk_size : 0));
+        if (!buf)
+            return -ENOMEM;
+
+        const char *src = bulk_iovs[0].iov_base;
+        if (nbulk > 1)
+        {
+            niova_io_copy_from_iovs(buf + zmax, bulk_size, bulk_iovs, nbulk);
+            src = buf + zmax;
+        }
+
+        const unsigned long long start = tcp_mgr_now_usec();
+
+        int zsize = LZ4_compress_default(src, buf, bulk_size, zmax);
+
+        tcp_mgr_compress_account(tmc, bulk_size, MAX(zsize, 0),
+                                 tcp_mgr_now_usec() - start);
+        if (zsize > 0)
+        {
+            czh->tmch_size = zsize;
+            czh->tmch_flags = TCP_MGR_COMPRESS_LZ4;
+
+            ssize_t nhdr = header_size ?
+                niova_io_iovs_map_consumed(iov, &frame_iovs[1], niovs, 0,
+                                           header_size) : 0;
+            if (nhdr < 0)
+            {
+                niova_free(buf);
+                return nhdr;
+            }
+
+            frame_iovs[nhdr + 1].iov_base = buf;
+            frame_iovs[nhdr + 1].iov_len = zsize;
+
+            *zbuf = buf;
+
+            return nhdr + 2;
+        }
+
+        niova_free(buf);
+    }
+
+    memcpy(&frame_iovs[1], iov, niovs * sizeof(struct iovec));
+
+    return niovs + 1;
+}
+
+/**
+ * tcp_mgr_compress_hdr_recv - validates the received tcp_mgr_compress_hdr
+ *   against the bulk size taken from the message's header and sets 'zsize'
+ *   to the size of the compressed bulk, or zero if the bulk was sent as is.
+ */
+static int
+tcp_mgr_compress_hdr_recv(const struct tcp_mgr_connection *tmc,
+                          const char *buf, size_t bulk_size, size_t *zsize)
+{
+    struct tcp_mgr_compress_hdr czh;
+    memcpy(&czh, buf, sizeof(czh));
+
+    *zsize = 0;
+
+    if (czh.tmch_flags & ~TCP_MGR_COMPRESS_LZ4)
+        return -EBADMSG;
+
+    else if (!czh.tmch_flags)
+        return czh.tmch_size == bulk_size ? 0 : -EBADMSG;
+
+    if (!czh.tmch_size || czh.tmch_size >= bulk_size)
+    {
+        DBG_TCP_MGR_CXN(LL_NOTIFY, tmc, "invalid compressed size %u (%zu)",
+                        czh.tmch_size, bulk_size);
+        return -EBADMSG;
+    }
+
+    *zsize = czh.tmch_size;
+
+    return 0;
+}
+
+/**
+ * tcp_mgr_compress_recv_prepare - called once the bulk's destination has
+ *   been prepared.  The compressed bulk is received into a staging buffer.
+ */
+static int
+tcp_mgr_compress_recv_prepare(struct tcp_mgr_connection *tmc, size_t zsize,
+                              size_t bulk_size)
+{
+    NIOVA_ASSERT(!tmc->tmc_zbuf && !tmc->tmc_bulk_niovs &&
+                 tmc->tmc_bulk_remain == bulk_size);
+
+    tmc->tmc_zbuf = niova_malloc_can_fail(zsize);
+    if (!tmc->tmc_zbuf)
+        return -ENOMEM;
+
+    tmc->tmc_zbuf_size = zsize;
+    tmc->tmc_zbuf_bulk_size = bulk_size;
+    tmc->tmc_bulk_remain = zsize;
+
+    return 0;
+}
+
+static void
+tcp_mgr_compress_recv_release(struct tcp_mgr_connection *tmc)
+{
+    niova_free(tmc->tmc_zbuf);
+    tmc->tmc_zbuf = NULL;
+    tmc->tmc_zbuf_size = 0;
+    tmc->tmc_zbuf_bulk_size = 0;
+}
+
+/**
+ * tcp_mgr_compress_recv_complete - decompresses the staged bulk into the
+ *   bulk buffer, behind the header.
+ */
+static int
+tcp_mgr_compress_recv_complete(struct tcp_mgr_connection *tmc)
+{
+    const unsigned long long start = tcp_mgr_now_usec();
+
+    int rc = LZ4_decompress_safe(tmc->tmc_zbuf,
+                                 tmc->tmc_bulk_buf + tmc->tmc_bulk_offset,
+                                 tmc->tmc_zbuf_size, tmc->tmc_zbuf_bulk_size);
+
+    tmc->tmc_stats.tmcs_decompress_usec += tcp_mgr_now_usec() - start;
+
+    if (rc < 0 || (size_t)rc != tmc->tmc_zbuf_bulk_size)
+    {
+        DBG_TCP_MGR_CXN(LL_NOTIFY, tmc, "LZ4_decompress_safe(): %d (%zu)",
+                        rc, tmc->tmc_zbuf_bulk_size);
+        return -EBADMSG;
+    }
+
+    tmc->tmc_bulk_offset += tmc->tmc_zbuf_bulk_size;
+
+    tcp_mgr_compress_recv_release(tmc);
+
+    return 0;
+}
+
+static void *
+tcp_mgr_bulk_malloc(struct tcp_mgr_instance *tmi, size_t sz)
+{
+    return tcp_mgr_credits_malloc(&tmi->tmi_bulk_credits, sz);
+}
+
+static void
+tcp_mgr_bulk_free(struct tcp_mgr_instance *tmi, void *buf)
+{
+    tcp_mgr_credits_free(&tmi->tmi_bulk_credits, buf);
+}
+
+void
+tcp_mgr_bulk_iov_cb_set(struct tcp_mgr_instance *tmi,
+                        tcp_mgr_bulk_iov_cb_t bulk_iov_cb)
+{
+    tmi->tmi_bulk_iov_cb = bulk_iov_cb;
+}
+
+/**
+ * tcp_mgr_bulk_pools_setup - creates a pool of 'nbufs' buffers for each bulk
+ *   size class.  The buffers are faulted in here so that receiving into them
+ *   does not incur page faults.  Should be called prior to connecting.
+ */
+int
+tcp_mgr_bulk_pools_setup(struct tcp_mgr_instance *tmi, size_t nbufs)
+{
+    if (!tmi || !nbufs)
+        return -EINVAL;
+
+    else if (tmi->tmi_bulk_pools_enabled)
+        return -EALREADY;
+
+    for (int i = 0; i < TCP_MGR_BULK_POOL_NCLASSES; i++)
+    {
+        struct buffer_set *bs = &tmi->tmi_bulk_pools[i];
+        const size_t buf_size = TCP_MGR_BULK_POOL_MIN_SIZE << (2 * i);
+
+        int rc = buffer_set_init(bs, nbufs, buf_size,
+                                 BUFSET_OPT_SERIALIZE | BUFSET_OPT_MEMALIGN_L2);
+        if (rc)
+        {
+            SIMPLE_LOG_MSG(LL_WARN, "buffer_set_init(%zu, %zu): %s",
+                           nbufs, buf_size, strerror(-rc));
+            while (i--)
+                buffer_set_destroy(&tmi->tmi_bulk_pools[i]);
+
+            return rc;
+        }
+
+        char name[BUFFER_SET_NAME_MAX + 1];
+        snprintf(name, sizeof(name), "tcp-mgr-bulk-%zuK", buf_size / 1024);
+        buffer_set_apply_name(bs, name);
+    }
+
+    tmi->tmi_bulk_pools_enabled = 1;
+
+    return 0;
+}
+
+/**
+ * tcp_mgr_bulk_pools_destroy - returns -EBUSY while any pooled buffer is held
+ *   by a connection or by a user which has taken it.
+ */
+int
+tcp_mgr_bulk_pools_destroy(struct tcp_mgr_instance *tmi)
+{
+    if (!tmi)
+        return -EINVAL;
+
+    else if (!tmi->tmi_bulk_pools_enabled)
+        return -EALREADY;
+
+    for (int i = 0; i < TCP_MGR_BULK_POOL_NCLASSES; i++)
+    {
+        const struct buffer_set *bs = &tmi->tmi_bulk_pools[i];
+
+        if (buffer_set_navail(bs) != bs->bs_num_bufs)
+            return -EBUSY;
+    }
+
+    tmi->tmi_bulk_pools_enabled = 0;
+
+    for (int i = 0; i < TCP_MGR_BULK_POOL_NCLASSES; i++)
+    {
+        int rc = buffer_set_destroy(&tmi->tmi_bulk_pools[i]);
+        NIOVA_ASSERT(!rc);
+    }
+
+    return 0;
+}
+
+static bool
+tcp_mgr_bulk_pool_fits(const struct tcp_mgr_instance *tmi, size_t sz)
+{
+    return (tmi->tmi_bulk_pools_enabled &&
+            sz <= tmi->tmi_bulk_pools[TCP_MGR_BULK_POOL_NCLASSES - 1].
+            bs_item_size) ? true : false;
+}
+
+static struct buffer_item *
+tcp_mgr_bulk_pool_alloc(struct tcp_mgr_instance *tmi, size_t sz)
+{
+    for (int i = 0; i < TCP_MGR_BULK_POOL_NCLASSES; i++)
+    {
+        struct buffer_set *bs = &tmi->tmi_bulk_pools[i];
+        if (bs->bs_item_size < sz)
+            continue;
+
+        struct buffer_item *bi = buffer_set_allocate_item(bs);
+        if (bi)
+        {
+            bi->bi_iov.iov_len = sz;
+            return bi;
+        }
+    }
+
+    return NULL;
+}
+
+static void
+tcp_mgr_connection_bulk_release(struct tcp_mgr_connection *tmc)
+{
+    // Scattered bulk is received into the user's memory
+    if (tmc->tmc_bulk_niovs)
+        tmc->tmc_bulk_niovs = 0;
+
+    else if (tmc->tmc_bulk_bi)
+        buffer_set_release_item(tmc->tmc_bulk_bi);
+
+    else if (tmc->tmc_bulk_buf)
+        tcp_mgr_bulk_free(tmc->tmc_tmi, tmc->tmc_bulk_buf);
+
+    tmc->tmc_bulk_bi = NULL;
+    tmc->tmc_bulk_buf = NULL;
+    tmc->tmc_bulk_offset = 0;
+
+    if (tmc->tmc_zbuf)
+        tcp_mgr_compress_recv_release(tmc);
+}
+
+// The pipelined request being processed by this worker thread
+static __thread struct tcp_mgr_pipeline_msg *tcpMgrPipelineMsg;
+
+static struct tcp_mgr_pipeline_msg *
+tcp_mgr_pipeline_msg_current(const struct tcp_mgr_connection *tmc)
+{
+    return (tcpMgrPipelineMsg && tcpMgrPipelineMsg->tmpm_tmc == tmc) ?
+        tcpMgrPipelineMsg : NULL;
+}
+
+/**
+ * tcp_mgr_connection_bulk_item_take - may be called from tmi_recv_cb to take
+ *   ownership of the pooled buffer holding the message, which is described
+ *   by the item's bi_iov.  The caller must release the item with
+ *   buffer_set_release_item().  Returns NULL if the message was not received
+ *   into a pooled buffer.
+ */
+struct buffer_item *
+tcp_mgr_connection_bulk_item_take(struct tcp_mgr_connection *tmc)
+{
+    struct tcp_mgr_pipeline_msg *tmpm = tcp_mgr_pipeline_msg_current(tmc);
+    if (tmpm)
+    {
+        struct buffer_item *bi = tmpm->tmpm_bulk_bi;
+
+        tmpm->tmpm_bulk_bi = NULL;
+        tmpm->tmpm_bulk_buf = NULL;
+
+        return bi;
+    }
+
+    if (!tmc || !tmc->tmc_bulk_bi || tmc->tmc_bulk_remain)
+        return NULL;
+
+    struct buffer_item *bi = tmc->tmc_bulk_bi;
+
+    tmc->tmc_bulk_bi = NULL;
+    tmc->tmc_bulk_buf = NULL;
+
+    return bi;
+}
+
+static void
+tcp_mgr_connection_get(struct tcp_mgr_connection *tmc)
+{
+    if (tmc->tmc_tmi && tmc->tmc_tmi->tmi_connection_ref_cb)
+        tmc->tmc_tmi->tmi_connection_ref_cb(tmc, EPH_REF_GET);
+}
+
+static void
+tcp_mgr_connection_put(struct tcp_mgr_connection *tmc)
+{
+    if (tmc->tmc_tmi && tmc->tmc_tmi->tmi_connection_ref_cb)
+        tmc->tmc_tmi->tmi_connection_ref_cb(tmc, EPH_REF_PUT);
+}
+
+static void
+tcp_mgr_conn_recv_inline(struct tcp_mgr_connection *tmc);
+
+static void
+tcp_mgr_connection_close_internal(struct tcp_mgr_connection *tmc);
+
+/**
+ * tcp_mgr_connection_epm - returns the epoll_mgr which hosts the connection.
+ *   When the instance is driven by an epoll_mgr_pool, a reactor is assigned
+ *   to the connection on first use.
+ */
+static struct epoll_mgr *
+tcp_mgr_connection_epm(struct tcp_mgr_connection *tmc)
+{
+    struct tcp_mgr_instance *tmi = tmc->tmc_tmi;
+
+    if (tmc->tmc_epm || !tmi->tmi_epoll_pool)
+        return tmc->tmc_epm ? tmc->tmc_epm : tmi->tmi_epoll_mgr;
+
+    struct epoll_mgr *epm =
+        epoll_mgr_pool_select(tmi->tmi_epoll_pool, (uintptr_t)tmc);
+
+    niova_atomic_cas(&tmc->tmc_epm, NULL, epm);
+
+    return tmc->tmc_epm;
+}
+
+/**
+ * tcp_mgr_connection_events - EPOLLOUT is requested while the connection's
+ *   send queue is non-empty.
+ */
+static int
+tcp_mgr_connection_events(const struct tcp_mgr_connection *tmc)
+{
+    return (tmc->tmc_eph.eph_events & ~EPOLLOUT) |
+        (niova_atomic_read(&tmc->tmc_sendq_pending) ? EPOLLOUT : 0);
+}
+
+/**
+ * tcp_mgr_connection_events_apply - updates the connection's epoll handle
+ *   after its send queue has become empty or non-empty.  One-shot handles
+ *   which have been handed off to a worker are left disarmed, the update is
+ *   applied when the worker re-enables the connection.
+ */
+static void
+tcp_mgr_connection_events_apply(struct tcp_mgr_connection *tmc)
+{
+    struct tcp_mgr_connq *tmcq = &tmc->tmc_tmi->tmi_connq;
+
+    niova_mutex_lock(&tmcq->tmcq_mutex);
+
+    if (tmc->tmc_status == TMCS_CONNECTED && tmc->tmc_eph.eph_installed &&
+        !(tmc->tmc_handoff && (tmc->tmc_eph.eph_events & EPOLLONESHOT)))
+    {
+        tmc->tmc_eph.eph_events = tcp_mgr_connection_events(tmc);
+
+        int rc = epoll_handle_mod(tcp_mgr_connection_epm(tmc), &tmc->tmc_eph);
+        if (rc)
+            DBG_TCP_MGR_CXN(LL_NOTIFY, tmc, "epoll_handle_mod(): %s",
+                            strerror(-rc));
+    }
+
+    niova_mutex_unlock(&tmcq->tmcq_mutex);
+}
+
+static void
+tcp_mgr_cork_timer_cancel(struct tcp_mgr_connection *tmc);
+
+/**
+ * tcp_mgr_send_bufs_complete - issues the done callbacks of the buffers on
+ *   'done' and frees them.  Must be called without tmc_send_mutex held.
+ */
+static void
+tcp_mgr_send_bufs_complete(struct tcp_mgr_connection *tmc,
+                           struct tcp_mgr_send_queue *done, int status)
+{
+    struct tcp_mgr_send_buf *tmsb;
+
+    while ((tmsb = STAILQ_FIRST(done)))
+    {
+        STAILQ_REMOVE_HEAD(done, tmsb_lentry);
+
+        if (tmsb->tmsb_done_cb)
+            tmsb->tmsb_done_cb(tmc, tmsb->tmsb_done_arg, status);
+
+        niova_free(tmsb);
+    }
+}
+
+/**
+ * tcp_mgr_sendq_purge - releases all queued and in-flight buffers.  Zero-copy
+ *   sends which are outstanding when the connection closes are completed
+ *   with -ENOTCONN since their delivery is unknown.
+ */
+static void
+tcp_mgr_sendq_purge(struct tcp_mgr_connection *tmc)
+{
+    struct tcp_mgr_send_queue done = STAILQ_HEAD_INITIALIZER(done);
+
+    niova_mutex_lock(&tmc->tmc_send_mutex);
+
+    tcp_mgr_cork_timer_cancel(tmc);
+
+    STAILQ_CONCAT(&done, &tmc->tmc_zc_inflight);
+    STAILQ_CONCAT(&done, &tmc->tmc_sendq);
+
+    /* Detach the connection's outstanding requests.  Replies held for them
+     * are discarded and those still being processed may no longer reply.
+     */
+    struct tcp_mgr_pipeline_msg *tmpm;
+    while ((tmpm = STAILQ_FIRST(&tmc->tmc_pipeline_msgs)))
+    {
+        STAILQ_REMOVE_HEAD(&tmc->tmc_pipeline_msgs, tmpm_conn_lentry);
+        STAILQ_CONCAT(&done, &tmpm->tmpm_replies);
+
+        if (!tmpm->tmpm_done)
+            tmpm->tmpm_orphaned = 1;
+        else
+            niova_free(tmpm);
+    }
+
+    tmc->tmc_sendq_bytes = 0;
+    tmc->tmc_zerocopy = 0;
+    niova_atomic_init(&tmc->tmc_sendq_pending, 0);
+
+    niova_mutex_unlock(&tmc->tmc_send_mutex);
+
+    tcp_mgr_send_bufs_complete(tmc, &done, -ENOTCONN);
+}
+
+static void
+tcp_mgr_sendq_insert_locked(struct tcp_mgr_connection *tmc,
+                            struct tcp_mgr_send_buf *tmsb)
+{
+    STAILQ_INSERT_TAIL(&tmc->tmc_sendq, tmsb, tmsb_lentry);
+    tmc->tmc_sendq_bytes += tmsb->tmsb_len;
+
+    tmc->tmc_stats.tmcs_sendq_max_bytes =
+        MAX(tmc->tmc_stats.tmcs_sendq_max_bytes, tmc->tmc_sendq_bytes);
+}
+
+/**
+ * tcp_mgr_send_buf_copy - allocates a send buffer holding a copy of the
+ *   iovs' contents beyond 'already_sent'.
+ */
+static int
+tcp_mgr_send_buf_copy(const struct iovec *iov, size_t niovs,
+                      size_t already_sent, size_t total_size,
+                      struct tcp_mgr_send_buf **ret_tmsb)
+{
+    NIOVA_ASSERT(already_sent < total_size);
+
+    const size_t len = total_size - already_sent;
+
+    struct tcp_mgr_send_buf *tmsb =
+        niova_calloc_can_fail(1UL, sizeof(struct tcp_mgr_send_buf) + len);
+    if (!tmsb)
+        return -ENOMEM;
+
+    struct iovec unsent[niovs];
+    ssize_t nunsent =
+        niova_io_iovs_map_consumed(iov, unsent, niovs, already_sent, -1UL);
+    if (nunsent <= 0)
+    {
+        niova_free(tmsb);
+        return nunsent ? nunsent : -EINVAL;
+    }
+
+    niova_io_copy_from_iovs(tmsb->tmsb_data, len, unsent, nunsent);
+
+    tmsb->tmsb_len = len;
+    tmsb->tmsb_iov.iov_base = tmsb->tmsb_data;
+    tmsb->tmsb_iov.iov_len = len;
+    tmsb->tmsb_iovs = &tmsb->tmsb_iov;
+    tmsb->tmsb_niovs = 1;
+
+    *ret_tmsb = tmsb;
+
+    return 0;
+}
+
+/**
+ * tcp_mgr_sendq_append_locked - copies the unsent portion of the iovs onto
+ *   the tail of the send queue.  'charged' is set if the message has already
+ *   taken one of the peer's flow control credits.
+ */
+static int
+tcp_mgr_sendq_append_locked(struct tcp_mgr_connection *tmc,
+                            const struct iovec *iov, size_t niovs,
+                            size_t already_sent, size_t total_size,
+                            bool charged)
+{
+    struct tcp_mgr_send_buf *tmsb = NULL;
+
+    int rc = tcp_mgr_send_buf_copy(iov, niovs, already_sent, total_size,
+                                   &tmsb);
+    if (!rc)
+    {
+        tmsb->tmsb_fc_charged = charged ? 1 : 0;
+        tmsb->tmsb_start_usec = tcp_mgr_stats_start_usec(tmc);
+        tcp_mgr_sendq_insert_locked(tmc, tmsb);
+    }
+
+    return rc;
+}
+
+/**
+ * tcp_mgr_sendq_append_zerocopy_locked - queues a reference to the sender's
+ *   iovs.  Only the iov array is copied, the memory it describes must not be
+ *   modified until the done callback has been issued.
+ */
+static int
+tcp_mgr_sendq_append_zerocopy_locked(struct tcp_mgr_connection *tmc,
+                                     const struct iovec *iov, size_t niovs,
+                                     size_t total_size,
+                                     tcp_mgr_send_done_cb_t done_cb,
+                                     void *done_arg)
+{
+    struct tcp_mgr_send_buf *tmsb =
+        niova_calloc_can_fail(1UL, sizeof(struct tcp_mgr_send_buf) +
+                              niovs * sizeof(struct iovec));
+    if (!tmsb)
+        return -ENOMEM;
+
+    tmsb->tmsb_iovs = (struct iovec *)tmsb->tmsb_data;
+    memcpy(tmsb->tmsb_iovs, iov, niovs * sizeof(struct iovec));
+
+    tmsb->tmsb_niovs = niovs;
+    tmsb->tmsb_len = total_size;
+    tmsb->tmsb_zerocopy = 1;
+    tmsb->tmsb_done_cb = done_cb;
+    tmsb->tmsb_done_arg = done_arg;
+    tmsb->tmsb_start_usec = tcp_mgr_stats_start_usec(tmc);
+
+    tcp_mgr_sendq_insert_locked(tmc, tmsb);
+
+    return 0;
+}
+
+/**
+ * tcp_mgr_fc_charge_locked - takes one of the peer's credits.  Returns false
+ *   if none remain, in which case the message must wait for a grant.
+ */
+static bool
+tcp_mgr_fc_charge_locked(struct tcp_mgr_connection *tmc)
+{
+    if (!tmc->tmc_fc_window)
+        return true;
+
+    else if (!tmc->tmc_fc_credits)
+        return false;
+
+    tmc->tmc_fc_credits--;
+
+    return true;
+}
+
+/**
+ * tcp_mgr_sendq_gather_locked - maps the unsent contents of the queue into
+ *   'iovs'.  Zero-copy and copied buffers are not mixed within a single
+ *   sendmsg() since copied buffers are released as soon as they are sent.
+ *   Gathering stops at the first message for which no credit is available.
+ */
+static size_t
+tcp_mgr_sendq_gather_locked(struct tcp_mgr_connection *tmc,
+                            struct iovec *iovs, size_t max_iovs,
+                            bool *zerocopy)
+{
+    struct tcp_mgr_send_buf *tmsb = STAILQ_FIRST(&tmc->tmc_sendq);
+    size_t niovs = 0;
+
+    *zerocopy = tmsb->tmsb_zerocopy ? true : false;
+
+    STAILQ_FOREACH(tmsb, &tmc->tmc_sendq, tmsb_lentry)
+    {
+        if (tmsb->tmsb_zerocopy != *zerocopy ||
+            tmsb->tmsb_niovs > max_iovs - niovs)
+            break;
+
+        if (!tmsb->tmsb_fc_charged)
+        {
+            if (!tcp_mgr_fc_charge_locked(tmc))
+                break;
+
+            tmsb->tmsb_fc_charged = 1;
+        }
+
+        ssize_t n = niova_io_iovs_map_consumed(tmsb->tmsb_iovs, &iovs[niovs],
+                                               tmsb->tmsb_niovs,
+                                               tmsb->tmsb_off, -1UL);
+        NIOVA_ASSERT(n > 0);
+
+        niovs += n;
+    }
+
+    return niovs;
+}
+
+/**
+ * tcp_mgr_sendq_flush_locked - writes queued buffers to the socket until the
+ *   queue is empty or the socket would block.  Buffers whose done callback
+ *   may be issued immediately, since their data was copied, are moved onto
+ *   'done'.  Returns 0 or a negative errno if the connection has failed.
+ */
+static int
+tcp_mgr_sendq_flush_locked(struct tcp_mgr_connection *tmc,
+                           struct tcp_mgr_send_queue *done)
+{
+    while (!STAILQ_EMPTY(&tmc->tmc_sendq))
+    {
+        struct iovec iovs[TCP_MGR_SENDQ_FLUSH_IOVS];
+        bool zerocopy;
+
+        size_t niovs = tcp_mgr_sendq_gather_locked(tmc, iovs,
+                                                   TCP_MGR_SENDQ_FLUSH_IOVS,
+                                                   &zerocopy);
+        if (!niovs)
+            return 0;
+
+        ssize_t rc = tcp_socket_send_nb(&tmc->tmc_tsh, iovs, niovs, zerocopy);
+        tmc->tmc_send_syscalls++;
+
+        // The kernel may refuse to pin more pages, fall back to copying
+        if (rc == -ENOBUFS && zerocopy)
+        {
+            zerocopy = false;
+            rc = tcp_socket_send_nb(&tmc->tmc_tsh, iovs, niovs, false);
+            tmc->tmc_send_syscalls++;
+        }
+
+        if (rc == -EAGAIN)
+        {
+            tmc->tmc_stats.tmcs_sock_eagain++;
+            return 0;
+        }
+        else if (rc < 0)
+        {
+            return rc;
+        }
+
+        // Each successful zero-copy send is assigned the next id
+        const uint32_t zc_id = zerocopy ? tmc->tmc_zc_next_id++ : 0;
+        if (zerocopy)
+            tmc->tmc_zc_sends++;
+
+        size_t sent = rc;
+        tmc->tmc_sendq_bytes -= sent;
+        tmc->tmc_stats.tmcs_bytes_out += sent;
+
+        while (sent)
+        {
+            struct tcp_mgr_send_buf *tmsb = STAILQ_FIRST(&tmc->tmc_sendq);
+            NIOVA_ASSERT(tmsb);
+
+            size_t n = MIN(sent, tmsb->tmsb_len - tmsb->tmsb_off);
+            tmsb->tmsb_off += n;
+            sent -= n;
+
+            if (zerocopy)
+            {
+                tmsb->tmsb_zc_last_id = zc_id;
+                tmsb->tmsb_zc_has_id = 1;
+            }
+
+            if (tmsb->tmsb_off < tmsb->tmsb_len)
+                continue;
+
+            STAILQ_REMOVE_HEAD(&tmc->tmc_sendq, tmsb_lentry);
+
+            tcp_mgr_stats_usec_record(tmc->tmc_stats.tmcs_send_usec_hist,
+                                      tmsb->tmsb_start_usec);
+
+            /* Zero-copy buffers remain referenced by the kernel until their
+             * completion has been read from the error queue.
+             */
+            if (tmsb->tmsb_zc_has_id)
+                STAILQ_INSERT_TAIL(&tmc->tmc_zc_inflight, tmsb, tmsb_lentry);
+            else if (tmsb->tmsb_done_cb)
+                STAILQ_INSERT_TAIL(done, tmsb, tmsb_lentry);
+            else
+                niova_free(tmsb);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * tcp_mgr_sendq_pending_update_locked - EPOLLOUT is needed while data remains
+ *   queued after a flush, unless it is waiting on the peer's credits.
+ *   Returns true if the state has changed.
+ */
+static bool
+tcp_mgr_sendq_pending_update_locked(struct tcp_mgr_connection *tmc)
+{
+    const struct tcp_mgr_send_buf *tmsb = STAILQ_FIRST(&tmc->tmc_sendq);
+    const uint8_t pending =
+        (tmsb && (tmsb->tmsb_fc_charged || !tmc->tmc_fc_window ||
+                  tmc->tmc_fc_credits)) ? 1 : 0;
+    if (pending == tmc->tmc_sendq_pending)
+        return false;
+
+    niova_atomic_init(&tmc->tmc_sendq_pending, pending);
+
+    return true;
+}
+
+/**
+ * tcp_mgr_sendq_flush - called from the epm thread when the socket has become
+ *   writable or the cork timer has expired.  The epoll events are updated if
+ *   'apply_events' is set or the EPOLLOUT state has changed.
+ */
+static int
+tcp_mgr_sendq_flush(struct tcp_mgr_connection *tmc, bool apply_events)
+{
+    struct tcp_mgr_send_queue done = STAILQ_HEAD_INITIALIZER(done);
+
+    niova_mutex_lock(&tmc->tmc_send_mutex);
+
+    int rc = tcp_mgr_sendq_flush_locked(tmc, &done);
+    bool changed = tcp_mgr_sendq_pending_update_locked(tmc);
+
+    niova_mutex_unlock(&tmc->tmc_send_mutex);
+
+    tcp_mgr_send_bufs_complete(tmc, &done, 0);
+
+    if (!rc && (apply_events || changed))
+        tcp_mgr_connection_events_apply(tmc);
+
+    return rc;
+}
+
+/**
+ * tcp_mgr_fc_frame_locked - places a flow control header ahead of the
+ *   message's iovs in 'fc_iovs'.  The credits owed to the peer are returned
+ *   in the header only if the message is 'charged' and will not be held
+ *   behind the sender's own lack of credits.  Returns the number of iovs.
+ */
+static size_t
+tcp_mgr_fc_frame_locked(struct tcp_mgr_connection *tmc,
+                        struct tcp_mgr_fc_hdr *fch, bool charged,
+                        const struct iovec *iov, size_t niovs,
+                        struct iovec *fc_iovs)
+{
+    fch->tmfh_grant = charged ? tmc->tmc_fc_owed : 0;
+    fch->tmfh_flags = 0;
+
+    if (charged)
+        tmc->tmc_fc_owed = 0;
+
+    fc_iovs[0].iov_base = fch;
+    fc_iovs[0].iov_len = sizeof(struct tcp_mgr_fc_hdr);
+
+    memcpy(&fc_iovs[1], iov, niovs * sizeof(struct iovec));
+
+    return niovs + 1;
+}
+
+/**
+ * tcp_mgr_fc_grant_queue_locked - queues a header which carries only the
+ *   credits owed to the peer.  It needs no credit of its own and is placed
+ *   ahead of the messages waiting for credits, otherwise two peers which have
+ *   exhausted one another's credits would wait forever.
+ */
+static int
+tcp_mgr_fc_grant_queue_locked(struct tcp_mgr_connection *tmc)
+{
+    struct tcp_mgr_fc_hdr fch = {
+        .tmfh_grant = tmc->tmc_fc_owed,
+        .tmfh_flags = TCP_MGR_FC_FLAG_GRANT_ONLY,
+    };
+    struct iovec iov = {
+        .iov_base = &fch,
+        .iov_len = sizeof(fch),
+    };
+    struct tcp_mgr_send_buf *tmsb = NULL;
+
+    int rc = tcp_mgr_send_buf_copy(&iov, 1, 0, sizeof(fch), &tmsb);
+    if (rc)
+        return rc;
+
+    tmc->tmc_fc_owed = 0;
+    tmsb->tmsb_fc_charged = 1;
+
+    // Charged buffers always precede those which are waiting
+    struct tcp_mgr_send_buf *prev = NULL;
+    struct tcp_mgr_send_buf *tmp;
+
+    STAILQ_FOREACH(tmp, &tmc->tmc_sendq, tmsb_lentry)
+    {
+        if (!tmp->tmsb_fc_charged)
+            break;
+
+        prev = tmp;
+    }
+
+    if (prev)
+        STAILQ_INSERT_AFTER(&tmc->tmc_sendq, prev, tmsb, tmsb_lentry);
+    else
+        STAILQ_INSERT_HEAD(&tmc->tmc_sendq, tmsb, tmsb_lentry);
+
+    tmc->tmc_sendq_bytes += tmsb->tmsb_len;
+
+    return 0;
+}
+
+/**
+ * tcp_mgr_fc_credit_return - called once a received message has been
+ *   processed.  The credit is returned with the next outgoing message unless
+ *   a quarter of the window is owed, at which point a grant is sent.
+ */
+static void
+tcp_mgr_fc_credit_return(struct tcp_mgr_connection *tmc)
+{
+    struct tcp_mgr_send_queue done = STAILQ_HEAD_INITIALIZER(done);
+    bool apply_events = false;
+    int rc = 0;
+
+    niova_mutex_lock(&tmc->tmc_send_mutex);
+
+    if (tmc->tmc_fc_window &&
+        ++tmc->tmc_fc_owed >= MAX(1, tmc->tmc_fc_window / 4) &&
+        tmc->tmc_status == TMCS_CONNECTED)
+    {
+        // A failed allocation leaves the credits owed until the next try
+        rc = tcp_mgr_fc_grant_queue_locked(tmc);
+        if (rc)
+        {
+            DBG_TCP_MGR_CXN(LL_NOTIFY, tmc,
+                            "tcp_mgr_fc_grant_queue_locked(): %s",
+                            strerror(-rc));
+            rc = 0;
+        }
+        else if (!tmc->tmc_sendq_pending)
+        {
+            rc = tcp_mgr_sendq_flush_locked(tmc, &done);
+            apply_events = tcp_mgr_sendq_pending_update_locked(tmc);
+        }
+    }
+
+    niova_mutex_unlock(&tmc->tmc_send_mutex);
+
+    tcp_mgr_send_bufs_complete(tmc, &done, 0);
+
+    if (rc)
+        tcp_mgr_connection_close(tmc);
+    else if (apply_events)
+        tcp_mgr_connection_events_apply(tmc);
+}
+
+static bool
+tcp_mgr_fc_hdr_grant_only(const char *buf)
+{
+    struct tcp_mgr_fc_hdr fch;
+
+    // The header may not be aligned within the receive buffer
+    memcpy(&fch, buf, sizeof(fch));
+
+    return (fch.tmfh_flags & TCP_MGR_FC_FLAG_GRANT_ONLY) ? true : false;
+}
+
+/**
+ * tcp_mgr_fc_hdr_recv - applies the credits granted by the peer and sends
+ *   the messages they release.  Returns 1 if no message follows the header,
+ *   0 if one does, or a negative errno if the connection has failed.
+ */
+static int
+tcp_mgr_fc_hdr_recv(struct tcp_mgr_connection *tmc, const char *buf)
+{
+    struct tcp_mgr_send_queue done = STAILQ_HEAD_INITIALIZER(done);
+    struct tcp_mgr_fc_hdr fch;
+    bool apply_events = false;
+    int rc = 0;
+
+    memcpy(&fch, buf, sizeof(fch));
+
+    const int grant_only =
+        (fch.tmfh_flags & TCP_MGR_FC_FLAG_GRANT_ONLY) ? 1 : 0;
+
+    if (!fch.tmfh_grant)
+        return grant_only;
+
+    niova_mutex_lock(&tmc->tmc_send_mutex);
+
+    tmc->tmc_fc_credits = MIN((uint64_t)tmc->tmc_fc_credits + fch.tmfh_grant,
+                              tmc->tmc_fc_window);
+
+    if (!tmc->tmc_sendq_pending && tmc->tmc_status == TMCS_CONNECTED)
+    {
+        rc = tcp_mgr_sendq_flush_locked(tmc, &done);
+        apply_events = tcp_mgr_sendq_pending_update_locked(tmc);
+    }
+
+    niova_mutex_unlock(&tmc->tmc_send_mutex);
+
+    tcp_mgr_send_bufs_complete(tmc, &done, 0);
+
+    if (rc)
+        return rc;
+
+    if (apply_events)
+        tcp_mgr_connection_events_apply(tmc);
+
+    return grant_only;
+}
+
+/**
+ * tcp_mgr_zerocopy_reap - reads zero-copy completions from the socket's error
+ *   queue and issues the done callbacks of the buffers they cover.  TCP
+ *   completes zero-copy sends in order so only the head of the in-flight
+ *   list needs to be checked.
+ */
+static void
+tcp_mgr_zerocopy_reap(struct tcp_mgr_connection *tmc)
+{
+    struct tcp_mgr_send_queue done = STAILQ_HEAD_INITIALIZER(done);
+    uint32_t lo, hi;
+    bool copied;
+    int rc;
+
+    niova_mutex_lock(&tmc->tmc_send_mutex);
+
+    while ((rc = tcp_socket_zerocopy_reap(&tmc->tmc_tsh, &lo, &hi,
+                                          &copied)) != -EAGAIN)
+    {
+        if (rc)
+        {
+            if (rc == -ENOMSG)
+                continue;
+
+            DBG_TCP_MGR_CXN(LL_NOTIFY, tmc, "tcp_socket_zerocopy_reap(): %s",
+                            strerror(-rc));
+            break;
+        }
+
+        if (copied)
+            tmc->tmc_zc_copied += hi - lo + 1;
+
+        struct tcp_mgr_send_buf *tmsb;
+        while ((tmsb = STAILQ_FIRST(&tmc->tmc_zc_inflight)) &&
+               (!tmsb->tmsb_zc_has_id ||
+                (int32_t)(tmsb->tmsb_zc_last_id - hi) <= 0))
+        {
+            STAILQ_REMOVE_HEAD(&tmc->tmc_zc_inflight, tmsb_lentry);
+            STAILQ_INSERT_TAIL(&done, tmsb, tmsb_lentry);
+        }
+    }
+
+    niova_mutex_unlock(&tmc->tmc_send_mutex);
+
+    tcp_mgr_send_bufs_complete(tmc, &done, 0);
+}
+
+static void
+tcp_mgr_cork_timer_cb(struct epoll_mgr_timer *emt, void *arg)
+{
+    (void)emt;
+
+    struct tcp_mgr_connection *tmc = arg;
+
+    if (tmc->tmc_status == TMCS_CONNECTED)
+    {
+        int rc = tcp_mgr_sendq_flush(tmc, false);
+        if (rc)
+        {
+            DBG_TCP_MGR_CXN(LL_NOTIFY, tmc, "tcp_mgr_sendq_flush(): %s",
+                            strerror(-rc));
+            tcp_mgr_connection_close_internal(tmc);
+        }
+    }
+
+    // Release the reference taken when the timer was armed
+    tcp_mgr_connection_put(tmc);
+}
+
+/**
+ * tcp_mgr_cork_timer_arm_locked - the timer holds a connection reference
+ *   until it expires or is canceled.  The timer is not re-armed if it is
+ *   pending so the window is measured from the first corked message.
+ */
+static int
+tcp_mgr_cork_timer_arm_locked(struct tcp_mgr_connection *tmc)
+{
+    if (epoll_mgr_timer_is_armed(&tmc->tmc_cork_timer))
+        return 0;
+
+    tcp_mgr_connection_get(tmc);
+
+    int rc = epoll_mgr_timer_arm(tcp_mgr_connection_epm(tmc),
+                                 &tmc->tmc_cork_timer,
+                                 tmc->tmc_tmi->tmi_cork_usec);
+    if (rc)
+        tcp_mgr_connection_put(tmc);
+
+    return rc;
+}
+
+static void
+tcp_mgr_cork_timer_cancel(struct tcp_mgr_connection *tmc)
+{
+    if (epoll_mgr_timer_is_armed(&tmc->tmc_cork_timer) &&
+        !epoll_mgr_timer_cancel(tcp_mgr_connection_epm(tmc),
+                                &tmc->tmc_cork_timer))
+        tcp_mgr_connection_put(tmc);
+}
+
+static void
+tcp_mgr_conn_reenable(struct tcp_mgr_connection *tmc)
+{
+    if (!tmc->tmc_handoff)
+        return;
+
+    struct tcp_mgr_instance *tmi = tmc->tmc_tmi;
+    struct tcp_mgr_connq *tmcq = &tmi->tmi_connq;
+
+    niova_mutex_lock(&tmcq->tmcq_mutex);
+
+    if (!tmc->tmc_handoff)
+    {
+        niova_mutex_unlock(&tmcq->tmcq_mutex);
+        return;
+    }
+
+    // Leave the connection disarmed until its outstanding requests drain
+    if (tmi->tmi_pipeline_depth > 1 &&
+        tmc->tmc_pipeline_inflight >= tmi->tmi_pipeline_depth)
+    {
+        tmc->tmc_pipeline_throttled = 1;
+        niova_mutex_unlock(&tmcq->tmcq_mutex);
+        return;
+    }
+
+    tmc->tmc_handoff = 0; // mark the tmc as not residing on the queue
+
+    // Pick up EPOLLOUT changes which were deferred during the handoff
+    tmc->tmc_eph.eph_events = tcp_mgr_connection_events(tmc);
+
+    int rc = epoll_handle_mod(tcp_mgr_connection_epm(tmc), &tmc->tmc_eph);
+    if (rc != 0)
+        LOG_MSG(LL_DEBUG, "epoll_handle_mod(): %s", strerror(-rc));
+
+    niova_mutex_unlock(&tmcq->tmcq_mutex);
+}
+
+/**
+ * tcp_mgr_pipeline_depth_set - sets the number of requests from a single
+ *   connection which may be processed concurrently.  Only applies to
+ *   instances in handoff mode, a depth of 0 or 1 disables pipelining.
+ */
+int
+tcp_mgr_pipeline_depth_set(struct tcp_mgr_instance *tmi, unsigned int depth)
+{
+    if (!tmi || !tmi->tmi_conn_recv_handoff ||
+        depth > TCP_MGR_PIPELINE_MAX_DEPTH)
+        return -EINVAL;
+
+    tmi->tmi_pipeline_depth = depth;
+
+    return 0;
+}
+
+static void
+tcp_mgr_worker_enqueue(struct tcp_mgr_instance *tmi,
+                       struct tcp_mgr_connection *tmc,
+                       struct tcp_mgr_pipeline_msg *tmpm);
+
+/**
+ * tcp_mgr_pipeline_msg_queue - called in place of tmi_recv_cb once a request
+ *   has been read.  The request is placed onto the workers' queue and onto
+ *   the connection's list of outstanding requests, which orders the replies.
+ *   A bulk buffer is handed to the request, other contents are copied.
+ */
+static int
+tcp_mgr_pipeline_msg_queue(struct tcp_mgr_connection *tmc, char *buf,
+                           size_t size)
+{
+    struct tcp_mgr_instance *tmi = tmc->tmc_tmi;
+    const bool bulk = (buf == tmc->tmc_bulk_buf && !tmc->tmc_bulk_niovs) ?
+        true : false;
+
+    struct tcp_mgr_pipeline_msg *tmpm =
+        niova_calloc_can_fail(1UL, sizeof(struct tcp_mgr_pipeline_msg) +
+                              (bulk ? 0 : size));
+    if (!tmpm)
+        return -ENOMEM;
+
+    if (bulk)
+    {
+        tmpm->tmpm_bulk_buf = tmc->tmc_bulk_buf;
+        tmpm->tmpm_bulk_bi = tmc->tmc_bulk_bi;
+        tmpm->tmpm_buf = buf;
+
+        tmc->tmc_bulk_buf = NULL;
+        tmc->tmc_bulk_bi = NULL;
+    }
+    else
+    {
+        memcpy(tmpm->tmpm_data, buf, size);
+        tmpm->tmpm_buf = tmpm->tmpm_data;
+    }
+
+    tmpm->tmpm_size = size;
+    tmpm->tmpm_tmc = tmc;
+    STAILQ_INIT(&tmpm->tmpm_replies);
+
+    // Released once the request has been processed
+    tcp_mgr_connection_get(tmc);
+
+    niova_mutex_lock(&tmc->tmc_send_mutex);
+    STAILQ_INSERT_TAIL(&tmc->tmc_pipeline_msgs, tmpm, tmpm_conn_lentry);
+    niova_mutex_unlock(&tmc->tmc_send_mutex);
+
+    struct tcp_mgr_connq *tmcq = &tmi->tmi_connq;
+
+    niova_mutex_lock(&tmcq->tmcq_mutex);
+    tmc->tmc_pipeline_inflight++;
+    niova_mutex_unlock(&tmcq->tmcq_mutex);
+
+    tcp_mgr_worker_enqueue(tmi, NULL, tmpm);
+
+    return 0;
+}
+
+/**
+ * tcp_mgr_pipeline_msg_complete - retires the request.  Once the oldest
+ *   outstanding request has completed, the replies held by the requests
+ *   behind it are written in order.  A request which is not the oldest is
+ *   left on the connection's list and freed when it is retired.
+ */
+static void
+tcp_mgr_pipeline_msg_complete(struct tcp_mgr_pipeline_msg *tmpm)
+{
+    struct tcp_mgr_connection *tmc = tmpm->tmpm_tmc;
+    struct tcp_mgr_instance *tmi = tmc->tmc_tmi;
+    struct tcp_mgr_pipeline_msg_list retired =
+        STAILQ_HEAD_INITIALIZER(retired);
+    struct tcp_mgr_send_queue done = STAILQ_HEAD_INITIALIZER(done);
+    bool apply_events = false;
+    int rc = 0;
+
+    niova_mutex_lock(&tmc->tmc_send_mutex);
+
+    tmpm->tmpm_done = 1;
+
+    const bool orphaned = tmpm->tmpm_orphaned ? true : false;
+
+    if (tmpm->tmpm_orphaned)
+    {
+        STAILQ_INSERT_TAIL(&retired, tmpm, tmpm_conn_lentry);
+    }
+    else
+    {
+        bool released = false;
+        struct tcp_mgr_pipeline_msg *head;
+
+        while ((head = STAILQ_FIRST(&tmc->tmc_pipeline_msgs)) &&
+               head->tmpm_done)
+        {
+            STAILQ_REMOVE_HEAD(&tmc->tmc_pipeline_msgs, tmpm_conn_lentry);
+            STAILQ_INSERT_TAIL(&retired, head, tmpm_conn_lentry);
+
+            // The next request may now reply directly
+            struct tcp_mgr_pipeline_msg *next =
+                STAILQ_FIRST(&tmc->tmc_pipeline_msgs);
+
+            struct tcp_mgr_send_buf *tmsb;
+            while (next && (tmsb = STAILQ_FIRST(&next->tmpm_replies)))
+            {
+                STAILQ_REMOVE_HEAD(&next->tmpm_replies, tmsb_lentry);
+                tcp_mgr_sendq_insert_locked(tmc, tmsb);
+                released = true;
+            }
+        }
+
+        if (released && tmc->tmc_status == TMCS_CONNECTED &&
+            !tmc->tmc_sendq_pending)
+        {
+            rc = tcp_mgr_sendq_flush_locked(tmc, &done);
+            apply_events = tcp_mgr_sendq_pending_update_locked(tmc);
+        }
+    }
+
+    niova_mutex_unlock(&tmc->tmc_send_mutex);
+
+    tcp_mgr_send_bufs_complete(tmc, &done, 0);
+
+    if (rc)
+        tcp_mgr_connection_close(tmc);
+    else if (apply_events)
+        tcp_mgr_connection_events_apply(tmc);
+
+    // The request's credit belongs to the connection it arrived on
+    if (!orphaned)
+        tcp_mgr_fc_credit_return(tmc);
+
+    struct tcp_mgr_connq *tmcq = &tmi->tmi_connq;
+
+    niova_mutex_lock(&tmcq->tmcq_mutex);
+
+    NIOVA_ASSERT(tmc->tmc_pipeline_inflight > 0);
+    tmc->tmc_pipeline_inflight--;
+
+    const bool resume = (tmc->tmc_pipeline_throttled &&
+                         tmc->tmc_pipeline_inflight < tmi->tmi_pipeline_depth);
+    if (resume)
+        tmc->tmc_pipeline_throttled = 0;
+
+    niova_mutex_unlock(&tmcq->tmcq_mutex);
+
+    if (resume)
+        tcp_mgr_conn_reenable(tmc);
+
+    struct tcp_mgr_pipeline_msg *tmp;
+    while ((tmp = STAILQ_FIRST(&retired)))
+    {
+        STAILQ_REMOVE_HEAD(&retired, tmpm_conn_lentry);
+        niova_free(tmp);
+    }
+
+    tcp_mgr_connection_put(tmc);
+}
+
+static void
+tcp_mgr_pipeline_msg_process(struct tcp_mgr_pipeline_msg *tmpm)
+{
+    struct tcp_mgr_connection *tmc = tmpm->tmpm_tmc;
+    struct tcp_mgr_instance *tmi = tmc->tmc_tmi;
+
+    tcpMgrPipelineMsg = tmpm;
+
+    int rc = tmi->tmi_recv_cb(tmc, tmpm->tmpm_buf, tmpm->tmpm_size,
+                              tmi->tmi_data);
+
+    tcpMgrPipelineMsg = NULL;
+
+    // The bulk buffer may have been taken by the recv cb
+    if (tmpm->tmpm_bulk_bi)
+        buffer_set_release_item(tmpm->tmpm_bulk_bi);
+    else if (tmpm->tmpm_bulk_buf)
+        tcp_mgr_bulk_free(tmi, tmpm->tmpm_bulk_buf);
+
+    tmpm->tmpm_bulk_bi = NULL;
+    tmpm->tmpm_bulk_buf = NULL;
+    tmpm->tmpm_buf = NULL;
+
+    if (rc < 0)
+    {
+        DBG_TCP_MGR_CXN(LL_NOTIFY, tmc, "recv cb failed: %s", strerror(-rc));
+        tcp_mgr_connection_close(tmc);
+    }
+
+    tcp_mgr_pipeline_msg_complete(tmpm);
+}
+
+// The worker, if any, which is running in this thread
+static __thread struct tcp_mgr_worker *tcpMgrWorkerSelf;
+
+static bool
+tcp_mgr_worker_pop_locked(struct tcp_mgr_worker *tmw,
+                          struct tcp_mgr_connection **ret_tmc,
+                          struct tcp_mgr_pipeline_msg **ret_tmpm)
+{
+    // Connections are read ahead of processing queued requests
+    if (!STAILQ_EMPTY(&tmw->tmw_conns))
+    {
+        *ret_tmc = STAILQ_FIRST(&tmw->tmw_conns);
+        STAILQ_REMOVE_HEAD(&tmw->tmw_conns, tmc_lentry);
+        return true;
+    }
+    else if (!STAILQ_EMPTY(&tmw->tmw_msgs))
+    {
+        *ret_tmpm = STAILQ_FIRST(&tmw->tmw_msgs);
+        STAILQ_REMOVE_HEAD(&tmw->tmw_msgs, tmpm_lentry);
+        return true;
+    }
+
+    return false;
+}
+
+static bool
+tcp_mgr_worker_pop(struct tcp_mgr_worker *tmw,
+                   struct tcp_mgr_connection **ret_tmc,
+                   struct tcp_mgr_pipeline_msg **ret_tmpm)
+{
+    // Unlocked peek to avoid taking the lock of an empty queue
+    if (STAILQ_EMPTY(&tmw->tmw_conns) && STAILQ_EMPTY(&tmw->tmw_msgs))
+        return false;
+
+    niova_mutex_lock(&tmw->tmw_mutex);
+    bool found = tcp_mgr_worker_pop_locked(tmw, ret_tmc, ret_tmpm);
+    niova_mutex_unlock(&tmw->tmw_mutex);
+
+    return found;
+}
+
+static bool
+tcp_mgr_worker_steal(struct tcp_mgr_worker *tmw,
+                     struct tcp_mgr_connection **ret_tmc,
+                     struct tcp_mgr_pipeline_msg **ret_tmpm)
+{
+    struct tcp_mgr_instance *tmi = tmw->tmw_tmi;
+
+    for (size_t i = 1; i < tmi->tmi_nworkers; i++)
+    {
+        struct tcp_mgr_worker *victim =
+            &tmi->tmi_workers[(tmw->tmw_idx + i) % tmi->tmi_nworkers];
+
+        if (tcp_mgr_worker_pop(victim, ret_tmc, ret_tmpm))
+        {
+            tmw->tmw_steals++;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * tcp_mgr_worker_wake_idle - wakes a single idle worker, if there is one, so
+ *   that it may steal work which was queued to a busy worker.
+ */
+static void
+tcp_mgr_worker_wake_idle(struct tcp_mgr_instance *tmi, size_t start)
+{
+    if (!niova_atomic_read(&tmi->tmi_workers_idle))
+        return;
+
+    for (size_t i = 0; i < tmi->tmi_nworkers; i++)
+    {
+        struct tcp_mgr_worker *tmw =
+            &tmi->tmi_workers[(start + i) % tmi->tmi_nworkers];
+
+        if (!tmw->tmw_idle || tmw->tmw_wake)
+            continue;
+
+        bool woken = false;
+
+        niova_mutex_lock(&tmw->tmw_mutex);
+        if (tmw->tmw_idle && !tmw->tmw_wake)
+        {
+            NIOVA_SET_COND_AND_WAKE_LOCKED(signal, { tmw->tmw_wake = 1; },
+                                           &tmw->tmw_cond);
+            woken = true;
+        }
+        niova_mutex_unlock(&tmw->tmw_mutex);
+
+        if (woken)
+            return;
+    }
+}
+
+/**
+ * tcp_mgr_worker_enqueue - queues either a connection which is to be read or
+ *   a pipelined request.
+ */
+static void
+tcp_mgr_worker_enqueue(struct tcp_mgr_instance *tmi,
+                       struct tcp_mgr_connection *tmc,
+                       struct tcp_mgr_pipeline_msg *tmpm)
+{
+    NIOVA_ASSERT(tmi->tmi_nworkers && (tmc || tmpm));
+
+    struct tcp_mgr_worker *tmw =
+        (tcpMgrWorkerSelf && tcpMgrWorkerSelf->tmw_tmi == tmi) ?
+        tcpMgrWorkerSelf : NULL;
+
+    if (!tmw)
+    {
+        const size_t start =
+            (uint32_t)niova_atomic_inc(&tmi->tmi_worker_next) %
+            tmi->tmi_nworkers;
+
+        // Prefer an idle worker so that a single wakeup suffices
+        for (size_t i = 0;
+             i < tmi->tmi_nworkers && niova_atomic_read(&tmi->tmi_workers_idle);
+             i++)
+        {
+            struct tcp_mgr_worker *x =
+                &tmi->tmi_workers[(start + i) % tmi->tmi_nworkers];
+
+            if (x->tmw_idle && !x->tmw_wake)
+            {
+                tmw = x;
+                break;
+            }
+        }
+
+        if (!tmw)
+            tmw = &tmi->tmi_workers[start];
+    }
+
+    niova_mutex_lock(&tmw->tmw_mutex);
+
+    if (tmc)
+        STAILQ_INSERT_TAIL(&tmw->tmw_conns, tmc, tmc_lentry);
+    else
+        STAILQ_INSERT_TAIL(&tmw->tmw_msgs, tmpm, tmpm_lentry);
+
+    const bool woken = tmw->tmw_idle ? true : false;
+    if (woken)
+        NIOVA_SET_COND_AND_WAKE_LOCKED(signal, { tmw->tmw_wake = 1; },
+                                       &tmw->tmw_cond);
+
+    niova_mutex_unlock(&tmw->tmw_mutex);
+
+    if (!woken)
+        tcp_mgr_worker_wake_idle(tmi, tmw->tmw_idx + 1);
+}
+
+/**
+ * tcp_mgr_worker_wait - sleeps until work is queued to the worker or it is
+ *   woken to steal.  The worker is marked idle before its final attempt to
+ *   steal so that work queued to a busy worker in the meantime is not missed.
+ */
+static bool
+tcp_mgr_worker_wait(struct tcp_mgr_worker *tmw,
+                    struct tcp_mgr_connection **ret_tmc,
+                    struct tcp_mgr_pipeline_msg **ret_tmpm)
+{
+    struct tcp_mgr_instance *tmi = tmw->tmw_tmi;
+    struct thread_ctl *tc = &tmw->tmw_thr_ctl;
+
+    niova_mutex_lock(&tmw->tmw_mutex);
+    tmw->tmw_idle = 1;
+    niova_atomic_inc(&tmi->tmi_workers_idle);
+    niova_mutex_unlock(&tmw->tmw_mutex);
+
+    bool found = tcp_mgr_worker_steal(tmw, ret_tmc, ret_tmpm);
+
+    niova_mutex_lock(&tmw->tmw_mutex);
+
+    if (!found)
+    {
+        NIOVA_WAIT_COND_LOCKED((!STAILQ_EMPTY(&tmw->tmw_conns) ||
+                                !STAILQ_EMPTY(&tmw->tmw_msgs) ||
+                                tmw->tmw_wake ||
+                                thread_ctl_has_flag(tc, TC_FLAG_HALT)),
+                               &tmw->tmw_mutex, &tmw->tmw_cond);
+
+        found = tcp_mgr_worker_pop_locked(tmw, ret_tmc, ret_tmpm);
+    }
+
+    tmw->tmw_idle = 0;
+    tmw->tmw_wake = 0;
+    niova_atomic_dec(&tmi->tmi_workers_idle);
+
+    niova_mutex_unlock(&tmw->tmw_mutex);
+
+    return found;
+}
+
+static void *
+tcp_mgr_worker(void *arg)
+{
+    struct thread_ctl *tc = (struct thread_ctl *)arg;
+    NIOVA_ASSERT(tc && tc->tc_arg);
+
+    struct tcp_mgr_worker *tmw = (struct tcp_mgr_worker *)tc->tc_arg;
+
+    tcpMgrWorkerSelf = tmw;
+
+    THREAD_LOOP_WITH_CTL(tc)
+    {
+        struct tcp_mgr_connection *tmc = NULL;
+        struct tcp_mgr_pipeline_msg *tmpm = NULL;
+
+        if (!tcp_mgr_worker_pop(tmw, &tmc, &tmpm) &&
+            !tcp_mgr_worker_steal(tmw, &tmc, &tmpm) &&
+            !tcp_mgr_worker_wait(tmw, &tmc, &tmpm))
+            continue;
+
+        SIMPLE_LOG_MSG(LL_DEBUG, "tmc=%p tmpm=%p", tmc, tmpm);
+
+        if (tmpm)
+        {
+            tcp_mgr_pipeline_msg_process(tmpm);
             continue;
+        }
 
         NIOVA_ASSERT(tmc->tmc_handoff);
 
-        /* Start work.  Note: this method ensures that only a single operation,
-         * per connection, will be processed at any one time.  This ensures that
+        /* Start work.  Note: unless pipelining is enabled, this method
+         * ensures that only a single operation, per connection, will be
+         * processed at any one time.  This ensures that
          * a greedy client will not occupy all processing threads.  If this
          * behavior were to be changed, it's likely that a per-connection send
          * mutex would be required to prevent interleaving of reply contents on
          * the socket.
-         * NOTE that the send mutex may be needed anyway since the write replies
-         * will be handled async - by another thread.  The other issue becomes
-         * socket writes which can't be completed, in this case we need to
-         * queue the sends on the connection, similar to how nconn.c works.
+         * NOTE that the send mutex is needed anyway since the write replies
+         * will be handled async - by another thread.  Socket writes which
+         * can't be completed are placed on the connection's send queue.
          */
         tcp_mgr_conn_recv_inline(tmc);
         // end work
@@ -172,6 +2489,13 @@ tcp_mgr_set_thread_cnt_env_cb(const struct niova_env_var *ev)
     tcpWorkerCnt = ev->nev_long_value;
 }
 
+env_cb_ctx_t
+tcp_mgr_cork_usec_env_cb(const struct niova_env_var *ev)
+{
+    if (ev && ev->nev_present)
+        tcpMgrCorkUsec = ev->nev_long_value;
+}
+
 int
 tcp_mgr_setup(struct tcp_mgr_instance *tmi, void *data,
               epoll_mgr_ref_cb_t connection_ref_cb,
@@ -189,6 +2513,7 @@ tcp_mgr_setup(struct tcp_mgr_instance *tmi, void *data,
     tmi->tmi_connection_ref_cb = connection_ref_cb;
     tmi->tmi_recv_cb = recv_cb;
     tmi->tmi_bulk_size_cb = bulk_size_cb;
+    tmi->tmi_bulk_iov_cb = NULL;
     tmi->tmi_handshake_cb = handshake_cb;
     tmi->tmi_handshake_fill = handshake_fill;
     tmi->tmi_handshake_size = handshake_size;
@@ -197,29 +2522,80 @@ tcp_mgr_setup(struct tcp_mgr_instance *tmi, void *data,
     tcp_mgr_bulk_credits_set(tmi, bulk_credits);
     tcp_mgr_incoming_credits_set(tmi, incoming_credits);
 
+    tmi->tmi_bulk_pools_enabled = 0;
+    memset(tmi->tmi_bulk_pools, 0, sizeof(tmi->tmi_bulk_pools));
+    tcp_mgr_sendq_max_bytes_set(tmi, TCP_MGR_SENDQ_MAX_BYTES);
+    tcp_mgr_cork_usec_set(tmi, tcpMgrCorkUsec);
+    tmi->tmi_zerocopy_threshold = 0;
+    tmi->tmi_pipeline_depth = 0;
+    tmi->tmi_recv_buf_size = 0;
+    tmi->tmi_fc_credits = 0;
+    tmi->tmi_compress_threshold = 0;
+    tmi->tmi_listen_shards = NULL;
+    tmi->tmi_nlisten_shards = 0;
+
     pthread_mutex_init(&tmi->tmi_epoll_ctx_mutex, NULL);
 
+    pthread_mutex_init(&tmi->tmi_stats_mutex, NULL);
+    tmi->tmi_latency_stats = 0;
+    tmi->tmi_stats_conns = NULL;
+    tmi->tmi_stats_nconns = 0;
+    tmi->tmi_stats_nalloc = 0;
+    tmi->tmi_stats_nclosed = 0;
+    tmi->tmi_stats_closed_msgs_out = 0;
+    memset(&tmi->tmi_stats_closed, 0, sizeof(tmi->tmi_stats_closed));
+    if (tcp_mgr_connection_stats_hists_alloc(&tmi->tmi_stats_closed))
+        return -ENOMEM;
+
+    tcp_mgr_connection_stats_init(&tmi->tmi_stats_closed);
+    tmi->tmi_lrn = NULL;
+    tmi->tmi_name[0] = '\0';
+
     struct tcp_mgr_connq *tmcq = &tmi->tmi_connq;
-    STAILQ_INIT(&tmcq->tmcq_queue);
     pthread_mutex_init(&tmcq->tmcq_mutex, NULL);
-    pthread_cond_init(&tmcq->tmcq_cond, NULL);
+
+    tmi->tmi_workers = NULL;
+    niova_atomic_init(&tmi->tmi_worker_next, 0);
+    niova_atomic_init(&tmi->tmi_workers_idle, 0);
 
     if (conn_recv_handoff)
     {
         int rc = 0;
 
+        tmi->tmi_workers = niova_calloc_can_fail((size_t)tcpWorkerCnt,
+                                                 sizeof(struct tcp_mgr_worker));
+        if (!tmi->tmi_workers)
+            return -ENOMEM;
+
+        /* The queues are initialized up front since workers may steal from
+         * one another as soon as they start.
+         */
+        for (int i = 0; i < tcpWorkerCnt; i++)
+        {
+            struct tcp_mgr_worker *tmw = &tmi->tmi_workers[i];
+
+            tmw->tmw_tmi = tmi;
+            tmw->tmw_idx = i;
+            pthread_mutex_init(&tmw->tmw_mutex, NULL);
+            pthread_cond_init(&tmw->tmw_cond, NULL);
+            STAILQ_INIT(&tmw->tmw_conns);
+            STAILQ_INIT(&tmw->tmw_msgs);
+        }
+
         SIMPLE_LOG_MSG(LL_DEBUG, "Number of worker threads: %d", tcpWorkerCnt);
         for (int i = 0; i < tcpWorkerCnt; i++)
         {
+            struct tcp_mgr_worker *tmw = &tmi->tmi_workers[i];
+
             char thr_name[MAX_THREAD_NAME] = {0};
             snprintf(thr_name, MAX_THREAD_NAME, "tcp_wrk.%d", i);
 
-            rc = thread_create(tcp_mgr_worker, &tmi->tmi_workers[i], thr_name,
-                               (void *)tmi, NULL);
+            rc = thread_create(tcp_mgr_worker, &tmw->tmw_thr_ctl, thr_name,
+                               (void *)tmw, NULL);
             if (rc == 0)
             {
                 tmi->tmi_nworkers++;
-                thread_ctl_run(&tmi->tmi_workers[i]);
+                thread_ctl_run(&tmw->tmw_thr_ctl);
             }
             else
             {
@@ -231,7 +2607,8 @@ tcp_mgr_setup(struct tcp_mgr_instance *tmi, void *data,
             return rc;
 
         for (size_t i = 0; i < tmi->tmi_nworkers; i++)
-            thread_creator_wait_until_ctl_loop_reached(&tmi->tmi_workers[i]);
+            thread_creator_wait_until_ctl_loop_reached(
+                &tmi->tmi_workers[i].tmw_thr_ctl);
     }
 
     return 0;
@@ -241,11 +2618,14 @@ int
 tcp_mgr_sockets_setup(struct tcp_mgr_instance *tmi, const char *ipaddr,
                       int port)
 {
-    strncpy(tmi->tmi_listen_socket.tsh_ipaddr, ipaddr, IPV4_STRLEN);
-    tmi->tmi_listen_socket.tsh_ipaddr[IPV4_STRLEN - 1] = 0;
-    tmi->tmi_listen_socket.tsh_port = port;
+    struct tcp_socket_handle *tsh = &tmi->tmi_listen_socket;
 
-    return tcp_socket_setup(&tmi->tmi_listen_socket);
+    // "unix:<path>" listens on a Unix-domain socket rather than on TCP
+    strncpy(tsh->tsh_ipaddr, ipaddr, sizeof(tsh->tsh_ipaddr));
+    tsh->tsh_ipaddr[sizeof(tsh->tsh_ipaddr) - 1] = 0;
+    tsh->tsh_port = port;
+
+    return tcp_socket_setup(tsh);
 }
 
 int
@@ -254,13 +2634,102 @@ tcp_mgr_sockets_close(struct tcp_mgr_instance *tmi)
     if (tmi->tmi_listen_eph.eph_installed)
         epoll_handle_del(tmi->tmi_epoll_mgr, &tmi->tmi_listen_eph);
 
+    for (size_t i = 0; i < tmi->tmi_nlisten_shards; i++)
+    {
+        struct tcp_mgr_listen_shard *tmls = &tmi->tmi_listen_shards[i];
+
+        if (tmls->tmls_eph.eph_installed)
+            epoll_handle_del(tmls->tmls_epm, &tmls->tmls_eph);
+
+        tcp_socket_close(&tmls->tmls_socket);
+    }
+
+    niova_free(tmi->tmi_listen_shards);
+    tmi->tmi_listen_shards = NULL;
+    tmi->tmi_nlisten_shards = 0;
+
     return tcp_socket_close(&tmi->tmi_listen_socket);
 }
 
+/**
+ * tcp_mgr_listen_shards_set - listen on 'nshards' sockets bound to the
+ *   instance's address with SO_REUSEPORT.  Must be called after
+ *   tcp_mgr_sockets_setup() and before tcp_mgr_sockets_bind().  The extra
+ *   shards are released by tcp_mgr_sockets_close().  Unix-domain listeners
+ *   cannot share their path and are limited to a single shard.
+ */
+int
+tcp_mgr_listen_shards_set(struct tcp_mgr_instance *tmi, size_t nshards)
+{
+    if (!tmi || !nshards || nshards > TCP_MGR_LISTEN_MAX_SHARDS ||
+        tmi->tmi_listen_shards || tmi->tmi_listen_eph.eph_installed)
+        return -EINVAL;
+
+    else if (nshards > 1 && tcp_socket_handle_is_unix(&tmi->tmi_listen_socket))
+        return -EOPNOTSUPP;
+
+    if (nshards == 1)
+        return 0;
+
+    tmi->tmi_listen_shards =
+        niova_calloc_can_fail(nshards - 1,
+                              sizeof(struct tcp_mgr_listen_shard));
+    if (!tmi->tmi_listen_shards)
+        return -ENOMEM;
+
+    for (size_t i = 0; i < nshards - 1; i++)
+    {
+        struct tcp_mgr_listen_shard *tmls = &tmi->tmi_listen_shards[i];
+
+        tcp_socket_handle_init(&tmls->tmls_socket);
+        tmls->tmls_tmi = tmi;
+    }
+
+    tmi->tmi_nlisten_shards = nshards - 1;
+
+    return 0;
+}
+
+static int
+tcp_mgr_listen_shards_bind(struct tcp_mgr_instance *tmi)
+{
+    for (size_t i = 0; i < tmi->tmi_nlisten_shards; i++)
+    {
+        struct tcp_socket_handle *tsh = &tmi->tmi_listen_shards[i].tmls_socket;
+
+        // Bind after the first shard so that its default port is used
+        tcp_socket_handle_set_data(tsh, tmi->tmi_listen_socket.tsh_ipaddr,
+                                   tmi->tmi_listen_socket.tsh_port);
+
+        int rc = tcp_socket_setup(tsh);
+        if (!rc)
+            rc = tcp_socket_reuseport_enable(tsh);
+        if (!rc)
+            rc = tcp_socket_bind(tsh);
+
+        if (rc)
+        {
+            SIMPLE_LOG_MSG(LL_ERROR, "listen shard %zu: %s", i + 1,
+                           strerror(-rc));
+            return rc;
+        }
+    }
+
+    return 0;
+}
+
 int
 tcp_mgr_sockets_bind(struct tcp_mgr_instance *tmi)
 {
-    int rc = tcp_socket_bind(&tmi->tmi_listen_socket);
+    int rc = tmi->tmi_nlisten_shards ?
+        tcp_socket_reuseport_enable(&tmi->tmi_listen_socket) : 0;
+
+    if (!rc)
+        rc = tcp_socket_bind(&tmi->tmi_listen_socket);
+
+    if (!rc)
+        rc = tcp_mgr_listen_shards_bind(tmi);
+
     if (rc)
         tcp_mgr_sockets_close(tmi);
 
@@ -285,20 +2754,67 @@ tcp_mgr_connection_setup_internal(struct tcp_mgr_connection *tmc,
     }
 
     tmc->tmc_tmi = tmi;
+    tmc->tmc_epm = NULL;
 
     // setup during handshake
     tmc->tmc_header_size = 0;
 
     tmc->tmc_bulk_buf = NULL;
+    tmc->tmc_bulk_bi = NULL;
+    tmc->tmc_hdr_buf = NULL;
+    tmc->tmc_hdr_offset = 0;
+    tmc->tmc_bulk_niovs = 0;
     tmc->tmc_bulk_offset = 0;
     tmc->tmc_bulk_remain = 0;
 
+    tmc->tmc_rbuf = NULL;
+    tmc->tmc_rbuf_size = 0;
+    tmc->tmc_rbuf_head = 0;
+    tmc->tmc_rbuf_tail = 0;
+    tmc->tmc_rbuf_bulk_size = -1;
+
     tmc->tmc_epoll_ctx_cb = NULL;
 
     tmc->tmc_status = TMCS_DISCONNECTED;
 
     pthread_mutex_init(&tmc->tmc_send_mutex, NULL);
 
+    STAILQ_INIT(&tmc->tmc_sendq);
+    tmc->tmc_sendq_bytes = 0;
+    tmc->tmc_sendq_pending = 0;
+    tmc->tmc_send_msgs = 0;
+    tmc->tmc_send_syscalls = 0;
+
+    // the histograms are allocated once the connection is established
+    memset(&tmc->tmc_stats, 0, sizeof(tmc->tmc_stats));
+    tmc->tmc_hdr_usec = 0;
+    tmc->tmc_stats_idx = -1;
+
+    tmc->tmc_zerocopy = 0;
+    tmc->tmc_zc_next_id = 0;
+    STAILQ_INIT(&tmc->tmc_zc_inflight);
+    tmc->tmc_zc_sends = 0;
+    tmc->tmc_zc_copied = 0;
+
+    tmc->tmc_fc_window = 0;
+    tmc->tmc_fc_credits = 0;
+    tmc->tmc_fc_owed = 0;
+    tmc->tmc_fc_stalls = 0;
+
+    tmc->tmc_compress_caps = 0;
+    tmc->tmc_compress = 0;
+    tmc->tmc_compress_backoff = 0;
+    tmc->tmc_compress_skip = 0;
+    tmc->tmc_zbuf = NULL;
+    tmc->tmc_zbuf_size = 0;
+    tmc->tmc_zbuf_bulk_size = 0;
+
+    STAILQ_INIT(&tmc->tmc_pipeline_msgs);
+    tmc->tmc_pipeline_inflight = 0;
+    tmc->tmc_pipeline_throttled = 0;
+
+    epoll_mgr_timer_init(&tmc->tmc_cork_timer, tcp_mgr_cork_timer_cb, tmc);
+
     return 0;
 }
 
@@ -333,16 +2849,29 @@ tcp_mgr_connection_close_internal(struct tcp_mgr_connection *tmc)
 
     tmc->tmc_status = TMCS_DISCONNECTING;
     if (tmc->tmc_eph.eph_installed)
-        epoll_handle_del(tmc->tmc_tmi->tmi_epoll_mgr, &tmc->tmc_eph);
-
-    if (tmc->tmc_bulk_buf)
-        tcp_mgr_bulk_free(tmc->tmc_tmi, tmc->tmc_bulk_buf);
+        epoll_handle_del(tcp_mgr_connection_epm(tmc), &tmc->tmc_eph);
 
-    tmc->tmc_bulk_buf = NULL;
-    tmc->tmc_bulk_offset = 0;
+    tcp_mgr_connection_bulk_release(tmc);
     tmc->tmc_bulk_remain = 0;
 
+    niova_free(tmc->tmc_hdr_buf);
+    tmc->tmc_hdr_buf = NULL;
+    tmc->tmc_hdr_offset = 0;
+
+    // Buffered data belongs to the closed socket
+    niova_free(tmc->tmc_rbuf);
+    tmc->tmc_rbuf = NULL;
+    tmc->tmc_rbuf_size = 0;
+    tmc->tmc_rbuf_head = 0;
+    tmc->tmc_rbuf_tail = 0;
+    tmc->tmc_rbuf_bulk_size = -1;
+
     tcp_socket_close(&tmc->tmc_tsh);
+
+    // Purge after the close so no further sends may reference the buffers
+    tcp_mgr_sendq_purge(tmc);
+    tcp_mgr_connection_stats_detach(tmc);
+
     tmc->tmc_status = TMCS_DISCONNECTED;
 }
 
@@ -433,7 +2962,7 @@ tcp_mgr_connection_epoll_ctx_run(struct tcp_mgr_connection *tmc,
     DBG_TCP_MGR_CXN(LL_TRACE, tmc, "");
 
     struct tcp_mgr_instance *tmi = tmc->tmc_tmi;
-    struct epoll_mgr *epm = tmi->tmi_epoll_mgr;
+    struct epoll_mgr *epm = tcp_mgr_connection_epm(tmc);
     if (!cb)
         return -EINVAL;
 
@@ -477,7 +3006,7 @@ tcp_mgr_connection_epoll_add(struct tcp_mgr_connection *tmc,
     if (rc)
         return rc;
 
-    return epoll_handle_add(tmc->tmc_tmi->tmi_epoll_mgr, &tmc->tmc_eph);
+    return epoll_handle_add(tcp_mgr_connection_epm(tmc), &tmc->tmc_eph);
 }
 
 static int
@@ -529,17 +3058,38 @@ tcp_mgr_bulk_progress_recv(struct tcp_mgr_connection *tmc)
     if (!tmc->tmc_bulk_remain)
         return 0;
 
-    char *bulk = tmc->tmc_bulk_buf + tmc->tmc_bulk_offset;
+    struct iovec iovs[TCP_MGR_BULK_MAX_IOVS];
+    ssize_t niovs = 1;
 
-    struct iovec iov = {
-        .iov_base = bulk,
-        .iov_len = tmc->tmc_bulk_remain,
-    };
+    if (tmc->tmc_zbuf)
+    {
+        iovs[0].iov_base =
+            tmc->tmc_zbuf + tmc->tmc_zbuf_size - tmc->tmc_bulk_remain;
+        iovs[0].iov_len = tmc->tmc_bulk_remain;
+    }
+    else if (tmc->tmc_bulk_niovs)
+    {
+        const size_t total =
+            niova_io_iovs_total_size_get(tmc->tmc_bulk_iovs,
+                                         tmc->tmc_bulk_niovs);
+
+        niovs = niova_io_iovs_map_consumed(tmc->tmc_bulk_iovs, iovs,
+                                           tmc->tmc_bulk_niovs,
+                                           total - tmc->tmc_bulk_remain, -1);
+        if (niovs <= 0)
+            return niovs ? niovs : -EINVAL;
+    }
+    else
+    {
+        iovs[0].iov_base = tmc->tmc_bulk_buf + tmc->tmc_bulk_offset;
+        iovs[0].iov_len = tmc->tmc_bulk_remain;
+    }
 
-    ssize_t recv_bytes = tcp_socket_recv(&tmc->tmc_tsh, &iov, 1, NULL, false);
+    ssize_t recv_bytes = tcp_socket_recv(&tmc->tmc_tsh, iovs, niovs, NULL,
+                                         false);
 
-    SIMPLE_LOG_MSG(LL_DEBUG, "recv_bytes=%ld iov_len=%ld", recv_bytes,
-                   iov.iov_len);
+    SIMPLE_LOG_MSG(LL_DEBUG, "recv_bytes=%ld remain=%zu niovs=%zd",
+                   recv_bytes, tmc->tmc_bulk_remain, niovs);
 
     if (recv_bytes == -EAGAIN)
         recv_bytes = 0;
@@ -550,7 +3100,9 @@ tcp_mgr_bulk_progress_recv(struct tcp_mgr_connection *tmc)
 
     NIOVA_ASSERT((size_t)recv_bytes <= tmc->tmc_bulk_remain);
 
-    tmc->tmc_bulk_offset += recv_bytes;
+    if (!tmc->tmc_bulk_niovs && !tmc->tmc_zbuf)
+        tmc->tmc_bulk_offset += recv_bytes;
+
     tmc->tmc_bulk_remain -= recv_bytes;
 
     return 0;
@@ -569,8 +3121,22 @@ tcp_mgr_bulk_prepare_and_recv(struct tcp_mgr_connection *tmc, size_t bulk_size,
     if (buf_size > TCP_MGR_MAX_BULK_SIZE)
         return -E2BIG;
 
-    // buffer free'd in tcp_mgr_recv_cb
-    void *buf = tcp_mgr_bulk_malloc(tmc->tmc_tmi, buf_size);
+    struct tcp_mgr_instance *tmi = tmc->tmc_tmi;
+    struct buffer_item *bi = NULL;
+    void *buf = NULL;
+
+    // buffer released in tcp_mgr_bulk_complete
+    if (tcp_mgr_bulk_pool_fits(tmi, buf_size))
+    {
+        bi = tcp_mgr_bulk_pool_alloc(tmi, buf_size);
+        if (bi)
+            buf = bi->bi_iov.iov_base;
+    }
+    else
+    {
+        buf = tcp_mgr_bulk_malloc(tmi, buf_size);
+    }
+
     if (!buf)
     {
         DBG_TCP_MGR_CXN(LL_NOTIFY, tmc, "cannot allocate bulk buf");
@@ -588,21 +3154,99 @@ tcp_mgr_bulk_prepare_and_recv(struct tcp_mgr_connection *tmc, size_t bulk_size,
         memcpy(buf, hdr, hdr_size);
 
     tmc->tmc_bulk_buf = buf;
+    tmc->tmc_bulk_bi = bi;
     tmc->tmc_bulk_offset = hdr_size;
     tmc->tmc_bulk_remain = bulk_size;
 
     return 0;
 }
 
+/**
+ * tcp_mgr_bulk_prepare_scatter - offers the header to tmi_bulk_iov_cb so the
+ *   bulk may be received directly into the user's iovs.  Returns 1 if the
+ *   iovs were accepted, 0 if the bulk should be received into a tcp_mgr
+ *   buffer, or a negative errno.
+ */
+static int
+tcp_mgr_connection_hdr_buf_alloc(struct tcp_mgr_connection *tmc)
+{
+    // Sized to hold a partial header and the tcp_mgr headers preceding it
+    if (!tmc->tmc_hdr_buf)
+    {
+        tmc->tmc_hdr_buf =
+            niova_malloc_can_fail(tmc->tmc_header_size +
+                                  sizeof(struct tcp_mgr_fc_hdr) +
+                                  sizeof(struct tcp_mgr_compress_hdr));
+        if (!tmc->tmc_hdr_buf)
+            return -ENOMEM;
+    }
+
+    return 0;
+}
+
+static int
+tcp_mgr_bulk_prepare_scatter(struct tcp_mgr_connection *tmc, size_t bulk_size,
+                             char *hdr, size_t hdr_size)
+{
+    struct tcp_mgr_instance *tmi = tmc->tmc_tmi;
+
+    NIOVA_ASSERT(!tmc->tmc_bulk_niovs && !tmc->tmc_bulk_remain);
+
+    if (!tmi->tmi_bulk_iov_cb)
+        return 0;
+
+    ssize_t niovs = tmi->tmi_bulk_iov_cb(tmc, hdr, bulk_size,
+                                         tmc->tmc_bulk_iovs,
+                                         TCP_MGR_BULK_MAX_IOVS,
+                                         tmi->tmi_data);
+    if (niovs <= 0)
+        return niovs;
+
+    else if (niovs > TCP_MGR_BULK_MAX_IOVS ||
+             niova_io_iovs_total_size_get(tmc->tmc_bulk_iovs, niovs) !=
+             bulk_size)
+        return -EINVAL;
+
+    // The header is retained, since the bulk may arrive over several events
+    int rc = tcp_mgr_connection_hdr_buf_alloc(tmc);
+    if (rc)
+        return rc;
+
+    NIOVA_ASSERT(hdr_size <= tmc->tmc_header_size);
+    memcpy(tmc->tmc_hdr_buf, hdr, hdr_size);
+
+    tmc->tmc_bulk_buf = tmc->tmc_hdr_buf;
+    tmc->tmc_bulk_niovs = niovs;
+    tmc->tmc_bulk_offset = hdr_size;
+    tmc->tmc_bulk_remain = bulk_size;
+
+    return 1;
+}
+
 static int
 tcp_mgr_tmi_exec_recv_cb(struct tcp_mgr_connection *tmc, char *sink_buf,
                          size_t size)
 {
     struct tcp_mgr_instance *tmi = tmc->tmc_tmi;
 
-    return tmi->tmi_recv_cb(tmc, sink_buf, size, tmi->tmi_data);
+    tcp_mgr_stats_usec_record(tmc->tmc_stats.tmcs_recv_usec_hist,
+                              tmc->tmc_hdr_usec);
+
+    if (tmi->tmi_pipeline_depth > 1)
+        return tcp_mgr_pipeline_msg_queue(tmc, sink_buf, size);
+
+    int rc = tmi->tmi_recv_cb(tmc, sink_buf, size, tmi->tmi_data);
+    if (rc >= 0)
+        tcp_mgr_fc_credit_return(tmc);
+
+    return rc;
 }
 
+/**
+ * tcp_mgr_new_msg_handler - reads the next header from the socket.  With flow
+ *   control the tcp_mgr_fc_hdr is read on its own first, since it may not be
+ *   followed by a message.
+ */
 static int
 tcp_mgr_new_msg_handler(struct tcp_mgr_connection *tmc)
 {
@@ -614,26 +3258,104 @@ tcp_mgr_new_msg_handler(struct tcp_mgr_connection *tmc)
     NIOVA_ASSERT(tmi->tmi_recv_cb && tmi->tmi_bulk_size_cb && header_size &&
                  header_size <= TCP_MGR_MAX_HDR_SIZE);
 
-    static __thread char sink_buf[TCP_MGR_MAX_HDR_SIZE];
-    struct iovec iov;
+    static __thread char
+        sink_buf[TCP_MGR_MAX_HDR_SIZE + sizeof(struct tcp_mgr_fc_hdr) +
+                 sizeof(struct tcp_mgr_compress_hdr)];
+
+    const ssize_t fc_size =
+        tmc->tmc_fc_window ? sizeof(struct tcp_mgr_fc_hdr) : 0;
+    const ssize_t cz_size = tcp_mgr_connection_compress_hdr_size(tmc);
+    const ssize_t wire_size = fc_size + cz_size + header_size;
+
+    // A partial header is resumed from the connection's header buffer
+    ssize_t offset = tmc->tmc_hdr_offset;
+    if (offset)
+        memcpy(sink_buf, tmc->tmc_hdr_buf, offset);
+
+    char *hdr = sink_buf + fc_size + cz_size;
+
+    while (offset < wire_size)
+    {
+        struct iovec iov = {
+            .iov_base = sink_buf + offset,
+            .iov_len = (offset < fc_size ? fc_size : wire_size) - offset,
+        };
 
-    // Note that tcp_socket_recv_all() will modify the iov
-    iov.iov_base = sink_buf;
-    iov.iov_len = header_size;
+        ssize_t rc = tcp_socket_recv(&tmc->tmc_tsh, &iov, 1, NULL, false);
+        if (rc == 0)
+            return -ENOTCONN;
+
+        // Keep what has arrived and return to epoll until the rest is readable
+        else if (rc == -EAGAIN && offset > (ssize_t)tmc->tmc_hdr_offset)
+        {
+            int rc2 = tcp_mgr_connection_hdr_buf_alloc(tmc);
+            if (rc2)
+                return rc2;
+
+            memcpy(tmc->tmc_hdr_buf, sink_buf, offset);
+            tmc->tmc_hdr_offset = offset;
+
+            return -EAGAIN;
+        }
+        else if (rc < 0)
+        {
+            return rc;
+        }
+
+        offset += rc;
+
+        if (offset == fc_size && tcp_mgr_fc_hdr_grant_only(sink_buf))
+        {
+            tmc->tmc_hdr_offset = 0;
+            tmc->tmc_stats.tmcs_bytes_in += fc_size;
+
+            rc = tcp_mgr_fc_hdr_recv(tmc, sink_buf);
+
+            return rc < 0 ? rc : 0;
+        }
+    }
 
-    ssize_t rc = tcp_socket_recv_all(&tmc->tmc_tsh, &iov, NULL, 1024);
-    if (rc != header_size)
-        return rc < 0 ? rc : -ECOMM;
+    tmc->tmc_hdr_offset = 0;
+
+    if (fc_size)
+    {
+        int rc = tcp_mgr_fc_hdr_recv(tmc, sink_buf);
+        if (rc < 0)
+            return rc;
+    }
 
     // Interpret the header to determine size of the bulk
-    ssize_t bulk_size = tmi->tmi_bulk_size_cb(tmc, sink_buf, tmi->tmi_data);
+    ssize_t bulk_size = tmi->tmi_bulk_size_cb(tmc, hdr, tmi->tmi_data);
     if (bulk_size < 0)
         return bulk_size;
 
+    size_t zsize = 0;
+    if (cz_size)
+    {
+        int rc = tcp_mgr_compress_hdr_recv(tmc, sink_buf + fc_size,
+                                           bulk_size, &zsize);
+        if (rc)
+            return rc;
+    }
+
+    tcp_mgr_stats_recv_hdr(tmc, wire_size + (zsize ? zsize : (size_t)bulk_size),
+                           bulk_size);
+
     // If there's no bulk proceed to request processor, else read the bulk
-    return bulk_size ?
-        tcp_mgr_bulk_prepare_and_recv(tmc, bulk_size, sink_buf, header_size) :
-        tcp_mgr_tmi_exec_recv_cb(tmc, sink_buf, header_size);
+    if (!bulk_size)
+        return tcp_mgr_tmi_exec_recv_cb(tmc, hdr, header_size);
+
+    // Compressed bulks are staged and so are never scattered
+    int rc = zsize ? 0 :
+        tcp_mgr_bulk_prepare_scatter(tmc, bulk_size, hdr, header_size);
+    if (rc)
+        return rc < 0 ? rc : 0;
+
+    rc = tcp_mgr_bulk_prepare_and_recv(tmc, bulk_size, hdr, header_size);
+    if (!rc && zsize)
+        rc = tcp_mgr_compress_recv_prepare(tmc, zsize, bulk_size);
+
+    return rc;
 }
 
 static int
@@ -644,15 +3366,251 @@ tcp_mgr_bulk_complete(struct tcp_mgr_connection *tmc)
     struct tcp_mgr_instance *tmi = tmc->tmc_tmi;
     NIOVA_ASSERT(tmi->tmi_recv_cb);
 
+    if (tmc->tmc_zbuf)
+    {
+        int rc = tcp_mgr_compress_recv_complete(tmc);
+        if (rc)
+            return rc;
+    }
+
     int rc =
         tcp_mgr_tmi_exec_recv_cb(tmc, tmc->tmc_bulk_buf, tmc->tmc_bulk_offset);
 
-    tcp_mgr_bulk_free(tmi, tmc->tmc_bulk_buf);
+    // The item may have been taken by the recv cb
+    tcp_mgr_connection_bulk_release(tmc);
+
+    return rc;
+}
+
+static bool
+tcp_mgr_connection_recv_buffered(const struct tcp_mgr_connection *tmc)
+{
+    const size_t size = tmc->tmc_tmi->tmi_recv_buf_size;
+    const size_t wire_size = tmc->tmc_header_size +
+        (tmc->tmc_fc_window ? sizeof(struct tcp_mgr_fc_hdr) : 0) +
+        tcp_mgr_connection_compress_hdr_size(tmc);
+
+    // Once allocated, the buffer may hold data which must be consumed first
+    return (tmc->tmc_rbuf || (size && wire_size <= size)) ? true : false;
+}
+
+/**
+ * tcp_mgr_rbuf_bulk_fill - moves the part of the bulk which was read into
+ *   the receive buffer into the bulk's destination.
+ */
+static void
+tcp_mgr_rbuf_bulk_fill(struct tcp_mgr_connection *tmc)
+{
+    const size_t len = MIN(tmc->tmc_rbuf_tail - tmc->tmc_rbuf_head,
+                           tmc->tmc_bulk_remain);
+    if (!len)
+        return;
+
+    const char *src = tmc->tmc_rbuf + tmc->tmc_rbuf_head;
+
+    if (tmc->tmc_zbuf)
+    {
+        memcpy(tmc->tmc_zbuf + tmc->tmc_zbuf_size - tmc->tmc_bulk_remain, src,
+               len);
+    }
+    else if (tmc->tmc_bulk_niovs)
+    {
+        struct iovec iovs[TCP_MGR_BULK_MAX_IOVS];
+        const size_t total =
+            niova_io_iovs_total_size_get(tmc->tmc_bulk_iovs,
+                                         tmc->tmc_bulk_niovs);
+
+        ssize_t niovs =
+            niova_io_iovs_map_consumed(tmc->tmc_bulk_iovs, iovs,
+                                       tmc->tmc_bulk_niovs,
+                                       total - tmc->tmc_bulk_remain, -1);
+        NIOVA_ASSERT(niovs > 0);
+
+        niova_io_copy_to_iovs(src, len, iovs, niovs);
+    }
+    else
+    {
+        memcpy(tmc->tmc_bulk_buf + tmc->tmc_bulk_offset, src, len);
+        tmc->tmc_bulk_offset += len;
+    }
+
+    tmc->tmc_bulk_remain -= len;
+    tmc->tmc_rbuf_head += len;
+}
+
+/**
+ * tcp_mgr_buffered_recv - reads whatever is available into the connection's
+ *   receive buffer and dispatches each complete message found there.  The
+ *   bulk of a message which does not fit into the buffer, or which is
+ *   scattered, is left pending for tcp_mgr_bulk_progress_recv() once the
+ *   buffer has been drained into it.
+ */
+static int
+tcp_mgr_buffered_recv(struct tcp_mgr_connection *tmc)
+{
+    SIMPLE_FUNC_ENTRY(LL_TRACE);
+
+    struct tcp_mgr_instance *tmi = tmc->tmc_tmi;
+    const size_t header_size = tmc->tmc_header_size;
+    const size_t fc_size =
+        tmc->tmc_fc_window ? sizeof(struct tcp_mgr_fc_hdr) : 0;
+    const size_t frame_size =
+        fc_size + tcp_mgr_connection_compress_hdr_size(tmc);
+
+    NIOVA_ASSERT(tmi->tmi_recv_cb && tmi->tmi_bulk_size_cb && header_size &&
+                 !tmc->tmc_bulk_remain);
+
+    if (!tmc->tmc_rbuf)
+    {
+        tmc->tmc_rbuf = niova_malloc_can_fail(tmi->tmi_recv_buf_size);
+        if (!tmc->tmc_rbuf)
+            return -ENOMEM;
+
+        tmc->tmc_rbuf_size = tmi->tmi_recv_buf_size;
+        tmc->tmc_rbuf_head = 0;
+        tmc->tmc_rbuf_tail = 0;
+        tmc->tmc_rbuf_bulk_size = -1;
+    }
+
+    // Move the partial message, if any, to the front of the buffer
+    if (tmc->tmc_rbuf_head)
+    {
+        memmove(tmc->tmc_rbuf, tmc->tmc_rbuf + tmc->tmc_rbuf_head,
+                tmc->tmc_rbuf_tail - tmc->tmc_rbuf_head);
+
+        tmc->tmc_rbuf_tail -= tmc->tmc_rbuf_head;
+        tmc->tmc_rbuf_head = 0;
+    }
+
+    // A partial message always fits, larger ones are moved out to the bulk
+    NIOVA_ASSERT(tmc->tmc_rbuf_tail < tmc->tmc_rbuf_size);
+
+    struct iovec iov = {
+        .iov_base = tmc->tmc_rbuf + tmc->tmc_rbuf_tail,
+        .iov_len = tmc->tmc_rbuf_size - tmc->tmc_rbuf_tail,
+    };
+
+    ssize_t rc = tcp_socket_recv(&tmc->tmc_tsh, &iov, 1, NULL, false);
+    if (rc == 0)
+        return -ENOTCONN;
+    else if (rc < 0)
+        return rc;
+
+    tmc->tmc_rbuf_tail += rc;
+
+    // Note that a recv cb which closes the connection also empties the buffer
+    while (tmc->tmc_rbuf_tail - tmc->tmc_rbuf_head >=
+           (fc_size ? fc_size : header_size))
+    {
+        char *fc_hdr = tmc->tmc_rbuf + tmc->tmc_rbuf_head;
+
+        // Grants which are not followed by a message are applied right away
+        if (fc_size && tmc->tmc_rbuf_bulk_size < 0 &&
+            tcp_mgr_fc_hdr_grant_only(fc_hdr))
+        {
+            tmc->tmc_rbuf_head += fc_size;
+            tmc->tmc_stats.tmcs_bytes_in += fc_size;
+
+            rc = tcp_mgr_fc_hdr_recv(tmc, fc_hdr);
+            if (rc < 0)
+                return rc;
+
+            continue;
+        }
+
+        if (tmc->tmc_rbuf_tail - tmc->tmc_rbuf_head < frame_size + header_size)
+            break;
+
+        char *hdr = fc_hdr + frame_size;
+
+        // The bulk size is retained while the rest of the message arrives
+        const bool new_msg = tmc->tmc_rbuf_bulk_size < 0 ? true : false;
+        if (new_msg)
+        {
+            tmc->tmc_rbuf_bulk_size =
+                tmi->tmi_bulk_size_cb(tmc, hdr, tmi->tmi_data);
+            if (tmc->tmc_rbuf_bulk_size < 0)
+                return tmc->tmc_rbuf_bulk_size;
+        }
+
+        const size_t bulk_size = tmc->tmc_rbuf_bulk_size;
+        const size_t msg_size = header_size + bulk_size;
+        size_t zsize = 0;
+
+        if (frame_size > fc_size)
+        {
+            rc = tcp_mgr_compress_hdr_recv(tmc, fc_hdr + fc_size, bulk_size,
+                                           &zsize);
+            if (rc)
+                return rc;
+        }
+
+        if (new_msg)
+            tcp_mgr_stats_recv_hdr(tmc, frame_size + header_size +
+                                   (zsize ? zsize : bulk_size), bulk_size);
+
+        // Compressed bulks are decompressed out of the buffer
+        if (!bulk_size ||
+            (!zsize && frame_size + msg_size <= tmc->tmc_rbuf_size &&
+             !tmi->tmi_bulk_iov_cb))
+        {
+            if (tmc->tmc_rbuf_tail - tmc->tmc_rbuf_head < frame_size + msg_size)
+                break;
+
+            tmc->tmc_rbuf_head += frame_size + msg_size;
+            tmc->tmc_rbuf_bulk_size = -1;
+
+            if (fc_size)
+            {
+                rc = tcp_mgr_fc_hdr_recv(tmc, fc_hdr);
+                if (rc < 0)
+                    return rc;
+            }
+
+            rc = tcp_mgr_tmi_exec_recv_cb(tmc, hdr, msg_size);
+            if (rc < 0)
+                return rc;
+
+            continue;
+        }
+
+        tmc->tmc_rbuf_head += frame_size + header_size;
+        tmc->tmc_rbuf_bulk_size = -1;
+
+        if (fc_size)
+        {
+            rc = tcp_mgr_fc_hdr_recv(tmc, fc_hdr);
+            if (rc < 0)
+                return rc;
+        }
+
+        rc = zsize ? 0 :
+            tcp_mgr_bulk_prepare_scatter(tmc, bulk_size, hdr, header_size);
+        if (!rc)
+        {
+            rc = tcp_mgr_bulk_prepare_and_recv(tmc, bulk_size, hdr,
+                                               header_size);
+            if (!rc && zsize)
+                rc = tcp_mgr_compress_recv_prepare(tmc, zsize, bulk_size);
+        }
+        if (rc < 0)
+            return rc;
+
+        tcp_mgr_rbuf_bulk_fill(tmc);
+
+        // The buffer is now empty, the rest of the bulk is read directly
+        if (tmc->tmc_bulk_remain)
+            break;
+
+        rc = tcp_mgr_bulk_complete(tmc);
+        if (rc < 0)
+            return rc;
+    }
 
-    tmc->tmc_bulk_buf = NULL;
-    tmc->tmc_bulk_offset = 0;
+    if (tmc->tmc_rbuf_head == tmc->tmc_rbuf_tail)
+        tmc->tmc_rbuf_head = tmc->tmc_rbuf_tail = 0;
 
-    return rc;
+    return 0;
 }
 
 static void
@@ -667,7 +3625,8 @@ tcp_mgr_conn_recv_inline(struct tcp_mgr_connection *tmc)
     {
         NIOVA_ASSERT(!tmc->tmc_bulk_buf);
 
-        rc = tcp_mgr_new_msg_handler(tmc);
+        rc = tcp_mgr_connection_recv_buffered(tmc) ?
+            tcp_mgr_buffered_recv(tmc) : tcp_mgr_new_msg_handler(tmc);
         if (rc == -EAGAIN) // Nothing to do on this socket
             return;
 
@@ -703,9 +3662,13 @@ tcp_mgr_conn_recv_handoff(struct tcp_mgr_connection *tmc)
     struct tcp_mgr_instance *tmi = tmc->tmc_tmi;
 
     niova_mutex_lock(&tmi->tmi_connq.tmcq_mutex);
+    /* A sender may re-arm the handle, in tcp_mgr_connection_events_apply(),
+     * after it fired but before the handoff was recorded.  The second event
+     * is dropped, the worker re-arms the handle once it is done.
+     */
     if (tmc->tmc_handoff)
     {
-        SIMPLE_LOG_MSG(LL_WARN, "tmc=%p handoff already set", tmc);
+        SIMPLE_LOG_MSG(LL_DEBUG, "tmc=%p handoff already set", tmc);
         goto out;
     }
 
@@ -713,10 +3676,12 @@ tcp_mgr_conn_recv_handoff(struct tcp_mgr_connection *tmc)
 
     SIMPLE_LOG_MSG(LL_DEBUG, "tmc=%p", tmc);
 
-    NIOVA_SET_COND_AND_WAKE_LOCKED(
-        signal,
-        { STAILQ_INSERT_TAIL(&tmi->tmi_connq.tmcq_queue, tmc, tmc_lentry); },
-        &tmi->tmi_connq.tmcq_cond);
+    niova_mutex_unlock(&tmi->tmi_connq.tmcq_mutex);
+
+    // The handle is disarmed so the tmc may be queued without the lock held
+    tcp_mgr_worker_enqueue(tmi, tmc, NULL);
+
+    return;
 
 out:
     niova_mutex_unlock(&tmi->tmi_connq.tmcq_mutex);
@@ -746,11 +3711,72 @@ tcp_mgr_recv_cb(const struct epoll_handle *eph, uint32_t events)
     struct tcp_mgr_instance *tmi = tmc->tmc_tmi;
     NIOVA_ASSERT(tmi);
 
+    // Zero-copy completions are reported through the socket's error queue
+    if ((events & EPOLLERR) && tmc->tmc_zerocopy)
+    {
+        tcp_mgr_zerocopy_reap(tmc);
+
+        // Re-arm one-shot handles which were woken only by completions
+        if (!(events & (EPOLLIN | EPOLLOUT)) &&
+            (eph->eph_events & EPOLLONESHOT))
+            tcp_mgr_connection_events_apply(tmc);
+    }
+
+    if (events & EPOLLOUT)
+    {
+        /* Handles which are about to be handed off are updated when the
+         * worker re-enables them.
+         */
+        rc = tcp_mgr_sendq_flush(tmc, !(tmi->tmi_conn_recv_handoff &&
+                                        (events & EPOLLIN)));
+        if (rc)
+        {
+            DBG_TCP_MGR_CXN(LL_NOTIFY, tmc, "tcp_mgr_sendq_flush(): %s",
+                            strerror(-rc));
+            tcp_mgr_connection_close_internal(tmc);
+            return;
+        }
+    }
+
+    if (!(events & EPOLLIN))
+        return;
+
     return tmi->tmi_conn_recv_handoff ?
         tcp_mgr_conn_recv_handoff(tmc) :
         tcp_mgr_conn_recv_inline(tmc);
 }
 
+static void
+tcp_mgr_connection_fc_setup(struct tcp_mgr_connection *tmc)
+{
+    niova_mutex_lock(&tmc->tmc_send_mutex);
+
+    tmc->tmc_fc_window = tmc->tmc_tmi->tmi_fc_credits;
+    tmc->tmc_fc_credits = tmc->tmc_fc_window;
+    tmc->tmc_fc_owed = 0;
+
+    niova_mutex_unlock(&tmc->tmc_send_mutex);
+}
+
+static void
+tcp_mgr_connection_zerocopy_setup(struct tcp_mgr_connection *tmc)
+{
+    tmc->tmc_zerocopy = 0;
+    tmc->tmc_zc_next_id = 0;
+
+    // Flow control and compression headers are sent from the stack
+    if (!tmc->tmc_tmi->tmi_zerocopy_threshold || tmc->tmc_fc_window ||
+        tmc->tmc_compress)
+        return;
+
+    int rc = tcp_socket_zerocopy_enable(&tmc->tmc_tsh);
+    if (rc)
+        DBG_TCP_MGR_CXN(LL_NOTIFY, tmc, "tcp_socket_zerocopy_enable(): %s",
+                        strerror(-rc));
+    else
+        tmc->tmc_zerocopy = 1;
+}
+
 static int
 tcp_mgr_connection_merge_incoming(struct tcp_mgr_connection *incoming,
                                   struct tcp_mgr_connection *owned)
@@ -782,10 +3808,18 @@ tcp_mgr_connection_merge_incoming(struct tcp_mgr_connection *incoming,
 
     owned->tmc_header_size = incoming->tmc_header_size;
     owned->tmc_tsh.tsh_socket = incoming->tmc_tsh.tsh_socket;
+    tcp_mgr_connection_fc_setup(owned);
+    tcp_mgr_connection_compress_setup(owned);
+    tcp_mgr_connection_zerocopy_setup(owned);
+    tcp_mgr_connection_stats_attach(owned);
     owned->tmc_status = TMCS_CONNECTED;
 
+    // The connection remains with the reactor which accepted it
+    if (tmi->tmi_epoll_pool)
+        owned->tmc_epm = tcp_mgr_connection_epm(incoming);
+
     if (incoming->tmc_eph.eph_installed)
-        epoll_handle_del(tmi->tmi_epoll_mgr, &incoming->tmc_eph);
+        epoll_handle_del(tcp_mgr_connection_epm(incoming), &incoming->tmc_eph);
 
     uint32_t events = EPOLLIN | (tmi->tmi_conn_recv_handoff ? EPOLLONESHOT : 0);
 
@@ -844,8 +3878,13 @@ tcp_mgr_handshake_cb(const struct epoll_handle *eph, uint32_t events)
         tcp_mgr_incoming_fini(tmc);
 }
 
+/**
+ * tcp_mgr_accept - accepts a connection from the listen socket 'fd'.  The
+ *   connection is placed onto 'epm', if set, otherwise onto a reactor chosen
+ *   by the instance's epoll_mgr_pool.
+ */
 static int
-tcp_mgr_accept(struct tcp_mgr_instance *tmi, int fd)
+tcp_mgr_accept(struct tcp_mgr_instance *tmi, int fd, struct epoll_mgr *epm)
 {
     SIMPLE_FUNC_ENTRY(LL_TRACE);
 
@@ -865,6 +3904,12 @@ tcp_mgr_accept(struct tcp_mgr_instance *tmi, int fd)
         return rc;
     }
 
+    if (epm)
+        tmc->tmc_epm = epm;
+    else if (tmi->tmi_epoll_pool)
+        tmc->tmc_epm = epoll_mgr_pool_select(tmi->tmi_epoll_pool,
+                                             tmc->tmc_tsh.tsh_socket);
+
     tcp_mgr_connection_epoll_add(tmc, EPOLLIN, tcp_mgr_handshake_cb, NULL);
 
     return 0;
@@ -880,11 +3925,65 @@ tcp_mgr_listen_cb(const struct epoll_handle *eph, uint32_t events)
 
     struct tcp_mgr_instance *tmi = eph->eph_arg;
 
-    int rc = tcp_mgr_accept(tmi, eph->eph_fd);
+    // Sharded listeners keep their connections on their own reactor
+    int rc = tcp_mgr_accept(tmi, eph->eph_fd,
+                            (tmi->tmi_nlisten_shards && tmi->tmi_epoll_pool) ?
+                            tmi->tmi_epoll_mgr : NULL);
+    if (rc < 0)
+        SIMPLE_LOG_MSG(LL_ERROR, "tcp_mgr_accept(): %d", rc);
+}
+
+static epoll_mgr_cb_ctx_t
+tcp_mgr_listen_shard_cb(const struct epoll_handle *eph, uint32_t events)
+{
+    SIMPLE_FUNC_ENTRY(LL_TRACE);
+    NIOVA_ASSERT(eph && eph->eph_arg);
+
+    (void)events;
+
+    struct tcp_mgr_listen_shard *tmls = eph->eph_arg;
+    struct tcp_mgr_instance *tmi = tmls->tmls_tmi;
+
+    int rc = tcp_mgr_accept(tmi, eph->eph_fd,
+                            tmi->tmi_epoll_pool ? tmls->tmls_epm : NULL);
     if (rc < 0)
         SIMPLE_LOG_MSG(LL_ERROR, "tcp_mgr_accept(): %d", rc);
 }
 
+/**
+ * tcp_mgr_listen_shards_epoll_add - installs the extra listen shards, shard
+ *   'n' is placed onto reactor 'n' of the pool, wrapping around if there are
+ *   more shards than reactors.
+ */
+static int
+tcp_mgr_listen_shards_epoll_add(struct tcp_mgr_instance *tmi)
+{
+    struct epoll_mgr_pool *emp = tmi->tmi_epoll_pool;
+
+    for (size_t i = 0; i < tmi->tmi_nlisten_shards; i++)
+    {
+        struct tcp_mgr_listen_shard *tmls = &tmi->tmi_listen_shards[i];
+
+        tmls->tmls_epm = emp ?
+            &emp->emp_epms[(i + 1) % emp->emp_nreactors] : tmi->tmi_epoll_mgr;
+
+        int rc = epoll_handle_init(&tmls->tmls_eph,
+                                   tmls->tmls_socket.tsh_socket, EPOLLIN,
+                                   tcp_mgr_listen_shard_cb, tmls, NULL);
+        if (!rc)
+            rc = epoll_handle_add(tmls->tmls_epm, &tmls->tmls_eph);
+
+        if (rc)
+        {
+            SIMPLE_LOG_MSG(LL_ERROR, "listen shard %zu: %s", i + 1,
+                           strerror(-rc));
+            return rc;
+        }
+    }
+
+    return 0;
+}
+
 /* must call sockets_setup and sockets_bind first */
 int
 tcp_mgr_epoll_setup(struct tcp_mgr_instance *tmi, struct epoll_mgr *epoll_mgr,
@@ -902,8 +4001,27 @@ tcp_mgr_epoll_setup(struct tcp_mgr_instance *tmi, struct epoll_mgr *epoll_mgr,
     int rc = epoll_handle_init(&tmi->tmi_listen_eph,
                                tmi->tmi_listen_socket.tsh_socket, EPOLLIN,
                                tcp_mgr_listen_cb, tmi, NULL);
+    if (!rc)
+        rc = epoll_handle_add(epoll_mgr, &tmi->tmi_listen_eph);
+
+    return rc ? rc : tcp_mgr_listen_shards_epoll_add(tmi);
+}
+
+/**
+ * tcp_mgr_epoll_pool_setup - spreads the instance's connections across the
+ *   reactors of 'emp'.  The listen socket is serviced by the first reactor,
+ *   listen shards by the reactors which follow it.
+ */
+int
+tcp_mgr_epoll_pool_setup(struct tcp_mgr_instance *tmi,
+                         struct epoll_mgr_pool *emp, bool tmi_listen)
+{
+    if (!tmi || !emp || !emp->emp_nreactors)
+        return -EINVAL;
+
+    tmi->tmi_epoll_pool = emp;
 
-    return rc ? rc : epoll_handle_add(epoll_mgr, &tmi->tmi_listen_eph);
+    return tcp_mgr_epoll_setup(tmi, &emp->emp_epms[0], tmi_listen);
 }
 
 static int
@@ -918,7 +4036,7 @@ tcp_mgr_connection_epoll_mod(struct tcp_mgr_connection *tmc, int op,
     if (op)
         tmc->tmc_eph.eph_events = op;
 
-    return epoll_handle_mod(tmc->tmc_tmi->tmi_epoll_mgr, &tmc->tmc_eph);
+    return epoll_handle_mod(tcp_mgr_connection_epm(tmc), &tmc->tmc_eph);
 };
 
 static int
@@ -956,7 +4074,12 @@ tcp_mgr_connect_complete(struct tcp_mgr_connection *tmc)
     }
 
     DBG_TCP_MGR_CXN(LL_DEBUG, tmc, "reinstalling epoll handler");
-    rc = tcp_mgr_connection_epoll_mod(tmc, EPOLLIN, tcp_mgr_recv_cb);
+
+    // As with incoming connections, handoff requires a one-shot handle
+    rc = tcp_mgr_connection_epoll_mod(tmc, EPOLLIN |
+                                      (tmc->tmc_tmi->tmi_conn_recv_handoff ?
+                                       EPOLLONESHOT : 0),
+                                      tcp_mgr_recv_cb);
     if (rc < 0)
     {
         DBG_TCP_MGR_CXN(LL_DEBUG, tmc, "error reinstalling epoll handler");
@@ -968,6 +4091,10 @@ tcp_mgr_connect_complete(struct tcp_mgr_connection *tmc)
         goto out;
 
     DBG_TCP_MGR_CXN(LL_NOTIFY, tmc, "connection established");
+    tcp_mgr_connection_fc_setup(tmc);
+    tcp_mgr_connection_compress_setup(tmc);
+    tcp_mgr_connection_zerocopy_setup(tmc);
+    tcp_mgr_connection_stats_attach(tmc);
     tmc->tmc_status = TMCS_CONNECTED;
     rc = 0;
 out:
@@ -1076,9 +4203,10 @@ tcp_mgr_connection_verify(struct tcp_mgr_connection *tmc,
     return -EAGAIN;
 }
 
-int
-tcp_mgr_send_msg(struct tcp_mgr_connection *tmc, struct iovec *iov,
-                 size_t niovs)
+static int
+tcp_mgr_send_msg_common(struct tcp_mgr_connection *tmc, struct iovec *iov,
+                        size_t niovs, tcp_mgr_send_done_cb_t done_cb,
+                        void *done_arg)
 {
     SIMPLE_FUNC_ENTRY(LL_TRACE);
     if (tmc->tmc_status == TMCS_NEEDS_SETUP)
@@ -1087,32 +4215,439 @@ tcp_mgr_send_msg(struct tcp_mgr_connection *tmc, struct iovec *iov,
         return -EINVAL;
     }
 
+    /* Bounds the on-stack iov arrays below and leaves room, within a single
+     * writev(), for the compression and flow control headers.
+     */
+    if (niovs > IO_MAX_IOVS - 3)
+        return -E2BIG;
+
     int rc = tcp_mgr_connection_verify(tmc, true);
     DBG_TCP_MGR_CXN(LL_DEBUG, tmc, "tcp_mgr_connection_verify(): %d", rc);
     if (rc < 0)
         return rc;
 
-    const ssize_t total_size = niova_io_iovs_total_size_get(iov, niovs);
+    ssize_t total_size = niova_io_iovs_total_size_get(iov, niovs);
+    if (!total_size || (size_t)total_size > tcp_get_max_size())
+        return -EMSGSIZE;
+
+    struct tcp_mgr_send_queue done = STAILQ_HEAD_INITIALIZER(done);
+    struct iovec cz_iovs[niovs + 2];
+    struct tcp_mgr_compress_hdr czh;
+    char *zbuf = NULL;
+
+    // Compress ahead of taking the lock
+    if (tmc->tmc_compress)
+    {
+        ssize_t cz_niovs = tcp_mgr_compress_frame(tmc, &czh, iov, niovs,
+                                                  total_size, cz_iovs, &zbuf);
+        if (cz_niovs < 0)
+            return cz_niovs;
+
+        iov = cz_iovs;
+        niovs = cz_niovs;
+        total_size = niova_io_iovs_total_size_get(iov, niovs);
+    }
+
+    struct iovec fc_iovs[niovs + 1];
+    struct tcp_mgr_fc_hdr fch;
 
     niova_mutex_lock(&tmc->tmc_send_mutex);
 
-    ssize_t send_rc = tcp_socket_send(&tmc->tmc_tsh, iov, niovs);
+    const bool fc = tmc->tmc_fc_window ? true : false;
+    if (fc)
+        total_size += sizeof(struct tcp_mgr_fc_hdr);
+
+    /* Replies to a pipelined request are held until the requests which
+     * arrived ahead of it have been processed.
+     */
+    struct tcp_mgr_pipeline_msg *tmpm = tcp_mgr_pipeline_msg_current(tmc);
+    if (tmpm && (tmpm->tmpm_orphaned ||
+                 STAILQ_FIRST(&tmc->tmc_pipeline_msgs) != tmpm))
+    {
+        struct tcp_mgr_send_buf *tmsb = NULL;
+
+        if (fc)
+        {
+            niovs = tcp_mgr_fc_frame_locked(tmc, &fch, false, iov, niovs,
+                                            fc_iovs);
+            iov = fc_iovs;
+        }
+
+        rc = tmpm->tmpm_orphaned ? -ENOTCONN :
+            tcp_mgr_send_buf_copy(iov, niovs, 0, total_size, &tmsb);
+        if (!rc)
+        {
+            tmsb->tmsb_start_usec = tcp_mgr_stats_start_usec(tmc);
+            STAILQ_INSERT_TAIL(&tmpm->tmpm_replies, tmsb, tmsb_lentry);
+            tmc->tmc_send_msgs++;
+        }
+
+        niova_mutex_unlock(&tmc->tmc_send_mutex);
+        niova_free(zbuf);
+
+        if (!rc && done_cb)
+            done_cb(tmc, done_arg, 0);
+
+        return rc;
+    }
+
+    const size_t zc_threshold = tmc->tmc_tmi->tmi_zerocopy_threshold;
+    const bool zerocopy = (done_cb && tmc->tmc_zerocopy && zc_threshold &&
+                           (size_t)total_size >= zc_threshold) ? true : false;
+    const bool cork = tmc->tmc_tmi->tmi_cork_usec ? true : false;
+
+    // Opportunistically drain the queue ahead of the new message
+    ssize_t send_rc = cork ? 0 : tcp_mgr_sendq_flush_locked(tmc, &done);
+
+    /* Apply backpressure once the queue is over its limit.  A message which
+     * is larger than the limit is still accepted by an empty queue.
+     */
+    if (!send_rc && tmc->tmc_sendq_bytes &&
+        tmc->tmc_sendq_bytes + total_size > tmc->tmc_tmi->tmi_sendq_max_bytes)
+    {
+        tmc->tmc_stats.tmcs_sendq_full++;
+
+        niova_mutex_unlock(&tmc->tmc_send_mutex);
+        niova_free(zbuf);
+
+        tcp_mgr_send_bufs_complete(tmc, &done, 0);
+
+        DBG_TCP_MGR_CXN(LL_DEBUG, tmc, "send queue full, bytes=%zu",
+                        tmc->tmc_sendq_bytes);
+        return -EAGAIN;
+    }
+
+    tmc->tmc_send_msgs++;
+
+    bool arm_epollout = false;
+    bool zc_queued = false;
+
+    // Only an uncorked message with nothing queued ahead of it is sent now
+    const bool direct = (!zerocopy && !cork && !send_rc &&
+                         STAILQ_EMPTY(&tmc->tmc_sendq) &&
+                         tcp_mgr_fc_charge_locked(tmc)) ? true : false;
+    if (fc)
+    {
+        if (!direct && !tmc->tmc_fc_credits)
+            tmc->tmc_fc_stalls++;
+
+        niovs = tcp_mgr_fc_frame_locked(tmc, &fch, direct, iov, niovs,
+                                        fc_iovs);
+        iov = fc_iovs;
+    }
+
+    if (zerocopy && !send_rc)
+    {
+        /* The message is sent from the caller's memory, behind anything
+         * which is already queued, and is not corked.
+         */
+        send_rc = tcp_mgr_sendq_append_zerocopy_locked(tmc, iov, niovs,
+                                                       total_size, done_cb,
+                                                       done_arg);
+        if (!send_rc)
+        {
+            zc_queued = true;
+            if (!tmc->tmc_sendq_pending)
+            {
+                send_rc = tcp_mgr_sendq_flush_locked(tmc, &done);
+                arm_epollout = tcp_mgr_sendq_pending_update_locked(tmc);
+            }
+        }
+    }
+    else if (cork)
+    {
+        /* Hold the message until the cork timer expires or enough data has
+         * accumulated.  Nothing is needed if EPOLLOUT is already pending.
+         */
+        send_rc = tcp_mgr_sendq_append_locked(tmc, iov, niovs, 0, total_size,
+                                              false);
+
+        if (!send_rc && !tmc->tmc_sendq_pending)
+        {
+            if (tmc->tmc_sendq_bytes >= TCP_MGR_CORK_MAX_BYTES)
+            {
+                send_rc = tcp_mgr_sendq_flush_locked(tmc, &done);
+                arm_epollout = tcp_mgr_sendq_pending_update_locked(tmc);
+            }
+            else
+            {
+                send_rc = tcp_mgr_cork_timer_arm_locked(tmc);
+            }
+        }
+    }
+    else
+    {
+        if (direct)
+        {
+            const unsigned long long start = tcp_mgr_stats_start_usec(tmc);
+
+            send_rc = tcp_socket_send_nb(&tmc->tmc_tsh, iov, niovs, false);
+            tmc->tmc_send_syscalls++;
+            if (send_rc == -EAGAIN)
+            {
+                tmc->tmc_stats.tmcs_sock_eagain++;
+                send_rc = 0;
+            }
+            else if (send_rc > 0)
+            {
+                tmc->tmc_stats.tmcs_bytes_out += send_rc;
+            }
+
+            if (send_rc == total_size)
+                tcp_mgr_stats_usec_record(tmc->tmc_stats.tmcs_send_usec_hist,
+                                          start);
+        }
+
+        if (send_rc >= 0 && send_rc < total_size)
+        {
+            send_rc = tcp_mgr_sendq_append_locked(tmc, iov, niovs, send_rc,
+                                                  total_size, direct);
+            if (!send_rc)
+                arm_epollout = tcp_mgr_sendq_pending_update_locked(tmc);
+        }
+    }
 
     niova_mutex_unlock(&tmc->tmc_send_mutex);
+    niova_free(zbuf);
+
+    tcp_mgr_send_bufs_complete(tmc, &done, 0);
 
-    if (send_rc != total_size)
+    if (send_rc < 0)
     {
-        DBG_TCP_MGR_CXN(LL_WARN, tmc,
-                        "tcp_socket_send(): returns=%zd, expected=%zd",
-                        send_rc, total_size);
+        DBG_TCP_MGR_CXN(LL_WARN, tmc, "send failed: %s", strerror(-send_rc));
         tcp_mgr_connection_close(tmc);
+
+        // A queued zero-copy message is completed by the close
+        return zc_queued ? 0 : send_rc;
     }
 
+    if (arm_epollout)
+        tcp_mgr_connection_events_apply(tmc);
+
+    // The data has been copied so the caller's memory may be reused
+    if (done_cb && !zerocopy)
+        done_cb(tmc, done_arg, 0);
+
     return rc;
 }
 
+int
+tcp_mgr_send_msg(struct tcp_mgr_connection *tmc, struct iovec *iov,
+                 size_t niovs)
+{
+    return tcp_mgr_send_msg_common(tmc, iov, niovs, NULL, NULL);
+}
+
+/**
+ * tcp_mgr_send_msg_zc - sends the message with MSG_ZEROCOPY if zero-copy is
+ *   enabled on the connection and the message meets the instance's threshold,
+ *   otherwise the message is sent as with tcp_mgr_send_msg().  The memory
+ *   referenced by 'iov' must not be modified until 'done_cb' has been issued,
+ *   which happens exactly once if 0 is returned.  The callback is issued
+ *   from the epm thread, or the calling thread if the data was copied, and a
+ *   negative status indicates the message may not have been delivered.
+ */
+int
+tcp_mgr_send_msg_zc(struct tcp_mgr_connection *tmc, struct iovec *iov,
+                    size_t niovs, tcp_mgr_send_done_cb_t done_cb,
+                    void *done_arg)
+{
+    if (!done_cb)
+        return -EINVAL;
+
+    else if (niovs > TCP_MGR_SENDQ_FLUSH_IOVS)
+        return -E2BIG;
+
+    return tcp_mgr_send_msg_common(tmc, iov, niovs, done_cb, done_arg);
+}
+
+int
+tcp_mgr_stripe_init(struct tcp_mgr_stripe *tms,
+                    enum tcp_mgr_stripe_order order)
+{
+    if (!tms || (order != TCP_MGR_STRIPE_ORDER_NONE &&
+                 order != TCP_MGR_STRIPE_ORDER_KEY))
+        return -EINVAL;
+
+    memset(tms, 0, sizeof(*tms));
+    tms->tms_order = order;
+
+    return 0;
+}
+
+/**
+ * tcp_mgr_stripe_conn_add - adds a connection, which has been set up with
+ *   tcp_mgr_connection_setup(), to the stripe.  Connections may not be
+ *   removed and, with TCP_MGR_STRIPE_ORDER_KEY, should all be added before
+ *   the first send so that each key keeps its connection.
+ */
+int
+tcp_mgr_stripe_conn_add(struct tcp_mgr_stripe *tms,
+                        struct tcp_mgr_connection *tmc)
+{
+    if (!tms || !tmc)
+        return -EINVAL;
+
+    else if (tms->tms_nconns >= TCP_MGR_STRIPE_MAX_CONNS)
+        return -E2BIG;
+
+    tms->tms_conns[tms->tms_nconns++] = tmc;
+
+    return 0;
+}
+
+/**
+ * tcp_mgr_stripe_select - returns the connection for a message with 'key'.
+ *   Unordered messages go to the connected tmc with the least queued data,
+ *   the search starts from a rotating index to spread ties, or to the next
+ *   tmc in turn if none are connected so that it may be connected by the
+ *   send.  The queue sizes are read without the send mutex and are only a
+ *   hint.
+ */
+struct tcp_mgr_connection *
+tcp_mgr_stripe_select(struct tcp_mgr_stripe *tms, uint64_t key)
+{
+    if (!tms || !tms->tms_nconns)
+        return NULL;
+
+    const size_t nconns = tms->tms_nconns;
+
+    if (tms->tms_order == TCP_MGR_STRIPE_ORDER_KEY)
+        return tms->tms_conns[key % nconns];
+
+    const size_t start = (uint32_t)niova_atomic_inc(&tms->tms_next) % nconns;
+    struct tcp_mgr_connection *best = NULL;
+
+    for (size_t i = 0; i < nconns; i++)
+    {
+        struct tcp_mgr_connection *tmc = tms->tms_conns[(start + i) % nconns];
+
+        if (tmc->tmc_status == TMCS_CONNECTED &&
+            (!best || tmc->tmc_sendq_bytes < best->tmc_sendq_bytes))
+            best = tmc;
+    }
+
+    return best ? best : tms->tms_conns[start];
+}
+
+int
+tcp_mgr_stripe_send_msg(struct tcp_mgr_stripe *tms, uint64_t key,
+                        struct iovec *iov, size_t niovs)
+{
+    struct tcp_mgr_connection *tmc = tcp_mgr_stripe_select(tms, key);
+
+    return tmc ? tcp_mgr_send_msg(tmc, iov, niovs) : -EINVAL;
+}
+
+/**
+ * tcp_mgr_stripe_send_split - divides the payload described by 'iov' into
+ *   chunks of at least 'min_chunk' bytes, one per connection at most, whose
+ *   sizes differ by no more than a byte.  Each is sent, behind the header
+ *   supplied by 'hdr_cb', on its own connection.  The header memory may be
+ *   reused once the next call to 'hdr_cb' is made.  On error, including
+ *   -EAGAIN from a full send queue, chunks which were already sent are not
+ *   recalled and the caller should resend the payload as a whole.
+ */
+int
+tcp_mgr_stripe_send_split(struct tcp_mgr_stripe *tms,
+                          const struct iovec *iov, size_t niovs,
+                          size_t min_chunk, tcp_mgr_stripe_hdr_cb_t hdr_cb,
+                          void *arg)
+{
+    if (!tms || !tms->tms_nconns || !iov || !niovs || !hdr_cb)
+        return -EINVAL;
+
+    else if (niovs > TCP_MGR_STRIPE_MAX_IOVS)
+        return -E2BIG;
+
+    const size_t total = niova_io_iovs_total_size_get(iov, niovs);
+    if (!total)
+        return -EINVAL;
+
+    const size_t nchunks =
+        MAX(1UL, MIN(tms->tms_nconns, total / MAX(1UL, min_chunk)));
+    const size_t start = (uint32_t)niova_atomic_inc(&tms->tms_next);
+
+    for (size_t i = 0, offset = 0; i < nchunks; i++)
+    {
+        // Spread the remainder so that no chunk comes out empty
+        const size_t len = total * (i + 1) / nchunks - offset;
+
+        // The first iov carries the caller's header
+        struct iovec iovs[TCP_MGR_STRIPE_MAX_IOVS + 1];
+
+        int rc = hdr_cb(arg, i, nchunks, offset, len, &iovs[0]);
+        if (rc)
+            return rc;
+
+        ssize_t chunk_niovs = niova_io_iovs_map_consumed(iov, &iovs[1], niovs,
+                                                         offset, len);
+        if (chunk_niovs <= 0)
+            return chunk_niovs ? chunk_niovs : -EINVAL;
+
+        rc = tcp_mgr_send_msg(tms->tms_conns[(start + i) % tms->tms_nconns],
+                              iovs, chunk_niovs + 1);
+        if (rc)
+            return rc;
+
+        offset += len;
+    }
+
+    return 0;
+}
+
+int
+tcp_mgr_stripe_reasm_init(struct tcp_mgr_stripe_reasm *tmsr, char *buf,
+                          size_t size)
+{
+    if (!tmsr || !buf || !size)
+        return -EINVAL;
+
+    tmsr->tmsr_buf = buf;
+    tmsr->tmsr_size = size;
+    niova_atomic_init(&tmsr->tmsr_received, 0);
+
+    return 0;
+}
+
+/**
+ * tcp_mgr_stripe_reasm_add - records the arrival of a chunk, copying it into
+ *   place unless 'data' is NULL, which indicates that the chunk was received
+ *   in place.  Chunks may be added concurrently from different connections.
+ *   Returns 1 once the whole payload has arrived, 0 if more is expected.
+ */
+int
+tcp_mgr_stripe_reasm_add(struct tcp_mgr_stripe_reasm *tmsr, size_t offset,
+                         const char *data, size_t len)
+{
+    if (!tmsr || !len)
+        return -EINVAL;
+
+    else if (offset > tmsr->tmsr_size || len > tmsr->tmsr_size - offset)
+        return -ERANGE;
+
+    if (data)
+        memcpy(tmsr->tmsr_buf + offset, data, len);
+
+    const long long received = niova_atomic_add(&tmsr->tmsr_received, len);
+
+    // A chunk was delivered more than once
+    if ((size_t)received > tmsr->tmsr_size)
+        return -EOVERFLOW;
+
+    return (size_t)received == tmsr->tmsr_size ? 1 : 0;
+}
+
 void
 tcp_mgr_connection_close(struct tcp_mgr_connection *tmc)
 {
     tcp_mgr_connection_epoll_ctx_run(tmc, tcp_mgr_connection_close_internal);
 };
+
+static init_ctx_t NIOVA_CONSTRUCTOR(TCP_MGR_CTOR_PRIORITY)
+tcp_mgr_ctor(void)
+{
+    LREG_ROOT_ENTRY_INSTALL(tcp_mgr_nodes);
+
+    return;
+}
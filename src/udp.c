@@ -4,6 +4,7 @@
  * Written by Paul Nowoczynski <pauln@niova.io> 2020
  */
 
+#define _GNU_SOURCE
 #include <fcntl.h>
 
 #include "log.h"
@@ -277,3 +278,162 @@ udp_socket_send(const struct udp_socket_handle *ush, const struct iovec *iov,
 
     return rc ? rc : (ssize_t)total_sent;
 }
+
+static int
+udp_socket_batch_prepare(struct udp_socket_batch_msg *msgs,
+                         struct mmsghdr *mmsgs, size_t nmsgs)
+{
+    for (size_t i = 0; i < nmsgs; i++)
+    {
+        struct udp_socket_batch_msg *usbm = &msgs[i];
+
+        if (!usbm->usbm_iov || !usbm->usbm_iovlen)
+            return -EINVAL;
+        else if (usbm->usbm_iovlen > IO_MAX_IOVS)
+            return -E2BIG;
+
+        const size_t total_size =
+            niova_io_iovs_total_size_get(usbm->usbm_iov, usbm->usbm_iovlen);
+        if (!total_size || !udp_iov_size_ok(total_size))
+            return -EMSGSIZE;
+
+        mmsgs[i].msg_hdr = (struct msghdr) {
+            .msg_name = &usbm->usbm_addr,
+            .msg_namelen = sizeof(usbm->usbm_addr),
+            .msg_iov = usbm->usbm_iov,
+            .msg_iovlen = usbm->usbm_iovlen,
+        };
+        mmsgs[i].msg_len = 0;
+
+        usbm->usbm_len = 0;
+    }
+
+    return 0;
+}
+
+/**
+ * udp_socket_recv_batch - receives up to 'nmsgs' datagrams with a single
+ *    recvmmsg().  When 'block' is set the call waits for the first datagram
+ *    only, those which follow are taken if they have already arrived.
+ *    Returns the number of datagrams received or a negative errno.
+ */
+ssize_t
+udp_socket_recv_batch(const struct udp_socket_handle *ush,
+                      struct udp_socket_batch_msg *msgs, size_t nmsgs,
+                      bool block)
+{
+    SIMPLE_FUNC_ENTRY(LL_TRACE);
+
+    if (!ush || !msgs || !nmsgs)
+        return -EINVAL;
+    else if (nmsgs > UDP_SOCKET_BATCH_MAX)
+        return -E2BIG;
+
+    struct mmsghdr mmsgs[nmsgs];
+
+    ssize_t rc = udp_socket_batch_prepare(msgs, mmsgs, nmsgs);
+    if (rc)
+        return rc;
+
+    rc = recvmmsg(ush->ush_socket, mmsgs, nmsgs,
+                  block ? MSG_WAITFORONE : MSG_DONTWAIT, NULL);
+    if (rc < 0)
+    {
+        rc = -errno;
+        SIMPLE_LOG_MSG(((rc == -EINTR ||
+                         (!block && (rc == -EAGAIN || rc == -EWOULDBLOCK))) ?
+                        LL_DEBUG : LL_WARN),
+                       "recvmmsg(): %s", strerror(-rc));
+        return rc;
+    }
+
+    for (ssize_t i = 0; i < rc; i++)
+    {
+        if (mmsgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+        {
+            /* Partial msg recv.
+             */
+            SIMPLE_LOG_MSG(LL_WARN, "recvmmsg(): msg %zd: %u (MSG_TRUNC)",
+                           i, mmsgs[i].msg_len);
+
+            msgs[i].usbm_len = -EBADMSG;
+        }
+        else
+        {
+            msgs[i].usbm_len = mmsgs[i].msg_len;
+        }
+    }
+
+    SIMPLE_LOG_MSG(LL_DEBUG, "nmsgs=%zd of %zu", rc, nmsgs);
+
+    return rc;
+}
+
+ssize_t
+udp_socket_recv_batch_fd(int fd, struct udp_socket_batch_msg *msgs,
+                         size_t nmsgs, bool block)
+{
+    struct udp_socket_handle ush = {
+        .ush_socket = fd,
+        .ush_port = 0,
+        .ush_ipaddr = "0.0.0.0",
+    };
+
+    return udp_socket_recv_batch(&ush, msgs, nmsgs, block);
+}
+
+/**
+ * udp_socket_send_batch - sends each datagram in 'msgs' to its usbm_addr
+ *    with as few sendmmsg() calls as possible.  Returns the number of
+ *    datagrams sent or a negative errno if none were.  Should sendmmsg() fail
+ *    part way through the batch, the number sent so far is returned and the
+ *    error is placed into the usbm_len of the first datagram not sent.
+ */
+ssize_t
+udp_socket_send_batch(const struct udp_socket_handle *ush,
+                      struct udp_socket_batch_msg *msgs, size_t nmsgs)
+{
+    SIMPLE_FUNC_ENTRY(LL_TRACE);
+
+    if (!ush || !msgs || !nmsgs)
+        return -EINVAL;
+    else if (nmsgs > UDP_SOCKET_BATCH_MAX)
+        return -E2BIG;
+
+    struct mmsghdr mmsgs[nmsgs];
+
+    ssize_t rc = udp_socket_batch_prepare(msgs, mmsgs, nmsgs);
+    if (rc)
+        return rc;
+
+    size_t nsent = 0;
+    while (nsent < nmsgs)
+    {
+        rc = sendmmsg(ush->ush_socket, &mmsgs[nsent], nmsgs - nsent, 0);
+        if (rc < 0)
+        {
+            if (errno == EINTR) // retry the send.
+                continue;
+
+            rc = -errno;
+
+            const struct sockaddr_in *to = &msgs[nsent].usbm_addr;
+            LOG_MSG(LL_NOTIFY, "sendmmsg() %s:%u (%zu of %zu): %s",
+                    inet_ntoa(to->sin_addr), ntohs(to->sin_port), nsent,
+                    nmsgs, strerror(-rc));
+
+            msgs[nsent].usbm_len = rc;
+            break;
+        }
+
+        for (size_t i = nsent; i < nsent + rc; i++)
+            msgs[i].usbm_len = mmsgs[i].msg_len;
+
+        nsent += rc;
+
+        SIMPLE_LOG_MSG(LL_DEBUG, "sendmmsg(): rc=%zd total=(%zu:%zu)", rc,
+                       nsent, nmsgs);
+    }
+
+    return nsent ? (ssize_t)nsent : rc;
+}
@@ -0,0 +1,223 @@
+/* Copyright (C) NIOVA Systems, Inc - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "log.h"
+#include "uring.h"
+
+static int
+niova_uring_sys_setup(unsigned int entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int
+niova_uring_sys_enter(int fd, unsigned int to_submit,
+                      unsigned int min_complete, unsigned int flags,
+                      void *arg, size_t argsz)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                        flags, arg, argsz);
+}
+
+void
+niova_uring_close(struct niova_uring *nur)
+{
+    if (!nur)
+        return;
+
+    if (nur->nur_sqes && nur->nur_sqes != MAP_FAILED)
+        munmap(nur->nur_sqes, nur->nur_sqes_sz);
+
+    if (nur->nur_cq_ring && nur->nur_cq_ring != MAP_FAILED &&
+        nur->nur_cq_ring != nur->nur_sq_ring)
+        munmap(nur->nur_cq_ring, nur->nur_cq_ring_sz);
+
+    if (nur->nur_sq_ring && nur->nur_sq_ring != MAP_FAILED)
+        munmap(nur->nur_sq_ring, nur->nur_sq_ring_sz);
+
+    if (nur->nur_fd >= 0)
+        close(nur->nur_fd);
+
+    memset(nur, 0, sizeof(*nur));
+    nur->nur_fd = -1;
+}
+
+/**
+ * niova_uring_setup - creates the ring and maps the submission and
+ *   completion queues.  Kernels lacking IORING_FEAT_EXT_ARG (< 5.11) are
+ *   rejected since waiting with a timeout depends on it.
+ */
+int
+niova_uring_setup(struct niova_uring *nur, unsigned int entries)
+{
+    if (!nur || !entries)
+        return -EINVAL;
+
+    memset(nur, 0, sizeof(*nur));
+
+    struct io_uring_params p = {0};
+
+    nur->nur_fd = niova_uring_sys_setup(entries, &p);
+    if (nur->nur_fd < 0)
+    {
+        int rc = -errno;
+        SIMPLE_LOG_MSG(LL_NOTIFY, "io_uring_setup(): %s", strerror(-rc));
+        nur->nur_fd = -1;
+        return rc;
+    }
+
+    nur->nur_features = p.features;
+
+    if (!(p.features & IORING_FEAT_EXT_ARG) ||
+        !(p.features & IORING_FEAT_NODROP))
+    {
+        SIMPLE_LOG_MSG(LL_NOTIFY, "io_uring features=%x are insufficient",
+                       p.features);
+        niova_uring_close(nur);
+        return -EOPNOTSUPP;
+    }
+
+    nur->nur_sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    nur->nur_cq_ring_sz =
+        p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        nur->nur_sq_ring_sz = nur->nur_cq_ring_sz =
+            MAX(nur->nur_sq_ring_sz, nur->nur_cq_ring_sz);
+
+    nur->nur_sq_ring = mmap(NULL, nur->nur_sq_ring_sz, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, nur->nur_fd,
+                            IORING_OFF_SQ_RING);
+    if (nur->nur_sq_ring == MAP_FAILED)
+        goto error;
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        nur->nur_cq_ring = nur->nur_sq_ring;
+    }
+    else
+    {
+        nur->nur_cq_ring = mmap(NULL, nur->nur_cq_ring_sz,
+                                PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, nur->nur_fd,
+                                IORING_OFF_CQ_RING);
+        if (nur->nur_cq_ring == MAP_FAILED)
+            goto error;
+    }
+
+    nur->nur_sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+    nur->nur_sqes = mmap(NULL, nur->nur_sqes_sz, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, nur->nur_fd,
+                         IORING_OFF_SQES);
+    if (nur->nur_sqes == MAP_FAILED)
+        goto error;
+
+    char *sq = nur->nur_sq_ring;
+    char *cq = nur->nur_cq_ring;
+
+    nur->nur_sq_khead = (unsigned int *)(sq + p.sq_off.head);
+    nur->nur_sq_ktail = (unsigned int *)(sq + p.sq_off.tail);
+    nur->nur_sq_mask = *(unsigned int *)(sq + p.sq_off.ring_mask);
+    nur->nur_sq_entries = *(unsigned int *)(sq + p.sq_off.ring_entries);
+    nur->nur_sq_tail = *nur->nur_sq_ktail;
+
+    // SQEs are always consumed in order so the index array is static
+    unsigned int *sq_array = (unsigned int *)(sq + p.sq_off.array);
+    for (unsigned int i = 0; i < nur->nur_sq_entries; i++)
+        sq_array[i] = i;
+
+    nur->nur_cq_khead = (unsigned int *)(cq + p.cq_off.head);
+    nur->nur_cq_ktail = (unsigned int *)(cq + p.cq_off.tail);
+    nur->nur_cq_mask = *(unsigned int *)(cq + p.cq_off.ring_mask);
+    nur->nur_cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    return 0;
+
+error:
+    {
+        int rc = -errno;
+        SIMPLE_LOG_MSG(LL_WARN, "mmap(): %s", strerror(-rc));
+        niova_uring_close(nur);
+        return rc;
+    }
+}
+
+/**
+ * niova_uring_get_sqe - returns the next free SQE or NULL if the submission
+ *   queue is full.  The SQE is made visible to the kernel, once it has been
+ *   filled, with niova_uring_sqe_commit().  Callers must serialize access.
+ */
+struct io_uring_sqe *
+niova_uring_get_sqe(struct niova_uring *nur)
+{
+    if (niova_uring_sq_pending(nur) >= nur->nur_sq_entries)
+    {
+        // Attempt to make room before giving up
+        niova_uring_submit(nur);
+        if (niova_uring_sq_pending(nur) >= nur->nur_sq_entries)
+            return NULL;
+    }
+
+    return &nur->nur_sqes[nur->nur_sq_tail & nur->nur_sq_mask];
+}
+
+void
+niova_uring_sqe_commit(struct niova_uring *nur)
+{
+    nur->nur_sq_tail++;
+    __atomic_store_n(nur->nur_sq_ktail, nur->nur_sq_tail, __ATOMIC_RELEASE);
+}
+
+/**
+ * niova_uring_enter - submits up to 'to_submit' committed SQEs and waits for
+ *   'min_complete' completions.  A negative 'timeout_ms' waits indefinitely.
+ *   Returns the number of SQEs consumed by the kernel or a negative errno.  A
+ *   timeout is not treated as an error.
+ */
+int
+niova_uring_enter(struct niova_uring *nur, unsigned int to_submit,
+                  unsigned int min_complete, int timeout_ms)
+{
+    if (!nur || nur->nur_fd < 0)
+        return -EBADF;
+
+    unsigned int flags = 0;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg = {
+        .sigmask = 0,
+        .sigmask_sz = _NSIG / 8,
+        .ts = 0,
+    };
+
+    if (min_complete)
+    {
+        flags |= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+        if (timeout_ms >= 0)
+        {
+            ts.tv_sec = timeout_ms / 1000;
+            ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+            arg.ts = (uint64_t)(uintptr_t)&ts;
+        }
+    }
+
+    int rc = niova_uring_sys_enter(nur->nur_fd, to_submit, min_complete, flags,
+                                   min_complete ? &arg : NULL,
+                                   min_complete ? sizeof(arg) : 0);
+
+    if (rc < 0)
+    {
+        rc = -errno;
+        if (rc == -ETIME)
+            rc = 0;
+    }
+
+    return rc;
+}
@@ -63,6 +63,29 @@ fill_bh(unsigned int start_bit, unsigned int num_buckets)
 //    dump_hist(&bh);
 }
 
+static void
+to_string_tests(void)
+{
+    struct binary_hist bh;
+    char buf[64];
+
+    NIOVA_ASSERT(!binary_hist_init(&bh, 0, 10));
+
+    binary_hist_to_string(&bh, buf, sizeof(buf));
+    NIOVA_ASSERT(!strcmp(buf, ""));
+
+    binary_hist_incorporate_val(&bh, 0);
+    binary_hist_incorporate_val(&bh, 5);
+    binary_hist_incorporate_val(&bh, 6);
+
+    binary_hist_to_string(&bh, buf, sizeof(buf));
+    NIOVA_ASSERT(!strcmp(buf, "0:1 4:2"));
+
+    // Output is truncated to the buffer
+    binary_hist_to_string(&bh, buf, 4);
+    NIOVA_ASSERT(!strcmp(buf, "0:1"));
+}
+
 static void
 postive_tests(void)
 {
@@ -71,6 +94,8 @@ postive_tests(void)
     fill_bh(1, 1);
     fill_bh(1, 10);
     fill_bh(13, 19);
+
+    to_string_tests();
 }
 
 int
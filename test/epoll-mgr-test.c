@@ -10,6 +10,7 @@
 #include "niova_backtrace.h"
 
 #include "common.h"
+#include "binary_hist.h"
 #include "epoll_mgr.h"
 #include "ev_pipe.h"
 #include "log.h"
@@ -26,6 +27,7 @@ enum epm_mgr_test_threads
 };
 
 static struct thread_ctl epmThreads[EPM__MAX];
+static enum epoll_mgr_backend epmTestBackend = EPOLL_MGR_BACKEND_EPOLL;
 
 struct epm_test_handle
 {
@@ -278,8 +280,8 @@ epoll_mgr_multi_thread_tests(void)
     struct epoll_mgr *epm = calloc(1UL, sizeof(struct epoll_mgr));
     FATAL_IF(!epm, "calloc(): ENOMEM");
 
-    int rc = epoll_mgr_setup(epm);
-    FATAL_IF(rc, "epoll_mgr_setup(): %s", strerror(-rc));
+    int rc = epoll_mgr_setup_backend(epm, epmTestBackend);
+    FATAL_IF(rc, "epoll_mgr_setup_backend(): %s", strerror(-rc));
 
     rc = thread_create(epoll_mgr_test_thread_mgr, &epmThreads[EPM_MGR],
                        "epm-test-mgr", epm, NULL);
@@ -334,14 +336,16 @@ epoll_mgr_basic_tests(void)
     FATAL_IF(rc != -EINVAL,
              "epoll_mgr_setup() expected to return -EINVAL (rc=%d)", rc);
 
-    rc = epoll_mgr_setup(epm);
+    rc = epoll_mgr_setup_backend(epm, epmTestBackend);
 
     // Check epm conditions following setup
-    FATAL_IF(rc, "epoll_mgr_setup(): %s", strerror(-rc));
+    FATAL_IF(rc, "epoll_mgr_setup_backend(): %s", strerror(-rc));
+    FATAL_IF(epm->epm_backend != epmTestBackend, "epm_backend invalid");
     FATAL_IF(!epm->epm_ready, "epm_ready invalid");
     FATAL_IF(epm->epm_epfd < 0, "epm_epfd invalid");
-    FATAL_IF(!CIRCLEQ_EMPTY(&epm->epm_active_list), "active list not empty");
-    FATAL_IF(!CIRCLEQ_EMPTY(&epm->epm_destroy_list), "destroy list not empty");
+    FATAL_IF(epm->epm_num_handles, "epm_num_handles is not 0 (%d)",
+             epm->epm_num_handles);
+    FATAL_IF(epm->epm_cmd_head, "command queue not empty");
 
     // > 1 setup should fail
     rc = epoll_mgr_setup(epm);
@@ -732,6 +736,491 @@ epoll_mgr_context_tests(void)
     SIMPLE_FUNC_EXIT(LL_TRACE);
 }
 
+#define EPM_POOL_TEST_NREACTORS 4
+#define EPM_POOL_TEST_NHANDLES 8
+
+static niova_atomic32_t epmPoolTestCnt;
+
+static void
+epoll_mgr_pool_test_cb(const struct epoll_handle *eph, uint32_t events)
+{
+    (void)events;
+
+    uint64_t val;
+    if (read(eph->eph_fd, &val, sizeof(val)) == sizeof(val))
+        niova_atomic_add(&epmPoolTestCnt, (int)val);
+}
+
+static void
+epoll_mgr_pool_test_wait(int expected)
+{
+    for (int i = 0; i < 1000 && niova_atomic_read(&epmPoolTestCnt) < expected;
+         i++)
+        usleep(1000);
+
+    FATAL_IF(niova_atomic_read(&epmPoolTestCnt) != expected,
+             "expected %d events, got %d", expected,
+             niova_atomic_read(&epmPoolTestCnt));
+}
+
+static void
+epoll_mgr_pool_tests(void)
+{
+    struct epoll_mgr_pool emp = {0};
+    struct epoll_handle ephs[EPM_POOL_TEST_NHANDLES];
+    struct epoll_mgr *epms[EPM_POOL_TEST_NHANDLES];
+    uint64_t one = 1;
+
+    int rc = epoll_mgr_pool_setup(&emp, 0, EPOLL_MGR_POOL_POLICY_HASH, false);
+    FATAL_IF(rc != -EINVAL, "epoll_mgr_pool_setup() expected -EINVAL got %d",
+             rc);
+
+    rc = epoll_mgr_pool_setup(&emp, EPM_POOL_TEST_NREACTORS,
+                              EPOLL_MGR_POOL_POLICY_LEAST_LOADED, true);
+    FATAL_IF(rc, "epoll_mgr_pool_setup(): %s", strerror(-rc));
+
+    for (int i = 0; i < EPM_POOL_TEST_NHANDLES; i++)
+    {
+        int fd = eventfd(0, EFD_NONBLOCK);
+        FATAL_IF(fd < 0, "eventfd(): %s", strerror(errno));
+
+        rc = epoll_handle_init(&ephs[i], fd, EPOLLIN, epoll_mgr_pool_test_cb,
+                               NULL, NULL);
+        FATAL_IF(rc, "epoll_handle_init() expected 0 got %d", rc);
+
+        rc = epoll_mgr_pool_handle_add(&emp, &ephs[i], &epms[i]);
+        FATAL_IF(rc, "epoll_mgr_pool_handle_add() expected 0 got %d", rc);
+    }
+
+    // Least-loaded placement should spread the handles evenly
+    for (size_t i = 0; i < EPM_POOL_TEST_NREACTORS; i++)
+        FATAL_IF(emp.emp_epms[i].epm_num_handles !=
+                 EPM_POOL_TEST_NHANDLES / EPM_POOL_TEST_NREACTORS,
+                 "reactor %zu has %d handles", i,
+                 emp.emp_epms[i].epm_num_handles);
+
+    for (int i = 0; i < EPM_POOL_TEST_NHANDLES; i++)
+        FATAL_IF(write(ephs[i].eph_fd, &one, sizeof(one)) != sizeof(one),
+                 "write(): %s", strerror(errno));
+
+    epoll_mgr_pool_test_wait(EPM_POOL_TEST_NHANDLES);
+
+    // Move the first handle to another reactor and ensure it still fires
+    struct epoll_mgr *dst = epms[0] == &emp.emp_epms[0] ?
+        &emp.emp_epms[1] : &emp.emp_epms[0];
+
+    rc = epoll_handle_migrate(epms[0], dst, &ephs[0]);
+    FATAL_IF(rc, "epoll_handle_migrate() expected 0 got %d", rc);
+    FATAL_IF(!ephs[0].eph_installed, "migrated handle is not installed");
+    epms[0] = dst;
+
+    FATAL_IF(write(ephs[0].eph_fd, &one, sizeof(one)) != sizeof(one),
+             "write(): %s", strerror(errno));
+
+    epoll_mgr_pool_test_wait(EPM_POOL_TEST_NHANDLES + 1);
+
+    rc = epoll_mgr_pool_destroy(&emp);
+    FATAL_IF(rc != -EBUSY, "epoll_mgr_pool_destroy() expected -EBUSY got %d",
+             rc);
+
+    for (int i = 0; i < EPM_POOL_TEST_NHANDLES; i++)
+    {
+        int fd = ephs[i].eph_fd;
+
+        rc = epoll_handle_del(epms[i], &ephs[i]);
+        FATAL_IF(rc, "epoll_handle_del() expected 0 got %d", rc);
+
+        close(fd);
+    }
+
+    rc = epoll_mgr_pool_destroy(&emp);
+    FATAL_IF(rc, "epoll_mgr_pool_destroy() expected 0 got %d", rc);
+}
+
+static void
+epoll_mgr_busy_poll_tests(void)
+{
+    struct epoll_mgr epm = {0};
+    struct epoll_handle eph;
+    uint64_t one = 1;
+
+    int rc = epoll_mgr_setup_backend(&epm, epmTestBackend);
+    FATAL_IF(rc, "epoll_mgr_setup_backend(): %s", strerror(-rc));
+
+    FATAL_IF(!epm.epm_lrn, "epm is not installed in the registry");
+
+    rc = epoll_mgr_busy_poll_set(&epm, EPOLL_MGR_BUSY_POLL_MAX_USEC + 1);
+    FATAL_IF(rc != -EINVAL, "epoll_mgr_busy_poll_set() expected -EINVAL got %d",
+             rc);
+
+    rc = epoll_mgr_busy_poll_set(&epm, 1000);
+    FATAL_IF(rc, "epoll_mgr_busy_poll_set() expected 0 got %d", rc);
+
+    int fd = eventfd(0, EFD_NONBLOCK);
+    FATAL_IF(fd < 0, "eventfd(): %s", strerror(errno));
+
+    rc = epoll_handle_init(&eph, fd, EPOLLIN, epoll_mgr_pool_test_cb, NULL,
+                           NULL);
+    FATAL_IF(rc, "epoll_handle_init() expected 0 got %d", rc);
+
+    rc = epoll_handle_add(&epm, &eph);
+    FATAL_IF(rc, "epoll_handle_add() expected 0 got %d", rc);
+
+    // A pending event is found by spinning
+    FATAL_IF(write(fd, &one, sizeof(one)) != sizeof(one), "write(): %s",
+             strerror(errno));
+
+    rc = epoll_mgr_wait_and_process_events(&epm, 100);
+    FATAL_IF(rc != 1, "epoll_mgr_wait_and_process_events() expected 1 got %d",
+             rc);
+    FATAL_IF(epm.epm_busy_poll_hits != 1, "busy-poll-hits=%llu",
+             epm.epm_busy_poll_hits);
+
+    // With no events the budget is spent before blocking
+    rc = epoll_mgr_wait_and_process_events(&epm, 10);
+    FATAL_IF(rc, "epoll_mgr_wait_and_process_events() expected 0 got %d", rc);
+    FATAL_IF(epm.epm_busy_poll_misses != 1, "busy-poll-misses=%llu",
+             epm.epm_busy_poll_misses);
+    FATAL_IF(!epm.epm_busy_poll_spin_usec, "busy-poll-spin-usec is 0");
+
+    rc = epoll_handle_del(&epm, &eph);
+    FATAL_IF(rc, "epoll_handle_del() expected 0 got %d", rc);
+    close(fd);
+
+    rc = epoll_mgr_close(&epm);
+    FATAL_IF(rc, "epoll_mgr_close() expected 0 got %d", rc);
+    FATAL_IF(epm.epm_lrn, "epm was not removed from the registry");
+}
+
+#define EPM_TIMER_TEST_NTIMERS 256
+#define EPM_TIMER_TEST_REARMS 3
+
+struct epm_timer_test
+{
+    struct epoll_mgr_timer ett_timer;
+    unsigned long long     ett_deadline_usec;
+    int                    ett_fired;
+};
+
+static struct epoll_mgr epmTimerTestEpm;
+
+static unsigned long long
+epoll_mgr_timer_test_now_usec(void)
+{
+    struct timespec now;
+    niova_unstable_clock(&now);
+
+    return timespec_2_usec(&now);
+}
+
+static void
+epoll_mgr_timer_test_arm(struct epm_timer_test *ett, unsigned long long usec)
+{
+    ett->ett_deadline_usec = epoll_mgr_timer_test_now_usec() + usec;
+
+    int rc = epoll_mgr_timer_arm(&epmTimerTestEpm, &ett->ett_timer, usec);
+    FATAL_IF(rc, "epoll_mgr_timer_arm(): %s", strerror(-rc));
+}
+
+static void
+epoll_mgr_timer_test_cb(struct epoll_mgr_timer *emt, void *arg)
+{
+    struct epm_timer_test *ett = arg;
+
+    NIOVA_ASSERT(emt == &ett->ett_timer);
+    NIOVA_ASSERT(!epoll_mgr_timer_is_armed(emt));
+    FATAL_IF(epoll_mgr_timer_test_now_usec() < ett->ett_deadline_usec,
+             "timer %p fired early", emt);
+
+    ett->ett_fired++;
+}
+
+static void
+epoll_mgr_timer_test_rearm_cb(struct epoll_mgr_timer *emt, void *arg)
+{
+    struct epm_timer_test *ett = arg;
+
+    epoll_mgr_timer_test_cb(emt, arg);
+
+    if (ett->ett_fired < EPM_TIMER_TEST_REARMS)
+        epoll_mgr_timer_test_arm(ett, 2000);
+}
+
+static void
+epoll_mgr_timer_tests(void)
+{
+    static struct epm_timer_test etts[EPM_TIMER_TEST_NTIMERS];
+    struct epm_timer_test canceled = {0};
+    struct epm_timer_test periodic = {0};
+    struct epm_timer_test distant = {0};
+
+    memset(etts, 0, sizeof(etts));
+
+    int rc = epoll_mgr_setup_backend(&epmTimerTestEpm, epmTestBackend);
+    FATAL_IF(rc, "epoll_mgr_setup_backend(): %s", strerror(-rc));
+
+    rc = epoll_mgr_timer_cancel(&epmTimerTestEpm, &canceled.ett_timer);
+    FATAL_IF(rc != -ENOENT, "epoll_mgr_timer_cancel() expected -ENOENT got %d",
+             rc);
+
+    // Spread the timers across the lower two levels of the wheel
+    for (int i = 0; i < EPM_TIMER_TEST_NTIMERS; i++)
+    {
+        epoll_mgr_timer_init(&etts[i].ett_timer, epoll_mgr_timer_test_cb,
+                             &etts[i]);
+        epoll_mgr_timer_test_arm(&etts[i], (i % 150) * 1000 + i);
+    }
+
+    epoll_mgr_timer_init(&canceled.ett_timer, epoll_mgr_timer_test_cb,
+                         &canceled);
+    epoll_mgr_timer_test_arm(&canceled, 10000);
+
+    epoll_mgr_timer_init(&periodic.ett_timer, epoll_mgr_timer_test_rearm_cb,
+                         &periodic);
+    epoll_mgr_timer_test_arm(&periodic, 2000);
+
+    // Beyond the range of the wheel
+    epoll_mgr_timer_init(&distant.ett_timer, epoll_mgr_timer_test_cb,
+                         &distant);
+    epoll_mgr_timer_test_arm(&distant, 365ULL * 24 * 3600 * 1000000);
+
+    // Rescheduling an armed timer replaces its expiration
+    epoll_mgr_timer_test_arm(&etts[0], 20000);
+
+    rc = epoll_mgr_timer_cancel(&epmTimerTestEpm, &canceled.ett_timer);
+    FATAL_IF(rc, "epoll_mgr_timer_cancel() expected 0 got %d", rc);
+    FATAL_IF(epoll_mgr_timer_is_armed(&canceled.ett_timer),
+             "canceled timer is still armed");
+
+    rc = epoll_mgr_close(&epmTimerTestEpm);
+    FATAL_IF(rc != -EBUSY, "epoll_mgr_close() expected -EBUSY got %d", rc);
+
+    const unsigned long long end = epoll_mgr_timer_test_now_usec() + 2000000;
+    bool done = false;
+
+    while (!done && epoll_mgr_timer_test_now_usec() < end)
+    {
+        rc = epoll_mgr_wait_and_process_events(&epmTimerTestEpm, 100);
+        FATAL_IF(rc < 0 && rc != -EINTR,
+                 "epoll_mgr_wait_and_process_events(): %s", strerror(-rc));
+
+        done = periodic.ett_fired == EPM_TIMER_TEST_REARMS;
+        for (int i = 0; i < EPM_TIMER_TEST_NTIMERS && done; i++)
+            done = etts[i].ett_fired ? true : false;
+    }
+
+    for (int i = 0; i < EPM_TIMER_TEST_NTIMERS; i++)
+        FATAL_IF(etts[i].ett_fired != 1, "timer %d fired %d times", i,
+                 etts[i].ett_fired);
+
+    FATAL_IF(periodic.ett_fired != EPM_TIMER_TEST_REARMS,
+             "periodic timer fired %d times", periodic.ett_fired);
+    FATAL_IF(canceled.ett_fired, "canceled timer fired");
+    FATAL_IF(distant.ett_fired, "distant timer fired");
+
+    rc = epoll_mgr_timer_cancel(&epmTimerTestEpm, &distant.ett_timer);
+    FATAL_IF(rc, "epoll_mgr_timer_cancel() expected 0 got %d", rc);
+
+    rc = epoll_mgr_close(&epmTimerTestEpm);
+    FATAL_IF(rc, "epoll_mgr_close() expected 0 got %d", rc);
+}
+
+#define EPM_AUTOSIZE_TEST_NHANDLES 300
+
+static void
+epoll_mgr_events_autosize_tests(void)
+{
+    static struct epoll_handle ephs[EPM_AUTOSIZE_TEST_NHANDLES];
+    struct epoll_mgr epm = {0};
+    uint64_t one = 1;
+
+    int rc = epoll_mgr_setup_backend(&epm, epmTestBackend);
+    FATAL_IF(rc, "epoll_mgr_setup_backend(): %s", strerror(-rc));
+    FATAL_IF(epm.epm_events_size != EPOLL_MGR_DEF_EVENTS,
+             "epm_events_size=%d", epm.epm_events_size);
+
+    for (int i = 0; i < EPM_AUTOSIZE_TEST_NHANDLES; i++)
+    {
+        int fd = eventfd(0, EFD_NONBLOCK);
+        FATAL_IF(fd < 0, "eventfd(): %s", strerror(errno));
+
+        rc = epoll_handle_init(&ephs[i], fd, EPOLLIN, foo_cb, NULL, NULL);
+        FATAL_IF(rc, "epoll_handle_init() expected 0 got %d", rc);
+
+        rc = epoll_handle_add(&epm, &ephs[i]);
+        FATAL_IF(rc, "epoll_handle_add() expected 0 got %d", rc);
+
+        // Leave the handles readable so that every wait returns a full batch
+        FATAL_IF(write(fd, &one, sizeof(one)) != sizeof(one), "write(): %s",
+                 strerror(errno));
+    }
+
+    for (int i = 0; i < 4; i++)
+    {
+        rc = epoll_mgr_wait_and_process_events(&epm, 0);
+        FATAL_IF(rc <= 0, "epoll_mgr_wait_and_process_events(): %d", rc);
+    }
+
+    // Growth stops once the array covers the handles
+    FATAL_IF(epm.epm_events_size < EPM_AUTOSIZE_TEST_NHANDLES ||
+             epm.epm_events_size >= EPM_AUTOSIZE_TEST_NHANDLES * 2,
+             "epm_events_size=%d", epm.epm_events_size);
+    FATAL_IF(!epm.epm_events_full_cnt, "no full batches were observed");
+
+    for (int i = 0; i < EPM_AUTOSIZE_TEST_NHANDLES; i++)
+    {
+        int fd = ephs[i].eph_fd;
+
+        rc = epoll_handle_del(&epm, &ephs[i]);
+        FATAL_IF(rc, "epoll_handle_del() expected 0 got %d", rc);
+
+        close(fd);
+    }
+
+    for (int i = 0; i < 1024; i++)
+    {
+        rc = epoll_mgr_wait_and_process_events(&epm, 0);
+        FATAL_IF(rc < 0, "epoll_mgr_wait_and_process_events(): %d", rc);
+    }
+
+    FATAL_IF(epm.epm_events_size != EPOLL_MGR_MIN_EVENTS,
+             "epm_events_size=%d", epm.epm_events_size);
+
+    rc = epoll_mgr_close(&epm);
+    FATAL_IF(rc, "epoll_mgr_close() expected 0 got %d", rc);
+}
+
+static void
+epoll_mgr_profiling_tests(void)
+{
+    struct epoll_mgr epm = {0};
+    struct epoll_handle ephs[2];
+    uint64_t one = 1;
+
+    int rc = epoll_mgr_setup_backend(&epm, epmTestBackend);
+    FATAL_IF(rc, "epoll_mgr_setup_backend(): %s", strerror(-rc));
+    FATAL_IF(epm.epm_profiling, "profiling should be off by default");
+
+    for (int i = 0; i < 2; i++)
+    {
+        // Only the second handle is added while profiling is enabled
+        if (i)
+            epoll_mgr_profiling_set(&epm, true);
+
+        int fd = eventfd(0, EFD_NONBLOCK);
+        FATAL_IF(fd < 0, "eventfd(): %s", strerror(errno));
+
+        rc = epoll_handle_init(&ephs[i], fd, EPOLLIN, foo_cb, NULL, NULL);
+        FATAL_IF(rc, "epoll_handle_init() expected 0 got %d", rc);
+
+        rc = epoll_handle_add(&epm, &ephs[i]);
+        FATAL_IF(rc, "epoll_handle_add() expected 0 got %d", rc);
+
+        FATAL_IF(write(fd, &one, sizeof(one)) != sizeof(one), "write(): %s",
+                 strerror(errno));
+    }
+
+    FATAL_IF(ephs[0].eph_stats, "unexpected stats on the first handle");
+    FATAL_IF(!ephs[1].eph_stats, "no stats on the second handle");
+    FATAL_IF(epm.epm_prof_nused != 1, "epm_prof_nused=%zu",
+             epm.epm_prof_nused);
+
+    rc = epoll_mgr_wait_and_process_events(&epm, 0);
+    FATAL_IF(rc != 2, "epoll_mgr_wait_and_process_events(): %d", rc);
+
+    FATAL_IF(binary_hist_is_empty(epm.epm_loop_hist),
+             "loop histogram is empty");
+
+    for (int i = 0; i < 2; i++)
+    {
+        int fd = ephs[i].eph_fd;
+
+        rc = epoll_handle_del(&epm, &ephs[i]);
+        FATAL_IF(rc, "epoll_handle_del() expected 0 got %d", rc);
+        FATAL_IF(ephs[i].eph_stats, "stats remain after removal");
+
+        close(fd);
+    }
+
+    FATAL_IF(epm.epm_prof_nused, "epm_prof_nused=%zu", epm.epm_prof_nused);
+
+    rc = epoll_mgr_close(&epm);
+    FATAL_IF(rc, "epoll_mgr_close() expected 0 got %d", rc);
+}
+
+#define EPM_WAKE_TEST_NHANDLES 8
+
+static int epmWakeTestCbCnt;
+
+static void
+epm_wake_test_ref_cb(void *arg, enum epoll_handle_ref_op op)
+{
+    (void)arg;
+    (void)op;
+}
+
+static void
+epm_wake_test_ctx_cb(void *arg)
+{
+    int *cnt = arg;
+    (*cnt)++;
+}
+
+static void
+epoll_mgr_wake_coalesce_tests(void)
+{
+    struct epoll_handle ephs[EPM_WAKE_TEST_NHANDLES];
+    struct epoll_mgr epm = {0};
+
+    int rc = epoll_mgr_setup_backend(&epm, epmTestBackend);
+    FATAL_IF(rc, "epoll_mgr_setup_backend(): %s", strerror(-rc));
+
+    for (int i = 0; i < EPM_WAKE_TEST_NHANDLES; i++)
+    {
+        int fd = eventfd(0, EFD_NONBLOCK);
+        FATAL_IF(fd < 0, "eventfd(): %s", strerror(errno));
+
+        rc = epoll_handle_init(&ephs[i], fd, EPOLLIN, foo_cb,
+                               &epmWakeTestCbCnt, epm_wake_test_ref_cb);
+        FATAL_IF(rc, "epoll_handle_init() expected 0 got %d", rc);
+
+        rc = epoll_handle_add(&epm, &ephs[i]);
+        FATAL_IF(rc, "epoll_handle_add() expected 0 got %d", rc);
+    }
+
+    // The epm thread has not run yet so each callback is queued
+    epmWakeTestCbCnt = 0;
+    for (int i = 0; i < EPM_WAKE_TEST_NHANDLES; i++)
+    {
+        rc = epoll_mgr_ctx_cb_add(&epm, &ephs[i], epm_wake_test_ctx_cb);
+        FATAL_IF(rc, "epoll_mgr_ctx_cb_add() expected 0 got %d", rc);
+    }
+
+    FATAL_IF(epm.epm_wakeups != 1, "epm_wakeups=%llu", epm.epm_wakeups);
+    FATAL_IF(epm.epm_wakeups_suppressed != EPM_WAKE_TEST_NHANDLES - 1,
+             "epm_wakeups_suppressed=%llu", epm.epm_wakeups_suppressed);
+
+    rc = epoll_mgr_wait_and_process_events(&epm, 0);
+    FATAL_IF(rc != 1, "epoll_mgr_wait_and_process_events(): %d", rc);
+
+    FATAL_IF(epmWakeTestCbCnt != EPM_WAKE_TEST_NHANDLES,
+             "epmWakeTestCbCnt=%d", epmWakeTestCbCnt);
+    FATAL_IF(epm.epm_wake_pending, "doorbell was not cleared");
+
+    for (int i = 0; i < EPM_WAKE_TEST_NHANDLES; i++)
+    {
+        int fd = ephs[i].eph_fd;
+
+        rc = epoll_handle_del(&epm, &ephs[i]);
+        FATAL_IF(rc, "epoll_handle_del() expected 0 got %d", rc);
+
+        close(fd);
+    }
+
+    rc = epoll_mgr_close(&epm);
+    FATAL_IF(rc, "epoll_mgr_close() expected 0 got %d", rc);
+}
+
 int
 main(void)
 {
@@ -741,4 +1230,33 @@ main(void)
     epoll_mgr_basic_tests();
     epoll_mgr_multi_thread_tests();
     epoll_mgr_context_tests();
+    epoll_mgr_pool_tests();
+    epoll_mgr_timer_tests();
+    epoll_mgr_busy_poll_tests();
+    epoll_mgr_events_autosize_tests();
+    epoll_mgr_profiling_tests();
+    epoll_mgr_wake_coalesce_tests();
+
+    // Repeat the basic and multi-threaded tests with the io_uring backend
+    struct epoll_mgr epm = {0};
+    if (epoll_mgr_setup_backend(&epm, EPOLL_MGR_BACKEND_IO_URING))
+    {
+        SIMPLE_LOG_MSG(LL_WARN, "io_uring is unavailable, skipping");
+        return 0;
+    }
+    epoll_mgr_close(&epm);
+
+    epmTestBackend = EPOLL_MGR_BACKEND_IO_URING;
+    destructor_cnt = 0;
+    memset(epmThreads, 0, sizeof(epmThreads));
+
+    epoll_mgr_basic_tests();
+    epoll_mgr_multi_thread_tests();
+    epoll_mgr_timer_tests();
+    epoll_mgr_busy_poll_tests();
+    epoll_mgr_events_autosize_tests();
+    epoll_mgr_profiling_tests();
+    epoll_mgr_wake_coalesce_tests();
+
+    return 0;
 }
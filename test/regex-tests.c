@@ -56,6 +56,16 @@ static const struct regex_item ipTests[] = {
     {"256.1.1.1", false},
 };
 
+static const struct regex_item netAddrTests[] = {
+    {"127.0.0.1", true},
+    {"256.1.1.1", false},
+    {"unix:/var/run/niova/peer.sock", true},
+    {"unix:/", false},
+    {"unix:peer.sock", false},
+    {"unix:/var/run/niova peer.sock", false},
+    {"tcp:/var/run/niova/peer.sock", false},
+};
+
 static const struct regex_item rncuiTests[] = {
     {"0d6ac28e-d278-11ea-9638-90324b2d1e89:0:0:0:0", true},
     {"0d6ac28e-d278-11ea-9638-90324b2d1e89:122:0:0:1", true},
@@ -103,6 +113,7 @@ static const struct regex_item raftChkptDirnameTests[] = {
 static const struct regex_test regexTests[] = {
     {RNCUI_V0_REGEX_BASE, rncuiTests, ARRAY_SIZE(rncuiTests)},
     {IPADDR_REGEX, ipTests, ARRAY_SIZE(ipTests)},
+    {NET_ADDR_REGEX, netAddrTests, ARRAY_SIZE(netAddrTests)},
     {PMDB_TEST_CLIENT_APPLY_CMD_REGEX, pmdbApplyCmdTests,
      ARRAY_SIZE(pmdbApplyCmdTests)},
     {COMMA_DELIMITED_UNSIGNED_INTEGER, commaIntegerTests,
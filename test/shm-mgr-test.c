@@ -0,0 +1,508 @@
+/* Copyright (C) NIOVA Systems, Inc - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "epoll_mgr.h"
+#include "log.h"
+#include "shm_mgr.h"
+
+#define SHM_MGR_TEST_RING_SIZE  SHM_MGR_RING_MIN_SIZE
+#define SHM_MGR_TEST_ARENA_SIZE (256UL * 1024)
+#define SHM_MGR_TEST_HANDSHAKE  "shm-mgr-test"
+#define SHM_MGR_TEST_NMSGS      10000
+
+static struct epoll_mgr smtEpm;
+static struct shm_mgr_instance smtServer;
+static struct shm_mgr_instance smtClient;
+static struct shm_mgr_connection smtServerConn;
+static struct shm_mgr_connection smtClientConn;
+
+static size_t smtServerRecvd;
+static size_t smtClientRecvd;
+static bool smtEcho;
+
+static char smtAddr[64];
+
+static void
+shm_mgr_test_pattern_fill(char *buf, size_t size, size_t seed)
+{
+    for (size_t i = 0; i < size; i++)
+        buf[i] = (char)((seed + i) * 7);
+}
+
+static void
+shm_mgr_test_pattern_check(const char *buf, size_t size, size_t seed)
+{
+    for (size_t i = 0; i < size; i++)
+        FATAL_IF(buf[i] != (char)((seed + i) * 7),
+                 "mismatch at %zu of %zu (seed=%zu)", i, size, seed);
+}
+
+/**
+ * Messages carry their sequence number in the first word, which seeds the
+ * pattern of the remainder.
+ */
+static size_t
+shm_mgr_test_msg_check(const char *buf, size_t size)
+{
+    size_t seq;
+
+    NIOVA_ASSERT(size >= sizeof(seq));
+    memcpy(&seq, buf, sizeof(seq));
+
+    shm_mgr_test_pattern_check(buf + sizeof(seq), size - sizeof(seq), seq);
+
+    return seq;
+}
+
+static int
+shm_mgr_test_send(struct shm_mgr_connection *smc, char *buf, size_t size,
+                  size_t seq)
+{
+    memcpy(buf, &seq, sizeof(seq));
+    shm_mgr_test_pattern_fill(buf + sizeof(seq), size - sizeof(seq), seq);
+
+    struct iovec iov[2] = {
+        {.iov_base = buf, .iov_len = size / 2},
+        {.iov_base = buf + size / 2, .iov_len = size - size / 2},
+    };
+
+    return shm_mgr_send_msg(smc, iov, 2);
+}
+
+static int
+shm_mgr_test_server_recv_cb(struct shm_mgr_connection *smc, char *buf,
+                            size_t size, void *data)
+{
+    NIOVA_ASSERT(smc == &smtServerConn && data == &smtServer);
+
+    size_t seq = shm_mgr_test_msg_check(buf, size);
+    FATAL_IF(seq != smtServerRecvd, "seq=%zu expected %zu", seq,
+             smtServerRecvd);
+
+    smtServerRecvd++;
+
+    // Reply from the epm thread, in place from the sender's buffer
+    if (smtEcho)
+    {
+        struct iovec iov = {.iov_base = buf, .iov_len = size};
+        int rc = shm_mgr_send_msg(smc, &iov, 1);
+        FATAL_IF(rc, "shm_mgr_send_msg(): %s", strerror(-rc));
+    }
+
+    return 0;
+}
+
+static int
+shm_mgr_test_client_recv_cb(struct shm_mgr_connection *smc, char *buf,
+                            size_t size, void *data)
+{
+    NIOVA_ASSERT(smc == &smtClientConn && data == &smtClient);
+
+    size_t seq = shm_mgr_test_msg_check(buf, size);
+    FATAL_IF(seq != smtClientRecvd, "seq=%zu expected %zu", seq,
+             smtClientRecvd);
+
+    smtClientRecvd++;
+
+    return 0;
+}
+
+static int
+shm_mgr_test_accept_cb(void *data, struct shm_mgr_connection **smc,
+                       const void *handshake, size_t handshake_size)
+{
+    NIOVA_ASSERT(data == &smtServer);
+
+    if (handshake_size != sizeof(SHM_MGR_TEST_HANDSHAKE) ||
+        memcmp(handshake, SHM_MGR_TEST_HANDSHAKE, handshake_size))
+        return -EBADMSG;
+
+    shm_mgr_connection_setup(&smtServerConn, &smtServer);
+    *smc = &smtServerConn;
+
+    return 0;
+}
+
+static void
+shm_mgr_test_pump(bool (*done)(void))
+{
+    for (int i = 0; i < 1000 && !done(); i++)
+        epoll_mgr_wait_and_process_events(&smtEpm, 10);
+
+    FATAL_IF(!done(), "timed out");
+}
+
+static bool
+shm_mgr_test_server_connected(void)
+{
+    return shm_mgr_connection_is_connected(&smtServerConn);
+}
+
+static bool
+shm_mgr_test_server_disconnected(void)
+{
+    return !shm_mgr_connection_is_connected(&smtServerConn);
+}
+
+static size_t smtExpected;
+
+static bool
+shm_mgr_test_all_recvd(void)
+{
+    return (smtServerRecvd == smtExpected &&
+            (!smtEcho || smtClientRecvd == smtExpected)) ? true : false;
+}
+
+static void
+shm_mgr_test_setup(void)
+{
+    snprintf(smtAddr, sizeof(smtAddr), "unix:/tmp/shm-mgr-test.%d.sock",
+             getpid());
+
+    int rc = epoll_mgr_setup(&smtEpm);
+    FATAL_IF(rc, "epoll_mgr_setup(): %s", strerror(-rc));
+
+    rc = shm_mgr_setup(&smtServer, &smtEpm, &smtServer,
+                       shm_mgr_test_server_recv_cb, shm_mgr_test_accept_cb);
+    FATAL_IF(rc, "shm_mgr_setup(): %s", strerror(-rc));
+
+    rc = shm_mgr_setup(&smtClient, &smtEpm, &smtClient,
+                       shm_mgr_test_client_recv_cb, NULL);
+    FATAL_IF(rc, "shm_mgr_setup(): %s", strerror(-rc));
+
+    NIOVA_ASSERT(shm_mgr_sizes_set(&smtClient, 3000, 1 << 20) == -EINVAL);
+    rc = shm_mgr_sizes_set(&smtClient, SHM_MGR_TEST_RING_SIZE,
+                           SHM_MGR_TEST_ARENA_SIZE);
+    FATAL_IF(rc, "shm_mgr_sizes_set(): %s", strerror(-rc));
+
+    NIOVA_ASSERT(shm_mgr_listen(&smtServer, "127.0.0.1") == -EAFNOSUPPORT);
+    rc = shm_mgr_listen(&smtServer, smtAddr);
+    FATAL_IF(rc, "shm_mgr_listen(): %s", strerror(-rc));
+}
+
+static void
+shm_mgr_test_connect(const char *handshake, size_t handshake_size)
+{
+    shm_mgr_connection_setup(&smtClientConn, &smtClient);
+
+    int rc = shm_mgr_connect(&smtClientConn, smtAddr, handshake,
+                             handshake_size);
+    FATAL_IF(rc, "shm_mgr_connect(): %s", strerror(-rc));
+
+    NIOVA_ASSERT(shm_mgr_connection_is_connected(&smtClientConn));
+}
+
+/**
+ * shm_mgr_test_bad_handshake - the server rejects the connection, which the
+ *   client notices through the socket.
+ */
+static void
+shm_mgr_test_bad_handshake(void)
+{
+    const char bad[] = "nope";
+
+    shm_mgr_test_connect(bad, sizeof(bad));
+
+    for (int i = 0;
+         i < 1000 && shm_mgr_connection_is_connected(&smtClientConn); i++)
+        epoll_mgr_wait_and_process_events(&smtEpm, 10);
+
+    NIOVA_ASSERT(!shm_mgr_connection_is_connected(&smtClientConn));
+    NIOVA_ASSERT(!shm_mgr_connection_is_connected(&smtServerConn));
+
+    char buf[64];
+    NIOVA_ASSERT(shm_mgr_test_send(&smtClientConn, buf, sizeof(buf), 0) ==
+                 -ENOTCONN);
+}
+
+static bool
+shm_mgr_test_disconnected(void)
+{
+    return (!shm_mgr_connection_is_connected(&smtClientConn) &&
+            !shm_mgr_connection_is_connected(&smtServerConn)) ? true : false;
+}
+
+static bool
+shm_mgr_test_none_pending(void)
+{
+    return LIST_EMPTY(&smtServer.smi_pending) ? true : false;
+}
+
+/**
+ * shm_mgr_test_raw_connect - connects a plain socket to the server, which
+ *   sends no handshake.  Returns the socket or a negative errno.
+ */
+static int
+shm_mgr_test_raw_connect(void)
+{
+    struct sockaddr_un sun = {.sun_family = AF_UNIX};
+
+    strncpy(sun.sun_path, smtAddr + TCP_UNIX_ADDR_PREFIX_LEN,
+            sizeof(sun.sun_path) - 1);
+
+    int s = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    FATAL_IF(s < 0, "socket(): %s", strerror(errno));
+
+    if (connect(s, (struct sockaddr *)&sun, sizeof(sun)))
+    {
+        int rc = -errno;
+        close(s);
+
+        return rc;
+    }
+
+    return s;
+}
+
+/**
+ * shm_mgr_test_silent_client - a client which never sends its handshake
+ *   does not hold up the epm.  The server drops it once the handshake
+ *   timeout passes.
+ */
+static void
+shm_mgr_test_silent_client(void)
+{
+    int s = shm_mgr_test_raw_connect();
+    FATAL_IF(s < 0, "shm_mgr_test_raw_connect(): %s", strerror(-s));
+
+    for (int i = 0; i < 1000 && shm_mgr_test_none_pending(); i++)
+        epoll_mgr_wait_and_process_events(&smtEpm, 10);
+
+    NIOVA_ASSERT(!shm_mgr_test_none_pending());
+
+    // Served while the silent client is still pending
+    shm_mgr_test_connect(SHM_MGR_TEST_HANDSHAKE,
+                         sizeof(SHM_MGR_TEST_HANDSHAKE));
+    shm_mgr_test_pump(shm_mgr_test_server_connected);
+    NIOVA_ASSERT(!shm_mgr_test_none_pending());
+
+    shm_mgr_connection_close(&smtClientConn);
+    shm_mgr_test_pump(shm_mgr_test_disconnected);
+
+    // The server closes the socket
+    char c;
+    ssize_t rc;
+    for (int i = 0; i < 1000 && (rc = recv(s, &c, 1, 0)) < 0; i++)
+        epoll_mgr_wait_and_process_events(&smtEpm, 10);
+
+    FATAL_IF(rc, "recv(): rc=%zd %s", rc, strerror(errno));
+    NIOVA_ASSERT(shm_mgr_test_none_pending());
+
+    close(s);
+}
+
+static void *
+shm_mgr_test_backlog_drain(void *arg)
+{
+    int *listen_fd = arg;
+
+    usleep(50 * 1000);
+
+    int s = accept(*listen_fd, NULL, NULL);
+    FATAL_IF(s < 0, "accept(): %s", strerror(errno));
+
+    close(s);
+
+    return NULL;
+}
+
+/**
+ * shm_mgr_test_backlog - while the server's backlog is full the client's
+ *   connect is retried, here until another thread makes room.
+ */
+static void
+shm_mgr_test_backlog(void)
+{
+    int socks[64];
+    size_t nsocks = 0;
+    int s;
+
+    while ((s = shm_mgr_test_raw_connect()) >= 0)
+    {
+        NIOVA_ASSERT(nsocks < ARRAY_SIZE(socks));
+        socks[nsocks++] = s;
+    }
+    FATAL_IF(s != -EAGAIN, "shm_mgr_test_raw_connect(): %s", strerror(-s));
+
+    pthread_t thread;
+    int rc = pthread_create(&thread, NULL, shm_mgr_test_backlog_drain,
+                            &smtServer.smi_listen_socket.tsh_socket);
+    FATAL_IF(rc, "pthread_create(): %s", strerror(rc));
+
+    shm_mgr_test_connect(SHM_MGR_TEST_HANDSHAKE,
+                         sizeof(SHM_MGR_TEST_HANDSHAKE));
+
+    pthread_join(thread, NULL);
+
+    // The raw sockets are accepted, then dropped as they close
+    for (size_t i = 0; i < nsocks; i++)
+        close(socks[i]);
+
+    shm_mgr_test_pump(shm_mgr_test_server_connected);
+    shm_mgr_test_pump(shm_mgr_test_none_pending);
+
+    shm_mgr_connection_close(&smtClientConn);
+    shm_mgr_test_pump(shm_mgr_test_disconnected);
+}
+
+/**
+ * shm_mgr_test_bad_entry - an inline entry whose message size would wrap
+ *   the bounds check is rejected and the connection is closed.  This relies
+ *   on the entry layout: the message size is the 64-bit word at offset 8 of
+ *   the first entry in the ring.
+ */
+static void
+shm_mgr_test_bad_entry(void)
+{
+    char buf[64];
+
+    shm_mgr_test_connect(SHM_MGR_TEST_HANDSHAKE,
+                         sizeof(SHM_MGR_TEST_HANDSHAKE));
+    shm_mgr_test_pump(shm_mgr_test_server_connected);
+
+    smtServerRecvd = 0;
+    smtEcho = false;
+
+    int rc = shm_mgr_test_send(&smtClientConn, buf, sizeof(buf), 0);
+    FATAL_IF(rc, "shm_mgr_test_send(): %s", strerror(-rc));
+
+    const uint64_t msg_size = UINT64_MAX - 15;
+    memcpy(smtClientConn.smc_tx.smr_data + 8, &msg_size, sizeof(msg_size));
+
+    shm_mgr_test_pump(shm_mgr_test_disconnected);
+    NIOVA_ASSERT(!smtServerRecvd);
+}
+
+/**
+ * shm_mgr_test_exchange - sends inline and bulk messages, which the server
+ *   echoes, until the rings wrap several times.
+ */
+static void
+shm_mgr_test_exchange(void)
+{
+    const size_t sizes[] = {8, 100, 4000, 16 * 1024, 100 * 1024, 777};
+    char *buf = malloc(SHM_MGR_TEST_ARENA_SIZE);
+    NIOVA_ASSERT(buf);
+
+    smtServerRecvd = smtClientRecvd = 0;
+    smtEcho = true;
+
+    for (size_t seq = 0; seq < 600; seq++)
+    {
+        int rc = shm_mgr_test_send(&smtClientConn, buf,
+                                   sizes[seq % ARRAY_SIZE(sizes)], seq);
+        FATAL_IF(rc, "shm_mgr_test_send(): %s", strerror(-rc));
+
+        smtExpected = seq + 1;
+        shm_mgr_test_pump(shm_mgr_test_all_recvd);
+    }
+
+    NIOVA_ASSERT(smtClientConn.smc_send_bulk > 0);
+
+    // Larger than half of the arena
+    NIOVA_ASSERT(shm_mgr_test_send(&smtClientConn, buf,
+                                   SHM_MGR_TEST_ARENA_SIZE / 2 + 1, 0) ==
+                 -EMSGSIZE);
+
+    // Fill the ring without letting the server run
+    smtEcho = false;
+    smtServerRecvd = 0;
+
+    size_t nsent = 0;
+    int rc;
+    while (!(rc = shm_mgr_test_send(&smtClientConn, buf, 1000, nsent)))
+        nsent++;
+
+    NIOVA_ASSERT(rc == -EAGAIN && nsent > 0);
+    NIOVA_ASSERT(smtClientConn.smc_send_full == 1);
+
+    smtExpected = nsent;
+    shm_mgr_test_pump(shm_mgr_test_all_recvd);
+
+    free(buf);
+}
+
+static void *
+shm_mgr_test_sender(void *arg)
+{
+    char buf[2048];
+    (void)arg;
+
+    for (size_t seq = 0; seq < SHM_MGR_TEST_NMSGS; seq++)
+    {
+        int rc;
+        while ((rc = shm_mgr_test_send(&smtClientConn, buf,
+                                       64 + (seq % 1900), seq)) == -EAGAIN)
+            usleep(10);
+
+        FATAL_IF(rc, "shm_mgr_test_send(): %s", strerror(-rc));
+    }
+
+    return NULL;
+}
+
+/**
+ * shm_mgr_test_threaded - the client sends from its own thread while the
+ *   server consumes in the epm thread, relying on the doorbell to wake it.
+ */
+static void
+shm_mgr_test_threaded(void)
+{
+    pthread_t thread;
+
+    smtServerRecvd = 0;
+    smtEcho = false;
+    smtExpected = SHM_MGR_TEST_NMSGS;
+
+    int rc = pthread_create(&thread, NULL, shm_mgr_test_sender, NULL);
+    FATAL_IF(rc, "pthread_create(): %s", strerror(rc));
+
+    for (int i = 0; i < 10000 && !shm_mgr_test_all_recvd(); i++)
+        epoll_mgr_wait_and_process_events(&smtEpm, 10);
+
+    pthread_join(thread, NULL);
+
+    FATAL_IF(!shm_mgr_test_all_recvd(), "recvd %zu of %zu",
+             smtServerRecvd, smtExpected);
+}
+
+int
+main(void)
+{
+    shm_mgr_test_setup();
+
+    shm_mgr_test_bad_handshake();
+    shm_mgr_test_silent_client();
+    shm_mgr_test_backlog();
+    shm_mgr_test_bad_entry();
+
+    shm_mgr_test_connect(SHM_MGR_TEST_HANDSHAKE,
+                         sizeof(SHM_MGR_TEST_HANDSHAKE));
+    shm_mgr_test_pump(shm_mgr_test_server_connected);
+
+    shm_mgr_test_exchange();
+    shm_mgr_test_threaded();
+
+    // Closing one side closes the other through the socket
+    shm_mgr_connection_close(&smtClientConn);
+    NIOVA_ASSERT(!shm_mgr_connection_is_connected(&smtClientConn));
+    shm_mgr_test_pump(shm_mgr_test_server_disconnected);
+
+    shm_mgr_close(&smtServer);
+    shm_mgr_close(&smtClient);
+
+    NIOVA_ASSERT(access(smtAddr + TCP_UNIX_ADDR_PREFIX_LEN, F_OK));
+
+    epoll_mgr_close(&smtEpm);
+
+    return 0;
+}
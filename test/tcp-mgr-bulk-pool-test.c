@@ -0,0 +1,83 @@
+/* Copyright (C) NIOVA Systems, Inc - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "log.h"
+#include "tcp-mgr-test-fixture.h"
+
+// Pooled bulks of odd numbered messages are taken by tmi_recv_cb
+static struct buffer_item *tmbptTaken[8];
+static size_t tmbptNtaken;
+
+static int
+tcp_mgr_bulk_pool_test_recv_cb(struct tcp_mgr_connection *tmc, char *buf,
+                               size_t size, void *data)
+{
+    struct tcp_mgr_test_hdr hdr;
+    memcpy(&hdr, buf, sizeof(hdr));
+
+    if (hdr.tth_seq & 1)
+    {
+        struct buffer_item *bi = tcp_mgr_connection_bulk_item_take(tmc);
+
+        NIOVA_ASSERT(bi && bi->bi_iov.iov_base == buf &&
+                     bi->bi_iov.iov_len == size);
+        NIOVA_ASSERT(tmbptNtaken < ARRAY_SIZE(tmbptTaken));
+
+        tmbptTaken[tmbptNtaken++] = bi;
+    }
+
+    return tcp_mgr_test_recv_cb(tmc, buf, size, data);
+}
+
+/**
+ * tcp_mgr_bulk_pool_test - bulks are received into pooled buffers, which
+ *   tmi_recv_cb may take.  Once the smallest class has been taken, bulks
+ *   fall through to the next class.
+ */
+static void
+tcp_mgr_bulk_pool_test(void)
+{
+    const uint32_t nmsgs = 6;
+    const struct buffer_set *bs = &tmtTmi.tmi_bulk_pools[0];
+
+    int rc = tcp_mgr_bulk_pools_setup(&tmtTmi, 2);
+    FATAL_IF(rc, "tcp_mgr_bulk_pools_setup(): %s", strerror(-rc));
+
+    tcp_mgr_test_peer_connect(0, 0);
+
+    for (uint32_t seq = 0; seq < nmsgs; seq++)
+        tcp_mgr_test_peer_msg_send(seq, 10 * 1024 + seq);
+
+    tmtExpected = nmsgs;
+    tcp_mgr_test_pump(tcp_mgr_test_all_recvd);
+
+    NIOVA_ASSERT(tmbptNtaken == nmsgs / 2);
+    NIOVA_ASSERT(!buffer_set_navail(bs));
+
+    // The pools may not be destroyed while their buffers are held
+    NIOVA_ASSERT(tcp_mgr_bulk_pools_destroy(&tmtTmi) == -EBUSY);
+
+    for (size_t i = 0; i < tmbptNtaken; i++)
+        buffer_set_release_item(tmbptTaken[i]);
+
+    NIOVA_ASSERT(buffer_set_navail(bs) == bs->bs_num_bufs);
+
+    tcp_mgr_test_peer_close();
+
+    rc = tcp_mgr_bulk_pools_destroy(&tmtTmi);
+    FATAL_IF(rc, "tcp_mgr_bulk_pools_destroy(): %s", strerror(-rc));
+}
+
+int
+main(void)
+{
+    tcp_mgr_test_setup(tcp_mgr_bulk_pool_test_recv_cb, false, 1);
+
+    tcp_mgr_bulk_pool_test();
+
+    tcp_mgr_test_teardown();
+
+    return 0;
+}
@@ -0,0 +1,216 @@
+/* Copyright (C) NIOVA Systems, Inc - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include <lz4.h>
+
+#include "log.h"
+#include "tcp-mgr-test-fixture.h"
+
+/**
+ * tcp_mgr_compress_test_peer_send - sends a message behind a compression
+ *   header, its bulk being compressed if 'compress' is set.
+ */
+static void
+tcp_mgr_compress_test_peer_send(uint32_t seq, uint32_t bulk_size, bool compress)
+{
+    static char zbuf[LZ4_COMPRESSBOUND(TCP_MGR_TEST_MAX_BULK)];
+    const size_t hdr_size = sizeof(struct tcp_mgr_test_hdr);
+
+    struct tcp_mgr_compress_hdr czh = {
+        .tmch_size = bulk_size,
+        .tmch_flags = 0,
+    };
+
+    tcp_mgr_test_msg_build(tmtPeerBuf, seq, bulk_size);
+    const char *bulk = tmtPeerBuf + hdr_size;
+
+    if (compress)
+    {
+        const int zsize =
+            LZ4_compress_default(bulk, zbuf, bulk_size, sizeof(zbuf));
+        NIOVA_ASSERT(zsize > 0 && (uint32_t)zsize < bulk_size);
+
+        czh.tmch_size = zsize;
+        czh.tmch_flags = TCP_MGR_COMPRESS_LZ4;
+        bulk = zbuf;
+    }
+
+    tcp_mgr_test_peer_write(&czh, sizeof(czh));
+    tcp_mgr_test_peer_write(tmtPeerBuf, hdr_size);
+    tcp_mgr_test_peer_write(bulk, czh.tmch_size);
+}
+
+/**
+ * tcp_mgr_compress_test_peer_recv - reads a message, which must carry 'seq',
+ *   from behind its compression header and returns the header's flags.
+ */
+static uint32_t
+tcp_mgr_compress_test_peer_recv(uint32_t seq)
+{
+    static char zbuf[TCP_MGR_TEST_MAX_BULK];
+    struct tcp_mgr_compress_hdr czh;
+    struct tcp_mgr_test_hdr hdr;
+
+    tcp_mgr_test_peer_read(&czh, sizeof(czh));
+    tcp_mgr_test_peer_read(&hdr, sizeof(hdr));
+
+    FATAL_IF(hdr.tth_seq != seq, "seq=%u expected %u", hdr.tth_seq, seq);
+    NIOVA_ASSERT(hdr.tth_bulk_size <= TCP_MGR_TEST_MAX_BULK);
+
+    if (!czh.tmch_flags)
+    {
+        NIOVA_ASSERT(czh.tmch_size == hdr.tth_bulk_size);
+        tcp_mgr_test_peer_read(tmtPeerBuf, hdr.tth_bulk_size);
+    }
+    else
+    {
+        NIOVA_ASSERT(czh.tmch_flags == TCP_MGR_COMPRESS_LZ4 &&
+                     czh.tmch_size < hdr.tth_bulk_size);
+
+        tcp_mgr_test_peer_read(zbuf, czh.tmch_size);
+
+        int rc = LZ4_decompress_safe(zbuf, tmtPeerBuf, czh.tmch_size,
+                                     hdr.tth_bulk_size);
+        FATAL_IF(rc != (int)hdr.tth_bulk_size,
+                 "LZ4_decompress_safe(): %d (%u)", rc, hdr.tth_bulk_size);
+    }
+
+    tcp_mgr_test_pattern_check(tmtPeerBuf, hdr.tth_bulk_size, seq);
+
+    return czh.tmch_flags;
+}
+
+/**
+ * tcp_mgr_compress_test_niovs - a message of as many iovs as leave room for
+ *   the framing headers is compressed and sent, one with more is rejected.
+ */
+static void
+tcp_mgr_compress_test_niovs(void)
+{
+    static struct iovec iovs[IO_MAX_IOVS + 1];
+    const size_t hdr_size = sizeof(struct tcp_mgr_test_hdr);
+    const size_t niovs = IO_MAX_IOVS - 3;
+    const size_t piece = 4;
+
+    tcp_mgr_test_msg_build(tmtSendBuf, 2, (niovs - 1) * piece);
+
+    iovs[0].iov_base = tmtSendBuf;
+    iovs[0].iov_len = hdr_size;
+    for (size_t i = 1; i < ARRAY_SIZE(iovs); i++)
+    {
+        iovs[i].iov_base = tmtSendBuf + hdr_size + (i - 1) * piece;
+        iovs[i].iov_len = piece;
+    }
+
+    NIOVA_ASSERT(tcp_mgr_send_msg(&tmtConn, iovs, niovs + 1) == -E2BIG);
+    NIOVA_ASSERT(tcp_mgr_send_msg(&tmtConn, iovs, ARRAY_SIZE(iovs)) ==
+                 -E2BIG);
+
+    int rc = tcp_mgr_send_msg(&tmtConn, iovs, niovs);
+    FATAL_IF(rc, "tcp_mgr_send_msg(): %s", strerror(-rc));
+
+    NIOVA_ASSERT(tcp_mgr_compress_test_peer_recv(2) == TCP_MGR_COMPRESS_LZ4);
+}
+
+/**
+ * tcp_mgr_compress_test - bulks over the threshold are sent compressed,
+ *   those under it are sent as is, and bulks compressed by the peer are
+ *   delivered decompressed, with and without a receive buffer.
+ */
+static void
+tcp_mgr_compress_test(size_t recv_buf_size)
+{
+    const struct tcp_mgr_connection_stats *tmcs = &tmtConn.tmc_stats;
+    const uint32_t big = 64 * 1024;
+    const uint32_t small = 500;
+
+    int rc = tcp_mgr_compress_threshold_set(&tmtTmi, 1024);
+    FATAL_IF(rc, "tcp_mgr_compress_threshold_set(): %s", strerror(-rc));
+
+    rc = tcp_mgr_recv_buf_size_set(&tmtTmi, recv_buf_size);
+    FATAL_IF(rc, "tcp_mgr_recv_buf_size_set(): %s", strerror(-rc));
+
+    tcp_mgr_test_peer_connect(TCP_MGR_COMPRESS_LZ4, 0);
+    NIOVA_ASSERT(tmtConn.tmc_compress);
+
+    NIOVA_ASSERT(!tcp_mgr_test_send(0, big));
+    NIOVA_ASSERT(!tcp_mgr_test_send(1, small));
+
+    NIOVA_ASSERT(tcp_mgr_compress_test_peer_recv(0) == TCP_MGR_COMPRESS_LZ4);
+    NIOVA_ASSERT(!tcp_mgr_compress_test_peer_recv(1));
+
+    NIOVA_ASSERT(tmcs->tmcs_compress_in == big &&
+                 tmcs->tmcs_compress_out < big);
+
+    tcp_mgr_compress_test_niovs();
+
+    tcp_mgr_compress_test_peer_send(0, big, true);
+    tcp_mgr_compress_test_peer_send(1, small, false);
+    tcp_mgr_compress_test_peer_send(2, big + 1, true);
+
+    tmtExpected = 3;
+    tcp_mgr_test_pump(tcp_mgr_test_all_recvd);
+
+    tcp_mgr_test_peer_close();
+
+    NIOVA_ASSERT(!tcp_mgr_recv_buf_size_set(&tmtTmi, 0));
+    NIOVA_ASSERT(!tcp_mgr_compress_threshold_set(&tmtTmi, 0));
+}
+
+/**
+ * tcp_mgr_compress_test_invalid - a compression header which does not
+ *   describe the bulk, or a bulk which fails to decompress, closes the
+ *   connection without the message being delivered.
+ */
+static void
+tcp_mgr_compress_test_invalid(void)
+{
+    const uint32_t bulk_size = 4096;
+    const size_t czh_size = sizeof(struct tcp_mgr_compress_hdr);
+
+    const struct tcp_mgr_compress_hdr bad[] = {
+        // Compressed bulks must be smaller than the bulk
+        {.tmch_size = bulk_size, .tmch_flags = TCP_MGR_COMPRESS_LZ4},
+        {.tmch_size = 0, .tmch_flags = TCP_MGR_COMPRESS_LZ4},
+        // Uncompressed bulks must be the size of the bulk
+        {.tmch_size = bulk_size - 1, .tmch_flags = 0},
+        {.tmch_size = 100, .tmch_flags = TCP_MGR_COMPRESS_LZ4 << 1},
+        // Followed by data which is not lz4
+        {.tmch_size = 100, .tmch_flags = TCP_MGR_COMPRESS_LZ4},
+    };
+
+    for (size_t i = 0; i < ARRAY_SIZE(bad); i++)
+    {
+        tcp_mgr_test_peer_connect(TCP_MGR_COMPRESS_LZ4, 0);
+
+        memcpy(tmtPeerBuf, &bad[i], czh_size);
+        size_t size = czh_size +
+            tcp_mgr_test_msg_build(tmtPeerBuf + czh_size, 0, bulk_size);
+
+        memset(tmtPeerBuf + czh_size + sizeof(struct tcp_mgr_test_hdr),
+               0xff, bulk_size);
+
+        tcp_mgr_test_peer_write(tmtPeerBuf, size);
+        tcp_mgr_test_pump(tcp_mgr_test_disconnected);
+
+        NIOVA_ASSERT(!tmtRecvd);
+
+        tcp_mgr_test_peer_close();
+    }
+}
+
+int
+main(void)
+{
+    tcp_mgr_test_setup(NULL, false, 1);
+
+    tcp_mgr_compress_test(0);
+    tcp_mgr_compress_test(16 * 1024);
+    tcp_mgr_compress_test_invalid();
+
+    tcp_mgr_test_teardown();
+
+    return 0;
+}
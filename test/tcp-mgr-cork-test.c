@@ -0,0 +1,62 @@
+/* Copyright (C) NIOVA Systems, Inc - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "log.h"
+#include "tcp-mgr-test-fixture.h"
+
+/**
+ * tcp_mgr_cork_test - corked messages are held until the cork timer expires
+ *   and are then written together, or are written once enough has queued.
+ */
+static void
+tcp_mgr_cork_test(void)
+{
+    const uint32_t nmsgs = 8;
+
+    int rc = tcp_mgr_cork_usec_set(&tmtTmi, 2000);
+    FATAL_IF(rc, "tcp_mgr_cork_usec_set(): %s", strerror(-rc));
+
+    tcp_mgr_test_peer_connect(0, 0);
+
+    for (uint32_t seq = 0; seq < nmsgs; seq++)
+        NIOVA_ASSERT(!tcp_mgr_test_send(seq, 100 + seq));
+
+    NIOVA_ASSERT(!tmtConn.tmc_send_syscalls && tmtConn.tmc_sendq_bytes);
+    NIOVA_ASSERT(epoll_mgr_timer_is_armed(&tmtConn.tmc_cork_timer));
+
+    for (uint32_t seq = 0; seq < nmsgs; seq++)
+        tcp_mgr_test_peer_msg_recv(seq);
+
+    NIOVA_ASSERT(tmtConn.tmc_send_msgs == nmsgs);
+    NIOVA_ASSERT(tmtConn.tmc_send_syscalls < nmsgs);
+
+    // TCP_MGR_CORK_MAX_BYTES is reached without waiting for the timer
+    const unsigned long long syscalls = tmtConn.tmc_send_syscalls;
+    const uint32_t bulk_size = TCP_MGR_CORK_MAX_BYTES / 4;
+
+    for (uint32_t seq = nmsgs; seq < nmsgs + 4; seq++)
+        NIOVA_ASSERT(!tcp_mgr_test_send(seq, bulk_size));
+
+    NIOVA_ASSERT(tmtConn.tmc_send_syscalls > syscalls);
+
+    for (uint32_t seq = nmsgs; seq < nmsgs + 4; seq++)
+        tcp_mgr_test_peer_msg_recv(seq);
+
+    tcp_mgr_test_peer_close();
+
+    NIOVA_ASSERT(!tcp_mgr_cork_usec_set(&tmtTmi, 0));
+}
+
+int
+main(void)
+{
+    tcp_mgr_test_setup(NULL, false, 1);
+
+    tcp_mgr_cork_test();
+
+    tcp_mgr_test_teardown();
+
+    return 0;
+}
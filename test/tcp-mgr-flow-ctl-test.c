@@ -0,0 +1,109 @@
+/* Copyright (C) NIOVA Systems, Inc - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include <sys/socket.h>
+
+#include "log.h"
+#include "tcp-mgr-test-fixture.h"
+
+static void
+tcp_mgr_flow_ctl_test_hdr_recv(uint32_t grant, uint32_t flags)
+{
+    struct tcp_mgr_fc_hdr fch;
+
+    tcp_mgr_test_peer_read(&fch, sizeof(fch));
+
+    FATAL_IF(fch.tmfh_grant != grant || fch.tmfh_flags != flags,
+             "grant=%u flags=%x, expected %u %x", fch.tmfh_grant,
+             fch.tmfh_flags, grant, flags);
+}
+
+/**
+ * tcp_mgr_flow_ctl_test - sends stall once the peer's credits have been
+ *   used and resume once a grant-only frame returns them.  Credits for the
+ *   peer's messages are returned once a quarter of the window is owed.
+ */
+static void
+tcp_mgr_flow_ctl_test(void)
+{
+    const uint32_t credits = 4;
+
+    int rc = tcp_mgr_flow_control_set(&tmtTmi, credits);
+    FATAL_IF(rc, "tcp_mgr_flow_control_set(): %s", strerror(-rc));
+
+    tcp_mgr_test_peer_connect(0, 0);
+    NIOVA_ASSERT(tmtConn.tmc_fc_credits == credits);
+
+    for (uint32_t seq = 0; seq < credits + 2; seq++)
+        NIOVA_ASSERT(!tcp_mgr_test_send(seq, 1000 + seq));
+
+    NIOVA_ASSERT(!tmtConn.tmc_fc_credits && tmtConn.tmc_fc_stalls == 2);
+
+    for (uint32_t seq = 0; seq < credits; seq++)
+    {
+        tcp_mgr_flow_ctl_test_hdr_recv(0, 0);
+        tcp_mgr_test_peer_msg_recv(seq);
+    }
+
+    // The stalled messages are held
+    struct tcp_mgr_fc_hdr fch;
+    for (int i = 0; i < 10; i++)
+        epoll_mgr_wait_and_process_events(&tmtEpm, 1);
+
+    NIOVA_ASSERT(recv(tmtPeer, &fch, sizeof(fch), 0) < 0 && errno == EAGAIN);
+    NIOVA_ASSERT(tmtConn.tmc_sendq_bytes);
+
+    fch.tmfh_grant = credits;
+    fch.tmfh_flags = TCP_MGR_FC_FLAG_GRANT_ONLY;
+    tcp_mgr_test_peer_write(&fch, sizeof(fch));
+
+    for (uint32_t seq = credits; seq < credits + 2; seq++)
+    {
+        tcp_mgr_flow_ctl_test_hdr_recv(0, 0);
+        tcp_mgr_test_peer_msg_recv(seq);
+    }
+
+    NIOVA_ASSERT(tmtConn.tmc_fc_credits == credits - 2);
+    NIOVA_ASSERT(!tmtRecvd);
+
+    // A message from the peer is owed a credit, which is returned on its own
+    fch.tmfh_grant = 0;
+    fch.tmfh_flags = 0;
+    memcpy(tmtPeerBuf, &fch, sizeof(fch));
+
+    size_t size = sizeof(fch) +
+        tcp_mgr_test_msg_build(tmtPeerBuf + sizeof(fch), 0, 500);
+    tcp_mgr_test_peer_write(tmtPeerBuf, size);
+
+    tcp_mgr_flow_ctl_test_hdr_recv(1, TCP_MGR_FC_FLAG_GRANT_ONLY);
+    NIOVA_ASSERT(tmtRecvd == 1);
+
+    // Credits may also be returned ahead of a message
+    fch.tmfh_grant = 2;
+    memcpy(tmtPeerBuf, &fch, sizeof(fch));
+
+    size = sizeof(fch) +
+        tcp_mgr_test_msg_build(tmtPeerBuf + sizeof(fch), 1, 0);
+    tcp_mgr_test_peer_write(tmtPeerBuf, size);
+
+    tcp_mgr_flow_ctl_test_hdr_recv(1, TCP_MGR_FC_FLAG_GRANT_ONLY);
+    NIOVA_ASSERT(tmtRecvd == 2 && tmtConn.tmc_fc_credits == credits);
+
+    tcp_mgr_test_peer_close();
+
+    NIOVA_ASSERT(!tcp_mgr_flow_control_set(&tmtTmi, 0));
+}
+
+int
+main(void)
+{
+    tcp_mgr_test_setup(NULL, false, 1);
+
+    tcp_mgr_flow_ctl_test();
+
+    tcp_mgr_test_teardown();
+
+    return 0;
+}
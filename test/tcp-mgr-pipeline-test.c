@@ -0,0 +1,96 @@
+/* Copyright (C) NIOVA Systems, Inc - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include <unistd.h>
+
+#include "log.h"
+#include "tcp-mgr-test-fixture.h"
+
+static niova_atomic32_t tmptInflight;
+static niova_atomic32_t tmptMaxInflight;
+
+/**
+ * tcp_mgr_pipeline_test_recv_cb - runs in the instance's workers and replies
+ *   to each request with its header.
+ */
+static int
+tcp_mgr_pipeline_test_recv_cb(struct tcp_mgr_connection *tmc, char *buf,
+                              size_t size, void *data)
+{
+    NIOVA_ASSERT(tmc == &tmtConn && data == &tmtTmi);
+    NIOVA_ASSERT(size >= sizeof(struct tcp_mgr_test_hdr));
+
+    struct tcp_mgr_test_hdr hdr;
+    memcpy(&hdr, buf, sizeof(hdr));
+
+    FATAL_IF(size != sizeof(hdr) + hdr.tth_bulk_size,
+             "size=%zu bulk_size=%u", size, hdr.tth_bulk_size);
+    tcp_mgr_test_pattern_check(buf + sizeof(hdr), hdr.tth_bulk_size,
+                               hdr.tth_seq);
+
+    const int32_t inflight = niova_atomic_inc(&tmptInflight);
+    int32_t max;
+    while (inflight > (max = niova_atomic_read(&tmptMaxInflight)) &&
+           !niova_atomic_cas(&tmptMaxInflight, max, inflight))
+        ;
+
+    // Vary the processing time so that requests complete out of order
+    usleep((3 - hdr.tth_seq % 4) * 200);
+
+    niova_atomic_dec(&tmptInflight);
+
+    // The reply is the request's header without the bulk
+    hdr.tth_bulk_size = 0;
+    struct iovec iov = {.iov_base = &hdr, .iov_len = sizeof(hdr)};
+
+    int rc;
+    while ((rc = tcp_mgr_send_msg(tmc, &iov, 1)) == -EAGAIN)
+        usleep(100);
+
+    FATAL_IF(rc, "tcp_mgr_send_msg(): %s", strerror(-rc));
+
+    return 0;
+}
+
+/**
+ * tcp_mgr_pipeline_test - requests are processed by the workers, up to
+ *   'depth' of them at once, and the replies arrive in request order.
+ */
+static void
+tcp_mgr_pipeline_test(unsigned int depth)
+{
+    const uint32_t nmsgs = 32;
+
+    int rc = tcp_mgr_pipeline_depth_set(&tmtTmi, depth);
+    FATAL_IF(rc, "tcp_mgr_pipeline_depth_set(): %s", strerror(-rc));
+
+    tcp_mgr_test_peer_connect(0, 0);
+    niova_atomic_init(&tmptMaxInflight, 0);
+
+    for (uint32_t seq = 0; seq < nmsgs; seq++)
+        tcp_mgr_test_peer_msg_send(seq, 1000 + seq * 100);
+
+    for (uint32_t seq = 0; seq < nmsgs; seq++)
+        NIOVA_ASSERT(!tcp_mgr_test_peer_msg_recv(seq));
+
+    const int32_t max_inflight = niova_atomic_read(&tmptMaxInflight);
+    FATAL_IF(max_inflight < 1 || max_inflight > (int32_t)MAX(depth, 1),
+             "max_inflight=%d depth=%u", max_inflight, depth);
+
+    tcp_mgr_test_peer_close();
+}
+
+int
+main(void)
+{
+    tcp_mgr_test_setup(tcp_mgr_pipeline_test_recv_cb, true, 1);
+
+    tcp_mgr_pipeline_test(0);
+    tcp_mgr_pipeline_test(4);
+
+    tcp_mgr_test_teardown();
+
+    return 0;
+}
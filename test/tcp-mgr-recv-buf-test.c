@@ -0,0 +1,78 @@
+/* Copyright (C) NIOVA Systems, Inc - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "tcp-mgr-test-fixture.h"
+
+/**
+ * tcp_mgr_recv_buf_test - messages which have arrived together are
+ *   dispatched from a single read into the receive buffer.  Messages which
+ *   straddle the end of the buffer, and bulks larger than the buffer, are
+ *   completed by further reads.
+ */
+static void
+tcp_mgr_recv_buf_test(void)
+{
+    const uint32_t nmsgs = 8;
+
+    int rc = tcp_mgr_recv_buf_size_set(&tmtTmi, TCP_MGR_RECV_BUF_MIN_SIZE);
+    FATAL_IF(rc, "tcp_mgr_recv_buf_size_set(): %s", strerror(-rc));
+
+    tcp_mgr_test_peer_connect(0, 0);
+
+    size_t size = 0;
+    for (uint32_t seq = 0; seq < nmsgs; seq++)
+        size += tcp_mgr_test_msg_build(tmtPeerBuf + size, seq, seq * 50);
+
+    NIOVA_ASSERT(size < TCP_MGR_RECV_BUF_MIN_SIZE);
+    tcp_mgr_test_peer_write(tmtPeerBuf, size);
+
+    // Wait for all of it to be readable, then process a single event
+    int nready = 0;
+    for (int i = 0; i < 1000 && nready < (int)size; i++)
+    {
+        FATAL_IF(ioctl(tmtConn.tmc_tsh.tsh_socket, FIONREAD, &nready),
+                 "ioctl(): %s", strerror(errno));
+        if (nready < (int)size)
+            usleep(1000);
+    }
+    NIOVA_ASSERT(nready == (int)size);
+
+    epoll_mgr_wait_and_process_events(&tmtEpm, 1000);
+    NIOVA_ASSERT(tmtRecvd == nmsgs);
+
+    // Messages straddling the end of the buffer, and bulks exceeding it
+    size = 0;
+    for (uint32_t seq = nmsgs; seq < nmsgs * 4; seq++)
+        size += tcp_mgr_test_msg_build(tmtPeerBuf + size, seq,
+                                       (seq % 8 == 5) ? 9000 + seq :
+                                       (seq * 373) % 1500);
+
+    tcp_mgr_test_peer_write(tmtPeerBuf, size);
+
+    tmtExpected = nmsgs * 4;
+    tcp_mgr_test_pump(tcp_mgr_test_all_recvd);
+
+    NIOVA_ASSERT(tmtConn.tmc_rbuf_head == tmtConn.tmc_rbuf_tail);
+
+    tcp_mgr_test_peer_close();
+
+    NIOVA_ASSERT(!tcp_mgr_recv_buf_size_set(&tmtTmi, 0));
+}
+
+int
+main(void)
+{
+    tcp_mgr_test_setup(NULL, false, 1);
+
+    tcp_mgr_recv_buf_test();
+
+    tcp_mgr_test_teardown();
+
+    return 0;
+}
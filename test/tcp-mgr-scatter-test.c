@@ -0,0 +1,119 @@
+/* Copyright (C) NIOVA Systems, Inc - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "log.h"
+#include "tcp-mgr-test-fixture.h"
+
+// Bulks of odd numbered messages are scattered by tmi_bulk_iov_cb
+static char tmstBuf[TCP_MGR_TEST_MAX_BULK + 128];
+static struct iovec tmstIovs[3];
+static size_t tmstScattered;
+
+static int
+tcp_mgr_scatter_test_recv_cb(struct tcp_mgr_connection *tmc, char *buf,
+                             size_t size, void *data)
+{
+    struct tcp_mgr_test_hdr hdr;
+    memcpy(&hdr, buf, sizeof(hdr));
+
+    if (size != sizeof(hdr) || !hdr.tth_bulk_size)
+        return tcp_mgr_test_recv_cb(tmc, buf, size, data);
+
+    // Only the header is passed up for scattered bulks
+    NIOVA_ASSERT(hdr.tth_seq & 1);
+    FATAL_IF(hdr.tth_seq != tmtRecvd, "seq=%u expected %zu", hdr.tth_seq,
+             tmtRecvd);
+
+    size_t off = 0;
+    for (size_t i = 0; i < ARRAY_SIZE(tmstIovs); i++)
+    {
+        tcp_mgr_test_pattern_check(tmstIovs[i].iov_base,
+                                   tmstIovs[i].iov_len, hdr.tth_seq + off);
+        off += tmstIovs[i].iov_len;
+    }
+    NIOVA_ASSERT(off == hdr.tth_bulk_size);
+
+    memset(tmstBuf, 0, sizeof(tmstBuf));
+    tmstScattered++;
+    tmtRecvd++;
+
+    return 0;
+}
+
+static ssize_t
+tcp_mgr_scatter_test_bulk_iov_cb(struct tcp_mgr_connection *tmc, char *buf,
+                                 size_t bulk_size, struct iovec *iovs,
+                                 size_t niovs, void *data)
+{
+    NIOVA_ASSERT(tmc == &tmtConn && data == &tmtTmi);
+    NIOVA_ASSERT(niovs >= ARRAY_SIZE(tmstIovs));
+
+    struct tcp_mgr_test_hdr hdr;
+    memcpy(&hdr, buf, sizeof(hdr));
+
+    NIOVA_ASSERT(hdr.tth_bulk_size == bulk_size);
+    if (!(hdr.tth_seq & 1))
+        return 0;
+
+    // Uneven pieces, separated by gaps
+    const size_t len0 = bulk_size / 3 + 1;
+    const size_t len1 = bulk_size / 5;
+
+    tmstIovs[0].iov_base = tmstBuf;
+    tmstIovs[0].iov_len = len0;
+    tmstIovs[1].iov_base = tmstBuf + len0 + 64;
+    tmstIovs[1].iov_len = len1;
+    tmstIovs[2].iov_base = tmstBuf + len0 + len1 + 128;
+    tmstIovs[2].iov_len = bulk_size - len0 - len1;
+
+    memcpy(iovs, tmstIovs, sizeof(tmstIovs));
+
+    return ARRAY_SIZE(tmstIovs);
+}
+
+/**
+ * tcp_mgr_scatter_test - bulks for which tmi_bulk_iov_cb returns iovs are
+ *   received directly into them, with and without a receive buffer, and
+ *   tmi_recv_cb is then issued with only the header.
+ */
+static void
+tcp_mgr_scatter_test(size_t recv_buf_size)
+{
+    const uint32_t sizes[] = {1000, 1001, 100000, 100001, 40000, 40001};
+
+    int rc = tcp_mgr_recv_buf_size_set(&tmtTmi, recv_buf_size);
+    FATAL_IF(rc, "tcp_mgr_recv_buf_size_set(): %s", strerror(-rc));
+
+    tcp_mgr_bulk_iov_cb_set(&tmtTmi, tcp_mgr_scatter_test_bulk_iov_cb);
+    tcp_mgr_test_peer_connect(0, 0);
+
+    tmstScattered = 0;
+
+    for (uint32_t seq = 0; seq < ARRAY_SIZE(sizes); seq++)
+        tcp_mgr_test_peer_msg_send(seq, sizes[seq]);
+
+    tmtExpected = ARRAY_SIZE(sizes);
+    tcp_mgr_test_pump(tcp_mgr_test_all_recvd);
+
+    NIOVA_ASSERT(tmstScattered == ARRAY_SIZE(sizes) / 2);
+
+    tcp_mgr_test_peer_close();
+
+    tcp_mgr_bulk_iov_cb_set(&tmtTmi, NULL);
+    NIOVA_ASSERT(!tcp_mgr_recv_buf_size_set(&tmtTmi, 0));
+}
+
+int
+main(void)
+{
+    tcp_mgr_test_setup(tcp_mgr_scatter_test_recv_cb, false, 1);
+
+    tcp_mgr_scatter_test(0);
+    tcp_mgr_scatter_test(16 * 1024);
+
+    tcp_mgr_test_teardown();
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+/* Copyright (C) NIOVA Systems, Inc - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "log.h"
+#include "tcp-mgr-test-fixture.h"
+
+static bool
+tcp_mgr_sendq_test_drained(void)
+{
+    return (!tmtConn.tmc_sendq_bytes &&
+            !(tmtConn.tmc_eph.eph_events & EPOLLOUT)) ? true : false;
+}
+
+/**
+ * tcp_mgr_sendq_test_backpressure - while the peer does not read, messages
+ *   are queued until the send queue exceeds its limit and -EAGAIN is
+ *   returned.  The queue is then drained through EPOLLOUT as the peer reads.
+ */
+static void
+tcp_mgr_sendq_test_backpressure(void)
+{
+    const uint32_t bulk_size = 16 * 1024;
+
+    tcp_mgr_sendq_max_bytes_set(&tmtTmi, 64 * 1024);
+    tcp_mgr_test_peer_connect(0, 4096);
+
+    uint32_t nsent = 0;
+    int rc;
+    while (!(rc = tcp_mgr_test_send(nsent, bulk_size)))
+        FATAL_IF(++nsent > 8192, "the send queue never filled");
+
+    NIOVA_ASSERT(rc == -EAGAIN && nsent > 0);
+    NIOVA_ASSERT(tmtConn.tmc_sendq_bytes > 0);
+    NIOVA_ASSERT(tmtConn.tmc_stats.tmcs_sendq_full == 1);
+    NIOVA_ASSERT(tmtConn.tmc_eph.eph_events & EPOLLOUT);
+
+    for (uint32_t seq = 0; seq < nsent; seq++)
+        NIOVA_ASSERT(tcp_mgr_test_peer_msg_recv(seq) == bulk_size);
+
+    tcp_mgr_test_pump(tcp_mgr_sendq_test_drained);
+
+    // The queue accepts messages again
+    NIOVA_ASSERT(!tcp_mgr_test_send(nsent, bulk_size));
+    tcp_mgr_test_peer_msg_recv(nsent);
+
+    tcp_mgr_test_peer_close();
+    tcp_mgr_sendq_max_bytes_set(&tmtTmi, TCP_MGR_SENDQ_MAX_BYTES);
+}
+
+int
+main(void)
+{
+    tcp_mgr_test_setup(NULL, false, 1);
+
+    tcp_mgr_sendq_test_backpressure();
+
+    tcp_mgr_test_teardown();
+
+    return 0;
+}
@@ -0,0 +1,176 @@
+/* Copyright (C) NIOVA Systems, Inc - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "tcp-mgr-test-fixture.h"
+
+#define TCP_MGR_SHARD_TEST_NSHARDS  4
+#define TCP_MGR_SHARD_TEST_NCLIENTS 16
+
+static struct tcp_mgr_connection tmstConns[TCP_MGR_SHARD_TEST_NCLIENTS];
+static int tmstClients[TCP_MGR_SHARD_TEST_NCLIENTS];
+static size_t tmstNaccepted;
+
+/**
+ * tcp_mgr_shard_test_handshake_cb - maps each incoming connection, whichever
+ *   shard accepted it, onto the next of tmstConns.
+ */
+static int
+tcp_mgr_shard_test_handshake_cb(void *data, struct tcp_mgr_connection **tmc_out,
+                                size_t *header_size_out, int fd, void *buf,
+                                size_t size)
+{
+    NIOVA_ASSERT(data == &tmtTmi);
+    (void)fd;
+
+    struct tcp_mgr_test_handshake hs;
+    if (size != sizeof(hs))
+        return -EBADMSG;
+
+    memcpy(&hs, buf, sizeof(hs));
+    if (hs.tths_magic != TCP_MGR_TEST_MAGIC)
+        return -EBADMSG;
+
+    NIOVA_ASSERT(tmstNaccepted < TCP_MGR_SHARD_TEST_NCLIENTS);
+
+    struct tcp_mgr_connection *tmc = &tmstConns[tmstNaccepted++];
+    NIOVA_ASSERT(tmc->tmc_status == TMCS_DISCONNECTED);
+
+    tcp_mgr_connection_compress_accept(tmc, hs.tths_compress);
+
+    *tmc_out = tmc;
+    *header_size_out = sizeof(struct tcp_mgr_test_hdr);
+
+    return 0;
+}
+
+static bool
+tcp_mgr_shard_test_all_status(enum tcp_mgr_connection_status status)
+{
+    for (size_t i = 0; i < TCP_MGR_SHARD_TEST_NCLIENTS; i++)
+        if (tmstConns[i].tmc_status != status)
+            return false;
+
+    return true;
+}
+
+static bool
+tcp_mgr_shard_test_connected(void)
+{
+    return tmstNaccepted == TCP_MGR_SHARD_TEST_NCLIENTS &&
+        tcp_mgr_shard_test_all_status(TMCS_CONNECTED);
+}
+
+static bool
+tcp_mgr_shard_test_disconnected(void)
+{
+    return tcp_mgr_shard_test_all_status(TMCS_DISCONNECTED);
+}
+
+static int
+tcp_mgr_shard_test_client_connect(void)
+{
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    FATAL_IF(s < 0, "socket(): %s", strerror(errno));
+
+    struct sockaddr_in sin = {
+        .sin_family = AF_INET,
+        .sin_port = htons(tmtTmi.tmi_listen_socket.tsh_port),
+    };
+    inet_pton(AF_INET, TCP_MGR_TEST_IPADDR, &sin.sin_addr);
+
+    FATAL_IF(connect(s, (struct sockaddr *)&sin, sizeof(sin)),
+             "connect(): %s", strerror(errno));
+
+    struct tcp_mgr_test_handshake hs = {.tths_magic = TCP_MGR_TEST_MAGIC};
+
+    FATAL_IF(send(s, &hs, sizeof(hs), MSG_NOSIGNAL) != sizeof(hs),
+             "send(): %s", strerror(errno));
+
+    return s;
+}
+
+/**
+ * tcp_mgr_shard_test - connections are spread by the kernel across the
+ *   instance's listen shards, all of which are serviced.
+ */
+static void
+tcp_mgr_shard_test(void)
+{
+    NIOVA_ASSERT(tmtTmi.tmi_nlisten_shards == TCP_MGR_SHARD_TEST_NSHARDS - 1);
+
+    tmtTmi.tmi_handshake_cb = tcp_mgr_shard_test_handshake_cb;
+
+    for (size_t i = 0; i < TCP_MGR_SHARD_TEST_NCLIENTS; i++)
+    {
+        tcp_mgr_connection_setup(&tmstConns[i], &tmtTmi, TCP_MGR_TEST_IPADDR,
+                                 0);
+        tmstClients[i] = tcp_mgr_shard_test_client_connect();
+    }
+
+    // Nothing has been accepted yet, so the shards hold the connections
+    struct pollfd pfds[TCP_MGR_SHARD_TEST_NSHARDS] = {
+        {.fd = tmtTmi.tmi_listen_socket.tsh_socket, .events = POLLIN},
+    };
+    for (size_t i = 1; i < TCP_MGR_SHARD_TEST_NSHARDS; i++)
+    {
+        pfds[i].fd = tmtTmi.tmi_listen_shards[i - 1].tmls_socket.tsh_socket;
+        pfds[i].events = POLLIN;
+    }
+
+    const int nready = poll(pfds, TCP_MGR_SHARD_TEST_NSHARDS, 0);
+    FATAL_IF(nready < 2, "only %d shards have pending connections", nready);
+
+    tcp_mgr_test_pump(tcp_mgr_shard_test_connected);
+
+    for (size_t i = 0; i < TCP_MGR_SHARD_TEST_NCLIENTS; i++)
+        close(tmstClients[i]);
+
+    tcp_mgr_test_pump(tcp_mgr_shard_test_disconnected);
+}
+
+/**
+ * tcp_mgr_shard_test_unix - a Unix-domain listener is limited to a single
+ *   shard.
+ */
+static void
+tcp_mgr_shard_test_unix(void)
+{
+    struct tcp_mgr_instance tmi = {0};
+    char path[64];
+
+    snprintf(path, sizeof(path), "%s/tmp/niova-tcp-mgr-shard-test.%d.sock",
+             TCP_UNIX_ADDR_PREFIX, getpid());
+
+    tcp_socket_handle_init(&tmi.tmi_listen_socket);
+
+    int rc = tcp_mgr_sockets_setup(&tmi, path, 0);
+    FATAL_IF(rc, "tcp_mgr_sockets_setup(): %s", strerror(-rc));
+
+    NIOVA_ASSERT(tcp_mgr_listen_shards_set(&tmi, 2) == -EOPNOTSUPP);
+    NIOVA_ASSERT(!tcp_mgr_listen_shards_set(&tmi, 1));
+    NIOVA_ASSERT(!tmi.tmi_nlisten_shards);
+
+    tcp_mgr_sockets_close(&tmi);
+}
+
+int
+main(void)
+{
+    tcp_mgr_test_setup(NULL, false, TCP_MGR_SHARD_TEST_NSHARDS);
+
+    tcp_mgr_shard_test();
+    tcp_mgr_shard_test_unix();
+
+    tcp_mgr_test_teardown();
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+/* Copyright (C) NIOVA Systems, Inc - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "log.h"
+#include "tcp-mgr-test-fixture.h"
+
+/**
+ * tcp_mgr_split_hdr_test - a header arriving a byte at a time is retained by
+ *   the connection across reads until it is complete.
+ */
+static void
+tcp_mgr_split_hdr_test(void)
+{
+    const size_t hdr_size = sizeof(struct tcp_mgr_test_hdr);
+
+    tcp_mgr_test_peer_connect(0, 0);
+
+    size_t size = tcp_mgr_test_msg_build(tmtPeerBuf, 0, 3000);
+
+    for (size_t i = 0; i < hdr_size - 1; i++)
+    {
+        tcp_mgr_test_peer_write(tmtPeerBuf + i, 1);
+
+        for (int j = 0; j < 100 && tmtConn.tmc_hdr_offset == i; j++)
+            epoll_mgr_wait_and_process_events(&tmtEpm, 10);
+
+        NIOVA_ASSERT(tmtConn.tmc_hdr_offset == i + 1 && !tmtRecvd);
+    }
+
+    // The rest of the header along with part of the bulk
+    tcp_mgr_test_peer_write(tmtPeerBuf + hdr_size - 1, 1000);
+    epoll_mgr_wait_and_process_events(&tmtEpm, 10);
+
+    tcp_mgr_test_peer_write(tmtPeerBuf + hdr_size + 999,
+                            size - hdr_size - 999);
+
+    tmtExpected = 1;
+    tcp_mgr_test_pump(tcp_mgr_test_all_recvd);
+    NIOVA_ASSERT(!tmtConn.tmc_hdr_offset);
+
+    // A header split between the end of one write and the next
+    size = tcp_mgr_test_msg_build(tmtPeerBuf, 1, 100);
+    size += tcp_mgr_test_msg_build(tmtPeerBuf + size, 2, 0);
+
+    tcp_mgr_test_peer_write(tmtPeerBuf, size - 3);
+    epoll_mgr_wait_and_process_events(&tmtEpm, 10);
+
+    tcp_mgr_test_peer_write(tmtPeerBuf + size - 3, 3);
+
+    tmtExpected = 3;
+    tcp_mgr_test_pump(tcp_mgr_test_all_recvd);
+
+    tcp_mgr_test_peer_close();
+}
+
+int
+main(void)
+{
+    tcp_mgr_test_setup(NULL, false, 1);
+
+    tcp_mgr_split_hdr_test();
+
+    tcp_mgr_test_teardown();
+
+    return 0;
+}
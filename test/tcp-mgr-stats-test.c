@@ -0,0 +1,162 @@
+/* Copyright (C) NIOVA Systems, Inc - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "log.h"
+#include "tcp-mgr-test-fixture.h"
+
+static long long
+tcp_mgr_stats_test_hist_cnt(const struct binary_hist *bh)
+{
+    long long cnt = 0;
+
+    for (int i = 0; i < binary_hist_size(bh); i++)
+        cnt += binary_hist_get_cnt(bh, i);
+
+    return cnt;
+}
+
+/**
+ * tcp_mgr_stats_test - traffic is counted by the connection while it is
+ *   established and folded into the instance's totals once it closes.
+ */
+/**
+ * tcp_mgr_stats_test_lreg_read - reads 'key' from the registry node into
+ *   'lv'.  Keys are looked up by name since their indices are private to
+ *   tcp_mgr.
+ */
+static void
+tcp_mgr_stats_test_lreg_read(struct lreg_node *lrn, const char *key,
+                             struct lreg_value *lv)
+{
+    memset(lv, 0, sizeof(*lv));
+    NIOVA_ASSERT(!lrn->lrn_cb(LREG_NODE_CB_OP_GET_NAME, lrn, lv));
+
+    const unsigned int nkeys = lv->get.lrv_num_keys_out;
+
+    for (unsigned int i = 0; i < nkeys; i++)
+    {
+        memset(lv, 0, sizeof(*lv));
+        lv->lrv_value_idx_in = i;
+
+        NIOVA_ASSERT(!lrn->lrn_cb(LREG_NODE_CB_OP_READ_VAL, lrn, lv));
+        if (!strcmp(lv->lrv_key_string, key))
+            return;
+    }
+
+    FATAL_MSG("key %s not found", key);
+}
+
+/**
+ * tcp_mgr_stats_test_lreg - the instance's totals, and those of its one
+ *   connection, as read through the registry callbacks.
+ */
+static void
+tcp_mgr_stats_test_lreg(unsigned long long msgs_in)
+{
+    struct lreg_node *lrn = tmtTmi.tmi_lrn;
+    struct lreg_value lv;
+
+    NIOVA_ASSERT(lrn);
+    NIOVA_ASSERT(lrn->lrn_cb(LREG_NODE_CB_OP_READ_VAL, lrn, NULL) ==
+                 -EINVAL);
+
+    tcp_mgr_stats_test_lreg_read(lrn, "msgs-in", &lv);
+    NIOVA_ASSERT(LREG_VALUE_TO_OUT_UNSIGNED_INT(&lv) == msgs_in);
+
+    tcp_mgr_stats_test_lreg_read(lrn, "num-connections", &lv);
+    NIOVA_ASSERT(LREG_VALUE_TO_OUT_UNSIGNED_INT(&lv) == 1);
+
+    // The connection's node, as the registry would set it up
+    struct lreg_node conn_lrn = {.lrn_cb_arg = &tmtTmi};
+
+    tcp_mgr_stats_test_lreg_read(lrn, "connections", &lv);
+    lreg_value_vnode_data_to_lreg_node(&lv, &conn_lrn);
+    NIOVA_ASSERT(conn_lrn.lrn_lvd.lvd_num_entries == 1);
+    conn_lrn.lrn_lvd.lvd_index = 0;
+
+    NIOVA_ASSERT(conn_lrn.lrn_cb(LREG_NODE_CB_OP_GET_NAME, &conn_lrn,
+                                 NULL) == -EINVAL);
+    NIOVA_ASSERT(conn_lrn.lrn_cb(LREG_NODE_CB_OP_READ_VAL, &conn_lrn,
+                                 NULL) == -EINVAL);
+
+    tcp_mgr_stats_test_lreg_read(&conn_lrn, "msgs-in", &lv);
+    NIOVA_ASSERT(LREG_VALUE_TO_OUT_UNSIGNED_INT(&lv) ==
+                 tmtConn.tmc_stats.tmcs_msgs_in);
+}
+
+static void
+tcp_mgr_stats_test(void)
+{
+    const uint32_t bulk_sizes[] = {1000, 2000, 0};
+    const size_t hdr_size = sizeof(struct tcp_mgr_test_hdr);
+    const struct tcp_mgr_connection_stats *tmcs = &tmtConn.tmc_stats;
+    const struct tcp_mgr_connection_stats *closed = &tmtTmi.tmi_stats_closed;
+
+    int rc = tcp_mgr_lreg_install(&tmtTmi, "tcp-mgr-test");
+    FATAL_IF(rc, "tcp_mgr_lreg_install(): %s", strerror(-rc));
+    NIOVA_ASSERT(tcp_mgr_lreg_install(&tmtTmi, "tcp-mgr-test") ==
+                 -EALREADY);
+
+    tcp_mgr_latency_stats_set(&tmtTmi, true);
+
+    const unsigned long long nclosed = tmtTmi.tmi_stats_nclosed;
+    const unsigned long long closed_msgs_in = closed->tmcs_msgs_in;
+
+    tcp_mgr_test_peer_connect(0, 0);
+
+    NIOVA_ASSERT(tmtTmi.tmi_stats_nconns == 1 && tmcs->tmcs_bulk_hist &&
+                 !tmcs->tmcs_msgs_in && !tmcs->tmcs_bytes_in);
+
+    size_t bytes = 0;
+    for (uint32_t seq = 0; seq < ARRAY_SIZE(bulk_sizes); seq++)
+    {
+        tcp_mgr_test_peer_msg_send(seq, bulk_sizes[seq]);
+        bytes += hdr_size + bulk_sizes[seq];
+    }
+
+    tmtExpected = ARRAY_SIZE(bulk_sizes);
+    tcp_mgr_test_pump(tcp_mgr_test_all_recvd);
+
+    NIOVA_ASSERT(tmcs->tmcs_msgs_in == ARRAY_SIZE(bulk_sizes) &&
+                 tmcs->tmcs_bytes_in == bytes);
+    NIOVA_ASSERT(tcp_mgr_stats_test_hist_cnt(tmcs->tmcs_recv_usec_hist) ==
+                 ARRAY_SIZE(bulk_sizes));
+    // Messages without a bulk are left out of the bulk size histogram
+    NIOVA_ASSERT(tcp_mgr_stats_test_hist_cnt(tmcs->tmcs_bulk_hist) == 2);
+
+    for (uint32_t seq = 0; seq < 2; seq++)
+    {
+        NIOVA_ASSERT(!tcp_mgr_test_send(seq, bulk_sizes[seq]));
+        tcp_mgr_test_peer_msg_recv(seq);
+    }
+
+    NIOVA_ASSERT(tmtConn.tmc_send_msgs == 2 &&
+                 tmcs->tmcs_bytes_out == 2 * hdr_size + 3000);
+    NIOVA_ASSERT(tcp_mgr_stats_test_hist_cnt(tmcs->tmcs_send_usec_hist) == 2);
+
+    tcp_mgr_stats_test_lreg(closed_msgs_in + ARRAY_SIZE(bulk_sizes));
+
+    tcp_mgr_test_peer_close();
+
+    NIOVA_ASSERT(!tmtTmi.tmi_stats_nconns && !tmcs->tmcs_bulk_hist);
+    NIOVA_ASSERT(tmtTmi.tmi_stats_nclosed == nclosed + 1);
+    NIOVA_ASSERT(closed->tmcs_msgs_in ==
+                 closed_msgs_in + ARRAY_SIZE(bulk_sizes));
+
+    tcp_mgr_latency_stats_set(&tmtTmi, false);
+    tcp_mgr_lreg_remove(&tmtTmi);
+}
+
+int
+main(void)
+{
+    tcp_mgr_test_setup(NULL, false, 1);
+
+    tcp_mgr_stats_test();
+
+    tcp_mgr_test_teardown();
+
+    return 0;
+}
@@ -0,0 +1,142 @@
+/* Copyright (C) NIOVA Systems, Inc - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "env.h"
+#include "log.h"
+#include "tcp-mgr-test-fixture.h"
+
+// More workers than the former maximum of TCP_MGR_NTHREADS
+#define TCP_MGR_STEAL_TEST_NWORKERS (TCP_MGR_NTHREADS + 8)
+#define TCP_MGR_STEAL_TEST_NMSGS    8
+
+static niova_atomic32_t tmstDone;
+static pthread_t tmstThreads[TCP_MGR_STEAL_TEST_NMSGS];
+
+/**
+ * tcp_mgr_steal_test_recv_cb - the first request holds its worker until the
+ *   rest have been processed, which requires that they be taken by other
+ *   workers.  Each request is replied to with its header.
+ */
+static int
+tcp_mgr_steal_test_recv_cb(struct tcp_mgr_connection *tmc, char *buf,
+                           size_t size, void *data)
+{
+    NIOVA_ASSERT(tmc == &tmtConn && data == &tmtTmi);
+
+    struct tcp_mgr_test_hdr hdr;
+    NIOVA_ASSERT(size == sizeof(hdr));
+    memcpy(&hdr, buf, sizeof(hdr));
+
+    NIOVA_ASSERT(hdr.tth_seq < TCP_MGR_STEAL_TEST_NMSGS);
+    tmstThreads[hdr.tth_seq] = pthread_self();
+
+    if (!hdr.tth_seq)
+    {
+        for (int i = 0; i < 5000 && niova_atomic_read(&tmstDone) <
+                 TCP_MGR_STEAL_TEST_NMSGS - 1; i++)
+            usleep(1000);
+
+        FATAL_IF(niova_atomic_read(&tmstDone) < TCP_MGR_STEAL_TEST_NMSGS - 1,
+                 "queued requests were not stolen, done=%d",
+                 niova_atomic_read(&tmstDone));
+    }
+
+    struct iovec iov = {.iov_base = &hdr, .iov_len = sizeof(hdr)};
+
+    int rc;
+    while ((rc = tcp_mgr_send_msg(tmc, &iov, 1)) == -EAGAIN)
+        usleep(100);
+
+    FATAL_IF(rc, "tcp_mgr_send_msg(): %s", strerror(-rc));
+
+    niova_atomic_inc(&tmstDone);
+
+    return 0;
+}
+
+static unsigned long long
+tcp_mgr_steal_test_nsteals(void)
+{
+    unsigned long long nsteals = 0;
+
+    for (size_t i = 0; i < tmtTmi.tmi_nworkers; i++)
+        nsteals += tmtTmi.tmi_workers[i].tmw_steals;
+
+    return nsteals;
+}
+
+static bool
+tcp_mgr_steal_test_workers_idle(void)
+{
+    return niova_atomic_read(&tmtTmi.tmi_workers_idle) ==
+        (int32_t)tmtTmi.tmi_nworkers;
+}
+
+/**
+ * tcp_mgr_steal_test - pipelined requests which are read together are queued
+ *   by the reading worker onto its own queue.  While one of them holds a
+ *   worker, idle workers are woken and steal the remainder.
+ */
+static void
+tcp_mgr_steal_test(void)
+{
+    NIOVA_ASSERT(tmtTmi.tmi_nworkers == TCP_MGR_STEAL_TEST_NWORKERS);
+    NIOVA_ASSERT(env_get(NIOVA_ENV_VAR_niova_thread_cnt)->nev_max ==
+                 TCP_MGR_NTHREADS_MAX);
+
+    int rc = tcp_mgr_pipeline_depth_set(&tmtTmi, TCP_MGR_STEAL_TEST_NMSGS);
+    FATAL_IF(rc, "tcp_mgr_pipeline_depth_set(): %s", strerror(-rc));
+
+    // Requests arriving together are then queued by a single worker
+    rc = tcp_mgr_recv_buf_size_set(&tmtTmi, TCP_MGR_RECV_BUF_MIN_SIZE);
+    FATAL_IF(rc, "tcp_mgr_recv_buf_size_set(): %s", strerror(-rc));
+
+    tcp_mgr_test_peer_connect(0, 0);
+    tcp_mgr_test_pump(tcp_mgr_steal_test_workers_idle);
+
+    const unsigned long long nsteals = tcp_mgr_steal_test_nsteals();
+    niova_atomic_init(&tmstDone, 0);
+
+    // A single write so that the requests are read, and queued, together
+    size_t size = 0;
+    for (uint32_t seq = 0; seq < TCP_MGR_STEAL_TEST_NMSGS; seq++)
+        size += tcp_mgr_test_msg_build(tmtPeerBuf + size, seq, 0);
+
+    tcp_mgr_test_peer_write(tmtPeerBuf, size);
+
+    // Replies are written in request order
+    for (uint32_t seq = 0; seq < TCP_MGR_STEAL_TEST_NMSGS; seq++)
+        NIOVA_ASSERT(!tcp_mgr_test_peer_msg_recv(seq));
+
+    FATAL_IF(tcp_mgr_steal_test_nsteals() <= nsteals, "no steals");
+
+    for (uint32_t seq = 1; seq < TCP_MGR_STEAL_TEST_NMSGS; seq++)
+        NIOVA_ASSERT(!pthread_equal(tmstThreads[0], tmstThreads[seq]));
+
+    // The woken workers return to idle
+    tcp_mgr_test_pump(tcp_mgr_steal_test_workers_idle);
+
+    tcp_mgr_test_peer_close();
+
+    NIOVA_ASSERT(!tcp_mgr_recv_buf_size_set(&tmtTmi, 0));
+}
+
+int
+main(void)
+{
+    tcp_mgr_set_thread_cnt_env_cb(&(struct niova_env_var){
+            .nev_long_value = TCP_MGR_STEAL_TEST_NWORKERS});
+
+    tcp_mgr_test_setup(tcp_mgr_steal_test_recv_cb, true, 1);
+
+    tcp_mgr_steal_test();
+
+    tcp_mgr_test_teardown();
+
+    return 0;
+}
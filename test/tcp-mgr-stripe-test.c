@@ -0,0 +1,137 @@
+/* Copyright (C) NIOVA Systems, Inc - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "log.h"
+#include "tcp-mgr-test-fixture.h"
+
+#define TCP_MGR_STRIPE_TEST_NCONNS 4
+
+static size_t tmstNchunks;
+
+static int
+tcp_mgr_stripe_test_hdr_cb(void *arg, size_t idx, size_t nchunks,
+                           size_t offset, size_t len, struct iovec *hdr_iov)
+{
+    struct tcp_mgr_test_hdr *hdr = arg;
+
+    NIOVA_ASSERT(idx < nchunks && len);
+    if (!idx)
+        tmstNchunks = nchunks;
+    else
+        NIOVA_ASSERT(nchunks == tmstNchunks);
+
+    // Chunks carry the pattern from their offset into the payload
+    hdr->tth_seq = offset;
+    hdr->tth_bulk_size = len;
+
+    hdr_iov->iov_base = hdr;
+    hdr_iov->iov_len = sizeof(*hdr);
+
+    return 0;
+}
+
+/**
+ * tcp_mgr_stripe_test_split - sends a 'total' byte payload, spread over
+ *   several iovs, through the stripe.  The peer must receive 'nchunks'
+ *   non-empty chunks of near equal size, which reassemble into the payload.
+ */
+static void
+tcp_mgr_stripe_test_split(struct tcp_mgr_stripe *tms, size_t total,
+                          size_t min_chunk, size_t nchunks)
+{
+    static char reasm_buf[TCP_MGR_TEST_MAX_BULK];
+    struct tcp_mgr_stripe_reasm tmsr;
+    struct tcp_mgr_test_hdr hdr;
+
+    NIOVA_ASSERT(total <= TCP_MGR_TEST_MAX_BULK);
+
+    // The payload is a single pattern spread over uneven iovs
+    tcp_mgr_test_pattern_fill(tmtSendBuf, total, 0);
+
+    struct iovec iov[3] = {
+        {.iov_base = tmtSendBuf, .iov_len = total / 4},
+        {.iov_base = tmtSendBuf + total / 4, .iov_len = total / 2},
+        {.iov_base = tmtSendBuf + total / 4 + total / 2,
+         .iov_len = total - total / 4 - total / 2},
+    };
+
+    tmstNchunks = 0;
+
+    int rc = tcp_mgr_stripe_send_split(tms, iov, ARRAY_SIZE(iov), min_chunk,
+                                       tcp_mgr_stripe_test_hdr_cb, &hdr);
+    FATAL_IF(rc, "tcp_mgr_stripe_send_split(): %s", strerror(-rc));
+    FATAL_IF(tmstNchunks != nchunks, "nchunks=%zu expected %zu",
+             tmstNchunks, nchunks);
+
+    NIOVA_ASSERT(!tcp_mgr_stripe_reasm_init(&tmsr, reasm_buf, total));
+
+    size_t off = 0;
+    for (size_t i = 0; i < nchunks; i++)
+    {
+        const uint32_t len = tcp_mgr_test_peer_msg_recv(off);
+        NIOVA_ASSERT(len == total / nchunks || len == total / nchunks + 1);
+
+        rc = tcp_mgr_stripe_reasm_add(&tmsr, off, tmtPeerBuf, len);
+        NIOVA_ASSERT(rc == (i < nchunks - 1 ? 0 : 1));
+
+        off += len;
+    }
+
+    NIOVA_ASSERT(off == total);
+    tcp_mgr_test_pattern_check(reasm_buf, total, 0);
+
+    NIOVA_ASSERT(tcp_mgr_stripe_reasm_add(&tmsr, 0, NULL, 1) == -EOVERFLOW);
+    NIOVA_ASSERT(tcp_mgr_stripe_reasm_add(&tmsr, total, NULL, 1) ==
+                 -ERANGE);
+    NIOVA_ASSERT(tcp_mgr_stripe_reasm_add(&tmsr, 0, NULL, 0) == -EINVAL);
+}
+
+/**
+ * tcp_mgr_stripe_test - payloads are split into one chunk per connection,
+ *   or fewer if the chunks would fall under 'min_chunk', and reassembled by
+ *   the peer.  The stripe's connections are all tmtConn so that the chunks
+ *   arrive in order on the peer's one socket.
+ */
+static void
+tcp_mgr_stripe_test(void)
+{
+    struct tcp_mgr_stripe tms;
+
+    NIOVA_ASSERT(!tcp_mgr_stripe_init(&tms, TCP_MGR_STRIPE_ORDER_KEY));
+    for (size_t i = 0; i < TCP_MGR_STRIPE_TEST_NCONNS; i++)
+        NIOVA_ASSERT(!tcp_mgr_stripe_conn_add(&tms, &tmtConn));
+
+    tcp_mgr_test_peer_connect(0, 0);
+
+    tcp_mgr_stripe_test_split(&tms, 35001, 4096, TCP_MGR_STRIPE_TEST_NCONNS);
+
+    // Rounding the chunk size up would leave the last chunk empty
+    tcp_mgr_stripe_test_split(&tms, 9, 2, TCP_MGR_STRIPE_TEST_NCONNS);
+    tcp_mgr_stripe_test_split(&tms, 5, 1, TCP_MGR_STRIPE_TEST_NCONNS);
+
+    // Payloads under 'nconns * min_chunk' use fewer connections
+    tcp_mgr_stripe_test_split(&tms, 10000, 4096, 2);
+    tcp_mgr_stripe_test_split(&tms, 7, 2, 3);
+
+    // A payload under twice 'min_chunk' is sent whole
+    tcp_mgr_stripe_test_split(&tms, 10000, 6000, 1);
+    tcp_mgr_stripe_test_split(&tms, 100, 4096, 1);
+
+    NIOVA_ASSERT(tcp_mgr_stripe_select(&tms, 5) == &tmtConn);
+
+    tcp_mgr_test_peer_close();
+}
+
+int
+main(void)
+{
+    tcp_mgr_test_setup(NULL, false, 1);
+
+    tcp_mgr_stripe_test();
+
+    tcp_mgr_test_teardown();
+
+    return 0;
+}
@@ -0,0 +1,356 @@
+/* Copyright (C) NIOVA Systems, Inc - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "tcp-mgr-test-fixture.h"
+
+struct epoll_mgr tmtEpm;
+struct tcp_mgr_instance tmtTmi;
+struct tcp_mgr_connection tmtConn;
+
+int tmtPeer = -1;
+size_t tmtRecvd;
+size_t tmtExpected;
+
+char tmtSendBuf[sizeof(struct tcp_mgr_test_hdr) + TCP_MGR_TEST_MAX_BULK];
+char tmtPeerBuf[sizeof(struct tcp_mgr_test_hdr) + TCP_MGR_TEST_MAX_BULK];
+
+void
+tcp_mgr_test_pattern_fill(char *buf, size_t size, size_t seed)
+{
+    for (size_t i = 0; i < size; i++)
+        buf[i] = (char)((seed + i) * 7);
+}
+
+void
+tcp_mgr_test_pattern_check(const char *buf, size_t size, size_t seed)
+{
+    for (size_t i = 0; i < size; i++)
+        FATAL_IF(buf[i] != (char)((seed + i) * 7),
+                 "mismatch at %zu of %zu (seed=%zu)", i, size, seed);
+}
+
+/**
+ * tcp_mgr_test_msg_build - places a header followed by a bulk, whose pattern
+ *   is seeded by the sequence number, into 'buf' and returns the total size.
+ */
+size_t
+tcp_mgr_test_msg_build(char *buf, uint32_t seq, uint32_t bulk_size)
+{
+    NIOVA_ASSERT(bulk_size <= TCP_MGR_TEST_MAX_BULK);
+
+    struct tcp_mgr_test_hdr hdr = {
+        .tth_seq = seq,
+        .tth_bulk_size = bulk_size,
+    };
+
+    memcpy(buf, &hdr, sizeof(hdr));
+    tcp_mgr_test_pattern_fill(buf + sizeof(hdr), bulk_size, seq);
+
+    return sizeof(hdr) + bulk_size;
+}
+
+int
+tcp_mgr_test_send(uint32_t seq, uint32_t bulk_size)
+{
+    tcp_mgr_test_msg_build(tmtSendBuf, seq, bulk_size);
+
+    struct iovec iov[2] = {
+        {.iov_base = tmtSendBuf,
+         .iov_len = sizeof(struct tcp_mgr_test_hdr)},
+        {.iov_base = tmtSendBuf + sizeof(struct tcp_mgr_test_hdr),
+         .iov_len = bulk_size},
+    };
+
+    return tcp_mgr_send_msg(&tmtConn, iov, 2);
+}
+
+static void
+tcp_mgr_test_conn_getput(void *tmc, enum epoll_handle_ref_op op)
+{
+    // The test's connections are static
+    (void)tmc;
+    (void)op;
+}
+
+/**
+ * tcp_mgr_test_recv_cb - checks that messages arrive whole and in order.
+ *   Tests which handle messages themselves may finish with this call.
+ */
+int
+tcp_mgr_test_recv_cb(struct tcp_mgr_connection *tmc, char *buf, size_t size,
+                     void *data)
+{
+    NIOVA_ASSERT(tmc == &tmtConn && data == &tmtTmi);
+    NIOVA_ASSERT(size >= sizeof(struct tcp_mgr_test_hdr));
+
+    struct tcp_mgr_test_hdr hdr;
+    memcpy(&hdr, buf, sizeof(hdr));
+
+    FATAL_IF(hdr.tth_seq != tmtRecvd, "seq=%u expected %zu", hdr.tth_seq,
+             tmtRecvd);
+    FATAL_IF(size != sizeof(hdr) + hdr.tth_bulk_size,
+             "size=%zu bulk_size=%u", size, hdr.tth_bulk_size);
+
+    tcp_mgr_test_pattern_check(buf + sizeof(hdr), hdr.tth_bulk_size,
+                               hdr.tth_seq);
+    tmtRecvd++;
+
+    return 0;
+}
+
+static ssize_t
+tcp_mgr_test_bulk_size_cb(struct tcp_mgr_connection *tmc, char *buf,
+                          void *data)
+{
+    NIOVA_ASSERT(tmc->tmc_tmi == data);
+
+    struct tcp_mgr_test_hdr hdr;
+    memcpy(&hdr, buf, sizeof(hdr));
+
+    return hdr.tth_bulk_size;
+}
+
+static int
+tcp_mgr_test_handshake_cb(void *data, struct tcp_mgr_connection **tmc_out,
+                          size_t *header_size_out, int fd, void *buf,
+                          size_t size)
+{
+    NIOVA_ASSERT(data == &tmtTmi);
+    (void)fd;
+
+    struct tcp_mgr_test_handshake hs;
+    if (size != sizeof(hs))
+        return -EBADMSG;
+
+    memcpy(&hs, buf, sizeof(hs));
+    if (hs.tths_magic != TCP_MGR_TEST_MAGIC)
+        return -EBADMSG;
+
+    tcp_mgr_connection_compress_accept(&tmtConn, hs.tths_compress);
+
+    *tmc_out = &tmtConn;
+    *header_size_out = sizeof(struct tcp_mgr_test_hdr);
+
+    return 0;
+}
+
+void
+tcp_mgr_test_pump(bool (*done)(void))
+{
+    for (int i = 0; i < 1000 && !done(); i++)
+        epoll_mgr_wait_and_process_events(&tmtEpm, 10);
+
+    FATAL_IF(!done(), "timed out");
+}
+
+static bool
+tcp_mgr_test_connected(void)
+{
+    return tmtConn.tmc_status == TMCS_CONNECTED;
+}
+
+bool
+tcp_mgr_test_disconnected(void)
+{
+    return tmtConn.tmc_status == TMCS_DISCONNECTED;
+}
+
+bool
+tcp_mgr_test_all_recvd(void)
+{
+    return tmtRecvd == tmtExpected;
+}
+
+/**
+ * tcp_mgr_test_peer_connect - connects the peer socket to tmtTmi and sends
+ *   the handshake, 'compress' is the peer's compression offer.  A non-zero
+ *   'rcvbuf' shrinks the peer's receive buffer.
+ */
+void
+tcp_mgr_test_peer_connect(uint32_t compress, int rcvbuf)
+{
+    NIOVA_ASSERT(tmtPeer < 0 && tmtConn.tmc_status == TMCS_DISCONNECTED);
+
+    tmtPeer = socket(AF_INET, SOCK_STREAM, 0);
+    FATAL_IF(tmtPeer < 0, "socket(): %s", strerror(errno));
+
+    if (rcvbuf)
+        FATAL_IF(setsockopt(tmtPeer, SOL_SOCKET, SO_RCVBUF, &rcvbuf,
+                            sizeof(rcvbuf)), "setsockopt(): %s",
+                 strerror(errno));
+
+    struct sockaddr_in sin = {
+        .sin_family = AF_INET,
+        .sin_port = htons(tmtTmi.tmi_listen_socket.tsh_port),
+    };
+    inet_pton(AF_INET, TCP_MGR_TEST_IPADDR, &sin.sin_addr);
+
+    FATAL_IF(connect(tmtPeer, (struct sockaddr *)&sin, sizeof(sin)),
+             "connect(): %s", strerror(errno));
+
+    struct tcp_mgr_test_handshake hs = {
+        .tths_magic = TCP_MGR_TEST_MAGIC,
+        .tths_compress = compress,
+    };
+
+    FATAL_IF(send(tmtPeer, &hs, sizeof(hs), MSG_NOSIGNAL) != sizeof(hs),
+             "send(): %s", strerror(errno));
+
+    FATAL_IF(fcntl(tmtPeer, F_SETFL, O_NONBLOCK), "fcntl(): %s",
+             strerror(errno));
+
+    tcp_mgr_test_pump(tcp_mgr_test_connected);
+
+    tmtRecvd = tmtExpected = 0;
+}
+
+void
+tcp_mgr_test_peer_close(void)
+{
+    close(tmtPeer);
+    tmtPeer = -1;
+
+    tcp_mgr_test_pump(tcp_mgr_test_disconnected);
+}
+
+/**
+ * tcp_mgr_test_peer_write - writes all of 'buf', running the epm while the
+ *   peer's socket is full.
+ */
+void
+tcp_mgr_test_peer_write(const void *buf, size_t size)
+{
+    const char *p = buf;
+    int nwaits = 0;
+
+    while (size)
+    {
+        ssize_t rc = send(tmtPeer, p, size, MSG_NOSIGNAL);
+        if (rc > 0)
+        {
+            p += rc;
+            size -= rc;
+            continue;
+        }
+
+        FATAL_IF(errno != EAGAIN, "send(): %s", strerror(errno));
+        FATAL_IF(++nwaits > 10000, "timed out");
+
+        epoll_mgr_wait_and_process_events(&tmtEpm, 1);
+    }
+}
+
+void
+tcp_mgr_test_peer_msg_send(uint32_t seq, uint32_t bulk_size)
+{
+    const size_t size = tcp_mgr_test_msg_build(tmtPeerBuf, seq, bulk_size);
+
+    tcp_mgr_test_peer_write(tmtPeerBuf, size);
+}
+
+/**
+ * tcp_mgr_test_peer_read - reads exactly 'size' bytes, running the epm while
+ *   none are available.
+ */
+void
+tcp_mgr_test_peer_read(void *buf, size_t size)
+{
+    char *p = buf;
+    int nwaits = 0;
+
+    while (size)
+    {
+        ssize_t rc = recv(tmtPeer, p, size, 0);
+        if (rc > 0)
+        {
+            p += rc;
+            size -= rc;
+            continue;
+        }
+
+        FATAL_IF(!rc, "connection closed");
+        FATAL_IF(errno != EAGAIN, "recv(): %s", strerror(errno));
+        FATAL_IF(++nwaits > 10000, "timed out");
+
+        epoll_mgr_wait_and_process_events(&tmtEpm, 1);
+    }
+}
+
+/**
+ * tcp_mgr_test_peer_msg_recv - reads a message sent to the peer, which must
+ *   carry 'seq', into tmtPeerBuf and returns its bulk size.
+ */
+uint32_t
+tcp_mgr_test_peer_msg_recv(uint32_t seq)
+{
+    struct tcp_mgr_test_hdr hdr;
+
+    tcp_mgr_test_peer_read(&hdr, sizeof(hdr));
+    FATAL_IF(hdr.tth_seq != seq, "seq=%u expected %u", hdr.tth_seq, seq);
+    NIOVA_ASSERT(hdr.tth_bulk_size <= TCP_MGR_TEST_MAX_BULK);
+
+    tcp_mgr_test_peer_read(tmtPeerBuf, hdr.tth_bulk_size);
+    tcp_mgr_test_pattern_check(tmtPeerBuf, hdr.tth_bulk_size, seq);
+
+    return hdr.tth_bulk_size;
+}
+
+/**
+ * tcp_mgr_test_setup - sets up tmtEpm and tmtTmi, which listens on
+ *   'nshards' sockets.  'recv_cb' defaults to tcp_mgr_test_recv_cb().
+ */
+void
+tcp_mgr_test_setup(tcp_mgr_recv_cb_t recv_cb, bool handoff, size_t nshards)
+{
+    int rc = epoll_mgr_setup(&tmtEpm);
+    FATAL_IF(rc, "epoll_mgr_setup(): %s", strerror(-rc));
+
+    // Connections are only accepted, so no handshake_fill is needed
+    rc = tcp_mgr_setup(&tmtTmi, &tmtTmi, tcp_mgr_test_conn_getput,
+                       recv_cb ? recv_cb : tcp_mgr_test_recv_cb,
+                       tcp_mgr_test_bulk_size_cb, tcp_mgr_test_handshake_cb,
+                       NULL, sizeof(struct tcp_mgr_test_handshake), 16, 16,
+                       handoff);
+    FATAL_IF(rc, "tcp_mgr_setup(): %s", strerror(-rc));
+
+    // Avoid colliding with concurrent runs
+    for (int i = 0; i < 100; i++)
+    {
+        const int port = TCP_MGR_TEST_PORT_BASE + (getpid() + i) % 10000;
+
+        rc = tcp_mgr_sockets_setup(&tmtTmi, TCP_MGR_TEST_IPADDR, port);
+        FATAL_IF(rc, "tcp_mgr_sockets_setup(): %s", strerror(-rc));
+
+        rc = tcp_mgr_listen_shards_set(&tmtTmi, nshards);
+        FATAL_IF(rc, "tcp_mgr_listen_shards_set(): %s", strerror(-rc));
+
+        rc = tcp_mgr_sockets_bind(&tmtTmi);
+        if (rc != -EADDRINUSE)
+            break;
+    }
+    FATAL_IF(rc, "tcp_mgr_sockets_bind(): %s", strerror(-rc));
+
+    rc = tcp_mgr_epoll_setup(&tmtTmi, &tmtEpm, true);
+    FATAL_IF(rc, "tcp_mgr_epoll_setup(): %s", strerror(-rc));
+
+    tcp_mgr_connection_setup(&tmtConn, &tmtTmi, TCP_MGR_TEST_IPADDR, 0);
+    NIOVA_ASSERT(tmtConn.tmc_status == TMCS_DISCONNECTED);
+}
+
+void
+tcp_mgr_test_teardown(void)
+{
+    NIOVA_ASSERT(tmtPeer < 0);
+
+    tcp_mgr_sockets_close(&tmtTmi);
+    epoll_mgr_close(&tmtEpm);
+}
@@ -0,0 +1,99 @@
+/* Copyright (C) NIOVA Systems, Inc - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#ifndef _TCP_MGR_TEST_FIXTURE_H_
+#define _TCP_MGR_TEST_FIXTURE_H_ 1
+
+#include "common.h"
+#include "epoll_mgr.h"
+#include "tcp_mgr.h"
+
+/**
+ * The tcp_mgr tests run a single instance, tmtTmi, on tmtEpm.  The remote
+ * end of its connection, tmtConn, is a plain socket driven by the test, so
+ * that the tests control exactly which bytes arrive and when.  Each message
+ * is a tcp_mgr_test_hdr followed by a bulk whose pattern is seeded by the
+ * message's sequence number.
+ */
+#define TCP_MGR_TEST_IPADDR    "127.0.0.1"
+#define TCP_MGR_TEST_PORT_BASE 21000
+#define TCP_MGR_TEST_MAGIC     0x7C9A11E5
+#define TCP_MGR_TEST_MAX_BULK  (256UL * 1024)
+
+struct tcp_mgr_test_hdr
+{
+    uint32_t tth_seq;
+    uint32_t tth_bulk_size;
+};
+
+struct tcp_mgr_test_handshake
+{
+    uint32_t tths_magic;
+    uint32_t tths_compress;
+};
+
+extern struct epoll_mgr tmtEpm;
+extern struct tcp_mgr_instance tmtTmi;
+extern struct tcp_mgr_connection tmtConn;
+
+extern int tmtPeer;
+extern size_t tmtRecvd;
+extern size_t tmtExpected;
+
+extern char tmtSendBuf[sizeof(struct tcp_mgr_test_hdr) +
+                       TCP_MGR_TEST_MAX_BULK];
+extern char tmtPeerBuf[sizeof(struct tcp_mgr_test_hdr) +
+                       TCP_MGR_TEST_MAX_BULK];
+
+void
+tcp_mgr_test_pattern_fill(char *buf, size_t size, size_t seed);
+
+void
+tcp_mgr_test_pattern_check(const char *buf, size_t size, size_t seed);
+
+size_t
+tcp_mgr_test_msg_build(char *buf, uint32_t seq, uint32_t bulk_size);
+
+int
+tcp_mgr_test_send(uint32_t seq, uint32_t bulk_size);
+
+int
+tcp_mgr_test_recv_cb(struct tcp_mgr_connection *tmc, char *buf, size_t size,
+                     void *data);
+
+void
+tcp_mgr_test_pump(bool (*done)(void));
+
+bool
+tcp_mgr_test_all_recvd(void);
+
+bool
+tcp_mgr_test_disconnected(void);
+
+void
+tcp_mgr_test_peer_connect(uint32_t compress, int rcvbuf);
+
+void
+tcp_mgr_test_peer_close(void);
+
+void
+tcp_mgr_test_peer_write(const void *buf, size_t size);
+
+void
+tcp_mgr_test_peer_msg_send(uint32_t seq, uint32_t bulk_size);
+
+void
+tcp_mgr_test_peer_read(void *buf, size_t size);
+
+uint32_t
+tcp_mgr_test_peer_msg_recv(uint32_t seq);
+
+void
+tcp_mgr_test_setup(tcp_mgr_recv_cb_t recv_cb, bool handoff, size_t nshards);
+
+void
+tcp_mgr_test_teardown(void);
+
+#endif
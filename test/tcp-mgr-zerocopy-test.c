@@ -0,0 +1,94 @@
+/* Copyright (C) NIOVA Systems, Inc - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "log.h"
+#include "tcp-mgr-test-fixture.h"
+
+static unsigned int tmztDone;
+
+static void
+tcp_mgr_zerocopy_test_done_cb(struct tcp_mgr_connection *tmc, void *arg,
+                              int status)
+{
+    NIOVA_ASSERT(tmc == &tmtConn && arg == tmtSendBuf);
+    FATAL_IF(status, "status=%d", status);
+
+    tmztDone++;
+}
+
+static bool
+tcp_mgr_zerocopy_test_all_done(void)
+{
+    return tmztDone == 2;
+}
+
+/**
+ * tcp_mgr_zerocopy_test_send - tmtSendBuf may not be reused until
+ *   tcp_mgr_zerocopy_test_done_cb() has been issued for it.
+ */
+static int
+tcp_mgr_zerocopy_test_send(uint32_t seq, uint32_t bulk_size)
+{
+    tcp_mgr_test_msg_build(tmtSendBuf, seq, bulk_size);
+
+    struct iovec iov[2] = {
+        {.iov_base = tmtSendBuf,
+         .iov_len = sizeof(struct tcp_mgr_test_hdr)},
+        {.iov_base = tmtSendBuf + sizeof(struct tcp_mgr_test_hdr),
+         .iov_len = bulk_size},
+    };
+
+    return tcp_mgr_send_msg_zc(&tmtConn, iov, 2,
+                               tcp_mgr_zerocopy_test_done_cb, tmtSendBuf);
+}
+
+/**
+ * tcp_mgr_zerocopy_test - a message under the threshold is copied and
+ *   completed by the send call, one over it is completed by the epm once the
+ *   kernel is done with it.  Zero-copy may be unavailable, in which case
+ *   both are copied.
+ */
+static void
+tcp_mgr_zerocopy_test(void)
+{
+    const uint32_t bulk_size = 128 * 1024;
+
+    int rc = tcp_mgr_zerocopy_threshold_set(&tmtTmi, bulk_size / 2);
+    FATAL_IF(rc, "tcp_mgr_zerocopy_threshold_set(): %s", strerror(-rc));
+
+    tcp_mgr_test_peer_connect(0, 0);
+    tmztDone = 0;
+
+    NIOVA_ASSERT(!tcp_mgr_zerocopy_test_send(0, 1000));
+    NIOVA_ASSERT(tmztDone == 1);
+
+    NIOVA_ASSERT(!tcp_mgr_zerocopy_test_send(1, bulk_size));
+    NIOVA_ASSERT(tmztDone == (tmtConn.tmc_zerocopy ? 1 : 2));
+
+    tcp_mgr_test_peer_msg_recv(0);
+    tcp_mgr_test_peer_msg_recv(1);
+
+    tcp_mgr_test_pump(tcp_mgr_zerocopy_test_all_done);
+
+    if (tmtConn.tmc_zerocopy)
+        NIOVA_ASSERT(tmtConn.tmc_zc_sends == 1 &&
+                     STAILQ_EMPTY(&tmtConn.tmc_zc_inflight));
+
+    tcp_mgr_test_peer_close();
+
+    NIOVA_ASSERT(!tcp_mgr_zerocopy_threshold_set(&tmtTmi, 0));
+}
+
+int
+main(void)
+{
+    tcp_mgr_test_setup(NULL, false, 1);
+
+    tcp_mgr_zerocopy_test();
+
+    tcp_mgr_test_teardown();
+
+    return 0;
+}
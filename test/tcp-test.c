@@ -132,6 +132,96 @@ tcp_test_connect()
     return rc;
 }
 
+/**
+ * tcp_test_connect_unix - connects over a Unix-domain socket and exchanges a
+ *    message.  The listener's socket file must be removed when it's closed.
+ */
+static int
+tcp_test_connect_unix(void)
+{
+    struct tcp_socket_handle listener;
+    tcp_socket_handle_init(&listener);
+
+    snprintf(listener.tsh_ipaddr, sizeof(listener.tsh_ipaddr),
+             TCP_UNIX_ADDR_PREFIX"/tmp/niova-tcp-test.%d.sock", getpid());
+
+    struct tcp_socket_handle connector = listener;
+    struct tcp_socket_handle accepted;
+    tcp_socket_handle_init(&accepted);
+
+    int rc = tcp_test_connect_helper(&listener, &connector, &accepted);
+    if (!rc)
+    {
+        char buf[64] = "unix";
+        struct iovec iov = {.iov_base = buf, .iov_len = sizeof(buf)};
+
+        ssize_t size_rc = tcp_socket_send(&connector, &iov, 1);
+        if (size_rc == sizeof(buf))
+        {
+            memset(buf, 0, sizeof(buf));
+            size_rc = tcp_socket_recv(&accepted, &iov, 1, NULL, true);
+        }
+
+        if (size_rc != sizeof(buf) || strcmp(buf, "unix"))
+            rc = size_rc < 0 ? size_rc : -EBADMSG;
+    }
+
+    tcp_socket_close(&accepted);
+    tcp_socket_close(&connector);
+    tcp_socket_close(&listener);
+
+    const char *path = listener.tsh_ipaddr + TCP_UNIX_ADDR_PREFIX_LEN;
+    if (!rc && !access(path, F_OK))
+        rc = -EEXIST;
+
+    return rc;
+}
+
+/**
+ * tcp_test_send_timeout - tcp_socket_send() to a peer which does not read
+ *    gives up with -ETIMEDOUT once the socket stays full.
+ */
+static int
+tcp_test_send_timeout(void)
+{
+    struct tcp_socket_handle listener;
+    tcp_socket_handle_init(&listener);
+
+    snprintf(listener.tsh_ipaddr, sizeof(listener.tsh_ipaddr),
+             TCP_UNIX_ADDR_PREFIX"/tmp/niova-tcp-test-to.%d.sock", getpid());
+
+    struct tcp_socket_handle connector = listener;
+    struct tcp_socket_handle accepted;
+    tcp_socket_handle_init(&accepted);
+
+    const size_t size = 16 * 1024 * 1024;
+    char *buf = NULL;
+
+    int rc = tcp_test_connect_helper(&listener, &connector, &accepted);
+    if (!rc)
+    {
+        buf = calloc(1, size);
+        if (!buf)
+            rc = -ENOMEM;
+    }
+
+    if (!rc)
+    {
+        struct iovec iov = {.iov_base = buf, .iov_len = size};
+
+        ssize_t size_rc = tcp_socket_send(&connector, &iov, 1);
+        if (size_rc != -ETIMEDOUT)
+            rc = size_rc < 0 ? size_rc : -EBADMSG;
+    }
+
+    free(buf);
+    tcp_socket_close(&accepted);
+    tcp_socket_close(&connector);
+    tcp_socket_close(&listener);
+
+    return rc;
+}
+
 static void *
 tcp_test_pingpong_worker(void *arg)
 {
@@ -319,6 +409,18 @@ main(int argc, char **argv)
     if (rc)
         return rc;
 
+    rc = tcp_test_connect_unix();
+
+    STDERR_MSG("tcp_test_connect_unix(): %s", rc ? strerror(-rc) : "OK");
+    if (rc)
+        return rc;
+
+    rc = tcp_test_send_timeout();
+
+    STDERR_MSG("tcp_test_send_timeout(): %s", rc ? strerror(-rc) : "OK");
+    if (rc)
+        return rc;
+
     rc = tcp_test_pingpong();
 
     STDERR_MSG("tcp_test_pingpong(): %s", rc ? strerror(-rc) : "OK");
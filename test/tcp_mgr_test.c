@@ -197,7 +197,12 @@ tmt_send_thread(void *arg)
         iov.iov_len = msg_size + sizeof(struct tmt_message);
         SIMPLE_LOG_MSG(LL_NOTIFY, "sending message, msg_size=%d", msg_size);
         int rc = tcp_mgr_send_msg(&oc->oc_tmc, &iov, 1);
-        if (rc < 0)
+        if (rc == -EAGAIN)
+        {
+            // Still connecting or the send queue is full, retry the message
+            SIMPLE_LOG_MSG(LL_NOTIFY, "send deferred, msg_idx=%d", msg_idx);
+        }
+        else if (rc < 0)
         {
             SIMPLE_LOG_MSG(LL_NOTIFY, "error sending message, rc=%d", rc);
             niova_atomic_inc(&oc->oc_tmt_data->td_send_err_cnt);
@@ -197,6 +197,117 @@ udp_test_pingpong(void)
     return 0;
 }
 
+#define UDP_TEST_BATCH_NMSGS 16
+
+static int
+udp_test_batch_socket(struct udp_socket_handle *ush, int port_offset)
+{
+    ush->ush_port = udp_get_default_port() + port_offset;
+    ush->ush_socket = -1;
+    strncpy(ush->ush_ipaddr, "127.0.0.1", 16);
+
+    int rc = udp_socket_setup(ush);
+    if (rc)
+        return rc;
+
+    rc = udp_socket_bind(ush);
+    if (rc)
+        SIMPLE_LOG_MSG(LL_ERROR, "udp_socket_bind(): %s", strerror(-rc));
+
+    return rc;
+}
+
+/**
+ * udp_test_batch - sends a batch of datagrams of varying size with
+ *    udp_socket_send_batch() and drains them with udp_socket_recv_batch(),
+ *    checking each datagram's size, source, and contents.
+ */
+static int
+udp_test_batch(void)
+{
+    struct udp_socket_handle tx, rx;
+
+    int rc = udp_test_batch_socket(&tx, 2);
+    if (rc)
+        return rc;
+
+    rc = udp_test_batch_socket(&rx, 3);
+    if (rc)
+        return rc;
+
+    char sbuf[UDP_TEST_BATCH_NMSGS][512];
+    char rbuf[UDP_TEST_BATCH_NMSGS][512];
+    struct iovec siov[UDP_TEST_BATCH_NMSGS];
+    struct iovec riov[UDP_TEST_BATCH_NMSGS];
+    struct udp_socket_batch_msg smsgs[UDP_TEST_BATCH_NMSGS] = {0};
+    struct udp_socket_batch_msg rmsgs[UDP_TEST_BATCH_NMSGS] = {0};
+
+    for (int i = 0; i < UDP_TEST_BATCH_NMSGS; i++)
+    {
+        memset(sbuf[i], 'a' + i, sizeof(sbuf[i]));
+        siov[i].iov_base = sbuf[i];
+        siov[i].iov_len = 32 * (i + 1);
+
+        riov[i].iov_base = rbuf[i];
+        riov[i].iov_len = sizeof(rbuf[i]);
+
+        smsgs[i].usbm_iov = &siov[i];
+        smsgs[i].usbm_iovlen = 1;
+        rc = udp_setup_sockaddr_in(rx.ush_ipaddr, rx.ush_port,
+                                   &smsgs[i].usbm_addr);
+        NIOVA_ASSERT(!rc);
+
+        rmsgs[i].usbm_iov = &riov[i];
+        rmsgs[i].usbm_iovlen = 1;
+    }
+
+    ssize_t size_rc = udp_socket_recv_batch(&rx, rmsgs, UDP_TEST_BATCH_NMSGS,
+                                            false);
+    NIOVA_ASSERT(size_rc == -EAGAIN || size_rc == -EWOULDBLOCK);
+
+    size_rc = udp_socket_recv_batch(&rx, rmsgs, UDP_SOCKET_BATCH_MAX + 1,
+                                    false);
+    NIOVA_ASSERT(size_rc == -E2BIG);
+
+    size_rc = udp_socket_send_batch(&tx, smsgs, UDP_TEST_BATCH_NMSGS);
+    NIOVA_ASSERT(size_rc == UDP_TEST_BATCH_NMSGS);
+
+    for (int i = 0; i < UDP_TEST_BATCH_NMSGS; i++)
+        NIOVA_ASSERT(smsgs[i].usbm_len == (ssize_t)siov[i].iov_len);
+
+    // Loopback delivery is not necessarily complete when sendmmsg() returns
+    int nrecv = 0;
+    while (nrecv < UDP_TEST_BATCH_NMSGS)
+    {
+        size_rc = udp_socket_recv_batch(&rx, &rmsgs[nrecv],
+                                        UDP_TEST_BATCH_NMSGS - nrecv, true);
+        NIOVA_ASSERT(size_rc > 0);
+
+        nrecv += size_rc;
+    }
+
+    for (int i = 0; i < UDP_TEST_BATCH_NMSGS; i++)
+    {
+        NIOVA_ASSERT(rmsgs[i].usbm_len == (ssize_t)siov[i].iov_len);
+        NIOVA_ASSERT(ntohs(rmsgs[i].usbm_addr.sin_port) == tx.ush_port);
+        NIOVA_ASSERT(!memcmp(rbuf[i], sbuf[i], siov[i].iov_len));
+    }
+
+    // A datagram larger than its receive buffer is flagged
+    riov[0].iov_len = siov[1].iov_len - 1;
+
+    size_rc = udp_socket_send_batch(&tx, &smsgs[1], 1);
+    NIOVA_ASSERT(size_rc == 1);
+
+    size_rc = udp_socket_recv_batch(&rx, rmsgs, 1, true);
+    NIOVA_ASSERT(size_rc == 1 && rmsgs[0].usbm_len == -EBADMSG);
+
+    udp_socket_close(&tx);
+    udp_socket_close(&rx);
+
+    return 0;
+}
+
 static void
 udp_test_print_help(const int error)
 {
@@ -252,5 +363,11 @@ main(int argc, char **argv)
     if (rc)
         return rc;
 
+    rc = udp_test_batch();
+
+    STDERR_MSG("udp_test_batch(): %s", rc ? strerror(-rc) : "OK");
+    if (rc)
+        return rc;
+
     return 0;
 }